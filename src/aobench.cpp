@@ -0,0 +1,415 @@
+/**
+ * Times the flagging kernels and the default strategies on reproducible,
+ * synthesized data, and writes the results as JSON. The output of a previous
+ * run can be given as baseline, in which case benchmarks that became slower
+ * than the tolerance are reported and the exit code is non-zero.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "strategy/actions/strategy.h"
+
+#include "strategy/algorithms/baselineselector.h"
+#include "strategy/algorithms/highpassfilter.h"
+#include "strategy/algorithms/morphologicalflagger.h"
+#include "strategy/algorithms/polarizationstatistics.h"
+#include "strategy/algorithms/siroperator.h"
+#include "strategy/algorithms/sumthreshold.h"
+#include "strategy/algorithms/testsetgenerator.h"
+#include "strategy/algorithms/thresholdtools.h"
+
+#include "strategy/control/artifactset.h"
+#include "strategy/control/defaultstrategy.h"
+
+#include "structures/image2d.h"
+#include "structures/mask2d.h"
+#include "structures/timefrequencydata.h"
+
+#include "util/logger.h"
+#include "util/progresslistener.h"
+#include "util/simdsupport.h"
+#include "util/stopwatch.h"
+
+#include "version.h"
+
+namespace {
+
+struct Settings
+{
+	Settings() :
+		width(10000), height(256), repeats(5), seed(1),
+		tolerance(0.1), runStrategies(true)
+	{ }
+
+	size_t width, height, repeats;
+	unsigned seed;
+	double tolerance;
+	bool runStrategies;
+	std::string filter, outputFilename, baselineFilename;
+};
+
+struct Result
+{
+	std::string name;
+	/** Number of visibilities that are processed per run */
+	size_t samples;
+	/** Run times in seconds, sorted */
+	std::vector<double> seconds;
+
+	double Percentile(double p) const
+	{
+		const double index = p * (seconds.size() - 1);
+		const size_t low = size_t(index), high = std::min(low + 1, seconds.size() - 1);
+		return seconds[low] + (seconds[high] - seconds[low]) * (index - low);
+	}
+
+	double SamplesPerSecond() const
+	{
+		return samples / Percentile(0.5);
+	}
+};
+
+class BenchmarkRunner
+{
+public:
+	explicit BenchmarkRunner(const Settings& settings) : _settings(settings)
+	{ }
+
+	/**
+	 * Times @p run the configured number of times. @p prepare is called before
+	 * each run to reset the input, and is not timed.
+	 */
+	void Run(const std::string& name, size_t samples, const std::function<void()>& prepare, const std::function<void()>& run)
+	{
+		if(!_settings.filter.empty() && name.find(_settings.filter) == std::string::npos)
+			return;
+		Logger::Info << "Running " << name << "...\n";
+		Result result;
+		result.name = name;
+		result.samples = samples;
+		// The first run warms up caches and lazily initialized tables
+		prepare();
+		run();
+		for(size_t i=0; i!=_settings.repeats; ++i)
+		{
+			prepare();
+			Stopwatch watch(true);
+			run();
+			result.seconds.push_back(watch.Seconds());
+		}
+		std::sort(result.seconds.begin(), result.seconds.end());
+		_results.push_back(std::move(result));
+	}
+
+	const std::vector<Result>& Results() const { return _results; }
+
+private:
+	const Settings& _settings;
+	std::vector<Result> _results;
+};
+
+Image2DPtr makeTestImage(const Settings& settings, Mask2D& rfi)
+{
+	rfi = Mask2D::MakeSetMask<false>(settings.width, settings.height);
+	return Image2D::MakePtr(TestSetGenerator::MakeTestSet(26, rfi, settings.width, settings.height));
+}
+
+void benchmarkKernels(const Settings& settings, BenchmarkRunner& runner)
+{
+	const size_t samples = settings.width * settings.height;
+	Mask2D rfi = Mask2D::MakeSetMask<false>(settings.width, settings.height);
+	Image2DPtr image = makeTestImage(settings, rfi);
+	Mask2DPtr mask = Mask2D::CreateSetMaskPtr<false>(settings.width, settings.height);
+	Mask2D scratch = Mask2D::MakeUnsetMask(settings.width, settings.height);
+	auto clearMask = [&]() { mask->SetAll<false>(); };
+
+	num_t mean, stddev;
+	ThresholdTools::WinsorizedMeanAndStdDev(image.get(), mean, stddev);
+	const std::string simd = SIMDSupport::Name(SIMDSupport::Selected());
+	for(size_t length=1; length<=256; length*=2)
+	{
+		// The thresholds decrease with length like in the default strategies
+		const num_t threshold = mean + 6.0 * stddev * std::pow(1.5, -std::log2(double(length)));
+		std::ostringstream hName, vName;
+		hName << "sumthreshold-horizontal-" << length << "-" << simd;
+		vName << "sumthreshold-vertical-" << length << "-" << simd;
+		runner.Run(hName.str(), samples, clearMask, [&]() {
+			SumThreshold::HorizontalLarge(image.get(), mask.get(), &scratch, length, threshold);
+		});
+		runner.Run(vName.str(), samples, clearMask, [&]() {
+			SumThreshold::VerticalLarge(image.get(), mask.get(), &scratch, length, threshold);
+		});
+	}
+
+	runner.Run("sir-operator-horizontal", samples, [&]() { *mask = rfi; }, [&]() {
+		SIROperator::OperateHorizontally(*mask, 0.2);
+	});
+	runner.Run("sir-operator-vertical", samples, [&]() { *mask = rfi; }, [&]() {
+		SIROperator::OperateVertically(*mask, 0.2);
+	});
+
+	runner.Run("high-pass-filter", samples, clearMask, [&]() {
+		HighPassFilter filter;
+		filter.SetHWindowSize(21);
+		filter.SetVWindowSize(31);
+		filter.SetHKernelSigmaSq(2.5);
+		filter.SetVKernelSigmaSq(5.0);
+		filter.ApplyHighPass(image, mask);
+	});
+
+	runner.Run("winsorized-mean-stddev", samples, [&]() { *mask = rfi; }, [&]() {
+		num_t m, s;
+		ThresholdTools::WinsorizedMeanAndStdDev(image.get(), mask.get(), m, s);
+	});
+
+	runner.Run("dilate-flags", samples, [&]() { *mask = rfi; }, [&]() {
+		MorphologicalFlagger::DilateFlags(mask.get(), 2, 2);
+	});
+	runner.Run("density-time-flagger", samples, [&]() { *mask = rfi; }, [&]() {
+		MorphologicalFlagger::DensityTimeFlagger(mask.get(), 0.5);
+	});
+	runner.Run("density-frequency-flagger", samples, [&]() { *mask = rfi; }, [&]() {
+		MorphologicalFlagger::DensityFrequencyFlagger(mask.get(), 0.5);
+	});
+
+	runner.Run("shrink-horizontally-3", samples, [](){}, [&]() {
+		image->ShrinkHorizontally(3);
+	});
+	runner.Run("shrink-vertically-3", samples, [](){}, [&]() {
+		image->ShrinkVertically(3);
+	});
+	const Image2D shrunk = image->ShrinkHorizontally(3).ShrinkVertically(3);
+	runner.Run("enlarge-horizontally-3", samples, [](){}, [&]() {
+		shrunk.EnlargeHorizontally(3, settings.width);
+	});
+	runner.Run("enlarge-vertically-3", samples, [](){}, [&]() {
+		shrunk.EnlargeVertically(3, settings.height);
+	});
+}
+
+void benchmarkStrategies(const Settings& settings, BenchmarkRunner& runner)
+{
+	const size_t samples = settings.width * settings.height;
+	std::vector<Image2DPtr> images(8);
+	Mask2D rfi = Mask2D::MakeSetMask<false>(settings.width, settings.height);
+	for(Image2DPtr& image : images)
+		image = makeTestImage(settings, rfi);
+	const TimeFrequencyData data = TimeFrequencyData::FromLinear(
+		images[0], images[1], images[2], images[3],
+		images[4], images[5], images[6], images[7]);
+	TimeFrequencyData zeroData(data);
+	zeroData.SetImagesToZero();
+
+	const rfiStrategy::DefaultStrategy::TelescopeId telescopes[] = {
+		rfiStrategy::DefaultStrategy::GENERIC_TELESCOPE,
+		rfiStrategy::DefaultStrategy::AARTFAAC_TELESCOPE,
+		rfiStrategy::DefaultStrategy::ARECIBO_TELESCOPE,
+		rfiStrategy::DefaultStrategy::BIGHORNS_TELESCOPE,
+		rfiStrategy::DefaultStrategy::JVLA_TELESCOPE,
+		rfiStrategy::DefaultStrategy::LOFAR_TELESCOPE,
+		rfiStrategy::DefaultStrategy::MWA_TELESCOPE,
+		rfiStrategy::DefaultStrategy::PARKES_TELESCOPE,
+		rfiStrategy::DefaultStrategy::WSRT_TELESCOPE
+	};
+	for(rfiStrategy::DefaultStrategy::TelescopeId telescope : telescopes)
+	{
+		rfiStrategy::Strategy strategy;
+		rfiStrategy::DefaultStrategy::LoadSingleStrategy(strategy, rfiStrategy::DefaultStrategy::DetermineSetup(
+			telescope, rfiStrategy::DefaultStrategy::FLAG_NONE, 0.0, 0.0, 0.0));
+		std::unique_ptr<rfiStrategy::ArtifactSet> artifacts;
+		DummyProgressListener progressListener;
+		std::string name = rfiStrategy::DefaultStrategy::TelescopeName(telescope);
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		runner.Run("strategy-" + name, samples, [&]() {
+			artifacts.reset(new rfiStrategy::ArtifactSet(nullptr));
+			artifacts->SetOriginalData(data);
+			artifacts->SetContaminatedData(data);
+			artifacts->SetRevisedData(zeroData);
+			artifacts->SetPolarizationStatistics(std::unique_ptr<PolarizationStatistics>(new PolarizationStatistics()));
+			artifacts->SetBaselineSelectionInfo(std::unique_ptr<rfiStrategy::BaselineSelector>(new rfiStrategy::BaselineSelector()));
+		}, [&]() {
+			strategy.Perform(*artifacts, progressListener);
+		});
+	}
+}
+
+std::string escapeJSON(const std::string& str)
+{
+	std::string result;
+	for(char c : str)
+	{
+		if(c == '"' || c == '\\')
+			result += '\\';
+		result += c;
+	}
+	return result;
+}
+
+/**
+ * Each benchmark is written on its own line, so that the baseline can be
+ * read back without a JSON parser.
+ */
+void writeJSON(std::ostream& stream, const Settings& settings, const std::vector<Result>& results)
+{
+	stream << std::setprecision(6)
+		<< "{\n"
+		<< "  \"version\": \"" << AOFLAGGER_VERSION_STR << "\",\n"
+		<< "  \"simd\": \"" << SIMDSupport::Name(SIMDSupport::Selected()) << "\",\n"
+		<< "  \"width\": " << settings.width << ",\n"
+		<< "  \"height\": " << settings.height << ",\n"
+		<< "  \"repeats\": " << settings.repeats << ",\n"
+		<< "  \"seed\": " << settings.seed << ",\n"
+		<< "  \"benchmarks\": [\n";
+	for(size_t i=0; i!=results.size(); ++i)
+	{
+		const Result& r = results[i];
+		stream << "    { \"name\": \"" << escapeJSON(r.name) << "\""
+			<< ", \"samples\": " << r.samples
+			<< ", \"samples_per_second\": " << r.SamplesPerSecond()
+			<< ", \"min\": " << r.seconds.front()
+			<< ", \"p10\": " << r.Percentile(0.1)
+			<< ", \"median\": " << r.Percentile(0.5)
+			<< ", \"p90\": " << r.Percentile(0.9)
+			<< ", \"max\": " << r.seconds.back()
+			<< " }" << (i+1 == results.size() ? "\n" : ",\n");
+	}
+	stream << "  ]\n}\n";
+}
+
+bool readField(const std::string& line, const std::string& field, std::string& value)
+{
+	const std::string key = "\"" + field + "\": ";
+	size_t start = line.find(key);
+	if(start == std::string::npos)
+		return false;
+	start += key.size();
+	if(line[start] == '"')
+	{
+		const size_t end = line.find('"', start+1);
+		value = line.substr(start+1, end-start-1);
+	}
+	else {
+		value = line.substr(start, line.find_first_of(",}", start) - start);
+	}
+	return true;
+}
+
+/**
+ * Compares the results with a baseline file that was written by writeJSON().
+ * Returns the number of benchmarks that are slower than the tolerance allows.
+ */
+size_t compareWithBaseline(const Settings& settings, const std::vector<Result>& results)
+{
+	std::ifstream file(settings.baselineFilename);
+	if(!file)
+		throw std::runtime_error("Could not open baseline file " + settings.baselineFilename);
+	std::map<std::string, double> baseline;
+	std::string line, name, speed;
+	while(std::getline(file, line))
+	{
+		if(readField(line, "name", name) && readField(line, "samples_per_second", speed))
+			baseline[name] = std::atof(speed.c_str());
+	}
+
+	size_t regressions = 0;
+	for(const Result& r : results)
+	{
+		std::map<std::string, double>::const_iterator iter = baseline.find(r.name);
+		if(iter == baseline.end())
+			continue;
+		const double ratio = r.SamplesPerSecond() / iter->second;
+		const bool isRegression = ratio < 1.0 - settings.tolerance;
+		if(isRegression)
+			++regressions;
+		std::cerr << r.name << ": " << round(ratio*1000.0)/10.0 << "% of baseline"
+			<< (isRegression ? " (REGRESSION)" : "") << '\n';
+	}
+	return regressions;
+}
+
+void printSyntax(const char* program)
+{
+	std::cout << "Syntax: " << program << " [options]\n"
+		"Times the flagging kernels and default strategies on synthesized data\n"
+		"and writes the results as JSON.\n\n"
+		"Options:\n"
+		"  -width <n>          Number of timesteps of the test data (default: 10000).\n"
+		"  -height <n>         Number of channels of the test data (default: 256).\n"
+		"  -repeats <n>        Number of timed runs per benchmark (default: 5).\n"
+		"  -seed <n>           Seed for the random generator (default: 1).\n"
+		"  -filter <text>      Only run benchmarks whose name contains the text.\n"
+		"  -no-strategies      Only run the kernels, not the full strategies.\n"
+		"  -o <file>           Write the JSON to the file instead of to stdout.\n"
+		"  -baseline <file>    Compare with the JSON output of an earlier run.\n"
+		"  -tolerance <frac>   Allowed slowdown relative to the baseline (default: 0.1).\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings;
+	int argi = 1;
+	while(argi < argc && argv[argi][0] == '-')
+	{
+		const std::string p(argv[argi]+1);
+		if(p == "width" && argi+1 < argc) settings.width = std::atol(argv[++argi]);
+		else if(p == "height" && argi+1 < argc) settings.height = std::atol(argv[++argi]);
+		else if(p == "repeats" && argi+1 < argc) settings.repeats = std::max(1l, std::atol(argv[++argi]));
+		else if(p == "seed" && argi+1 < argc) settings.seed = std::atol(argv[++argi]);
+		else if(p == "filter" && argi+1 < argc) settings.filter = argv[++argi];
+		else if(p == "no-strategies") settings.runStrategies = false;
+		else if(p == "o" && argi+1 < argc) settings.outputFilename = argv[++argi];
+		else if(p == "baseline" && argi+1 < argc) settings.baselineFilename = argv[++argi];
+		else if(p == "tolerance" && argi+1 < argc) settings.tolerance = std::atof(argv[++argi]);
+		else {
+			printSyntax(argv[0]);
+			return p == "help" ? 0 : 1;
+		}
+		++argi;
+	}
+	if(argi != argc)
+	{
+		printSyntax(argv[0]);
+		return 1;
+	}
+
+	// Only the JSON is written to stdout
+	if(settings.outputFilename.empty())
+		Logger::SetVerbosity(Logger::QuietVerbosity);
+
+	std::srand(settings.seed);
+	BenchmarkRunner runner(settings);
+	benchmarkKernels(settings, runner);
+	if(settings.runStrategies)
+		benchmarkStrategies(settings, runner);
+
+	if(settings.outputFilename.empty())
+		writeJSON(std::cout, settings, runner.Results());
+	else {
+		std::ofstream file(settings.outputFilename);
+		writeJSON(file, settings, runner.Results());
+	}
+
+	if(!settings.baselineFilename.empty())
+	{
+		const size_t regressions = compareWithBaseline(settings, runner.Results());
+		if(regressions != 0)
+		{
+			Logger::Error << regressions << " benchmark(s) are slower than the baseline.\n";
+			return 2;
+		}
+	}
+	return 0;
+}
@@ -1,10 +1,14 @@
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <mutex>
 
 #include <libgen.h>
 
 #include "strategy/actions/foreachmsaction.h"
+#include "strategy/actions/pythonaction.h"
 #include "strategy/actions/strategy.h"
 
 #include "strategy/algorithms/baselineselector.h"
@@ -17,10 +21,12 @@
 #include "strategy/control/artifactset.h"
 #include "strategy/control/strategyreader.h"
 #include "strategy/control/defaultstrategy.h"
+#include "strategy/control/pythonstrategy.h"
 
 #include "structures/system.h"
 
 #include "util/logger.h"
+#include "util/memoryaccountant.h"
 #include "util/progresslistener.h"
 #include "util/stopwatch.h"
 #include "util/numberlist.h"
@@ -101,6 +107,23 @@ void generalInfo()
 		"Author: André Offringa (offringa@gmail.com)\n\n";
 }
 
+/**
+ * Parses a positive number of megabytes, as given to a command line option,
+ * into bytes. Returns false if the value is not such a number.
+ */
+bool parseMegabytes(const char* str, size_t& bytes)
+{
+	if(*str < '0' || *str > '9')
+		return false;
+	errno = 0;
+	char* end;
+	unsigned long megabytes = strtoul(str, &end, 10);
+	if(*end != 0 || errno == ERANGE || megabytes == 0 || megabytes > std::numeric_limits<size_t>::max() / (1024 * 1024))
+		return false;
+	bytes = size_t(megabytes) * 1024 * 1024;
+	return true;
+}
+
 int main(int argc, char **argv)
 {
 	if(argc == 1)
@@ -111,9 +134,13 @@ int main(int argc, char **argv)
 		"  -j overrides the number of threads specified in the strategy\n"
 		"     (default: one thread for each CPU core)\n"
 		"  -strategy <strategy>\n"
-		"     specifies a customized strategy\n"
+		"     specifies a customized strategy. A Python strategy (a .py file) is run on each\n"
+		"     baseline; it should set its flag function with aoflagger.set_flag_function().\n"
 		"  -direct-read\n"
 		"     Will perform the slowest IO but will always work.\n"
+		"  -direct-read-ahead <mb>\n"
+		"     Amount of memory for baselines that are read ahead in direct read mode (default: 512).\n"
+		"     More read-ahead allows larger, consecutive reads.\n"
 		"  -indirect-read\n"
 		"     Will reorder the measurement set before starting, which is normally faster but requires\n"
 		"     free disk space to reorder the data to.\n"
@@ -139,6 +166,14 @@ int main(int argc, char **argv)
 		"     no noticable difference. With a size of 100 the difference is mostly not problematic\n"
 		"     either. In some cases, splitting the data increases accuracy, in particular when the\n"
 		"     statistics in the set change significantly over time (e.g. rising Galaxy).\n"
+		"  -interval-guard <ntimes>\n"
+		"     When splitting the set with -max-interval-size, read the given number of extra\n"
+		"     timesteps on both sides of each interval, to avoid edge effects at the interval\n"
+		"     borders. Only the flags of the interval itself are written.\n"
+		"  -mem-limit <mb>\n"
+		"     Keep the memory use below the given number of megabytes, by reading fewer baselines ahead\n"
+		"     and by holding back threads. By default, the limit is the system memory or the memory\n"
+		"     limit of the cgroup (e.g. set by Slurm or Kubernetes), whichever is lower.\n"
 		"  -bands <list>\n"
 		"     Comma separated list of (zero-indexed) band ids to process\n"
 		"  -fields <list>\n"
@@ -169,6 +204,9 @@ int main(int argc, char **argv)
 	boost::optional<std::string> dataColumn;
 	boost::optional<std::pair<size_t, size_t>> interval;
 	boost::optional<size_t> maxIntervalSize;
+	boost::optional<size_t> readAheadSize;
+	boost::optional<size_t> memoryLimit;
+	size_t intervalGuardSize = 0;
 	boost::optional<bool> combineSPWs;
 	boost::optional<std::string> bandpass;
 	std::set<size_t> bands, fields;
@@ -200,6 +238,17 @@ int main(int argc, char **argv)
 		{
 			readMode = DirectReadMode;
 		}
+		else if(flag=="direct-read-ahead")
+		{
+			size_t bytes;
+			if(parameterIndex+1 >= (size_t) argc || !parseMegabytes(argv[parameterIndex+1], bytes))
+			{
+				Logger::Error << "Incorrect usage; parameter -direct-read-ahead needs a positive number of megabytes.\n";
+				return RETURN_CMDLINE_ERROR;
+			}
+			++parameterIndex;
+			readAheadSize = bytes;
+		}
 		else if(flag=="indirect-read")
 		{
 			readMode = IndirectReadMode;
@@ -261,6 +310,22 @@ int main(int argc, char **argv)
 			++parameterIndex;
 			maxIntervalSize = atoi(argv[parameterIndex]);
 		}
+		else if(flag == "mem-limit")
+		{
+			size_t bytes;
+			if(parameterIndex+1 >= (size_t) argc || !parseMegabytes(argv[parameterIndex+1], bytes))
+			{
+				Logger::Error << "Incorrect usage; parameter -mem-limit needs a positive number of megabytes.\n";
+				return RETURN_CMDLINE_ERROR;
+			}
+			++parameterIndex;
+			memoryLimit = bytes;
+		}
+		else if(flag == "interval-guard")
+		{
+			++parameterIndex;
+			intervalGuardSize = atoi(argv[parameterIndex]);
+		}
 		else
 		{
 			Logger::Error << "Incorrect usage; parameter \"" << argv[parameterIndex] << "\" not understood.\n";
@@ -275,6 +340,9 @@ int main(int argc, char **argv)
 			
 		checkRelease();
 
+		if(memoryLimit)
+			MemoryAccountant::SetLimit(memoryLimit.get());
+
 		if(!threadCount)
 			threadCount = System::ProcessorCount();
 		Logger::Debug << "Number of threads: " << threadCount.get() << "\n";
@@ -293,6 +361,8 @@ int main(int argc, char **argv)
 		if(interval)
 			fomAction->SetInterval(interval.get().first, interval.get().second);
 		fomAction->SetMaxIntervalSize(maxIntervalSize);
+		fomAction->SetIntervalGuardSize(intervalGuardSize);
+		fomAction->SetReadAheadSize(readAheadSize);
 		if(!bands.empty())
 			fomAction->Bands() = bands;
 		if(!fields.empty())
@@ -323,7 +393,17 @@ int main(int argc, char **argv)
 			std::unique_ptr<rfiStrategy::Strategy> subStrategy;
 			try {
 				Logger::Debug << "Opening strategy file '" << strategyFile.get() << "'\n";
-				subStrategy = reader.CreateStrategyFromFile(strategyFile.get());
+				if(rfiStrategy::PythonAction::IsPythonFile(strategyFile.get()))
+				{
+					// The flag function of a Python strategy is run on each baseline
+					// by the encapsulating ForEachBaselineAction below.
+					subStrategy.reset(new rfiStrategy::Strategy());
+					subStrategy->Add(std::unique_ptr<rfiStrategy::PythonAction>(
+						new rfiStrategy::PythonAction(PythonStrategy::ReadFile(strategyFile.get()))));
+				}
+				else {
+					subStrategy = reader.CreateStrategyFromFile(strategyFile.get());
+				}
 				Logger::Debug << "Strategy parsed succesfully.\n";
 			} catch(std::exception &e)
 			{
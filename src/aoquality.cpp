@@ -12,10 +12,18 @@
 #include "quality/statisticscollection.h"
 #include "quality/statisticsderivator.h"
 
+#include "structures/system.h"
+
 #include "remote/clusteredobservation.h"
 #include "remote/processcommander.h"
+#include "util/lane.h"
 #include "util/plot.h"
 
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <thread>
+
 #ifdef HAS_LOFARSTMAN
 #include <LofarStMan/Register.h>
 #include <AOFlagger/quality/histogramtablesformatter.h>
@@ -40,8 +48,191 @@ enum CollectingMode
 	CollectTimeFrequency
 };
 
-void actionCollect(const std::string &filename, enum CollectingMode mode, StatisticsCollection &statisticsCollection, HistogramCollection &histogramCollection, bool mwaChannels, size_t flaggedTimesteps, const std::set<size_t> &flaggedAntennae, const char* dataColumnName, size_t intervalStart, size_t intervalEnd)
+/**
+ * The settings of a collect run that the workers need.
+ */
+struct CollectSettings
+{
+	CollectSettings(CollectingMode _mode, unsigned _polarizationCount, bool _ignoreChannelZero, size_t _flaggedTimesteps, const std::set<size_t>& _flaggedAntennae, const std::vector<BandInfo>& _bands) :
+		mode(_mode), polarizationCount(_polarizationCount), ignoreChannelZero(_ignoreChannelZero),
+		flaggedTimesteps(_flaggedTimesteps), flaggedAntennae(_flaggedAntennae), bands(_bands)
+	{ }
+	
+	CollectingMode mode;
+	unsigned polarizationCount;
+	bool ignoreChannelZero;
+	size_t flaggedTimesteps;
+	const std::set<size_t>& flaggedAntennae;
+	const std::vector<BandInfo>& bands;
+	// std::vector<bool> can not provide a bool pointer
+	std::vector<char> correlatorFlags, correlatorFlagsForBadAntenna;
+};
+
+/**
+ * Consecutive rows of the measurement set that all have the same number of
+ * channels, so that their data can be read with a single call per column.
+ */
+struct RowChunk
+{
+	static const size_t MaxRows = 4096;
+	static const size_t MaxSize = 16*1024*1024;
+	
+	casacore::Vector<int> windows, antenna1, antenna2;
+	casacore::Vector<double> times;
+	std::vector<size_t> timestepIndices;
+	casacore::Array<casacore::Complex> data;
+	casacore::Array<bool> flags;
+};
+
+/**
+ * Collects the statistics of the chunks that are written to its lane into its
+ * own collections. The sample buffers are reused for all rows.
+ */
+struct CollectWorker
+{
+	explicit CollectWorker(const CollectSettings& _settings) :
+		settings(_settings),
+		chunks(2),
+		histograms(_settings.polarizationCount)
+	{
+		size_t maxChannels = 0;
+		for(const BandInfo& band : settings.bands)
+			maxChannels = std::max(maxChannels, band.channels.size());
+		samples.resize(settings.polarizationCount * maxChannels);
+		isRFI.reset(new bool[settings.polarizationCount * maxChannels]);
+	}
+	
+	void Run()
+	{
+		std::unique_ptr<RowChunk> chunk;
+		while(chunks.read(chunk))
+		{
+			// After an error, the chunks are still read, so that the reader
+			// does not block.
+			if(!exception)
+			{
+				try {
+					process(*chunk);
+				} catch(...) {
+					exception = std::current_exception();
+				}
+			}
+		}
+	}
+	
+	const CollectSettings& settings;
+	lane<std::unique_ptr<RowChunk>> chunks;
+	StatisticsCollection statistics;
+	HistogramCollection histograms;
+	std::exception_ptr exception;
+	
+private:
+	void process(const RowChunk& chunk)
+	{
+		const unsigned polarizationCount = settings.polarizationCount;
+		const casacore::Complex* dataIter = chunk.data.data();
+		const bool* flagIter = chunk.flags.data();
+		const bool* correlatorFlags = reinterpret_cast<const bool*>(settings.correlatorFlags.data());
+		const bool* correlatorFlagsForBadAntenna = reinterpret_cast<const bool*>(settings.correlatorFlagsForBadAntenna.data());
+		for(size_t i=0; i!=chunk.times.size(); ++i)
+		{
+			const double time = chunk.times[i];
+			const size_t timestepIndex = chunk.timestepIndices[i];
+			const unsigned antenna1Index = chunk.antenna1[i];
+			const unsigned antenna2Index = chunk.antenna2[i];
+			const unsigned bandIndex = chunk.windows[i];
+			const BandInfo& band = settings.bands[bandIndex];
+			const size_t channelCount = band.channels.size();
+			const bool antennaIsFlagged =
+				settings.flaggedAntennae.find(antenna1Index) != settings.flaggedAntennae.end() ||
+				settings.flaggedAntennae.find(antenna2Index) != settings.flaggedAntennae.end();
+			
+			const unsigned startChannel = settings.ignoreChannelZero ? 1 : 0;
+			const size_t sampleCount = channelCount - startChannel;
+			const casacore::Complex* rowData = dataIter + startChannel * polarizationCount;
+			const bool* rowFlags = flagIter + startChannel * polarizationCount;
+			for(size_t channel = 0; channel != sampleCount; ++channel)
+			{
+				for(unsigned p = 0; p < polarizationCount; ++p)
+				{
+					samples[p * sampleCount + channel] = *rowData;
+					isRFI[p * sampleCount + channel] = *rowFlags;
+					++rowData;
+					++rowFlags;
+				}
+			}
+			dataIter += channelCount * polarizationCount;
+			flagIter += channelCount * polarizationCount;
+			
+			const bool* origFlags = (antennaIsFlagged || timestepIndex < settings.flaggedTimesteps) ? correlatorFlagsForBadAntenna : correlatorFlags;
+			for(unsigned p = 0; p < polarizationCount; ++p)
+			{
+				const float* values = reinterpret_cast<const float*>(&samples[p * sampleCount]);
+				const bool* rfi = &isRFI[p * sampleCount];
+				switch(settings.mode)
+				{
+				case CollectDefault:
+					statistics.Add(antenna1Index, antenna2Index, time, bandIndex, p,
+						&values[0], &values[1], rfi, origFlags, sampleCount, 2, 1, 1);
+					break;
+				case CollectHistograms:
+					histograms.Add(antenna1Index, antenna2Index, p, &samples[p * sampleCount], rfi, sampleCount);
+					break;
+				case CollectTimeFrequency:
+					if(antennaIsFlagged || timestepIndex < settings.flaggedTimesteps)
+						statistics.Add(antenna1Index, antenna2Index, time, bandIndex, p,
+							&values[0], &values[1], rfi, origFlags, sampleCount, 2, 1, 1);
+					else
+						statistics.AddToTimeFrequency(antenna1Index, antenna2Index, time, bandIndex, p,
+							&values[0], &values[1], rfi, origFlags, sampleCount, 2, 1, 1);
+					break;
+				}
+			}
+		}
+	}
+	
+	std::vector<std::complex<float>> samples;
+	std::unique_ptr<bool[]> isRFI;
+};
+
+/**
+ * Finds the rows of the timesteps in the interval [intervalStart, intervalEnd).
+ * Only the time column is read for this.
+ */
+void findIntervalRows(casacore::ROScalarColumn<double>& timeColumn, size_t intervalStart, size_t intervalEnd, size_t& startRow, size_t& endRow)
+{
+	const size_t nrow = timeColumn.nrow(), blockSize = 1024*1024;
+	startRow = nrow;
+	endRow = nrow;
+	size_t timestepIndex = (size_t) -1;
+	double prevtime = -1.0;
+	casacore::Vector<double> times;
+	for(size_t blockStart = 0; blockStart < nrow; blockStart += blockSize)
+	{
+		const size_t n = std::min(blockSize, nrow - blockStart);
+		timeColumn.getColumnRange(casacore::Slicer(casacore::IPosition(1, blockStart), casacore::IPosition(1, n)), times, true);
+		for(size_t i=0; i!=n; ++i)
+		{
+			if(times[i] != prevtime)
+			{
+				++timestepIndex;
+				prevtime = times[i];
+				if(timestepIndex == intervalStart)
+					startRow = blockStart + i;
+				if(timestepIndex == intervalEnd)
+				{
+					endRow = blockStart + i;
+					return;
+				}
+			}
+		}
+	}
+}
+
+void actionCollect(const std::string &filename, enum CollectingMode mode, StatisticsCollection &statisticsCollection, HistogramCollection &histogramCollection, bool mwaChannels, size_t flaggedTimesteps, const std::set<size_t> &flaggedAntennae, const char* dataColumnName, size_t intervalStart, size_t intervalEnd, size_t threadCount)
 {
+	if(!(intervalStart == 0 && intervalEnd == 0) && intervalStart >= intervalEnd)
+		throw std::runtime_error("The start of the interval should be before its end");
 	std::unique_ptr<MSMetaData> ms(new MSMetaData(filename));
 	const unsigned polarizationCount = ms->PolarizationCount();
 	const unsigned bandCount = ms->BandCount();
@@ -70,17 +261,21 @@ void actionCollect(const std::string &filename, enum CollectingMode mode, Statis
 		std::cout << "Channel zero will be ignored, as this looks like a LOFAR data set with bad channel 0.\n";
 	
 	// Initialize statisticscollection
-	statisticsCollection.SetPolarizationCount(polarizationCount);
-	if(mode != CollectHistograms)
+	auto initializeStatistics = [&](StatisticsCollection& collection)
 	{
-		for(unsigned b=0;b<bandCount;++b)
+		collection.SetPolarizationCount(polarizationCount);
+		if(mode != CollectHistograms)
 		{
-			if(ignoreChannelZero)
-				statisticsCollection.InitializeBand(b, (frequencies[b].data()+1), bands[b].channels.size()-1);
-			else
-				statisticsCollection.InitializeBand(b, frequencies[b].data(), bands[b].channels.size());
+			for(unsigned b=0;b<bandCount;++b)
+			{
+				if(ignoreChannelZero)
+					collection.InitializeBand(b, (frequencies[b].data()+1), bands[b].channels.size()-1);
+				else
+					collection.InitializeBand(b, frequencies[b].data(), bands[b].channels.size());
+			}
 		}
-	}
+	};
+	initializeStatistics(statisticsCollection);
 	// Initialize Histograms collection
 	histogramCollection.SetPolarizationCount(polarizationCount);
 
@@ -95,14 +290,10 @@ void actionCollect(const std::string &filename, enum CollectingMode mode, Statis
 	
 	std::cout << "Collecting statistics..." << std::endl;
 	
+	CollectSettings settings(mode, polarizationCount, ignoreChannelZero, flaggedTimesteps, flaggedAntennae, bands);
 	size_t channelCount = bands[0].channels.size();
-	bool *correlatorFlags = new bool[channelCount];
-	bool *correlatorFlagsForBadAntenna = new bool[channelCount];
-	for(size_t ch=0; ch!=channelCount; ++ch)
-	{
-		correlatorFlags[ch] = false;
-		correlatorFlagsForBadAntenna[ch] = true;
-	}
+	settings.correlatorFlags.assign(channelCount, false);
+	settings.correlatorFlagsForBadAntenna.assign(channelCount, true);
 	
 	if(mwaChannels)
 	{
@@ -113,11 +304,11 @@ void actionCollect(const std::string &filename, enum CollectingMode mode, Statis
 			size_t sideCh = chanPerSb / 16;
 			for(size_t x=0;x!=24;++x)
 			{
-				correlatorFlags[x*chanPerSb + chanPerSb/2] = true;
+				settings.correlatorFlags[x*chanPerSb + chanPerSb/2] = true;
 				for(size_t side=0; side!=sideCh; ++side)
 				{
-					correlatorFlags[x*chanPerSb + side] = true;
-					correlatorFlags[x*chanPerSb + chanPerSb-1 - side] = true;
+					settings.correlatorFlags[x*chanPerSb + side] = true;
+					settings.correlatorFlags[x*chanPerSb + chanPerSb-1 - side] = true;
 				}
 			}
 		}
@@ -125,117 +316,103 @@ void actionCollect(const std::string &filename, enum CollectingMode mode, Statis
 	
 	bool hasInterval = !(intervalStart == 0 && intervalEnd == 0);
 	
-	const unsigned nrow = table.nrow();
+	const size_t nrow = table.nrow();
+	size_t startRow = 0, endRow = nrow;
 	size_t timestepIndex = (size_t) -1;
-	double prevtime = -1.0;
-	for(unsigned row = 0; row!=nrow; ++row)
+	if(hasInterval)
 	{
-		const double time = timeColumn(row);
-		
-		if(time != prevtime)
-		{
-			++timestepIndex;
-			prevtime = time;
-		}
-		
-		if(!hasInterval || (timestepIndex >= intervalStart && timestepIndex < intervalEnd))
+		findIntervalRows(timeColumn, intervalStart, intervalEnd, startRow, endRow);
+		timestepIndex = intervalStart - 1;
+	}
+	
+	// The rows are read on this thread, because casacore is not thread safe,
+	// and are processed by the workers in chunks of consecutive rows. Chunk i
+	// goes to worker i % threadCount, and each worker adds to its own
+	// collections, so that the result does not depend on the scheduling.
+	if(threadCount == 0)
+		threadCount = System::ProcessorCount();
+	std::vector<std::unique_ptr<CollectWorker>> workers;
+	for(size_t i=0; i!=threadCount; ++i)
+	{
+		workers.emplace_back(new CollectWorker(settings));
+		initializeStatistics(workers.back()->statistics);
+	}
+	std::vector<std::thread> threads;
+	for(std::unique_ptr<CollectWorker>& worker : workers)
+		threads.emplace_back([&worker]() { worker->Run(); });
+	
+	size_t chunkIndex = 0;
+	double prevtime = -1.0;
+	try {
+		size_t row = startRow;
+		while(row != endRow)
 		{
-			const unsigned antenna1Index = antenna1Column(row);
-			const unsigned antenna2Index = antenna2Column(row);
-			const unsigned bandIndex = windowColumn(row);
-			
-			const BandInfo& band = bands[bandIndex];
-			
-			const casacore::Array<casacore::Complex> dataArray = dataColumn(row);
-			const casacore::Array<bool> flagArray = flagColumn(row);
-			
-			std::vector<std::complex<float>* > samples(polarizationCount);
-			bool **isRFI = new bool*[polarizationCount];
-			for(unsigned p = 0; p < polarizationCount; ++p)
-			{
-				isRFI[p] = new bool[band.channels.size()];
-				samples[p] = new std::complex<float>[band.channels.size()];
-			}
-			const bool antennaIsFlagged =
-				flaggedAntennae.find(antenna1Index) != flaggedAntennae.end() ||
-				flaggedAntennae.find(antenna2Index) != flaggedAntennae.end();
+			// Read the band of the rows first, to cut the chunk where the number
+			// of channels changes, since the data of a chunk is read as one array.
+			std::unique_ptr<RowChunk> chunk(new RowChunk());
+			size_t chunkEnd = std::min(endRow, row + RowChunk::MaxRows);
+			windowColumn.getColumnRange(casacore::Slicer(casacore::IPosition(1, row), casacore::IPosition(1, chunkEnd-row)), chunk->windows, true);
+			const size_t chunkChannels = bands[chunk->windows[0]].channels.size();
+			const size_t maxRows = std::max<size_t>(1, RowChunk::MaxSize / (chunkChannels * polarizationCount * (sizeof(casacore::Complex) + sizeof(bool))));
+			size_t n = 1;
+			while(n != chunkEnd-row && n != maxRows && bands[chunk->windows[n]].channels.size() == chunkChannels)
+				++n;
+			chunkEnd = row + n;
+			chunk->windows.resize(n, true);
 			
-			casacore::Array<casacore::Complex>::const_contiter dataIter = dataArray.cbegin();
-			casacore::Array<bool>::const_contiter flagIter = flagArray.cbegin();
-			const unsigned startChannel = ignoreChannelZero ? 1 : 0;
-			if(ignoreChannelZero)
-			{
-				dataIter += polarizationCount;
-				flagIter += polarizationCount;
-			}
-			for(unsigned channel = startChannel ; channel<band.channels.size(); ++channel)
+			const casacore::Slicer rowRange(casacore::IPosition(1, row), casacore::IPosition(1, n));
+			timeColumn.getColumnRange(rowRange, chunk->times, true);
+			antenna1Column.getColumnRange(rowRange, chunk->antenna1, true);
+			antenna2Column.getColumnRange(rowRange, chunk->antenna2, true);
+			dataColumn.getColumnRange(rowRange, chunk->data, true);
+			flagColumn.getColumnRange(rowRange, chunk->flags, true);
+			chunk->timestepIndices.resize(n);
+			for(size_t i=0; i!=n; ++i)
 			{
-				for(unsigned p = 0; p < polarizationCount; ++p)
+				if(chunk->times[i] != prevtime)
 				{
-					samples[p][channel - startChannel] = *dataIter;
-					isRFI[p][channel - startChannel] = *flagIter;
-					
-					++dataIter;
-					++flagIter;
+					++timestepIndex;
+					prevtime = chunk->times[i];
 				}
+				chunk->timestepIndices[i] = timestepIndex;
+				reportProgress(row + i - startRow, endRow - startRow);
 			}
 			
-			for(unsigned p = 0; p < polarizationCount; ++p)
-			{
-				switch(mode)
-				{
-				case CollectDefault:
-					if(antennaIsFlagged || timestepIndex < flaggedTimesteps)
-						statisticsCollection.Add(antenna1Index, antenna2Index, time, bandIndex, p,
-																		&reinterpret_cast<float*>(samples[p])[0],
-																		&reinterpret_cast<float*>(samples[p])[1],
-																		isRFI[p], correlatorFlagsForBadAntenna, band.channels.size() - startChannel, 2, 1, 1);
-					else
-						statisticsCollection.Add(antenna1Index, antenna2Index, time, bandIndex, p,
-																		&reinterpret_cast<float*>(samples[p])[0],
-																		&reinterpret_cast<float*>(samples[p])[1],
-																		isRFI[p], correlatorFlags, band.channels.size() - startChannel, 2, 1, 1);
-					break;
-				case CollectHistograms:
-					histogramCollection.Add(antenna1Index, antenna2Index, p, samples[p], isRFI[p], band.channels.size() - startChannel);
-					break;
-				case CollectTimeFrequency:
-					if(antennaIsFlagged || timestepIndex < flaggedTimesteps)
-						statisticsCollection.Add(antenna1Index, antenna2Index, time, bandIndex, p,
-																		&reinterpret_cast<float*>(samples[p])[0],
-																		&reinterpret_cast<float*>(samples[p])[1],
-																		isRFI[p], correlatorFlagsForBadAntenna, band.channels.size() - startChannel, 2, 1, 1);
-					else
-						statisticsCollection.AddToTimeFrequency(antenna1Index, antenna2Index, time, bandIndex, p,
-																										&reinterpret_cast<float*>(samples[p])[0],
-																										&reinterpret_cast<float*>(samples[p])[1],
-																										isRFI[p], correlatorFlags, band.channels.size() - startChannel, 2, 1, 1);
-					break;
-				}
-			}
-
-			for(unsigned p = 0; p < polarizationCount; ++p)
-			{
-				delete[] isRFI[p];
-				delete[] samples[p];
-			}
-			delete[] isRFI;
-			
+			workers[chunkIndex % workers.size()]->chunks.write(std::move(chunk));
+			++chunkIndex;
+			row = chunkEnd;
 		}
-		reportProgress(row, nrow);
+	} catch(...) {
+		for(std::unique_ptr<CollectWorker>& worker : workers)
+			worker->chunks.write_end();
+		for(std::thread& thread : threads)
+			thread.join();
+		throw;
+	}
+	for(std::unique_ptr<CollectWorker>& worker : workers)
+		worker->chunks.write_end();
+	for(std::thread& thread : threads)
+		thread.join();
+	
+	for(std::unique_ptr<CollectWorker>& worker : workers)
+	{
+		if(worker->exception)
+			std::rethrow_exception(worker->exception);
+		if(mode == CollectHistograms)
+			histogramCollection.Add(worker->histograms);
+		else
+			statisticsCollection.Add(worker->statistics);
 	}
-	delete[] correlatorFlags;
-	delete[] correlatorFlagsForBadAntenna;
 	
 	std::cout << "100\n";
 }
 
-void actionCollect(const std::string &filename, enum CollectingMode mode, bool mwaChannels, size_t flaggedTimesteps, const std::set<size_t> &flaggedAntennae, const char* dataColumnName, size_t intervalStart, size_t intervalEnd)
+void actionCollect(const std::string &filename, enum CollectingMode mode, bool mwaChannels, size_t flaggedTimesteps, const std::set<size_t> &flaggedAntennae, const char* dataColumnName, size_t intervalStart, size_t intervalEnd, size_t threadCount)
 {
 	StatisticsCollection statisticsCollection;
 	HistogramCollection histogramCollection;
 	
-	actionCollect(filename, mode, statisticsCollection, histogramCollection, mwaChannels, flaggedTimesteps, flaggedAntennae, dataColumnName, intervalStart, intervalEnd);
+	actionCollect(filename, mode, statisticsCollection, histogramCollection, mwaChannels, flaggedTimesteps, flaggedAntennae, dataColumnName, intervalStart, intervalEnd, threadCount);
 	
 	switch(mode)
 	{
@@ -264,7 +441,7 @@ void actionCollect(const std::string &filename, enum CollectingMode mode, bool m
 void actionCollectHistogram(const std::string &filename, HistogramCollection &histogramCollection, bool mwaChannels, size_t flaggedTimesteps, const std::set<size_t> &flaggedAntennae, const char* dataColumnName)
 {
 	StatisticsCollection tempCollection;
-	actionCollect(filename, CollectHistograms, tempCollection, histogramCollection, mwaChannels, flaggedTimesteps, flaggedAntennae, dataColumnName, 0, 0);
+	actionCollect(filename, CollectHistograms, tempCollection, histogramCollection, mwaChannels, flaggedTimesteps, flaggedAntennae, dataColumnName, 0, 0, 0);
 }
 
 void printStatistics(std::complex<long double> *complexStat, unsigned count)
@@ -781,7 +958,7 @@ int main(int argc, char *argv[])
 				}
 				else if(helpAction == "collect")
 				{
-					std::cout << "Syntax: " << argv[0] << " collect [-d [column]/-tf/-h] <ms> [quack timesteps] [list of antennae]\n\n"
+					std::cout << "Syntax: " << argv[0] << " collect [-d [column]/-tf/-h/-j <threads>/-interval <start> <end>] <ms> [quack timesteps] [list of antennae]\n\n"
 						"The collect action will go over a whole measurement set and \n"
 						"collect the default statistics. It will write the results in the \n"
 						"quality subtables of the main measurement set.\n\n"
@@ -789,7 +966,10 @@ int main(int argc, char *argv[])
 						"\tRFIRatio, Count, Mean, SumP2, DCount, DMean, DSumP2.\n"
 						"The subtables that will be updated are:\n"
 						"\tQUALITY_KIND_NAME, QUALITY_TIME_STATISTIC,\n"
-						"\tQUALITY_FREQUENCY_STATISTIC and QUALITY_BASELINE_STATISTIC.\n\n";
+						"\tQUALITY_FREQUENCY_STATISTIC and QUALITY_BASELINE_STATISTIC.\n\n"
+						"The -j option sets the number of threads that process the data; the\n"
+						"default is the number of processors. The -interval option restricts\n"
+						"the collection to the timesteps start up to end.\n\n";
 				}
 				else if(helpAction == "summarize")
 				{
@@ -868,7 +1048,7 @@ int main(int argc, char *argv[])
 				int argi = 2;
 				bool histograms = false, timeFrequency = false;
 				const char* dataColumnName = "DATA";
-				size_t intervalStart = 0, intervalEnd = 0;
+				size_t intervalStart = 0, intervalEnd = 0, threadCount = 0;
 				while(argi < argc && argv[argi][0] == '-')
 				{
 					std::string p = &argv[argi][1];
@@ -883,10 +1063,19 @@ int main(int argc, char *argv[])
 						timeFrequency = true;
 					else if(p == "interval")
 					{
+						if(argi + 2 >= argc)
+							throw std::runtime_error("The -interval parameter of aoquality collect needs a start and end timestep");
 						intervalStart = atoi(argv[argi+1]);
 						intervalEnd = atoi(argv[argi+2]);
 						argi += 2;
 					}
+					else if(p == "j")
+					{
+						if(argi + 1 >= argc)
+							throw std::runtime_error("The -j parameter of aoquality collect needs the number of threads");
+						++argi;
+						threadCount = atoi(argv[argi]);
+					}
 					else throw std::runtime_error("Bad parameter given to aoquality collect");
 					++argi;
 				}
@@ -909,7 +1098,7 @@ int main(int argc, char *argv[])
 					mode = CollectTimeFrequency;
 				else
 					mode = CollectDefault;
-				actionCollect(filename, mode, mwacollect, flaggedTimesteps, flaggedAntennae, dataColumnName, intervalStart, intervalEnd);
+				actionCollect(filename, mode, mwacollect, flaggedTimesteps, flaggedAntennae, dataColumnName, intervalStart, intervalEnd, threadCount);
 			}
 		}
 		else if(action == "combine")
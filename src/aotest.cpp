@@ -2,7 +2,9 @@
 
 #include "test/strategy/algorithms/algorithmstestgroup.h"
 #include "test/experiments/experimentstestgroup.h"
+#include "test/interface/interfacetestgroup.h"
 #include "test/msio/msiotestgroup.h"
+#include "test/plot/plottestgroup.h"
 #include "test/quality/qualitytestgroup.h"
 #include "test/structures/structurestestgroup.h"
 #include "test/util/utiltestgroup.h"
@@ -45,6 +47,16 @@ int main(int argc, char *argv[])
 		structGroup.Run();
 		successes += structGroup.Successes();
 		failures += structGroup.Failures();
+		
+		PlotTestGroup plotGroup;
+		plotGroup.Run();
+		successes += plotGroup.Successes();
+		failures += plotGroup.Failures();
+		
+		InterfaceTestGroup interfaceGroup;
+		interfaceGroup.Run();
+		successes += interfaceGroup.Successes();
+		failures += interfaceGroup.Failures();
 	}
 	
 	if(argc > 1 && (std::string(argv[1])=="all" || std::string(argv[1])=="only"))
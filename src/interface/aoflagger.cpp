@@ -14,12 +14,19 @@
 #include "../strategy/control/defaultstrategy.h"
 #include "../strategy/control/strategyreader.h"
 
+#include "../structures/system.h"
+
 #include "../util/progresslistener.h"
 
 #include "../quality/histogramcollection.h"
 #include "../quality/statisticscollection.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <vector>
+#include <thread>
 #include <typeinfo>
 #include <memory>
 #include <mutex>
@@ -446,19 +453,42 @@ namespace aoflagger {
 		StatusListener *_destination;
 	};
 	
+	/**
+	 * The state that is needed to run a strategy, which is reused when
+	 * a thread runs the strategy several times.
+	 */
+	class RunContext {
+		public:
+			const Image2DCPtr& ZeroImage(size_t width, size_t height)
+			{
+				if(!zeroImage || zeroImage->Width() != width || zeroImage->Height() != height)
+					zeroImage = Image2D::CreateZeroImagePtr(width, height);
+				return zeroImage;
+			}
+			
+			std::mutex ioMutex;
+			ErrorListener errorListener;
+		private:
+			Image2DCPtr zeroImage;
+	};
+	
 	FlagMask AOFlagger::Run(Strategy& strategy, const ImageSet& input)
 	{
-		std::mutex mutex;
-		rfiStrategy::ArtifactSet artifacts(&mutex);
-		std::unique_ptr<ProgressListener> listener;
-		if(_statusListener == 0)
-			listener.reset(new ErrorListener());
-		else
-			listener.reset(new ForwardingListener(_statusListener));
+		RunContext context;
+		return run(strategy, input, context, _statusListener);
+	}
+	
+	FlagMask AOFlagger::run(Strategy& strategy, const ImageSet& input, RunContext& context, StatusListener* statusListener)
+	{
+		rfiStrategy::ArtifactSet artifacts(&context.ioMutex);
+		ForwardingListener forwardingListener(statusListener);
+		ProgressListener& listener = statusListener == nullptr ?
+			static_cast<ProgressListener&>(context.errorListener) :
+			static_cast<ProgressListener&>(forwardingListener);
 		
 		Mask2DPtr mask = Mask2D::CreateSetMaskPtr<false>(input.Width(), input.Height());
 		TimeFrequencyData inputData, revisedData;
-		Image2DPtr zeroImage = Image2D::CreateZeroImagePtr(input.Width(), input.Height());
+		const Image2DCPtr& zeroImage = context.ZeroImage(input.Width(), input.Height());
 		switch(input.ImageCount())
 		{
 		case 1:
@@ -504,9 +534,7 @@ namespace aoflagger {
 		artifacts.SetPolarizationStatistics(std::unique_ptr<PolarizationStatistics>(new PolarizationStatistics()));
 		artifacts.SetBaselineSelectionInfo(std::unique_ptr<rfiStrategy::BaselineSelector>(new rfiStrategy::BaselineSelector()));
 		
-		strategy._data->strategyPtr->Perform(artifacts, *listener);
-		
-		listener.reset();
+		strategy._data->strategyPtr->Perform(artifacts, listener);
 		
 		FlagMask flagMask;
 		mask.reset(new Mask2D(*artifacts.ContaminatedData().GetSingleMask()));
@@ -519,6 +547,306 @@ namespace aoflagger {
 	{
 		return Run(strategy, input);
 	}
+
+	/**
+	 * Worker threads that stay alive between calls to RunBatch(). Each worker
+	 * has its own RunContext. A batch is handed to all workers at once; they
+	 * take the inputs in order of index from a shared counter.
+	 */
+	class WorkerPool {
+		public:
+			explicit WorkerPool(size_t threadCount) :
+				_contexts(threadCount == 0 ? System::ProcessorCount() : threadCount),
+				_batch(nullptr),
+				_generation(0),
+				_activeWorkers(0),
+				_stop(false)
+			{
+				for(size_t i=0; i!=_contexts.size(); ++i)
+					_threads.emplace_back([this, i]() { workerLoop(i); });
+			}
+			
+			~WorkerPool()
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_stop = true;
+				_change.notify_all();
+				lock.unlock();
+				for(std::thread& thread : _threads)
+					thread.join();
+			}
+			
+			void Run(Strategy& strategy, const ImageSet* inputs, FlagMask* results, size_t count, StatusListener* statusListener)
+			{
+				Batch batch(strategy, inputs, results, count, statusListener);
+				// Batches of different callers are processed one after the other
+				std::lock_guard<std::mutex> batchLock(_batchMutex);
+				std::unique_lock<std::mutex> lock(_mutex);
+				_batch = &batch;
+				_activeWorkers = _threads.size();
+				++_generation;
+				_change.notify_all();
+				while(_activeWorkers != 0)
+					_finished.wait(lock);
+				_batch = nullptr;
+				lock.unlock();
+				if(batch.exception)
+					std::rethrow_exception(batch.exception);
+			}
+			
+		private:
+			struct Batch {
+				Batch(Strategy& _strategy, const ImageSet* _inputs, FlagMask* _results, size_t _count, StatusListener* _statusListener) :
+					strategy(_strategy), inputs(_inputs), results(_results), count(_count),
+					statusListener(_statusListener), next(0), exceptionIndex(_count)
+				{ }
+				
+				Strategy& strategy;
+				const ImageSet* inputs;
+				FlagMask* results;
+				size_t count;
+				StatusListener* statusListener;
+				std::atomic<size_t> next;
+				std::mutex exceptionMutex;
+				size_t exceptionIndex;
+				std::exception_ptr exception;
+			};
+			
+			void workerLoop(size_t workerIndex)
+			{
+				size_t generation = 0;
+				std::unique_lock<std::mutex> lock(_mutex);
+				while(true)
+				{
+					while(!_stop && _generation == generation)
+						_change.wait(lock);
+					if(_stop)
+						break;
+					generation = _generation;
+					Batch& batch = *_batch;
+					lock.unlock();
+					
+					for(size_t i = batch.next++; i < batch.count; i = batch.next++)
+					{
+						try {
+							batch.results[i] = AOFlagger::run(batch.strategy, batch.inputs[i], _contexts[workerIndex], batch.statusListener);
+						} catch(...) {
+							// Keep the exception of the lowest index, so that the
+							// reported exception does not depend on the scheduling.
+							std::lock_guard<std::mutex> exceptionLock(batch.exceptionMutex);
+							if(i < batch.exceptionIndex)
+							{
+								batch.exceptionIndex = i;
+								batch.exception = std::current_exception();
+							}
+						}
+					}
+					
+					lock.lock();
+					--_activeWorkers;
+					if(_activeWorkers == 0)
+						_finished.notify_all();
+				}
+			}
+			
+			std::vector<RunContext> _contexts;
+			std::vector<std::thread> _threads;
+			std::mutex _batchMutex, _mutex;
+			std::condition_variable _change, _finished;
+			Batch* _batch;
+			size_t _generation, _activeWorkers;
+			bool _stop;
+	};
+	
+	AOFlagger::~AOFlagger()
+	{
+		delete _pool;
+	}
+	
+	void AOFlagger::RunBatch(Strategy& strategy, const ImageSet* inputs, FlagMask* results, size_t count)
+	{
+		static std::mutex creationMutex;
+		std::unique_lock<std::mutex> lock(creationMutex);
+		if(_pool == nullptr)
+			_pool = new WorkerPool(0);
+		lock.unlock();
+		_pool->Run(strategy, inputs, results, count, _statusListener);
+	}
+	
+	void AOFlagger::SetThreadCount(size_t threadCount)
+	{
+		delete _pool;
+		_pool = new WorkerPool(threadCount);
+	}
+	
+	class StreamingFlaggerData {
+		public:
+			StreamingFlaggerData(const Strategy& _strategy, StatusListener* statusListener, size_t _height, size_t _count, size_t _chunkSize, size_t _guardSize) :
+				strategy(_strategy),
+				height(_height),
+				chunkSize(_chunkSize),
+				guardSize(_guardSize),
+				capacity(_chunkSize + 2*_guardSize),
+				start(0), end(0), emitted(0),
+				readyCount(0)
+			{
+				if(chunkSize == 0)
+					throw std::runtime_error("The chunk size of a streaming flagger should be at least one timestep");
+				flagger.SetStatusListener(statusListener);
+				ring = flagger.MakeImageSet(capacity, height, _count);
+				window = flagger.MakeImageSet(capacity, height, _count);
+			}
+			
+			void push(const ImageSet& timeSlice);
+			void flagWindow(size_t windowEnd);
+			
+			AOFlagger flagger;
+			Strategy strategy;
+			size_t height, chunkSize, guardSize, capacity;
+			/**
+			 * The ring buffer holds the timesteps [start, end), the first
+			 * 'emitted' timesteps have final flags. Timestep t is stored in
+			 * column t % capacity.
+			 */
+			ImageSet ring;
+			ImageSet window;
+			size_t start, end, emitted;
+			std::vector<FlagMask> readyFlags;
+			size_t readyCount;
+	};
+	
+	void StreamingFlaggerData::push(const ImageSet& timeSlice)
+	{
+		if(timeSlice.Height() != height || timeSlice.ImageCount() != ring.ImageCount())
+			throw std::runtime_error("The image set that was pushed to a streaming flagger has a different number of channels or images than the flagger was created for");
+		size_t sliceX = 0;
+		while(sliceX != timeSlice.Width())
+		{
+			// Copy no more than what is needed to complete the next window; this
+			// also guarantees that no columns are overwritten that are still needed.
+			const size_t n = std::min(timeSlice.Width() - sliceX, chunkSize + guardSize - (end - emitted));
+			for(size_t i=0; i!=ring.ImageCount(); ++i)
+			{
+				for(size_t y=0; y!=height; ++y)
+				{
+					const float* source = timeSlice.ImageBuffer(i) + y*timeSlice.HorizontalStride() + sliceX;
+					float* destRow = ring.ImageBuffer(i) + y*ring.HorizontalStride();
+					const size_t destX = end % capacity, firstPart = std::min(n, capacity - destX);
+					std::copy_n(source, firstPart, destRow + destX);
+					std::copy_n(source + firstPart, n - firstPart, destRow);
+				}
+			}
+			end += n;
+			sliceX += n;
+			if(end - emitted == chunkSize + guardSize)
+				flagWindow(end);
+		}
+	}
+	
+	/**
+	 * Runs the strategy on the timesteps up to windowEnd, preceded by at most
+	 * guardSize timesteps of which the flags have already been emitted, and
+	 * finalizes the flags of the timesteps that are not in the future guard.
+	 */
+	void StreamingFlaggerData::flagWindow(size_t windowEnd)
+	{
+		const size_t
+			windowStart = std::max(start, emitted > guardSize ? emitted - guardSize : 0),
+			width = windowEnd - windowStart,
+			chunkEnd = std::min(emitted + chunkSize, windowEnd);
+		// The window is not resized within its capacity, because the strategy
+		// combines images by their underlying buffers, which requires that they
+		// have the same stride. Only the first and last windows are smaller.
+		if(window.Width() != width)
+			window = flagger.MakeImageSet(width, height, ring.ImageCount());
+		for(size_t i=0; i!=ring.ImageCount(); ++i)
+		{
+			for(size_t y=0; y!=height; ++y)
+			{
+				const float* sourceRow = ring.ImageBuffer(i) + y*ring.HorizontalStride();
+				float* dest = window.ImageBuffer(i) + y*window.HorizontalStride();
+				const size_t sourceX = windowStart % capacity, firstPart = std::min(width, capacity - sourceX);
+				std::copy_n(sourceRow + sourceX, firstPart, dest);
+				std::copy_n(sourceRow, width - firstPart, dest + firstPart);
+			}
+		}
+		
+		const FlagMask windowFlags = flagger.Run(strategy, window);
+		
+		FlagMask chunkFlags = flagger.MakeFlagMask(chunkEnd - emitted, height);
+		for(size_t y=0; y!=height; ++y)
+		{
+			std::copy_n(windowFlags.Buffer() + y*windowFlags.HorizontalStride() + (emitted - windowStart),
+				chunkEnd - emitted,
+				chunkFlags.Buffer() + y*chunkFlags.HorizontalStride());
+		}
+		readyFlags.emplace_back(std::move(chunkFlags));
+		readyCount += chunkEnd - emitted;
+		emitted = chunkEnd;
+		if(emitted > start + guardSize)
+			start = emitted - guardSize;
+	}
+	
+	StreamingFlagger::StreamingFlagger(const Strategy& strategy, StatusListener* statusListener, size_t height, size_t count, size_t chunkSize, size_t guardSize) :
+		_data(new StreamingFlaggerData(strategy, statusListener, height, count, chunkSize, guardSize))
+	{ }
+	
+	StreamingFlagger::StreamingFlagger(StreamingFlagger&& source) :
+		_data(source._data)
+	{
+		source._data = nullptr;
+	}
+	
+	StreamingFlagger& StreamingFlagger::operator=(StreamingFlagger&& source)
+	{
+		std::swap(_data, source._data);
+		return *this;
+	}
+	
+	StreamingFlagger::~StreamingFlagger()
+	{
+		delete _data;
+	}
+	
+	void StreamingFlagger::Push(const ImageSet& timeSlice)
+	{
+		_data->push(timeSlice);
+	}
+	
+	void StreamingFlagger::Finish()
+	{
+		while(_data->emitted != _data->end)
+			_data->flagWindow(_data->end);
+		_data->start = _data->end;
+	}
+	
+	size_t StreamingFlagger::ReadyCount() const
+	{
+		return _data->readyCount;
+	}
+	
+	size_t StreamingFlagger::PendingCount() const
+	{
+		return _data->end - _data->emitted;
+	}
+	
+	FlagMask StreamingFlagger::TakeFlags()
+	{
+		FlagMask result = _data->flagger.MakeFlagMask(_data->readyCount, _data->height);
+		size_t x = 0;
+		for(const FlagMask& chunk : _data->readyFlags)
+		{
+			for(size_t y=0; y!=_data->height; ++y)
+			{
+				std::copy_n(chunk.Buffer() + y*chunk.HorizontalStride(), chunk.Width(),
+					result.Buffer() + y*result.HorizontalStride() + x);
+			}
+			x += chunk.Width();
+		}
+		_data->readyFlags.clear();
+		_data->readyCount = 0;
+		return result;
+	}
 	
 	QualityStatistics AOFlagger::MakeQualityStatistics(const double *scanTimes, size_t nScans, const double *channelFrequencies, size_t nChannels, size_t nPolarizations)
 	{
@@ -495,6 +495,80 @@ namespace aoflagger {
 			virtual void OnException(std::exception& thrownException) = 0;
 	};
 	
+	/** @brief Flags a baseline whose timesteps arrive in consecutive slices.
+	 * 
+	 * This is used when the data of a baseline can not be collected in full before
+	 * flagging, e.g. in a real-time pipeline. The caller pushes the timesteps
+	 * with Push() as they become available. The flagger keeps the most recent
+	 * timesteps in a ring buffer, and flags the data in windows of
+	 * @c chunkSize timesteps. Each window is extended on both sides with
+	 * @c guardSize timesteps of context, so that the flags near the edges of
+	 * a chunk are as accurate as when the full set would have been flagged at once.
+	 * Consequently, the flags of a timestep are final once @c guardSize further
+	 * timesteps have been pushed after its chunk. Final flags can be retrieved
+	 * with TakeFlags(). At the end of the stream, Finish() flags the remaining
+	 * timesteps without future context.
+	 * 
+	 * A StreamingFlagger is created with @ref AOFlagger::MakeStreamingFlagger().
+	 * An instance may only be used by one thread at a time, but different instances
+	 * can be used in parallel, also with the same Strategy.
+	 * @since Version 2.15
+	 */
+	class StreamingFlagger
+	{
+		public:
+			friend class AOFlagger;
+			
+			/** @brief Move construct a streaming flagger. */
+			StreamingFlagger(StreamingFlagger&& source);
+			
+			/** @brief Move assignment. */
+			StreamingFlagger& operator=(StreamingFlagger&& source);
+			
+			/** @brief Destruct the streaming flagger. Flags that have not been taken are lost. */
+			~StreamingFlagger();
+			
+			/** @brief Add the next timesteps of the baseline.
+			 * 
+			 * The slice should have the height and image count that were given when
+			 * constructing the flagger, and can have any width. Whenever enough timesteps
+			 * are available to flag a chunk, the strategy is run on the chunk and its
+			 * guard regions.
+			 * @param timeSlice Data of one or more timesteps that follow the previously pushed timesteps.
+			 */
+			void Push(const ImageSet& timeSlice);
+			
+			/** @brief Flag the timesteps that have not been flagged yet.
+			 * 
+			 * This ends the stream: the timesteps are flagged with the available past
+			 * context only. Timesteps that are pushed afterwards start a new stream.
+			 */
+			void Finish();
+			
+			/** @brief Number of timesteps for which final flags are available. */
+			size_t ReadyCount() const;
+			
+			/** @brief Number of timesteps that have been pushed but of which the flags are not final yet. */
+			size_t PendingCount() const;
+			
+			/** @brief Retrieve the final flags.
+			 * 
+			 * Returns a mask with the flags of the ReadyCount() timesteps that follow
+			 * the timesteps that were returned by the previous call, and removes them
+			 * from the flagger.
+			 * @return A mask of ReadyCount() timesteps by the number of channels.
+			 */
+			FlagMask TakeFlags();
+			
+		private:
+			StreamingFlagger(const Strategy& strategy, StatusListener* statusListener, size_t height, size_t count, size_t chunkSize, size_t guardSize);
+			
+			StreamingFlagger(const StreamingFlagger&) = delete;
+			void operator=(const StreamingFlagger&) = delete;
+			
+			class StreamingFlaggerData* _data;
+	};
+	
 	/** @brief Main class for access to the flagger functionality.
 	 * 
 	 * Software using the flagger should first create an instance of the @ref AOFlagger
@@ -523,6 +597,10 @@ namespace aoflagger {
 	 * To flag multiple baselines, the Strategy can be stored and the same instance can be used
 	 * again.
 	 * 
+	 * When the timesteps of a baseline arrive one by one, e.g. in a real-time pipeline,
+	 * a StreamingFlagger can be made with MakeStreamingFlagger(). It flags the data
+	 * in chunks as soon as enough timesteps have been pushed.
+	 * 
 	 * ### Thread safety
 	 * 
 	 * The Run() method is thread-safe, as long as different ImageSet instances are specified.
@@ -565,10 +643,10 @@ namespace aoflagger {
 	{
 		public:
 			/** @brief Create and initialize the flagger main class. */
-			AOFlagger() : _statusListener(nullptr) { }
+			AOFlagger() : _statusListener(nullptr), _pool(nullptr) { }
 			
-			/** @brief Destructor. */
-			~AOFlagger() { }
+			/** @brief Destructor. Stops the worker threads of RunBatch(), if any. */
+			~AOFlagger();
 			
 			/** @brief Create a new uninitialized @ref ImageSet with specified specs.
 			 * 
@@ -714,6 +792,54 @@ namespace aoflagger {
 			 */
 			FlagMask Run(Strategy& strategy, const ImageSet& input, const FlagMask& existingFlags);
 			
+			/** @brief Run the flagging strategy on several data sets in parallel.
+			 * 
+			 * Each input is flagged as if Run() was called on it, and the flags are stored
+			 * in the result with the same index, so the results do not depend on the number of
+			 * threads or on their scheduling. The inputs are divided over a pool of worker
+			 * threads that is created on the first call and is kept until the AOFlagger
+			 * instance is destructed. The workers reuse their buffers between runs, which
+			 * makes this faster than calling Run() for many small inputs.
+			 * 
+			 * Different threads may call this method on the same AOFlagger instance, but their
+			 * batches are processed one after the other. If the strategy throws an exception
+			 * for one of the inputs, the exception of the input with the lowest index is rethrown
+			 * after all inputs have been processed.
+			 * @param strategy The flagging strategy that will be used.
+			 * @param inputs Array of @p count data sets to run the flagger on.
+			 * @param results Array of @p count flag masks that will be assigned the flags of the corresponding input.
+			 * @param count Number of inputs.
+			 * @since Version 2.15
+			 */
+			void RunBatch(Strategy& strategy, const ImageSet* inputs, FlagMask* results, size_t count);
+			
+			/** @brief Set the number of worker threads used by RunBatch().
+			 * 
+			 * By default, one thread per processor is used. This method is not thread safe,
+			 * and should not be called while RunBatch() is running.
+			 * @param threadCount Number of worker threads, or zero to use one per processor.
+			 * @since Version 2.15
+			 */
+			void SetThreadCount(size_t threadCount);
+			
+			/** @brief Create a flagger for a baseline of which the timesteps are given in consecutive slices.
+			 * 
+			 * See the @ref StreamingFlagger class description for details. Larger chunks
+			 * require fewer runs of the strategy, and larger guards make the flags at the chunk
+			 * edges more accurate, but both increase the latency and memory use.
+			 * @param strategy The flagging strategy that will be used.
+			 * @param height Number of frequency channels of the pushed data.
+			 * @param count Number of images in the pushed image sets (see the @ref ImageSet class description).
+			 * @param chunkSize Number of timesteps for which flags are finalized per run of the strategy.
+			 * @param guardSize Number of timesteps that are added as context on both sides of a chunk.
+			 * @return A new StreamingFlagger.
+			 * @since Version 2.15
+			 */
+			StreamingFlagger MakeStreamingFlagger(Strategy& strategy, size_t height, size_t count, size_t chunkSize, size_t guardSize)
+			{
+				return StreamingFlagger(strategy, _statusListener, height, count, chunkSize, guardSize);
+			}
+			
 			/** @brief Create a new object for collecting statistics.
 			 * 
 			 * See the QualityStatistics class description for info on multithreading and/or combining statistics
@@ -806,7 +932,12 @@ namespace aoflagger {
 			 */
 			void operator=(const AOFlagger&) = delete;
 			
+			friend class WorkerPool;
+			
+			static FlagMask run(Strategy& strategy, const ImageSet& input, class RunContext& context, StatusListener* statusListener);
+			
 			StatusListener* _statusListener;
+			class WorkerPool* _pool;
 	};
 
 }
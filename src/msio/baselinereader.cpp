@@ -43,7 +43,7 @@ void BaselineReader::initObservationTimes()
 			unsigned index = 0;
 			for(double t : times)
 			{
-				_observationTimes[sequenceId].emplace(t, index);
+				_observationTimes[sequenceId].emplace_hint(_observationTimes[sequenceId].end(), t, index);
 				_observationTimesVector.push_back(t);
 				++index;
 			}
@@ -9,6 +9,7 @@
 
 #include <boost/optional/optional.hpp>
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <stdexcept>
@@ -70,7 +71,7 @@ public:
 	
 	void AddWriteTask(std::vector<Mask2DCPtr> flags, int antenna1, int antenna2, int spectralWindow, unsigned sequenceId)
 	{
-		initializePolarizations();
+		initializeMeta();
 		if(flags.size() != _polarizations.size())
 		{
 			std::stringstream s;
@@ -85,8 +86,12 @@ public:
 		task.sequenceId = sequenceId;
 		task.startIndex = 0;
 		task.endIndex = flags[0]->Width();
-		task.leftBorder = 0;
-		task.rightBorder = 0;
+		// Timesteps outside the flag write interval are not written
+		const size_t
+			writeStart = FlagWriteStart() - IntervalStart(),
+			writeEnd = FlagWriteEnd() - IntervalStart();
+		task.leftBorder = std::min(writeStart, task.endIndex);
+		task.rightBorder = task.endIndex > writeEnd ? task.endIndex - writeEnd : 0;
 		_writeRequests.push_back(task);
 	}
 	
@@ -112,6 +117,27 @@ public:
 			_msMetaData.SetIntervalEnd(IntervalEnd());
 	}
 	
+	/**
+	 * Restricts writing of flags to the given timesteps, which should lie
+	 * within the interval. The other timesteps of the interval are read and
+	 * flagged to provide context (e.g. guard timesteps that overlap with a
+	 * neighbouring interval), but their flags in the set are left unchanged.
+	 */
+	void SetFlagWriteInterval(boost::optional<size_t> start, boost::optional<size_t> end)
+	{
+		_flagWriteStart = start;
+		_flagWriteEnd = end;
+	}
+	
+	size_t FlagWriteStart() const
+	{
+		return _flagWriteStart ? std::max(_flagWriteStart.get(), IntervalStart()) : IntervalStart();
+	}
+	size_t FlagWriteEnd() const
+	{
+		return _flagWriteEnd ? std::min(_flagWriteEnd.get(), IntervalEnd()) : IntervalEnd();
+	}
+	
 	bool HasIntervalStart() const { return (bool) _intervalStart; }
 	bool HasIntervalEnd() const { return (bool) _intervalEnd; }
 	
@@ -187,6 +213,16 @@ protected:
 	{
 		return _observationTimes;
 	}
+	
+	/**
+	 * Whether flags of the given timestep (counted from the start of the
+	 * interval) should be written to the set.
+	 */
+	bool isInFlagWriteInterval(size_t timeIndexInSequence) const
+	{
+		const size_t timeIndex = timeIndexInSequence + IntervalStart();
+		return timeIndex >= FlagWriteStart() && timeIndex < FlagWriteEnd();
+	}
 
 	std::vector<ReadRequest> _readRequests;
 	std::vector<FlagWriteRequest> _writeRequests;
@@ -221,6 +257,7 @@ private:
 	std::vector<double> _observationTimesVector;
 	std::vector<PolarizationEnum> _polarizations;
 	boost::optional<size_t> _intervalStart, _intervalEnd;
+	boost::optional<size_t> _flagWriteStart, _flagWriteEnd;
 };
 
 #endif // BASELINEREADER_H
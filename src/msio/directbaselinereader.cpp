@@ -4,19 +4,41 @@
 
 #include "../structures/timefrequencydata.h"
 
+#include "../util/lane.h"
 #include "../util/logger.h"
 #include "../util/stopwatch.h"
 
 #include <casacore/tables/DataMan/TiledStManAccessor.h>
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
-#include <vector>
+#include <algorithm>
 #include <set>
 #include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+	// Maximum size of the data of a run of rows that is read at once
+	const size_t MaxSlabSize = 8*1024*1024;
+}
+
+/**
+ * A run of consecutive rows of the same band, read with one call per column.
+ */
+struct DirectBaselineReader::RowSlab
+{
+	size_t channelCount;
+	std::vector<size_t> requestIndices;
+	casacore::Vector<double> times;
+	casacore::Array<double> uvw;
+	casacore::Array<casacore::Complex> data, model;
+	casacore::Array<bool> flags;
+};
 
 DirectBaselineReader::DirectBaselineReader(const std::string &msFile) :
 	BaselineReader(msFile),
-	_ms(OpenMS())
+	_ms(OpenMS()),
+	_readAheadSize(DefaultReadAheadSize)
 {
 }
 
@@ -38,6 +60,7 @@ void DirectBaselineReader::initBaselineCache()
 	casacore::ScalarColumn<int> dataDescIdColumn(_ms, "DATA_DESC_ID");
 	
 	MSSelection msSelection(_ms, ObservationTimesPerSequence());
+	msSelection.SetRowRange(MetaData().GetIntervalRowRange());
 	msSelection.Process(
 		[&](size_t rowIndex, size_t sequenceId, size_t /*timeIndexInSequence*/)
 	{
@@ -146,7 +169,6 @@ void DirectBaselineReader::PerformReadRequests()
 	}
 
 	casacore::ScalarColumn<double> timeColumn(_ms, "TIME");
-	casacore::ArrayColumn<float> weightColumn(_ms, "WEIGHT");
 	casacore::ArrayColumn<double> uvwColumn(_ms, "UVW");
 	casacore::ArrayColumn<bool> flagColumn(_ms, "FLAG");
 	std::unique_ptr<casacore::ArrayColumn<casacore::Complex>> modelColumn, dataColumn;
@@ -157,48 +179,153 @@ void DirectBaselineReader::PerformReadRequests()
 	if(SubtractModel())
 		modelColumn.reset( new casacore::ArrayColumn<casacore::Complex>(_ms, "MODEL_DATA") );
 
-	for(std::pair<size_t, size_t> p : rows)
+	// Runs of consecutive rows are read with one call per column. Another
+	// thread copies the slab into the images, while the next slab is read.
+	lane<std::unique_ptr<RowSlab>> slabLane(2);
+	std::thread scatterThread([&]() {
+		std::unique_ptr<RowSlab> slab;
+		while(slabLane.read(slab))
+			scatterSlab(*slab);
+	});
+	
+	size_t slabCount = 0;
+	try {
+		size_t runStart = 0;
+		while(runStart != rows.size())
+		{
+			const size_t runEnd = endOfRowRun(rows, runStart, _readRequests);
+			std::unique_ptr<RowSlab> slab(new RowSlab());
+			slab->channelCount = MetaData().FrequencyCount(_readRequests[rows[runStart].second].spectralWindow);
+			for(size_t i=runStart; i!=runEnd; ++i)
+				slab->requestIndices.push_back(rows[i].second);
+			
+			casacore::Slicer rowRange(casacore::IPosition(1, rows[runStart].first), casacore::IPosition(1, rows[runEnd-1].first), casacore::Slicer::endIsLast);
+			timeColumn.getColumnRange(rowRange, slab->times, true);
+			uvwColumn.getColumnRange(rowRange, slab->uvw, true);
+			if(ReadData())
+				dataColumn->getColumnRange(rowRange, slab->data, true);
+			if(modelColumn != nullptr)
+				modelColumn->getColumnRange(rowRange, slab->model, true);
+			if(ReadFlags())
+				flagColumn.getColumnRange(rowRange, slab->flags, true);
+			
+			slabLane.write(std::move(slab));
+			++slabCount;
+			runStart = runEnd;
+		}
+	} catch(...) {
+		slabLane.write_end();
+		scatterThread.join();
+		throw;
+	}
+	slabLane.write_end();
+	scatterThread.join();
+	
+	Logger::Debug << "Time of ReadRequests(): " << stopwatch.ToString() << ", " << rows.size() << " rows in " << slabCount << " slabs.\n";
+
+	_readRequests.clear();
+}
+
+template<typename RequestType>
+size_t DirectBaselineReader::endOfRowRun(const std::vector<std::pair<size_t, size_t>>& rows, size_t start, const std::vector<RequestType>& requests)
+{
+	const size_t
+		band = requests[rows[start].second].spectralWindow,
+		bytesPerRow = MetaData().FrequencyCount(band) * Polarizations().size() * sizeof(casacore::Complex) * 2,
+		maxRows = std::max<size_t>(1, MaxSlabSize / bytesPerRow);
+	size_t end = start + 1;
+	while(end != rows.size() && end - start < maxRows &&
+		rows[end].first == rows[end-1].first + 1 &&
+		requests[rows[end].second].spectralWindow == band)
+		++end;
+	return end;
+}
+
+void DirectBaselineReader::scatterSlab(const RowSlab& slab)
+{
+	const size_t
+		polarizationCount = Polarizations().size(),
+		frequencyCount = slab.channelCount,
+		samplesPerRow = frequencyCount * polarizationCount;
+	const bool subtractModel = slab.model.nelements() != 0;
+	const casacore::Complex* slabData = slab.data.data();
+	const casacore::Complex* slabModel = slab.model.data();
+	const bool* slabFlags = slab.flags.data();
+	const double* slabUVW = slab.uvw.data();
+	
+	for(size_t rowOffset=0; rowOffset!=slab.requestIndices.size(); ++rowOffset)
 	{
-		size_t rowIndex = p.first;
-		size_t requestIndex = p.second;
-		
-		double time = timeColumn(rowIndex);
+		const size_t requestIndex = slab.requestIndices[rowOffset];
 		const ReadRequest &request = _readRequests[requestIndex];
-		size_t
-			timeIndex = ObservationTimes(request.sequenceId).find(time)->second,
-			startIndex = request.startIndex,
-			endIndex = request.endIndex,
-			band = request.spectralWindow;
-		bool timeIsSelected = timeIndex>=startIndex && timeIndex<endIndex;
-		if(ReadData() && timeIsSelected)
+		const size_t timeIndex = ObservationTimes(request.sequenceId).find(slab.times[rowOffset])->second;
+		if(timeIndex < request.startIndex || timeIndex >= request.endIndex)
+			continue;
+		const size_t x = timeIndex - request.startIndex;
+		Result& result = _results[requestIndex];
+		
+		const double* uvwPtr = &slabUVW[rowOffset * 3];
+		result._uvw[x].u = uvwPtr[0];
+		result._uvw[x].v = uvwPtr[1];
+		result._uvw[x].w = uvwPtr[2];
+		
+		for(size_t p=0; p!=polarizationCount; ++p)
 		{
-			//if(BaselineReader::DataKind() == WeightData)
-			//	readWeights(requestIndex, timeIndex-startIndex, MetaData().FrequencyCount(band), weightColumn(rowIndex));
-			//else
-			if(modelColumn == nullptr)
-				readTimeData(requestIndex, timeIndex-startIndex, MetaData().FrequencyCount(band), (*dataColumn)(rowIndex), 0);
-			else {
-				const casacore::Array<casacore::Complex> model = (*modelColumn)(rowIndex); 
-				readTimeData(requestIndex, timeIndex-startIndex, MetaData().FrequencyCount(band), (*dataColumn)(rowIndex), &model);
+			if(ReadData())
+			{
+				const casacore::Complex* dataPtr = &slabData[rowOffset * samplesPerRow + p];
+				const casacore::Complex* modelPtr = subtractModel ? &slabModel[rowOffset * samplesPerRow + p] : nullptr;
+				Image2D& real = *result._realImages[p];
+				Image2D& imag = *result._imaginaryImages[p];
+				const size_t stride = real.Stride();
+				num_t* realOutPtr = real.ValuePtr(x, 0);
+				num_t* imagOutPtr = imag.ValuePtr(x, 0);
+				for(size_t ch=0; ch!=frequencyCount; ++ch)
+				{
+					if(subtractModel)
+					{
+						*realOutPtr = dataPtr->real() - modelPtr->real();
+						*imagOutPtr = dataPtr->imag() - modelPtr->imag();
+						modelPtr += polarizationCount;
+					} else {
+						*realOutPtr = dataPtr->real();
+						*imagOutPtr = dataPtr->imag();
+					}
+					realOutPtr += stride;
+					imagOutPtr += stride;
+					dataPtr += polarizationCount;
+				}
+			}
+			if(ReadFlags())
+			{
+				const bool* flagPtr = &slabFlags[rowOffset * samplesPerRow + p];
+				Mask2D& mask = *result._flags[p];
+				const size_t stride = mask.Stride();
+				bool* flagOutPtr = mask.ValuePtr(x, 0);
+				for(size_t ch=0; ch!=frequencyCount; ++ch)
+				{
+					*flagOutPtr = *flagPtr;
+					flagOutPtr += stride;
+					flagPtr += polarizationCount;
+				}
 			}
-		}
-		if(ReadFlags() && timeIsSelected) {
-			readTimeFlags(requestIndex, timeIndex-startIndex, MetaData().FrequencyCount(band), flagColumn(rowIndex));
-		}
-		if(timeIsSelected) {
-			casacore::Array<double> arr = uvwColumn(rowIndex);
-			casacore::Array<double>::const_iterator i = arr.begin();
-			_results[requestIndex]._uvw[timeIndex-startIndex].u = *i;
-			++i;
-			_results[requestIndex]._uvw[timeIndex-startIndex].v = *i;
-			++i;
-			_results[requestIndex]._uvw[timeIndex-startIndex].w = *i;
 		}
 	}
-	
-	Logger::Debug << "Time of ReadRequests(): " << stopwatch.ToString() << '\n';
+}
 
-	_readRequests.clear();
+size_t DirectBaselineReader::GetMaxRecommendedBufferSize(size_t threadCount)
+{
+	const size_t minimum = 2*threadCount;
+	if(_readAheadSize == 0)
+		return minimum;
+	initializeMeta();
+	size_t timestepCount = 0, channelCount = 0;
+	for(size_t sequenceId=0; sequenceId!=ObservationTimesPerSequence().size(); ++sequenceId)
+		timestepCount = std::max(timestepCount, ObservationTimes(sequenceId).size());
+	for(size_t band=0; band!=MetaData().BandCount(); ++band)
+		channelCount = std::max<size_t>(channelCount, MetaData().FrequencyCount(band));
+	const size_t baselineSize = std::max<size_t>(1,
+		timestepCount * channelCount * Polarizations().size() * (2*sizeof(num_t) + sizeof(bool)));
+	return std::max(minimum, _readAheadSize / baselineSize);
 }
 
 std::vector<UVW> DirectBaselineReader::ReadUVW(unsigned antenna1, unsigned antenna2, unsigned spectralWindow, unsigned sequenceId)
@@ -285,82 +412,54 @@ void DirectBaselineReader::PerformFlagWriteRequests()
 		}
 	}
 
-	size_t rowsWritten = 0;
-
-	for(std::vector<std::pair<size_t, size_t> >::const_iterator i=rows.begin();i!=rows.end();++i)
+	// The flags of a run of consecutive rows are read, updated and written back
+	// with one call each. Rows of the run that are not written keep their
+	// flags.
+	size_t rowsWritten = 0, slabCount = 0;
+	const size_t polarizationCount = Polarizations().size();
+	casacore::Vector<double> times;
+	casacore::Array<bool> flags;
+	size_t runStart = 0;
+	while(runStart != rows.size())
 	{
-		size_t rowIndex = i->first;
-		FlagWriteRequest &request = _writeRequests[i->second];
-		double time = timeColumn(rowIndex);
-		size_t timeIndex = ObservationTimes(request.sequenceId).find(time)->second;
-		if(timeIndex >= request.startIndex + request.leftBorder && timeIndex < request.endIndex - request.rightBorder)
+		const size_t runEnd = endOfRowRun(rows, runStart, _writeRequests);
+		casacore::Slicer rowRange(casacore::IPosition(1, rows[runStart].first), casacore::IPosition(1, rows[runEnd-1].first), casacore::Slicer::endIsLast);
+		timeColumn.getColumnRange(rowRange, times, true);
+		flagColumn.getColumnRange(rowRange, flags, true);
+		
+		bool* flagPtr = flags.data();
+		bool isChanged = false;
+		for(size_t i=runStart; i!=runEnd; ++i)
 		{
-			casacore::Array<bool> flag = flagColumn(rowIndex);
-			casacore::Array<bool>::iterator j = flag.begin();
-			for(size_t f=0;f<(size_t) MetaData().FrequencyCount(request.spectralWindow);++f) {
-				for(size_t p=0;p<Polarizations().size();++p)
-				{
-					*j = request.flags[p]->Value(timeIndex - request.startIndex, f);
-					++j;
+			FlagWriteRequest &request = _writeRequests[rows[i].second];
+			const size_t frequencyCount = MetaData().FrequencyCount(request.spectralWindow);
+			const size_t timeIndex = ObservationTimes(request.sequenceId).find(times[i - runStart])->second;
+			if(timeIndex >= request.startIndex + request.leftBorder && timeIndex < request.endIndex - request.rightBorder &&
+				isInFlagWriteInterval(timeIndex))
+			{
+				bool* j = flagPtr;
+				for(size_t f=0;f<frequencyCount;++f) {
+					for(size_t p=0;p<polarizationCount;++p)
+					{
+						*j = request.flags[p]->Value(timeIndex - request.startIndex, f);
+						++j;
+					}
 				}
+				isChanged = true;
+				++rowsWritten;
 			}
-			flagColumn.basePut(rowIndex, flag);
-			++rowsWritten;
+			flagPtr += frequencyCount * polarizationCount;
 		}
-	}
-	_writeRequests.clear();
-	
-	Logger::Debug << rowsWritten << "/" << rows.size() << " rows written in " << stopwatch.ToString() << '\n';
-}
-
-void DirectBaselineReader::readTimeData(size_t requestIndex, size_t xOffset, int frequencyCount, const casacore::Array<casacore::Complex> data, const casacore::Array<casacore::Complex> *model)
-{
-	casacore::Array<casacore::Complex>::const_iterator i = data.begin();
-	casacore::Array<casacore::Complex>::const_iterator m;
-	if(DataKind() == ResidualData)
-		m = model->begin();
-
-	size_t polarizationCount = Polarizations().size();
-
-	for(size_t f=0;f<(size_t) frequencyCount;++f) {
-		num_t rv,iv;
-
-		for(size_t p=0;p<polarizationCount;++p)
+		if(isChanged)
 		{
-			if(DataKind() == ResidualData)
-			{
-				const casacore::Complex &iData = *i;
-				const casacore::Complex &iModel = *m;
-				++i; ++m;
-
-				rv = iData.real() - iModel.real();
-				iv = iData.imag() - iModel.imag();
-			} else {
-				const casacore::Complex &complex = *i;
-				++i;
-
-				rv = complex.real();
-				iv = complex.imag();
-			}
-			_results[requestIndex]._realImages[p]->SetValue(xOffset, f, rv);
-			_results[requestIndex]._imaginaryImages[p]->SetValue(xOffset, f, iv);
+			flagColumn.putColumnRange(rowRange, flags);
+			++slabCount;
 		}
+		runStart = runEnd;
 	}
-}
-
-void DirectBaselineReader::readTimeFlags(size_t requestIndex, size_t xOffset, int frequencyCount, const casacore::Array<bool> flag)
-{
-	size_t polarizationCount = Polarizations().size();
-
-	casacore::Array<bool>::const_iterator j = flag.begin();
-	for(size_t f=0;f<(size_t) frequencyCount;++f) {
-		for(size_t p=0;p<polarizationCount;++p)
-		{
-			bool v = *j;
-			++j;
-			_results[requestIndex]._flags[p]->SetValue(xOffset, f, v);
-		} 
-	}
+	_writeRequests.clear();
+	
+	Logger::Debug << rowsWritten << "/" << rows.size() << " rows written in " << slabCount << " slabs in " << stopwatch.ToString() << '\n';
 }
 
 void DirectBaselineReader::readWeights(size_t requestIndex, size_t xOffset, int frequencyCount, const casacore::Array<float> weight)
@@ -14,6 +14,8 @@
 
 class DirectBaselineReader : public BaselineReader {
 public:
+	static const size_t DefaultReadAheadSize = 512*1024*1024;
+	
 	explicit DirectBaselineReader(const std::string &msFile);
 	~DirectBaselineReader();
 
@@ -26,7 +28,20 @@ public:
 	std::vector<UVW> ReadUVW(unsigned antenna1, unsigned antenna2, unsigned spectralWindow, unsigned sequenceId);
 	void ShowStatistics();
 	
+	virtual size_t GetMaxRecommendedBufferSize(size_t threadCount) final override;
+	
+	/**
+	 * Sets the amount of memory in bytes that may be used for baselines that
+	 * are read ahead, while the previous baselines are being flagged. A larger
+	 * read-ahead makes the requests larger, which lets more of the rows be read
+	 * in consecutive runs. Zero means that only twice the number of threads
+	 * is read ahead. The default is DefaultReadAheadSize.
+	 */
+	void SetReadAheadSize(size_t readAheadSize) { _readAheadSize = readAheadSize; }
+	
 private:
+	struct RowSlab;
+	
 	class BaselineCacheIndex
 	{
 	public:
@@ -76,12 +91,14 @@ private:
 	void addRowToBaselineCache(int antenna1, int antenna2, int spectralWindow, int sequenceId, size_t row);
 	void readUVWData();
 
-	void readTimeData(size_t requestIndex, size_t xOffset, int frequencyCount, const casacore::Array<casacore::Complex> data, const casacore::Array<casacore::Complex> *model);
-	void readTimeFlags(size_t requestIndex, size_t xOffset, int frequencyCount, const casacore::Array<bool> flag);
+	template<typename RequestType>
+	size_t endOfRowRun(const std::vector<std::pair<size_t, size_t>>& rows, size_t start, const std::vector<RequestType>& requests);
+	void scatterSlab(const RowSlab& slab);
 	void readWeights(size_t requestIndex, size_t xOffset, int frequencyCount, const casacore::Array<float> weight);
 
 	std::map<BaselineCacheIndex, BaselineCacheValue> _baselineCache;
 	casacore::MeasurementSet _ms;
+	size_t _readAheadSize;
 };
 
 #endif // DIRECTBASELINEREADER_H
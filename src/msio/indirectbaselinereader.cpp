@@ -20,10 +20,61 @@
 #include "reorderedfilebuffer.h"
 #include "msselection.h"
 
+namespace {
+	/**
+	 * Converts the reordered layout of one baseline, in which the samples are
+	 * ordered by time, channel and polarization, into one image per
+	 * polarization. This is a transpose: the samples of a few timesteps are
+	 * collected per channel, so that both the reads and the writes of a tile
+	 * are contiguous and stay in the cache.
+	 */
+	void deinterleaveBaseline(const float* data, const bool* flags, size_t width, size_t channelCount, size_t polarizationCount, std::vector<Image2DPtr>& realImages, std::vector<Image2DPtr>& imaginaryImages, std::vector<Mask2DPtr>& masks)
+	{
+		const size_t TileWidth = 16;
+		const size_t samplesPerTimestep = channelCount * polarizationCount;
+		const bool readData = !realImages.empty(), readFlags = !masks.empty();
+		for(size_t tileStart=0; tileStart<width; tileStart+=TileWidth)
+		{
+			const size_t tileEnd = std::min(tileStart + TileWidth, width);
+			for(size_t f=0; f!=channelCount; ++f)
+			{
+				for(size_t p=0; p!=polarizationCount; ++p)
+				{
+					const size_t sampleIndex = f * polarizationCount + p;
+					if(readData)
+					{
+						num_t* realRow = realImages[p]->ValuePtr(0, f);
+						num_t* imaginaryRow = imaginaryImages[p]->ValuePtr(0, f);
+						const float* dataPtr = &data[(tileStart * samplesPerTimestep + sampleIndex) * 2];
+						for(size_t x=tileStart; x!=tileEnd; ++x)
+						{
+							realRow[x] = dataPtr[0];
+							imaginaryRow[x] = dataPtr[1];
+							dataPtr += samplesPerTimestep * 2;
+						}
+					}
+					if(readFlags)
+					{
+						bool* flagRow = masks[p]->ValuePtr(0, f);
+						const bool* flagPtr = &flags[tileStart * samplesPerTimestep + sampleIndex];
+						for(size_t x=tileStart; x!=tileEnd; ++x)
+						{
+							flagRow[x] = *flagPtr;
+							flagPtr += samplesPerTimestep;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
 IndirectBaselineReader::IndirectBaselineReader(const std::string &msFile) :
 	BaselineReader(msFile),
 	_directReader(msFile),
 	_seqIndexTable(),
+	_mappedDataFile(),
+	_mappedFlagFile(),
 	_msIsReordered(false),
 	_removeReorderedFiles(false),
 	_reorderedDataFilesHaveChanged(false),
@@ -50,24 +101,29 @@ void IndirectBaselineReader::PerformReadRequests()
 
 	if(!_msIsReordered) reorderMS();
 
+	if(!_mappedDataFile.IsOpen()) mapReorderedFiles();
+
 	_results.clear();
 	Logger::Debug << "Performing " << _readRequests.size() << " read requests...\n";
+	const size_t polarizationCount = Polarizations().size();
 	for(size_t i=0;i<_readRequests.size();++i)
 	{
 		const ReadRequest request = _readRequests[i];
 		_results.push_back(Result());
-		const size_t width = ObservationTimes(request.sequenceId).size();
-		for(size_t p=0;p<Polarizations().size();++p)
+		const size_t
+			width = ObservationTimes(request.sequenceId).size(),
+			channelCount = MetaData().FrequencyCount(request.spectralWindow);
+		// All samples are overwritten from the reordered files, including the
+		// padded timesteps of a baseline that misses some time scans, so the
+		// images do not need to be initialized.
+		for(size_t p=0;p<polarizationCount;++p)
 		{
 			if(ReadData()) {
-				_results[i]._realImages.push_back(Image2D::CreateZeroImagePtr(width, MetaData().FrequencyCount(request.spectralWindow)));
-				_results[i]._imaginaryImages.push_back(Image2D::CreateZeroImagePtr(width, MetaData().FrequencyCount(request.spectralWindow)));
+				_results[i]._realImages.push_back(Image2D::CreateUnsetImagePtr(width, channelCount));
+				_results[i]._imaginaryImages.push_back(Image2D::CreateUnsetImagePtr(width, channelCount));
 			}
 			if(ReadFlags()) {
-				// The flags should be initialized to true, as a baseline might
-				// miss some time scans that other baselines do have, and these
-				// should be flagged.
-				_results[i]._flags.push_back(Mask2D::CreateSetMaskPtr<true>(width, MetaData().FrequencyCount(request.spectralWindow)));
+				_results[i]._flags.push_back(Mask2D::CreateUnsetMaskPtr(width, channelCount));
 			}
 		}
 		if(_readUVW)
@@ -78,34 +134,31 @@ void IndirectBaselineReader::PerformReadRequests()
 			_results[i]._uvw.emplace_back(0.0, 0.0, 0.0);
 		}
 
-		std::ifstream dataFile(DataFilename(), std::ifstream::binary);
-		std::ifstream flagFile(FlagFilename(), std::ifstream::binary);
 		size_t index = _seqIndexTable->Value(request.antenna1, request.antenna2, request.spectralWindow, request.sequenceId);
 		size_t filePos = _filePositions[index];
-		dataFile.seekg(filePos * (sizeof(float)*2), std::ios_base::beg);
-		flagFile.seekg(filePos * sizeof(bool), std::ios_base::beg);
-
-		const size_t bufferSize = MetaData().FrequencyCount(request.spectralWindow) * Polarizations().size();
-		for(size_t x=0;x<width;++x)
+		const size_t sampleCount = width * channelCount * polarizationCount;
+		const size_t
+			dataOffset = filePos * (sizeof(float)*2), dataLength = sampleCount * (sizeof(float)*2),
+			flagOffset = filePos * sizeof(bool), flagLength = sampleCount * sizeof(bool);
+		if(dataOffset + dataLength > _mappedDataFile.Size() || flagOffset + flagLength > _mappedFlagFile.Size())
+			throw std::runtime_error("Error: temporary reordered files are smaller than expected; disk could have been full during reordering.");
+		
+		// Start reading the next baseline while this one is transposed
+		if(i+1 < _readRequests.size())
 		{
-			std::vector<float> dataBuffer(bufferSize*2);
-			std::vector<char> flagBuffer(bufferSize);
-			dataFile.read((char *) &dataBuffer[0], bufferSize * sizeof(float) * 2);
-			size_t dataBufferPtr = 0;
-			flagFile.read((char *) &flagBuffer[0], bufferSize * sizeof(bool));
-			size_t flagBufferPtr = 0;
-			for(size_t f=0;f<MetaData().FrequencyCount(request.spectralWindow);++f) {
-				for(size_t p=0;p<Polarizations().size();++p)
-				{
-					_results[i]._realImages[p]->SetValue(x, f, dataBuffer[dataBufferPtr]);
-					++dataBufferPtr;
-					_results[i]._imaginaryImages[p]->SetValue(x, f, dataBuffer[dataBufferPtr]);
-					++dataBufferPtr;
-					_results[i]._flags[p]->SetValue(x, f, flagBuffer[flagBufferPtr]);
-					++flagBufferPtr;
-				}
-			}
+			const ReadRequest& next = _readRequests[i+1];
+			size_t nextPos = _filePositions[_seqIndexTable->Value(next.antenna1, next.antenna2, next.spectralWindow, next.sequenceId)];
+			size_t nextCount = ObservationTimes(next.sequenceId).size() * MetaData().FrequencyCount(next.spectralWindow) * polarizationCount;
+			if(ReadData())
+				_mappedDataFile.WillNeed(nextPos * (sizeof(float)*2), nextCount * (sizeof(float)*2));
+			if(ReadFlags())
+				_mappedFlagFile.WillNeed(nextPos * sizeof(bool), nextCount * sizeof(bool));
 		}
+
+		deinterleaveBaseline(
+			_mappedDataFile.Data<float>(dataOffset), _mappedFlagFile.Data<bool>(flagOffset),
+			width, channelCount, polarizationCount,
+			_results[i]._realImages, _results[i]._imaginaryImages, _results[i]._flags);
 	}
 	Logger::Debug << "Done reading.\n";
 
@@ -227,22 +280,14 @@ void IndirectBaselineReader::reorderFull()
 	makeLookupTables(fileSize);
 	
 	Logger::Debug << "Opening temporary files.\n";
-	ReorderInfo reorderInfo;
 	preAllocate(DataFilename(), fileSize*sizeof(float)*2);
-	reorderInfo.dataFile.reset(new std::ofstream(DataFilename(), std::ofstream::binary | std::ios_base::in | std::ios_base::out));
-	if(reorderInfo.dataFile->fail())
-		throw std::runtime_error("Error: failed to open temporary data files for writing! Check access rights and free disk space.");
-	
 	preAllocate(FlagFilename(), fileSize*sizeof(bool));
-	reorderInfo.flagFile.reset(new std::ofstream(FlagFilename(), std::ofstream::binary | std::ios_base::in | std::ios_base::out));
-	if(reorderInfo.flagFile->fail())
-		throw std::runtime_error("Error: failed to open temporary data files for writing! Check access rights and free disk space.");
 
 	Logger::Debug << "Reordering data set...\n";
 	
 	size_t bufferMem = std::min<size_t>(System::TotalMemory()/10, 1024l*1024l*1024l);
-	ReorderedFileBuffer dataFile(reorderInfo.dataFile.get(), bufferMem);
-	ReorderedFileBuffer flagFile(reorderInfo.flagFile.get(), bufferMem/8);
+	ReorderedFileBuffer dataFile(DataFilename(), bufferMem);
+	ReorderedFileBuffer flagFile(FlagFilename(), bufferMem/8);
 	
 	std::vector<std::size_t> writeFilePositions = _filePositions;
 	std::vector<std::size_t> timePositions(_filePositions.size(), size_t(-1));
@@ -253,6 +298,7 @@ void IndirectBaselineReader::reorderFull()
 	unsigned progress = 0, prevProgress = unsigned(-1);
 	
 	MSSelection msSelection(ms, ObservationTimesPerSequence());
+	msSelection.SetRowRange(MetaData().GetIntervalRowRange());
 	
 	msSelection.Process(
 		[&](size_t rowIndex, size_t sequenceId, size_t timeIndexInSequence)
@@ -302,6 +348,8 @@ void IndirectBaselineReader::reorderFull()
 		
 		filePos += sampleCount;
 	});
+	dataFile.flush();
+	flagFile.flush();
 	
 	uint64_t dataSetSize = (uint64_t) fileSize * (uint64_t) (sizeof(float)*2 + sizeof(bool));
 	Logger::Debug << "Done reordering data set of " << dataSetSize/(1024*1024) << " MB in " << watch.Seconds() << " s (" << (long double) dataSetSize/(1024.0L*1024.0L*watch.Seconds()) << " MB/s)\n";
@@ -311,8 +359,17 @@ void IndirectBaselineReader::reorderFull()
 	_reorderedFlagFilesHaveChanged = false;
 }
 
+void IndirectBaselineReader::mapReorderedFiles()
+{
+	Logger::Debug << "Memory mapping reordered files.\n";
+	_mappedDataFile.Open(DataFilename());
+	_mappedFlagFile.Open(FlagFilename());
+}
+
 void IndirectBaselineReader::removeTemporaryFiles()
 {
+	_mappedDataFile.Close();
+	_mappedFlagFile.Close();
 	if(_msIsReordered && _removeReorderedFiles)
 	{
 		boost::filesystem::remove(MetaFilename());
@@ -465,6 +522,7 @@ void IndirectBaselineReader::updateOriginalMS()
 	std::vector<size_t> timePositions(updatedFilePos.size(), size_t(-1));
 		
 	MSSelection msSelection(ms, ObservationTimesPerSequence());
+	msSelection.SetRowRange(MetaData().GetIntervalRowRange());
 	msSelection.Process(
 		[&](size_t rowIndex, size_t sequenceId, size_t timeIndexInSequence)
 	{
@@ -500,7 +558,7 @@ void IndirectBaselineReader::updateOriginalMS()
 						
 			dataColumn.basePut(rowIndex, data);
 		}
-		if(UpdateFlags)
+		if(UpdateFlags && isInFlagWriteInterval(timeIndexInSequence))
 		{
 			casacore::Array<bool> flagArray(shape);
 			
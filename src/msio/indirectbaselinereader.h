@@ -9,6 +9,7 @@
 
 #include "baselinereader.h"
 #include "directbaselinereader.h"
+#include "mappedfile.h"
 
 class IndirectBaselineReader : public BaselineReader {
 	public:
@@ -26,11 +27,6 @@ class IndirectBaselineReader : public BaselineReader {
 		
 		void SetReadUVW(bool readUVW) { _readUVW = readUVW; }
 	private:
-		struct ReorderInfo
-		{
-			std::unique_ptr<std::ofstream> dataFile;
-			std::unique_ptr<std::ofstream> flagFile;
-		};
 		struct UpdateInfo
 		{
 			std::unique_ptr<std::ifstream> dataFile;
@@ -73,6 +69,7 @@ class IndirectBaselineReader : public BaselineReader {
 		void updateOriginalMS();
 		
 		void removeTemporaryFiles();
+		void mapReorderedFiles();
 		
 		static void preAllocate(const char *filename, size_t fileSize);
 		static const char* DataFilename()
@@ -91,6 +88,7 @@ class IndirectBaselineReader : public BaselineReader {
 		DirectBaselineReader _directReader;
 		std::unique_ptr<SeqIndexLookupTable> _seqIndexTable;
 		std::vector<size_t> _filePositions;
+		MappedFile _mappedDataFile, _mappedFlagFile;
 		bool _msIsReordered;
 		bool _removeReorderedFiles;
 		bool _reorderedDataFilesHaveChanged;
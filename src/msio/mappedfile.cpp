@@ -0,0 +1,64 @@
+#include "mappedfile.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void MappedFile::Open(const std::string& filename)
+{
+	Close();
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw std::runtime_error("Error while opening file '" + filename + "' for memory mapping: " + strerror(errno));
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Could not determine size of file '" + filename + "'");
+	}
+	const size_t size = fileStat.st_size;
+	if(size != 0)
+	{
+		void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		if(data == MAP_FAILED)
+		{
+			int err = errno;
+			close(fd);
+			std::ostringstream s;
+			s << "Could not memory map file '" << filename << "' of " << (size/(1024*1024)) << " MB: " << strerror(err);
+			throw std::runtime_error(s.str());
+		}
+		_data = static_cast<const char*>(data);
+		_size = size;
+		madvise(data, size, MADV_SEQUENTIAL);
+	}
+	// The mapping stays valid after closing the descriptor
+	close(fd);
+}
+
+void MappedFile::Close()
+{
+	if(_data != nullptr)
+	{
+		munmap(const_cast<char*>(_data), _size);
+		_data = nullptr;
+		_size = 0;
+	}
+}
+
+void MappedFile::WillNeed(size_t offset, size_t length) const
+{
+	if(length == 0)
+		return;
+	// madvise requires a page-aligned start address
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+	const size_t alignedOffset = offset - offset % pageSize;
+	madvise(const_cast<char*>(_data + alignedOffset), length + (offset - alignedOffset), MADV_WILLNEED);
+}
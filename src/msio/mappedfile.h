@@ -0,0 +1,54 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Read-only memory map of a complete file. The mapping is shared, so
+ * changes that are written to the file with normal file IO are visible
+ * through the mapping.
+ */
+class MappedFile
+{
+public:
+	MappedFile() : _data(nullptr), _size(0) { }
+
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * Maps the file, after closing a previously mapped file. The kernel is
+	 * told that the file will mostly be read sequentially.
+	 */
+	void Open(const std::string& filename);
+
+	void Close();
+
+	bool IsOpen() const { return _data != nullptr; }
+
+	size_t Size() const { return _size; }
+
+	/**
+	 * A view on the mapped data, starting at the given byte offset.
+	 */
+	template<typename T>
+	const T* Data(size_t offset) const
+	{
+		return reinterpret_cast<const T*>(_data + offset);
+	}
+
+	/**
+	 * Asks the kernel to start reading the given byte range, because it
+	 * will be accessed soon.
+	 */
+	void WillNeed(size_t offset, size_t length) const;
+
+private:
+	const char* _data;
+	size_t _size;
+};
+
+#endif
@@ -4,17 +4,43 @@
 
 #include "../structures/system.h"
 
+#include "../util/lane.h"
 #include "../util/logger.h"
+#include "../util/memoryaccountant.h"
 #include "../util/stopwatch.h"
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 #include <casacore/tables/Tables/ArrayColumn.h>
 #include <casacore/tables/Tables/ScalarColumn.h>
 
+#include <thread>
 #include <vector>
 
 using namespace casacore;
 
+/**
+ * A selected row of the measurement set, and where its data should go.
+ */
+struct MemoryBaselineReader::SelectedRow
+{
+	size_t rowIndex;
+	BaselineReader::Result* result;
+	size_t timeIndexInSequence;
+};
+
+/**
+ * A range of consecutive rows with the same shape, read with one call per
+ * column.
+ */
+struct MemoryBaselineReader::RowChunk
+{
+	std::vector<SelectedRow> rows;
+	size_t channelCount;
+	casacore::Array<casacore::Complex> data;
+	casacore::Array<bool> flags;
+	casacore::Array<double> uvw;
+};
+
 void MemoryBaselineReader::PerformReadRequests()
 {
 	if(!_isRead)
@@ -105,85 +131,95 @@ void MemoryBaselineReader::readSet()
 		}
 	}
 	
-	// The actual reading of the data
+	// The actual reading of the data. The rows are collected into chunks
+	// of consecutive rows, of which the columns are read in bulk. Other
+	// threads copy the chunks into the images of the baselines, while the
+	// next chunk is read.
 	Logger::Debug << "Reading the data (interval={" << intStart << "..." << intEnd << "})...\n";
 	
-	casacore::Array<casacore::Complex> dataArray;
-	casacore::Array<bool> flagArray;
-	
-	casacore::MeasurementSet ms(OpenMS());
-	MSSelection msSelection(ms, ObservationTimesPerSequence());
-	msSelection.Process(
-		[&](size_t rowIndex, size_t sequenceId, size_t timeIndexInSequence)
+	// Copying is limited by memory bandwidth, so a few threads are sufficient
+	const size_t scatterThreadCount = std::max<size_t>(1, std::min<size_t>(System::ProcessorCount() - 1, 8));
+	lane<std::unique_ptr<RowChunk>> chunkLane(scatterThreadCount * 2);
+	std::vector<std::thread> scatterThreads;
+	for(size_t i=0; i!=scatterThreadCount; ++i)
 	{
-		size_t ant1 = ant1Column(rowIndex);
-		size_t ant2 = ant2Column(rowIndex);
-		size_t spw = dataDescIdToSpw[dataDescIdColumn(rowIndex)];
-		size_t spwFieldIndex = spw + sequenceId * bandCount;
-		if(ant1 > ant2) std::swap(ant1, ant2);
-		std::unique_ptr<Result>& result = baselineCube[spwFieldIndex][ant1][ant2];
-		if(result == nullptr)
+		scatterThreads.emplace_back([&]() {
+			std::unique_ptr<RowChunk> chunk;
+			while(chunkLane.read(chunk))
+				scatterChunk(*chunk, polarizationCount);
+		});
+	}
+	
+	size_t chunkCount = 0, rowCount = 0;
+	std::unique_ptr<RowChunk> chunk;
+	auto sendChunk = [&]() {
+		const size_t
+			startRow = chunk->rows.front().rowIndex,
+			endRow = chunk->rows.back().rowIndex;
+		Slicer rowRange(IPosition(1, startRow), IPosition(1, endRow), Slicer::endIsLast);
+		dataColumn.getColumnRange(rowRange, chunk->data, true);
+		flagColumn.getColumnRange(rowRange, chunk->flags, true);
+		uvwColumn.getColumnRange(rowRange, chunk->uvw, true);
+		++chunkCount;
+		rowCount += chunk->rows.size();
+		chunkLane.write(std::move(chunk));
+		chunk.reset();
+	};
+	
+	try {
+		casacore::MeasurementSet ms(OpenMS());
+		MSSelection msSelection(ms, ObservationTimesPerSequence());
+		msSelection.SetRowRange(MetaData().GetIntervalRowRange());
+		msSelection.Process(
+			[&](size_t rowIndex, size_t sequenceId, size_t timeIndexInSequence)
 		{
-			const size_t timeStepCount = ObservationTimes(sequenceId).size();
+			size_t ant1 = ant1Column(rowIndex);
+			size_t ant2 = ant2Column(rowIndex);
+			size_t spw = dataDescIdToSpw[dataDescIdColumn(rowIndex)];
+			size_t spwFieldIndex = spw + sequenceId * bandCount;
+			if(ant1 > ant2) std::swap(ant1, ant2);
+			std::unique_ptr<Result>& result = baselineCube[spwFieldIndex][ant1][ant2];
 			const size_t nFreq = MetaData().FrequencyCount(spw);
-			result.reset(new Result());
-			for(size_t p=0;p!=polarizationCount;++p) {
-				result->_realImages.emplace_back(Image2D::CreateZeroImagePtr(timeStepCount, nFreq));
-				result->_imaginaryImages.emplace_back(Image2D::CreateZeroImagePtr(timeStepCount, nFreq));
-				result->_flags.emplace_back(Mask2D::CreateSetMaskPtr<true>(timeStepCount, nFreq));
+			if(result == nullptr)
+			{
+				const size_t timeStepCount = ObservationTimes(sequenceId).size();
+				result.reset(new Result());
+				for(size_t p=0;p!=polarizationCount;++p) {
+					result->_realImages.emplace_back(Image2D::CreateZeroImagePtr(timeStepCount, nFreq));
+					result->_imaginaryImages.emplace_back(Image2D::CreateZeroImagePtr(timeStepCount, nFreq));
+					result->_flags.emplace_back(Mask2D::CreateSetMaskPtr<true>(timeStepCount, nFreq));
+				}
+				result->_bandInfo = bandInfos[spw];
+				result->_uvw.resize(timeStepCount);
 			}
-			result->_bandInfo = bandInfos[spw];
-			result->_uvw.resize(timeStepCount);
-		}
-		
-		dataArray = dataColumn.get(rowIndex);
-		flagArray = flagColumn.get(rowIndex);
-		
-		Array<double> uvwArray = uvwColumn.get(rowIndex);
-		Array<double>::const_iterator uvwPtr = uvwArray.begin();
-		UVW uvw;
-		uvw.u = *uvwPtr; ++uvwPtr;
-		uvw.v = *uvwPtr; ++uvwPtr;
-		uvw.w = *uvwPtr;
-		result->_uvw[timeIndexInSequence] = uvw;
-		
-		for(size_t p=0; p!=polarizationCount; ++p)
-		{
-			Array<Complex>::const_contiter dataPtr = dataArray.cbegin();
-			Array<bool>::const_contiter flagPtr = flagArray.cbegin();
-		
-			Image2D& real = *result->_realImages[p];
-			Image2D& imag = *result->_imaginaryImages[p];
-			Mask2D& mask = *result->_flags[p];
-			const size_t imgStride = real.Stride();
-			const size_t mskStride = mask.Stride();
-			num_t* realOutPtr = real.ValuePtr(timeIndexInSequence, 0);
-			num_t* imagOutPtr = imag.ValuePtr(timeIndexInSequence, 0);
-			bool* flagOutPtr = mask.ValuePtr(timeIndexInSequence, 0);
 			
-			for(size_t i=0;i!=p;++i)
+			// A chunk ends at a gap in the selection, at a change of shape or
+			// when it has reached its maximum size (a few MB).
+			if(chunk != nullptr)
 			{
-				++dataPtr;
-				++flagPtr;
+				const size_t maxRows = std::max<size_t>(1, (8*1024*1024) / (sizeof(Complex) * polarizationCount * chunk->channelCount));
+				if(chunk->rows.back().rowIndex + 1 != rowIndex || chunk->channelCount != nFreq || chunk->rows.size() >= maxRows)
+					sendChunk();
 			}
-			size_t frequencyCount = bandInfos[spw].channels.size();
-			for(size_t ch=0;ch!=frequencyCount;++ch)
+			if(chunk == nullptr)
 			{
-				*realOutPtr = dataPtr->real();
-				*imagOutPtr = dataPtr->imag();
-				*flagOutPtr = *flagPtr;
-				
-				realOutPtr += imgStride;
-				imagOutPtr += imgStride;
-				flagOutPtr += mskStride;
-				
-				for(size_t i=0;i!=polarizationCount;++i) {
-					++dataPtr;
-					++flagPtr;
-				}
+				chunk.reset(new RowChunk());
+				chunk->channelCount = nFreq;
 			}
-		}
-	});
+			chunk->rows.push_back(SelectedRow{rowIndex, result.get(), timeIndexInSequence});
+		});
+		if(chunk != nullptr)
+			sendChunk();
+	} catch(...) {
+		chunkLane.write_end();
+		for(std::thread& thread : scatterThreads)
+			thread.join();
+		throw;
+	}
+	chunkLane.write_end();
+	for(std::thread& thread : scatterThreads)
+		thread.join();
+	Logger::Debug << "Read " << rowCount << " rows in " << chunkCount << " chunks.\n";
 	
 	// Move elements from matrix into the baseline map.
 	for(size_t s=0; s!=sequenceCount; ++s)
@@ -209,6 +245,57 @@ void MemoryBaselineReader::readSet()
 	Logger::Debug << "Reading toke " << watch.ToString() << ".\n";
 }
 
+void MemoryBaselineReader::scatterChunk(const RowChunk& chunk, size_t polarizationCount)
+{
+	const size_t
+		startRow = chunk.rows.front().rowIndex,
+		frequencyCount = chunk.channelCount,
+		samplesPerRow = frequencyCount * polarizationCount;
+	const Complex* chunkData = chunk.data.data();
+	const bool* chunkFlags = chunk.flags.data();
+	const double* chunkUVW = chunk.uvw.data();
+	
+	for(const SelectedRow& row : chunk.rows)
+	{
+		const size_t rowOffset = row.rowIndex - startRow;
+		Result& result = *row.result;
+		const double* uvwPtr = &chunkUVW[rowOffset * 3];
+		UVW uvw;
+		uvw.u = uvwPtr[0];
+		uvw.v = uvwPtr[1];
+		uvw.w = uvwPtr[2];
+		result._uvw[row.timeIndexInSequence] = uvw;
+		
+		for(size_t p=0; p!=polarizationCount; ++p)
+		{
+			const Complex* dataPtr = &chunkData[rowOffset * samplesPerRow + p];
+			const bool* flagPtr = &chunkFlags[rowOffset * samplesPerRow + p];
+			
+			Image2D& real = *result._realImages[p];
+			Image2D& imag = *result._imaginaryImages[p];
+			Mask2D& mask = *result._flags[p];
+			const size_t imgStride = real.Stride();
+			const size_t mskStride = mask.Stride();
+			num_t* realOutPtr = real.ValuePtr(row.timeIndexInSequence, 0);
+			num_t* imagOutPtr = imag.ValuePtr(row.timeIndexInSequence, 0);
+			bool* flagOutPtr = mask.ValuePtr(row.timeIndexInSequence, 0);
+			
+			for(size_t ch=0;ch!=frequencyCount;++ch)
+			{
+				*realOutPtr = dataPtr->real();
+				*imagOutPtr = dataPtr->imag();
+				*flagOutPtr = *flagPtr;
+				
+				realOutPtr += imgStride;
+				imagOutPtr += imgStride;
+				flagOutPtr += mskStride;
+				dataPtr += polarizationCount;
+				flagPtr += polarizationCount;
+			}
+		}
+	}
+}
+
 void MemoryBaselineReader::PerformFlagWriteRequests()
 {
 	if(!_isRead)
@@ -250,9 +337,12 @@ void MemoryBaselineReader::writeFlags()
 	Logger::Debug << "Flags have changed, writing them back to the set...\n";
 	
 	MSSelection msSelection(ms, ObservationTimesPerSequence());
+	msSelection.SetRowRange(MetaData().GetIntervalRowRange());
 	msSelection.Process(
 		[&](size_t rowIndex, size_t sequenceId, size_t timeIndexInSequence)
 	{
+		if(!isInFlagWriteInterval(timeIndexInSequence))
+			return;
 		size_t ant1 = ant1Column(rowIndex);
 		size_t ant2 = ant2Column(rowIndex);
 		size_t spw = dataIdToSpw[dataDescIdColumn(rowIndex)];
@@ -293,7 +383,7 @@ void MemoryBaselineReader::writeFlags()
 bool MemoryBaselineReader::IsEnoughMemoryAvailable(const std::string &filename)
 {
 	uint64_t size = MeasurementSetDataSize(filename);
-	uint64_t totalMem = System::TotalMemory();
+	uint64_t totalMem = MemoryAccountant::Limit();
 	
 	if(size * 2 >= totalMem)
 	{
@@ -40,7 +40,11 @@ public:
 	{ return 2; }
 	
 private:
+	struct SelectedRow;
+	struct RowChunk;
+	
 	void readSet();
+	static void scatterChunk(const RowChunk& chunk, size_t polarizationCount);
 	void writeFlags();
 	void clear();
 	
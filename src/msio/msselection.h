@@ -6,6 +6,8 @@
 
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
+#include "../structures/msmetadata.h"
+
 #include <limits>
 #include <map>
 #include <vector>
@@ -17,10 +19,23 @@ public:
 		const std::vector<std::map<double, size_t>>& observationTimes
 	) :
 		_observationTimes(observationTimes),
-		_ms(ms)
+		_ms(ms),
+		_startRow(0),
+		_endRow(ms.nrow()),
+		_startSequenceId(0)
 	{ 
 	}
 	
+	/**
+	 * Only scan the given rows, e.g. the rows of the selected interval.
+	 */
+	void SetRowRange(const MSMetaData::RowRange& range)
+	{
+		_startRow = range.startRow;
+		_endRow = range.endRow;
+		_startSequenceId = range.startSequenceId;
+	}
+	
 	template<typename Function>
 	void Process(Function function)
 	{
@@ -30,10 +45,10 @@ public:
 		double prevTime = -1.0;
 		size_t
 			prevFieldId = size_t(-1),
-			sequenceId = size_t(-1),
+			sequenceId = _startSequenceId - 1,
 			timeIndexInSequence = size_t(-1);
 	
-		for(size_t rowIndex = 0; rowIndex != _ms.nrow(); ++rowIndex)
+		for(size_t rowIndex = _startRow; rowIndex < _endRow; ++rowIndex)
 		{
 			double time = timeColumn(rowIndex);
 			bool newTime = time != prevTime;
@@ -66,6 +81,7 @@ private:
 	std::vector<std::map<double, size_t>> _observationTimes;
 	
 	casacore::MeasurementSet& _ms;
+	size_t _startRow, _endRow, _startSequenceId;
 };
 
 #endif
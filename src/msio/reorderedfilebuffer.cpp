@@ -0,0 +1,207 @@
+#include "reorderedfilebuffer.h"
+
+#include "../util/logger.h"
+#include "../util/stopwatch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+ReorderedFileBuffer::ReorderedFileBuffer(const std::string& filename, size_t maxSize) :
+	_filename(filename),
+	_fd(open(filename.c_str(), O_WRONLY)),
+	_nextWritePos(0),
+	_maxSize(maxSize),
+	_writeCount(0),
+	_flushCount(0),
+	_flushedExtents(0),
+	_flushedSyscalls(0),
+	_flushedBytes(0),
+	_flushSeconds(0.0)
+{
+	if(_fd < 0)
+		throw std::runtime_error("Error: failed to open temporary file '" + filename + "' for writing! Check access rights and free disk space.");
+	_arena.reserve(maxSize);
+}
+
+ReorderedFileBuffer::~ReorderedFileBuffer()
+{
+	// Errors should be caught by calling flush() explicitly; a destructor
+	// can not throw.
+	try {
+		flush();
+	} catch(std::exception& e) {
+		Logger::Error << e.what() << '\n';
+	}
+	close(_fd);
+	if(_flushCount != 0)
+	{
+		Logger::Debug << "Reordered file " << _filename << ": " << _writeCount << " writes, "
+			<< _flushedExtents << " extents and " << _flushedSyscalls << " system calls in "
+			<< _flushCount << " flushes, " << (_flushedBytes/(1024*1024)) << " MB at "
+			<< (_flushSeconds > 0.0 ? _flushedBytes / (1024.0*1024.0*_flushSeconds) : 0.0) << " MB/s.\n";
+	}
+}
+
+void ReorderedFileBuffer::write(const char* data, size_t length)
+{
+	++_writeCount;
+	if(_arena.size() + length + (_extents.size() + 1) * sizeof(Extent) > _maxSize)
+	{
+		flush();
+		if(length > _maxSize)
+		{
+			writeDirectly(data, length, _nextWritePos);
+			_nextWritePos += length;
+			return;
+		}
+	}
+
+	// The arena is only appended to, so the data of the last extent always
+	// ends at the end of the arena.
+	if(!_extents.empty() && _extents.back().position + _extents.back().length == _nextWritePos)
+		_extents.back().length += length;
+	else
+		_extents.push_back(Extent{_nextWritePos, _arena.size(), length});
+	_arena.insert(_arena.end(), data, data + length);
+	_nextWritePos += length;
+}
+
+void ReorderedFileBuffer::flush()
+{
+	if(_extents.empty())
+		return;
+
+	Stopwatch watch(true);
+	const size_t syscallsBefore = _flushedSyscalls;
+	sortExtents();
+
+	size_t runStart = 0;
+	for(size_t i=1; i<=_extents.size(); ++i)
+	{
+		const Extent& previous = _extents[i-1];
+		if(i == _extents.size() || _extents[i].position != previous.position + previous.length || i - runStart == IOV_MAX)
+		{
+			writeRun(runStart, i);
+			runStart = i;
+		}
+	}
+
+	const double seconds = watch.Seconds();
+	Logger::Debug << "Flushed " << (_arena.size()/(1024*1024)) << " MB of reordered data in "
+		<< _extents.size() << " extents with " << (_flushedSyscalls - syscallsBefore) << " writes ("
+		<< (seconds > 0.0 ? _arena.size() / (1024.0*1024.0*seconds) : 0.0) << " MB/s).\n";
+	++_flushCount;
+	_flushedExtents += _extents.size();
+	_flushedBytes += _arena.size();
+	_flushSeconds += seconds;
+	_extents.clear();
+	_arena.clear();
+}
+
+/**
+ * LSD radix sort on the file position, 16 bits per pass. Positions are taken
+ * relative to the lowest position, so that the number of passes depends on
+ * the range of positions in the buffer rather than on the size of the file.
+ */
+void ReorderedFileBuffer::sortExtents()
+{
+	const size_t DigitBits = 16, BucketCount = size_t(1) << DigitBits;
+	uint64_t minPos = _extents.front().position, maxPos = minPos;
+	for(const Extent& e : _extents)
+	{
+		minPos = std::min(minPos, e.position);
+		maxPos = std::max(maxPos, e.position);
+	}
+	const uint64_t range = maxPos - minPos;
+
+	std::vector<size_t> counts(BucketCount);
+	_sortBuffer.resize(_extents.size());
+	for(size_t shift=0; shift<64 && (range >> shift) != 0; shift+=DigitBits)
+	{
+		std::fill(counts.begin(), counts.end(), 0);
+		for(const Extent& e : _extents)
+			++counts[((e.position - minPos) >> shift) & (BucketCount-1)];
+		size_t offset = 0;
+		for(size_t& count : counts)
+		{
+			const size_t bucketSize = count;
+			count = offset;
+			offset += bucketSize;
+		}
+		for(const Extent& e : _extents)
+			_sortBuffer[counts[((e.position - minPos) >> shift) & (BucketCount-1)]++] = e;
+		std::swap(_extents, _sortBuffer);
+	}
+}
+
+void ReorderedFileBuffer::writeRun(size_t firstExtent, size_t endExtent)
+{
+	std::vector<iovec> vectors(endExtent - firstExtent);
+	size_t totalLength = 0;
+	for(size_t i=firstExtent; i!=endExtent; ++i)
+	{
+		iovec& v = vectors[i - firstExtent];
+		v.iov_base = &_arena[_extents[i].arenaOffset];
+		v.iov_len = _extents[i].length;
+		totalLength += v.iov_len;
+	}
+
+	iovec* current = vectors.data();
+	size_t vectorCount = vectors.size();
+	uint64_t position = _extents[firstExtent].position;
+	while(totalLength != 0)
+	{
+		ssize_t written = pwritev(_fd, current, vectorCount, position);
+		++_flushedSyscalls;
+		if(written < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			throw std::runtime_error("Error: failed to write to reordered file '" + _filename + "': " + strerror(errno) + ". Check access rights and free disk space.");
+		}
+		// Skip over what was written, in case of a partial write
+		totalLength -= written;
+		position += written;
+		size_t remaining = written;
+		while(vectorCount != 0 && remaining >= current->iov_len)
+		{
+			remaining -= current->iov_len;
+			++current;
+			--vectorCount;
+		}
+		if(vectorCount != 0)
+		{
+			current->iov_base = static_cast<char*>(current->iov_base) + remaining;
+			current->iov_len -= remaining;
+		}
+	}
+}
+
+void ReorderedFileBuffer::writeDirectly(const char* data, size_t length, uint64_t position)
+{
+	while(length != 0)
+	{
+		ssize_t written = pwrite(_fd, data, length, position);
+		++_flushedSyscalls;
+		if(written < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			throw std::runtime_error("Error: failed to write to reordered file '" + _filename + "': " + strerror(errno) + ". Check access rights and free disk space.");
+		}
+		data += written;
+		length -= written;
+		position += written;
+	}
+}
@@ -1,74 +1,65 @@
 #ifndef REORDERED_FILE_BUFFER_H
 #define REORDERED_FILE_BUFFER_H
 
-#include <fstream>
+#include <cstdint>
+#include <string>
 #include <vector>
-#include <set>
-
-#include "../util/logger.h"
 
+/**
+ * Buffers many small writes at random positions of a file, and writes them
+ * in file order when the buffer is full.
+ *
+ * The written data is appended to a single arena, and a write that continues
+ * where the previous write ended is merged with it into one extent. On
+ * flush, the extents are radix sorted on their file position, and each run of
+ * adjacent extents is written with a single pwritev() call. Writes to
+ * overlapping ranges of the file are not supported.
+ */
 class ReorderedFileBuffer
 {
 public:
-	ReorderedFileBuffer(std::ofstream* stream, size_t maxSize) :
-		_nextWritePos(0), _unflushedSize(0), _maxSize(maxSize), _stream(stream)
-	{
-	}
-	
-	~ReorderedFileBuffer()
-	{
-		flush();
-	}
-	
+	/**
+	 * Opens an existing (pre-allocated) file for writing.
+	 */
+	ReorderedFileBuffer(const std::string& filename, size_t maxSize);
+
+	~ReorderedFileBuffer();
+
+	ReorderedFileBuffer(const ReorderedFileBuffer&) = delete;
+	ReorderedFileBuffer& operator=(const ReorderedFileBuffer&) = delete;
+
 	void seekp(size_t offset)
 	{
 		_nextWritePos = offset;
 	}
-	
-	void write(const char* data, size_t length)
-	{
-		_buffer.insert(BufferEntry(_nextWritePos, data, length));
-		_nextWritePos += length;
-		_unflushedSize += length + sizeof(_nextWritePos)*2;
-		
-		if(_unflushedSize > _maxSize)
-			flush();
-	}
-	
-	void flush()
-	{
-		Logger::Debug << "Flushing reordered file buffer...\n";
-		for(std::set<BufferEntry>::const_iterator i=_buffer.begin(); i!=_buffer.end(); ++i)
-		{
-			_stream->seekp(i->position, std::ios_base::beg);
-			_stream->write(i->data.data(), i->data.size());
-			if(_stream->fail())
-				throw std::runtime_error("Error: failed to write to reordered file! Check access rights and free disk space.");
-		}
-		_buffer.clear();
-		_unflushedSize = 0;
-	}
-	
-	std::ofstream& stream() { return *_stream; }
-	
+
+	void write(const char* data, size_t length);
+
+	void flush();
+
 private:
-	struct BufferEntry {
-		BufferEntry(size_t pos_, const char* data_, size_t length_) :
-			position(pos_),
-			data(data_, data_ + length_)
-		{ }
-		bool operator<(const BufferEntry& other) const
-		{
-			return position < other.position;
-		}
-		size_t position;
-		std::vector<char> data;
+	struct Extent
+	{
+		uint64_t position;
+		size_t arenaOffset;
+		size_t length;
 	};
-	std::set<BufferEntry> _buffer;
-	size_t _nextWritePos;
-	size_t _unflushedSize;
+
+	void sortExtents();
+	void writeRun(size_t firstExtent, size_t endExtent);
+	void writeDirectly(const char* data, size_t length, uint64_t position);
+
+	std::string _filename;
+	int _fd;
+	std::vector<char> _arena;
+	std::vector<Extent> _extents, _sortBuffer;
+	uint64_t _nextWritePos;
 	size_t _maxSize;
-	std::ofstream* _stream;
+
+	// Statistics
+	size_t _writeCount, _flushCount, _flushedExtents, _flushedSyscalls;
+	uint64_t _flushedBytes;
+	double _flushSeconds;
 };
 
 #endif
@@ -5,6 +5,7 @@
 #include "verticalplotscale.h"
 #include "title.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -54,7 +55,10 @@ HeatMapPlot::HeatMapPlot() :
 	_manualXAxisDescription(false),
 	_manualYAxisDescription(false),
 	_manualZAxisDescription(false),
-	_highlightConfig(new ThresholdConfig())
+	_highlightConfig(new ThresholdConfig()),
+	_renderer(),
+	_imageSurface(),
+	_surfaceLeft(0.0), _surfaceTop(0.0), _surfaceWidth(1.0), _surfaceHeight(1.0)
 {
 	_highlightConfig->InitializeLengthsSingleSample();
 }
@@ -74,6 +78,7 @@ void HeatMapPlot::Clear()
 		_highlightConfig->InitializeLengthsSingleSample();
 		_segmentedImage.reset();
 		_image.reset();
+		_renderer.Reset();
 	}
 	_horiScale.reset();
 	_vertScale.reset();
@@ -93,15 +98,21 @@ void HeatMapPlot::redrawWithoutChanges(const Cairo::RefPtr<Cairo::Context>& cair
 		int
 			destWidth = width - (int) floor(_leftBorderSize + _rightBorderSize),
 			destHeight = height - (int) floor(_topBorderSize + _bottomBorderSize),
-			sourceWidth = _imageSurface->get_width(),
-			sourceHeight = _imageSurface->get_height();
+			surfaceWidth = _imageSurface->get_width(),
+			surfaceHeight = _imageSurface->get_height();
+		const double
+			sourceLeft = _surfaceLeft * surfaceWidth,
+			sourceTop = _surfaceTop * surfaceHeight,
+			sourceWidth = _surfaceWidth * surfaceWidth,
+			sourceHeight = _surfaceHeight * surfaceHeight;
 		cairo->save();
 		cairo->translate((int) round(_leftBorderSize), (int) round(_topBorderSize));
-		cairo->scale((double) destWidth / (double) sourceWidth, (double) destHeight / (double) sourceHeight);
+		cairo->scale((double) destWidth / sourceWidth, (double) destHeight / sourceHeight);
+		cairo->translate(-sourceLeft, -sourceTop);
 		Cairo::RefPtr<Cairo::SurfacePattern> pattern = Cairo::SurfacePattern::create(_imageSurface);
 		pattern->set_filter(_cairoFilter);
 		cairo->set_source(pattern);
-		cairo->rectangle(0, 0, sourceWidth, sourceHeight);
+		cairo->rectangle(sourceLeft, sourceTop, sourceWidth, sourceHeight);
 		cairo->clip();
 		cairo->paint();
 		cairo->restore();
@@ -365,24 +376,8 @@ void HeatMapPlot::update(const Cairo::RefPtr<Cairo::Context>& cairo, unsigned wi
 	unsigned int
 		startTimestep = startX,
 		endTimestep = endX;
-	size_t
-		imageWidth = endX - startX,
-		imageHeight = endY - startY;
-		
+
 	Image2DCPtr image = _image;
-	if(imageWidth > 30000)
-	{
-		int shrinkFactor = (imageWidth + 29999) / 30000;
-		image = Image2D::MakePtr(image->ShrinkHorizontally(shrinkFactor));
-		mask = Mask2D::MakePtr(mask->ShrinkHorizontally(shrinkFactor));
-		if(originalMask != 0)
-			originalMask = Mask2D::MakePtr(originalMask->ShrinkHorizontally(shrinkFactor));
-		if(alternativeMask != 0)
-			alternativeMask = Mask2D::MakePtr(alternativeMask->ShrinkHorizontally(shrinkFactor));
-		startX /= shrinkFactor;
-		endX /= shrinkFactor;
-		imageWidth = endX - startX;
-	}
 
 	num_t min, max;
 	findMinMax(image.get(), mask.get(), min, max);
@@ -482,9 +477,7 @@ void HeatMapPlot::update(const Cairo::RefPtr<Cairo::Context>& cairo, unsigned wi
 
 	std::unique_ptr<ColorMap> colorMap(ColorMap::CreateColorMap(_colorMap));
 	
-	const double
-		minLog10 = min>0.0 ? log10(min) : 0.0,
-		maxLog10 = max>0.0 ? log10(max) : 0.0;
+	const double minLog10 = min>0.0 ? log10(min) : 0.0;
 	if(_showColorScale)
 	{
 		for(unsigned x=0;x<256;++x)
@@ -503,14 +496,6 @@ void HeatMapPlot::update(const Cairo::RefPtr<Cairo::Context>& cairo, unsigned wi
 		}
 	}
 	
-	_imageSurface.clear();
-	_imageSurface =
-		Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, imageWidth, imageHeight);
-
-	_imageSurface->flush();
-	unsigned char *data = _imageSurface->get_data();
-	size_t rowStride = _imageSurface->get_stride();
-
 	Mask2DPtr highlightMask;
 	if(_highlighting)
 	{
@@ -520,65 +505,63 @@ void HeatMapPlot::update(const Cairo::RefPtr<Cairo::Context>& cairo, unsigned wi
 	const bool
 		originalActive = _showOriginalMask && originalMask != 0,
 		altActive = _showAlternativeMask && alternativeMask != 0;
-	int orMaskR=255, orMaskG=0, orMaskB=255;
-	int altMaskR=255, altMaskG=255, altMaskB=0;
+	_renderer.SetImage(image, {{
+		highlightMask,
+		originalActive ? originalMask : Mask2DCPtr(),
+		altActive ? alternativeMask : Mask2DCPtr() }});
+	_renderer.SetColorMap(*colorMap, min, max, _scaleOption == LogScale);
+	colorMap.reset();
+	_renderer.SetMaskColor(HeatMapRenderer::HighlightMask, 255, 0, 0);
 	if(_colorMap == ColorMap::Viridis)
 	{
-		orMaskR=0; orMaskG=0; orMaskB=0;
-		altMaskR=255; altMaskG=255; altMaskB=255;
-	}
-	for(unsigned long y=startY;y<endY;++y) {
-		guint8* rowpointer = data + rowStride * (endY - y - 1);
-		for(unsigned long x=startX;x<endX;++x) {
-			int xa = (x-startX) * 4;
-			unsigned char r,g,b,a;
-			if(_highlighting && highlightMask->Value(x, y) != 0) {
-				r = 255; g = 0; b = 0; a = 255;
-			} else if(originalActive && originalMask->Value(x, y)) {
-				r = orMaskR; g = orMaskG; b = orMaskB; a = 255;
-			} else if(altActive && alternativeMask->Value(x, y)) {
-				r = altMaskR; g = altMaskG; b = altMaskB; a = 255;
-			} else {
-				num_t val = image->Value(x, y);
-				if(val > max) val = max;
-				else if(val < min) val = min;
-
-				if(_scaleOption == LogScale)
-				{
-					if(image->Value(x, y) <= 0.0)
-						val = -1.0;
-					else
-						val = (log10(image->Value(x, y)) - minLog10) * 2.0 / (maxLog10 - minLog10) - 1.0;
-				}
-				else
-					val = (image->Value(x, y) - min) * 2.0 / (max - min) - 1.0;
-				if(val < -1.0) val = -1.0;
-				else if(val > 1.0) val = 1.0;
-				r = colorMap->ValueToColorR(val);
-				g = colorMap->ValueToColorG(val);
-				b = colorMap->ValueToColorB(val);
-				a = colorMap->ValueToColorA(val);
-			}
-			rowpointer[xa]=b;
-			rowpointer[xa+1]=g;
-			rowpointer[xa+2]=r;
-			rowpointer[xa+3]=a;
-		}
+		_renderer.SetMaskColor(HeatMapRenderer::OriginalMask, 0, 0, 0);
+		_renderer.SetMaskColor(HeatMapRenderer::AlternativeMask, 255, 255, 255);
 	}
-	colorMap.reset();
+	else {
+		_renderer.SetMaskColor(HeatMapRenderer::OriginalMask, 255, 0, 255);
+		_renderer.SetMaskColor(HeatMapRenderer::AlternativeMask, 255, 255, 0);
+	}
+
+	// Large images are drawn from a level of the image that has about as many
+	// samples as the plot has pixels
+	const unsigned
+		destWidth = std::max<int>(1, width - (int) floor(_leftBorderSize + _rightBorderSize)),
+		destHeight = std::max<int>(1, height - (int) floor(_topBorderSize + _bottomBorderSize));
+	const HeatMapRenderer::Region region =
+		_renderer.SelectRegion(startX, endX, startY, endY, destWidth, destHeight);
+	const unsigned
+		blockWidth = 1 << region.horizontalLevel,
+		blockHeight = 1 << region.verticalLevel;
+	_surfaceLeft = (double(startX) / blockWidth - region.startX) / region.Width();
+	_surfaceWidth = (double(endX - startX) / blockWidth) / region.Width();
+	_surfaceTop = (region.endY - double(endY) / blockHeight) / region.Height();
+	_surfaceHeight = (double(endY - startY) / blockHeight) / region.Height();
+
+	_imageSurface.clear();
+	_imageSurface =
+		Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, region.Width(), region.Height());
+
+	_imageSurface->flush();
+	unsigned char *data = _imageSurface->get_data();
+	size_t rowStride = _imageSurface->get_stride();
+
+	_renderer.Render(region, data, rowStride);
 
 	if(_segmentedImage != 0)
 	{
-		for(unsigned long y=startY;y<endY;++y) {
-			guint8* rowpointer = data + rowStride * (y - startY);
-			for(unsigned long x=startX;x<endX;++x) {
-				if(_segmentedImage->Value(x,y) != 0)
+		for(size_t y=region.startY;y<region.endY;++y) {
+			guint8* rowpointer = data + rowStride * (region.endY - y - 1);
+			for(size_t x=region.startX;x<region.endX;++x) {
+				const size_t
+					imageX = std::min<size_t>(x * blockWidth, image->Width() - 1),
+					imageY = std::min<size_t>(y * blockHeight, image->Height() - 1);
+				if(_segmentedImage->Value(imageX, imageY) != 0)
 				{
-					int xa = (x-startX) * 4;
-					rowpointer[xa]=IntMap::R(_segmentedImage->Value(x,y));
-					rowpointer[xa+1]=IntMap::G(_segmentedImage->Value(x,y));
-					rowpointer[xa+2]=IntMap::B(_segmentedImage->Value(x,y));
-					rowpointer[xa+3]=IntMap::A(_segmentedImage->Value(x,y));
+					int xa = (x-region.startX) * 4;
+					rowpointer[xa]=IntMap::R(_segmentedImage->Value(imageX, imageY));
+					rowpointer[xa+1]=IntMap::G(_segmentedImage->Value(imageX, imageY));
+					rowpointer[xa+2]=IntMap::B(_segmentedImage->Value(imageX, imageY));
+					rowpointer[xa+3]=IntMap::A(_segmentedImage->Value(imageX, imageY));
 				}
 			}
 		}
@@ -11,6 +11,8 @@
 #include "../structures/timefrequencymetadata.h"
 #include "../structures/segmentedimage.h"
 
+#include "heatmaprenderer.h"
+
 class HeatMapPlot
 {
 public:
@@ -34,13 +36,13 @@ public:
 	void Draw(const Cairo::RefPtr<Cairo::Context>& cairo, unsigned width, unsigned height, bool isInvalidated); 
 
 	Image2DCPtr Image() const { return _image; }
-	void SetImage(Image2DCPtr image) { _image = image; }
+	void SetImage(Image2DCPtr image) { _image = image; _renderer.Reset(); }
 
 	Mask2DCPtr OriginalMask() const { return _originalMask; }
-	void SetOriginalMask(Mask2DCPtr mask) { _originalMask = mask; }
+	void SetOriginalMask(Mask2DCPtr mask) { _originalMask = mask; _renderer.Reset(); }
 
 	Mask2DCPtr AlternativeMask() const { return _alternativeMask; }
-	void SetAlternativeMask(Mask2DCPtr mask) { _alternativeMask = mask; }
+	void SetAlternativeMask(Mask2DCPtr mask) { _alternativeMask = mask; _renderer.Reset(); }
 
 	Mask2DCPtr GetActiveMask() const;
 
@@ -242,7 +244,11 @@ private:
 			return _titleText;
 	}
 
+	HeatMapRenderer _renderer;
 	Cairo::RefPtr<Cairo::ImageSurface> _imageSurface;
+	// The part of _imageSurface that shows the zoomed area, relative to its size,
+	// since the surface is rounded outwards to whole blocks of samples.
+	double _surfaceLeft, _surfaceTop, _surfaceWidth, _surfaceHeight;
 };
 
 #endif
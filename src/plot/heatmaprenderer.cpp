@@ -0,0 +1,334 @@
+#include "heatmaprenderer.h"
+
+#include "../structures/system.h"
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+HeatMapRenderer::HeatMapRenderer() :
+	_image(),
+	_masks(),
+	_levels(),
+	_colorTable(ColorTableSize),
+	_maskColors(),
+	_logarithmic(false),
+	_offset(0.0),
+	_scale(0.0)
+{
+	for(std::array<unsigned char, 4>& color : _maskColors)
+		color = std::array<unsigned char, 4>{{0, 0, 0, 255}};
+}
+
+template<typename Function>
+void HeatMapRenderer::forEachRowRange(size_t rowCount, size_t rowSize, Function function)
+{
+	// Starting a thread costs more than colouring a few rows
+	const size_t
+		minRowsPerThread = std::max<size_t>(1, 65536 / std::max<size_t>(1, rowSize)),
+		threadCount = std::min<size_t>(System::ProcessorCount(), (rowCount + minRowsPerThread - 1) / minRowsPerThread);
+	if(threadCount <= 1)
+	{
+		function(0, rowCount);
+		return;
+	}
+
+	std::mutex mutex;
+	std::exception_ptr exception;
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for(size_t t=0; t!=threadCount; ++t)
+	{
+		const size_t
+			rowStart = rowCount * t / threadCount,
+			rowEnd = rowCount * (t + 1) / threadCount;
+		threads.emplace_back([&, rowStart, rowEnd]()
+		{
+			try {
+				function(rowStart, rowEnd);
+			} catch(...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				exception = std::current_exception();
+			}
+		});
+	}
+	for(std::thread& thread : threads)
+		thread.join();
+	if(exception)
+		std::rethrow_exception(exception);
+}
+
+void HeatMapRenderer::SetImage(const Image2DCPtr& image, const std::array<Mask2DCPtr, MaskCount>& masks)
+{
+	if(image != _image || masks != _masks)
+	{
+		Reset();
+		_image = image;
+		_masks = masks;
+	}
+}
+
+void HeatMapRenderer::Reset()
+{
+	_levels.clear();
+}
+
+void HeatMapRenderer::SetColorMap(const ColorMap& colorMap, num_t min, num_t max, bool logarithmic)
+{
+	for(size_t i=0; i!=ColorTableSize; ++i)
+	{
+		const long double value = (2.0L * i) / (ColorTableSize - 1) - 1.0L;
+		_colorTable[i] = std::array<unsigned char, 4>{{
+			colorMap.ValueToColorB(value),
+			colorMap.ValueToColorG(value),
+			colorMap.ValueToColorR(value),
+			colorMap.ValueToColorA(value) }};
+	}
+	_logarithmic = logarithmic;
+	if(logarithmic)
+	{
+		const num_t
+			minLog10 = min>0.0 ? std::log10(min) : 0.0,
+			maxLog10 = max>0.0 ? std::log10(max) : 0.0;
+		_offset = minLog10;
+		_scale = (ColorTableSize - 1) / (maxLog10 - minLog10);
+	}
+	else {
+		_offset = min;
+		_scale = (ColorTableSize - 1) / (max - min);
+	}
+}
+
+void HeatMapRenderer::SetMaskColor(enum MaskIndex mask, unsigned char r, unsigned char g, unsigned char b)
+{
+	_maskColors[mask] = std::array<unsigned char, 4>{{b, g, r, 255}};
+}
+
+HeatMapRenderer::Region HeatMapRenderer::SelectRegion(size_t startX, size_t endX, size_t startY, size_t endY, size_t destWidth, size_t destHeight) const
+{
+	destWidth = std::max<size_t>(destWidth, 1);
+	destHeight = std::max<size_t>(destHeight, 1);
+	Region region;
+	region.horizontalLevel = 0;
+	while(((endX - startX) >> (region.horizontalLevel + 1)) >= destWidth)
+		++region.horizontalLevel;
+	region.verticalLevel = 0;
+	while(((endY - startY) >> (region.verticalLevel + 1)) >= destHeight)
+		++region.verticalLevel;
+	// A level that is not much smaller than the image would take almost as
+	// much memory as the image, while colouring the area from the full
+	// resolution image is cheap, since it is not much larger than the destination.
+	if(region.horizontalLevel + region.verticalLevel < 2)
+	{
+		region.horizontalLevel = 0;
+		region.verticalLevel = 0;
+	}
+	const size_t
+		blockWidth = size_t(1) << region.horizontalLevel,
+		blockHeight = size_t(1) << region.verticalLevel;
+	region.startX = startX / blockWidth;
+	region.endX = (endX + blockWidth - 1) / blockWidth;
+	region.startY = startY / blockHeight;
+	region.endY = (endY + blockHeight - 1) / blockHeight;
+	return region;
+}
+
+void HeatMapRenderer::Render(const Region& region, unsigned char* data, size_t rowStride)
+{
+	const Level* level = nullptr;
+	if(region.horizontalLevel != 0 || region.verticalLevel != 0)
+	{
+		Level& cachedLevel = getLevel(region.horizontalLevel, region.verticalLevel);
+		if(_logarithmic && cachedLevel.logImage == nullptr)
+			cachedLevel.logImage = makeLogImage(*cachedLevel.image);
+		level = &cachedLevel;
+	}
+	forEachRowRange(region.Height(), region.Width(), [&](size_t rowStart, size_t rowEnd)
+	{
+		for(size_t y=region.startY+rowStart; y!=region.startY+rowEnd; ++y)
+			renderRow(region, level, y, data + rowStride * (region.endY - y - 1));
+	});
+}
+
+HeatMapRenderer::Level& HeatMapRenderer::getLevel(unsigned horizontalLevel, unsigned verticalLevel)
+{
+	for(std::vector<Level>::iterator i=_levels.begin(); i!=_levels.end(); ++i)
+	{
+		if(i->horizontalLevel == horizontalLevel && i->verticalLevel == verticalLevel)
+		{
+			// Keep the most recently used level at the back
+			std::rotate(i, i+1, _levels.end());
+			return _levels.back();
+		}
+	}
+	if(_levels.size() == MaxCachedLevels)
+		_levels.erase(_levels.begin());
+	_levels.push_back(makeLevel(horizontalLevel, verticalLevel));
+	return _levels.back();
+}
+
+HeatMapRenderer::Level HeatMapRenderer::makeLevel(unsigned horizontalLevel, unsigned verticalLevel) const
+{
+	const size_t
+		imageWidth = _image->Width(),
+		imageHeight = _image->Height(),
+		blockHeight = size_t(1) << verticalLevel,
+		width = (imageWidth + (size_t(1) << horizontalLevel) - 1) >> horizontalLevel,
+		height = (imageHeight + blockHeight - 1) >> verticalLevel;
+
+	Level level;
+	level.horizontalLevel = horizontalLevel;
+	level.verticalLevel = verticalLevel;
+	Image2DPtr image = Image2D::CreateUnsetImagePtr(width, height);
+	std::array<Image2DPtr, MaskCount> fractions;
+	for(size_t m=0; m!=MaskCount; ++m)
+	{
+		if(_masks[m] != nullptr)
+			fractions[m] = Image2D::CreateUnsetImagePtr(width, height);
+	}
+
+	forEachRowRange(height, imageWidth * blockHeight, [&](size_t rowStart, size_t rowEnd)
+	{
+		std::vector<double> valueSums(width);
+		std::vector<size_t> valueCounts(width);
+		std::array<std::vector<size_t>, MaskCount> maskCounts;
+		for(size_t m=0; m!=MaskCount; ++m)
+		{
+			if(_masks[m] != nullptr)
+				maskCounts[m].resize(width);
+		}
+		for(size_t levelY=rowStart; levelY!=rowEnd; ++levelY)
+		{
+			std::fill(valueSums.begin(), valueSums.end(), 0.0);
+			std::fill(valueCounts.begin(), valueCounts.end(), 0);
+			for(std::vector<size_t>& counts : maskCounts)
+				std::fill(counts.begin(), counts.end(), 0);
+
+			const size_t
+				yStart = levelY * blockHeight,
+				yEnd = std::min(yStart + blockHeight, imageHeight);
+			for(size_t y=yStart; y!=yEnd; ++y)
+			{
+				const num_t* values = _image->ValuePtr(0, y);
+				std::array<const bool*, MaskCount> flags;
+				for(size_t m=0; m!=MaskCount; ++m)
+					flags[m] = _masks[m] == nullptr ? nullptr : _masks[m]->ValuePtr(0, y);
+				for(size_t x=0; x!=imageWidth; ++x)
+				{
+					const size_t levelX = x >> horizontalLevel;
+					size_t m = 0;
+					while(m != MaskCount && (flags[m] == nullptr || !flags[m][x]))
+						++m;
+					if(m == MaskCount)
+					{
+						valueSums[levelX] += values[x];
+						++valueCounts[levelX];
+					}
+					else
+						++maskCounts[m][levelX];
+				}
+			}
+
+			for(size_t levelX=0; levelX!=width; ++levelX)
+			{
+				const size_t
+					xStart = levelX << horizontalLevel,
+					xEnd = std::min(xStart + (size_t(1) << horizontalLevel), imageWidth),
+					blockSize = (xEnd - xStart) * (yEnd - yStart);
+				image->SetValue(levelX, levelY, valueCounts[levelX] == 0 ? 0.0 : valueSums[levelX] / valueCounts[levelX]);
+				for(size_t m=0; m!=MaskCount; ++m)
+				{
+					if(fractions[m] != nullptr)
+						fractions[m]->SetValue(levelX, levelY, num_t(maskCounts[m][levelX]) / blockSize);
+				}
+			}
+		}
+	});
+
+	level.image = std::move(image);
+	for(size_t m=0; m!=MaskCount; ++m)
+		level.fractions[m] = std::move(fractions[m]);
+	return level;
+}
+
+Image2DCPtr HeatMapRenderer::makeLogImage(const Image2D& image)
+{
+	Image2DPtr logImage = Image2D::CreateUnsetImagePtr(image.Width(), image.Height());
+	forEachRowRange(image.Height(), image.Width(), [&](size_t rowStart, size_t rowEnd)
+	{
+		for(size_t y=rowStart; y!=rowEnd; ++y)
+		{
+			const num_t* values = image.ValuePtr(0, y);
+			num_t* logValues = logImage->ValuePtr(0, y);
+			for(size_t x=0; x!=image.Width(); ++x)
+				logValues[x] = logOrNaN(values[x]);
+		}
+	});
+	return logImage;
+}
+
+void HeatMapRenderer::renderRow(const Region& region, const Level* level, size_t y, unsigned char* row) const
+{
+	const num_t* values;
+	std::array<const bool*, MaskCount> flags;
+	std::array<const num_t*, MaskCount> fractions;
+	flags.fill(nullptr);
+	fractions.fill(nullptr);
+	if(level == nullptr)
+	{
+		values = _image->ValuePtr(region.startX, y);
+		for(size_t m=0; m!=MaskCount; ++m)
+		{
+			if(_masks[m] != nullptr)
+				flags[m] = _masks[m]->ValuePtr(region.startX, y);
+		}
+	}
+	else {
+		values = (_logarithmic ? level->logImage : level->image)->ValuePtr(region.startX, y);
+		for(size_t m=0; m!=MaskCount; ++m)
+		{
+			if(level->fractions[m] != nullptr)
+				fractions[m] = level->fractions[m]->ValuePtr(region.startX, y);
+		}
+	}
+	const bool takeLog = _logarithmic && level == nullptr;
+
+	const size_t width = region.Width();
+	for(size_t x=0; x!=width; ++x)
+	{
+		unsigned char* pixel = row + x * 4;
+		size_t m = 0;
+		while(m != MaskCount && (flags[m] == nullptr || !flags[m][x]))
+			++m;
+		if(m != MaskCount)
+		{
+			std::copy(_maskColors[m].begin(), _maskColors[m].end(), pixel);
+			continue;
+		}
+
+		const std::array<unsigned char, 4>& color = _colorTable[colorIndex(takeLog ? logOrNaN(values[x]) : values[x])];
+		num_t flaggedFraction = 0.0;
+		for(size_t f=0; f!=MaskCount; ++f)
+		{
+			if(fractions[f] != nullptr)
+				flaggedFraction += fractions[f][x];
+		}
+		if(flaggedFraction == 0.0)
+			std::copy(color.begin(), color.end(), pixel);
+		else {
+			// Mix the colours in proportion to how many samples have them, as if
+			// the full resolution image was averaged.
+			for(size_t c=0; c!=4; ++c)
+			{
+				num_t mixed = (1.0 - flaggedFraction) * color[c];
+				for(size_t f=0; f!=MaskCount; ++f)
+				{
+					if(fractions[f] != nullptr)
+						mixed += fractions[f][x] * _maskColors[f][c];
+				}
+				pixel[c] = (unsigned char) std::min<num_t>(mixed + 0.5, 255.0);
+			}
+		}
+	}
+}
@@ -0,0 +1,154 @@
+#ifndef HEAT_MAP_RENDERER_H
+#define HEAT_MAP_RENDERER_H
+
+#include "../structures/colormap.h"
+#include "../structures/image2d.h"
+#include "../structures/mask2d.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+/**
+ * Turns an image and its masks into the colours that a HeatMapPlot shows.
+ *
+ * Large images are drawn from lower-resolution levels of the image: level
+ * (h, v) holds the mean of blocks of 2^h x 2^v samples. For each mask, a level
+ * also holds the fraction of flagged samples in a block, so that flags show
+ * up in proportion to how often they occur, as they do when the full
+ * resolution image is averaged. A level is made for the whole image the first
+ * time it is needed, so that panning or redrawing does not need to go over
+ * all samples again.
+ *
+ * Values are turned into colours with a table that is filled from the colour
+ * map once, and the rows are coloured on multiple threads. For a logarithmic
+ * colour scale, a level also keeps the log10 of its values, which is computed
+ * once, so that the table is indexed linearly in log space. Samples that are
+ * drawn at full resolution are turned into their log while colouring. The
+ * class does not depend on Cairo, but writes the ARGB32 layout of a Cairo
+ * image surface.
+ */
+class HeatMapRenderer
+{
+public:
+	/**
+	 * The masks in order of priority: a sample that is set in more than one
+	 * mask gets the colour of the first.
+	 */
+	enum MaskIndex { HighlightMask, OriginalMask, AlternativeMask, MaskCount };
+
+	/**
+	 * A rectangle of samples in one of the levels.
+	 */
+	struct Region
+	{
+		unsigned horizontalLevel, verticalLevel;
+		size_t startX, endX, startY, endY;
+
+		size_t Width() const { return endX - startX; }
+		size_t Height() const { return endY - startY; }
+	};
+
+	HeatMapRenderer();
+
+	/**
+	 * Sets the image and masks to draw. Masks may be null. The levels are
+	 * only thrown away when one of them is a different object than before.
+	 */
+	void SetImage(const Image2DCPtr& image, const std::array<Mask2DCPtr, MaskCount>& masks);
+
+	/**
+	 * Throws away the levels, e.g. because the contents of the image changed.
+	 */
+	void Reset();
+
+	/**
+	 * Fills the colour table. Values from min to max are mapped linearly, or
+	 * logarithmically, on the colour map from -1 to 1.
+	 */
+	void SetColorMap(const ColorMap& colorMap, num_t min, num_t max, bool logarithmic);
+
+	void SetMaskColor(enum MaskIndex mask, unsigned char r, unsigned char g, unsigned char b);
+
+	/**
+	 * Returns the coarsest level that still has at least destWidth x destHeight
+	 * samples in the area of [startX, endX) x [startY, endY) of the full
+	 * resolution image, and the area in samples of that level. The area is
+	 * rounded outwards to whole blocks. Levels that shrink by less than four
+	 * are not used: such areas are drawn from the full resolution image.
+	 */
+	Region SelectRegion(size_t startX, size_t endX, size_t startY, size_t endY, size_t destWidth, size_t destHeight) const;
+
+	/**
+	 * Writes the colours of the region to data, which should have room for
+	 * region.Height() rows of rowStride bytes. The bottom row of the region is
+	 * written first, because the plot shows the first channel at the bottom.
+	 */
+	void Render(const Region& region, unsigned char* data, size_t rowStride);
+
+	/**
+	 * Number of entries in the colour table.
+	 */
+	static const size_t ColorTableSize = 4096;
+
+	/**
+	 * Number of levels that are kept at most.
+	 */
+	static const size_t MaxCachedLevels = 2;
+
+private:
+	struct Level
+	{
+		unsigned horizontalLevel, verticalLevel;
+		/** Mean of the samples in a block that are not flagged, or zero if all are */
+		Image2DCPtr image;
+		/** For each mask that is set, the fraction of the block that has the colour of the mask */
+		std::array<Image2DCPtr, MaskCount> fractions;
+		/** log10 of image, or NaN where it is not positive. Made when first needed. */
+		Image2DCPtr logImage;
+	};
+
+	Level& getLevel(unsigned horizontalLevel, unsigned verticalLevel);
+	Level makeLevel(unsigned horizontalLevel, unsigned verticalLevel) const;
+	static Image2DCPtr makeLogImage(const Image2D& image);
+	void renderRow(const Region& region, const Level* level, size_t y, unsigned char* row) const;
+
+	static num_t logOrNaN(num_t value)
+	{
+		return value > 0.0 ? std::log10(value) : std::numeric_limits<num_t>::quiet_NaN();
+	}
+
+	/**
+	 * For a logarithmic scale, value should be the log10 of the sample.
+	 */
+	size_t colorIndex(num_t value) const
+	{
+		const num_t position = (value - _offset) * _scale;
+		// Also maps NaN to the first entry
+		if(!(position > 0.0))
+			return 0;
+		else if(position >= num_t(ColorTableSize - 1))
+			return ColorTableSize - 1;
+		else
+			return size_t(position + 0.5);
+	}
+
+	/**
+	 * Calls function(rowStart, rowEnd) for parts of [0, rowCount) on multiple threads.
+	 */
+	template<typename Function>
+	static void forEachRowRange(size_t rowCount, size_t rowSize, Function function);
+
+	Image2DCPtr _image;
+	std::array<Mask2DCPtr, MaskCount> _masks;
+	std::vector<Level> _levels;
+
+	std::vector<std::array<unsigned char, 4>> _colorTable;
+	std::array<std::array<unsigned char, 4>, MaskCount> _maskColors;
+	bool _logarithmic;
+	num_t _offset, _scale;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "functions.h"
+#include "gil.h"
 
 #include "../strategy/algorithms/highpassfilter.h"
 #include "../strategy/algorithms/medianwindow.h"
@@ -27,6 +28,7 @@ static object flagFunction;
 
 void enlarge(const Data& input, Data& destination, size_t horizontalFactor, size_t verticalFactor)
 {
+	ReleaseGIL releaseGIL;
 	TimeFrequencyData timeFrequencyData = input.TFData();
 	const size_t
 		imageCount = timeFrequencyData.ImageCount(),
@@ -68,6 +70,7 @@ object get_flag_function()
 	
 void low_pass_filter(Data& data, size_t kernelWidth, size_t kernelHeight, double horizontalSigmaSquared, double verticalSigmaSquared)
 {
+	ReleaseGIL releaseGIL;
 	if(data.TFData().PolarizationCount() != 1)
 		throw std::runtime_error("High-pass filtering needs single polarization");
 	HighPassFilter filter;
@@ -84,6 +87,7 @@ void low_pass_filter(Data& data, size_t kernelWidth, size_t kernelHeight, double
 
 void high_pass_filter(Data& data, size_t kernelWidth, size_t kernelHeight, double horizontalSigmaSquared, double verticalSigmaSquared)
 {
+	ReleaseGIL releaseGIL;
 	if(data.TFData().PolarizationCount() != 1)
 		throw std::runtime_error("High-pass filtering needs single polarization");
 	HighPassFilter filter;
@@ -120,6 +124,7 @@ void print_polarization_statistics(const Data& data)
 
 void scale_invariant_rank_operator(Data& data, double level_horizontal, double level_vertical)
 {
+	ReleaseGIL releaseGIL;
 	Mask2DPtr mask(new Mask2D(*data.TFData().GetSingleMask()));
 	
 	SIROperator::OperateHorizontally(*mask, level_horizontal);
@@ -134,6 +139,7 @@ void set_flag_function(PyObject* callable)
 
 Data shrink(const Data& data, size_t horizontalFactor, size_t verticalFactor)
 {
+	ReleaseGIL releaseGIL;
 	TimeFrequencyData timeFrequencyData = data.TFData();
 	const size_t imageCount = timeFrequencyData.ImageCount();
 	const size_t maskCount = timeFrequencyData.MaskCount();
@@ -170,6 +176,7 @@ Data shrink(const Data& data, size_t horizontalFactor, size_t verticalFactor)
 
 void sumthreshold(Data& data, double hThresholdFactor, double vThresholdFactor, bool horizontal, bool vertical)
 {
+	ReleaseGIL releaseGIL;
 	ThresholdConfig thresholdConfig;
 	thresholdConfig.InitializeLengthsDefault();
 	thresholdConfig.InitializeThresholdsFromFirstThreshold(6.0L, ThresholdConfig::Rayleigh);
@@ -189,6 +196,7 @@ void sumthreshold(Data& data, double hThresholdFactor, double vThresholdFactor,
 
 void threshold_channel_rms(Data& data, double threshold, bool thresholdLowValues)
 {
+	ReleaseGIL releaseGIL;
 	Image2DCPtr image(data.TFData().GetSingleImage());
 	SampleRow channels = SampleRow::MakeEmpty(image->Height());
 	Mask2DPtr mask(new Mask2D(*data.TFData().GetSingleMask()));
@@ -218,6 +226,7 @@ void threshold_channel_rms(Data& data, double threshold, bool thresholdLowValues
 
 void threshold_timestep_rms(Data& data, double threshold)
 {
+	ReleaseGIL releaseGIL;
 	Image2DCPtr image = data.TFData().GetSingleImage();
 	SampleRow timesteps = SampleRow::MakeEmpty(image->Width());
 	Mask2DPtr mask(new Mask2D(*data.TFData().GetSingleMask()));
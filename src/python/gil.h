@@ -0,0 +1,52 @@
+#ifndef PYTHON_GIL_H
+#define PYTHON_GIL_H
+
+#include <Python.h>
+
+namespace aoflagger_python
+{
+	/**
+	 * Releases the global interpreter lock during its lifetime, so that other
+	 * threads can run Python code while this thread performs a C++ computation.
+	 * No Python objects may be accessed while the lock is released.
+	 */
+	class ReleaseGIL
+	{
+	public:
+		ReleaseGIL() : _state(PyEval_SaveThread())
+		{ }
+		
+		~ReleaseGIL()
+		{
+			PyEval_RestoreThread(_state);
+		}
+		
+		ReleaseGIL(const ReleaseGIL&) = delete;
+		ReleaseGIL& operator=(const ReleaseGIL&) = delete;
+	private:
+		PyThreadState* _state;
+	};
+	
+	/**
+	 * Acquires the global interpreter lock during its lifetime. Can be used
+	 * from threads that were not created by Python.
+	 */
+	class AcquireGIL
+	{
+	public:
+		AcquireGIL() : _state(PyGILState_Ensure())
+		{ }
+		
+		~AcquireGIL()
+		{
+			PyGILState_Release(_state);
+		}
+		
+		AcquireGIL(const AcquireGIL&) = delete;
+		AcquireGIL& operator=(const AcquireGIL&) = delete;
+	private:
+		PyGILState_STATE _state;
+	};
+}
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "data.h"
 #include "functions.h"
+#include "gil.h"
 
 #include "../structures/polarization.h"
 
@@ -11,100 +12,144 @@
 
 #include <iostream>
 
-static boost::python::numpy::ndarray GetImageBuffer(const aoflagger::ImageSet* imageSet, size_t imageIndex)
+/**
+ * Copies a two-dimensional numpy array of type T into a buffer with the given
+ * row stride. Rows with contiguous values are converted with a plain loop that
+ * the compiler can vectorize.
+ */
+template<typename T, typename Dest>
+static void copyFromArray(const boost::python::numpy::ndarray& values, Dest* buffer, size_t horizontalStride)
 {
-	if(imageIndex >= imageSet->ImageCount())
-		throw std::out_of_range("aoflagger.get_image_buffer: Image index out of bounds");
-	namespace np = boost::python::numpy;
-	const float* values = imageSet->ImageBuffer(imageIndex);
-	Py_intptr_t shape[2] = { unsigned(imageSet->Height()), unsigned(imageSet->Width()) };
-	np::ndarray result = np::zeros(2, shape, np::dtype::get_builtin<double>());
-	char* resultData = result.get_data();
-	int stride0 = result.get_strides()[0];
-	int stride1 = result.get_strides()[1];
-	for(size_t y=0; y!=imageSet->Height(); ++y)
+	const char *data = values.get_data();
+	if(!data)
+		throw std::runtime_error("Data needs to be provided that is interpretable as an array");
+	const Py_intptr_t
+		height = values.shape(0),
+		width = values.shape(1),
+		stride0 = values.get_strides()[0],
+		stride1 = values.get_strides()[1];
+	for(Py_intptr_t y=0; y!=height; ++y)
 	{
-		const float* rowOut = values + y * imageSet->HorizontalStride();
-		char* rowIn = resultData + y * stride0;
-		for(size_t x=0; x!=imageSet->Width(); ++x)
+		const char* rowIn = data + y * stride0;
+		Dest* rowOut = buffer + y * horizontalStride;
+		if(stride1 == sizeof(T))
 		{
-			*reinterpret_cast<double*>(rowIn + x * stride1) = rowOut[x];
+			const T* rowValues = reinterpret_cast<const T*>(rowIn);
+			for(Py_intptr_t x=0; x!=width; ++x)
+				rowOut[x] = rowValues[x];
+		}
+		else {
+			for(Py_intptr_t x=0; x!=width; ++x)
+				rowOut[x] = *reinterpret_cast<const T*>(rowIn + x*stride1);
 		}
 	}
+}
+
+/**
+ * Creates a new, contiguous numpy array of type T from a buffer with the
+ * given row stride.
+ */
+template<typename T, typename Source>
+static boost::python::numpy::ndarray copyToArray(const Source* buffer, size_t width, size_t height, size_t horizontalStride)
+{
+	namespace np = boost::python::numpy;
+	np::ndarray result = np::empty(boost::python::make_tuple(height, width), np::dtype::get_builtin<T>());
+	T* resultData = reinterpret_cast<T*>(result.get_data());
+	for(size_t y=0; y!=height; ++y)
+	{
+		const Source* rowIn = buffer + y * horizontalStride;
+		T* rowOut = resultData + y * width;
+		for(size_t x=0; x!=width; ++x)
+			rowOut[x] = rowIn[x];
+	}
 	return result;
 }
 
+static boost::python::numpy::ndarray GetImageBuffer(const aoflagger::ImageSet* imageSet, size_t imageIndex)
+{
+	if(imageIndex >= imageSet->ImageCount())
+		throw std::out_of_range("aoflagger.get_image_buffer: Image index out of bounds");
+	return copyToArray<double>(imageSet->ImageBuffer(imageIndex), imageSet->Width(), imageSet->Height(), imageSet->HorizontalStride());
+}
+
+/**
+ * Returns a float array that shares its data with the image. The array keeps
+ * the image set alive.
+ */
+static boost::python::numpy::ndarray GetImageView(boost::python::object self, size_t imageIndex)
+{
+	namespace np = boost::python::numpy;
+	aoflagger::ImageSet& imageSet = boost::python::extract<aoflagger::ImageSet&>(self);
+	if(imageIndex >= imageSet.ImageCount())
+		throw std::out_of_range("aoflagger.get_image_view: Image index out of bounds");
+	return np::from_data(imageSet.ImageBuffer(imageIndex), np::dtype::get_builtin<float>(),
+		boost::python::make_tuple(imageSet.Height(), imageSet.Width()),
+		boost::python::make_tuple(imageSet.HorizontalStride() * sizeof(float), sizeof(float)),
+		self);
+}
+
 static void SetImageBuffer(aoflagger::ImageSet* imageSet, size_t imageIndex, const boost::python::numpy::ndarray& values)
 {
 	if(imageIndex >= imageSet->ImageCount())
 		throw std::out_of_range("aoflagger.get_image_buffer: Image index out of bounds");
 	namespace np = boost::python::numpy;
-	if(values.get_dtype() != np::dtype::get_builtin<double>())
-		throw std::runtime_error("ImageSet.set_image_buffer(): Invalid type specified for data array; double numpy array required");
+	if(values.get_nd() != 2)
+		throw std::runtime_error("ImageSet.set_image_buffer(): Invalid dimensions specified for data array; two dimensional array required");
 	if(values.shape(0) != int(imageSet->Height()) || values.shape(1) != int(imageSet->Width()))
 		throw std::runtime_error("ImageSet.set_image_buffer(): dimensions of provided array doesn't match with image set");
-	int stride0 = values.get_strides()[0];
-	int stride1 = values.get_strides()[1];
-	const char *data = values.get_data();
-	if(!data)
-		throw std::runtime_error("Data needs to be provided that is interpretable as a double array");
 	float* buffer = imageSet->ImageBuffer(imageIndex);
-	for(size_t y=0; y!=imageSet->Height(); ++y)
-	{
-		const char* rowIn = data + y * stride0;
-		float* rowOut = buffer + y * imageSet->HorizontalStride();
-		for(size_t x=0; x!=imageSet->Width(); ++x)
-		{
-			rowOut[x] = *reinterpret_cast<const double*>(rowIn + x*stride1);
-		}
-	}
+	if(values.get_dtype() == np::dtype::get_builtin<double>())
+		copyFromArray<double>(values, buffer, imageSet->HorizontalStride());
+	else if(values.get_dtype() == np::dtype::get_builtin<float>())
+		copyFromArray<float>(values, buffer, imageSet->HorizontalStride());
+	else
+		throw std::runtime_error("ImageSet.set_image_buffer(): Invalid type specified for data array; float or double numpy array required");
 }
 
 static boost::python::numpy::ndarray GetBuffer(const aoflagger::FlagMask* flagMask)
+{
+	return copyToArray<bool>(flagMask->Buffer(), flagMask->Width(), flagMask->Height(), flagMask->HorizontalStride());
+}
+
+/**
+ * Returns a bool array that shares its data with the flag mask. The array
+ * keeps the flag mask alive.
+ */
+static boost::python::numpy::ndarray GetBufferView(boost::python::object self)
 {
 	namespace np = boost::python::numpy;
-	const bool* values = flagMask->Buffer();
-	Py_intptr_t shape[2] = { unsigned(flagMask->Height()), unsigned(flagMask->Width()) };
-	np::ndarray result = np::zeros(2, shape, np::dtype::get_builtin<bool>());
-	char* resultData = result.get_data();
-	int stride0 = result.get_strides()[0];
-	int stride1 = result.get_strides()[1];
-	for(size_t y=0; y!=flagMask->Height(); ++y)
-	{
-		const bool* rowOut = values + y * flagMask->HorizontalStride();
-		char* rowIn = resultData + y * stride0;
-		for(size_t x=0; x!=flagMask->Width(); ++x)
-		{
-			*reinterpret_cast<bool*>(rowIn + x * stride1) = rowOut[x];
-		}
-	}
-	return result;
+	aoflagger::FlagMask& flagMask = boost::python::extract<aoflagger::FlagMask&>(self);
+	return np::from_data(flagMask.Buffer(), np::dtype::get_builtin<bool>(),
+		boost::python::make_tuple(flagMask.Height(), flagMask.Width()),
+		boost::python::make_tuple(flagMask.HorizontalStride() * sizeof(bool), sizeof(bool)),
+		self);
+}
+
+/**
+ * Implements the numpy array interface, so that numpy.asarray(flagMask)
+ * shares the data of the mask instead of copying it.
+ */
+static boost::python::dict GetFlagMaskArrayInterface(const aoflagger::FlagMask& flagMask)
+{
+	boost::python::dict interface;
+	interface["version"] = 3;
+	interface["shape"] = boost::python::make_tuple(flagMask.Height(), flagMask.Width());
+	interface["typestr"] = "|b1";
+	interface["strides"] = boost::python::make_tuple(flagMask.HorizontalStride() * sizeof(bool), sizeof(bool));
+	interface["data"] = boost::python::make_tuple(reinterpret_cast<size_t>(flagMask.Buffer()), false);
+	return interface;
 }
 
 static void SetBuffer(aoflagger::FlagMask* flagMask, const boost::python::numpy::ndarray& values)
 {
 	namespace np = boost::python::numpy;
 	if(values.get_dtype() != np::dtype::get_builtin<bool>())
-		throw std::runtime_error("FlagMask.set_buffer(): Invalid type specified for data array; double numpy array required");
+		throw std::runtime_error("FlagMask.set_buffer(): Invalid type specified for data array; bool numpy array required");
 	if(values.get_nd() != 2)
 		throw std::runtime_error("FlagMask.set_buffer(): Invalid dimensions specified for data array; two dimensional array required");
 	if(values.shape(0) != int(flagMask->Height()) || values.shape(1) != int(flagMask->Width()))
 		throw std::runtime_error("FlagMask.set_buffer(): dimensions of provided array doesn't match with image set");
-	const char *data = values.get_data();
-	if(!data)
-		throw std::runtime_error("Data needs to be provided that is interpretable as a bool array");
-	bool* buffer = flagMask->Buffer();
-	int stride0 = values.get_strides()[0];
-	int stride1 = values.get_strides()[1];
-	for(size_t y=0; y!=flagMask->Height(); ++y)
-	{
-		const char* rowIn = data + y * stride0;
-		bool* rowOut = buffer + y * flagMask->HorizontalStride();
-		for(size_t x=0; x!=flagMask->Width(); ++x)
-		{
-			rowOut[x] = *reinterpret_cast<const double*>(rowIn + x*stride1);
-		}
-	}
+	copyFromArray<bool>(values, flagMask->Buffer(), flagMask->HorizontalStride());
 }
 
 boost::python::object MakeImageSet1(aoflagger::AOFlagger* flagger, size_t width, size_t height, size_t count)
@@ -144,10 +189,30 @@ boost::python::object LoadStrategy(aoflagger::AOFlagger* flagger, const std::str
 { return boost::python::object(flagger->LoadStrategy(filename)); }
 
 boost::python::object Run1(aoflagger::AOFlagger* flagger, aoflagger::Strategy& strategy, const aoflagger::ImageSet& input)
-{ return boost::python::object(flagger->Run(strategy, input)); }
+{
+	aoflagger::FlagMask flags;
+	{
+		aoflagger_python::ReleaseGIL releaseGIL;
+		flags = flagger->Run(strategy, input);
+	}
+	return boost::python::object(std::move(flags));
+}
 
 boost::python::object Run2(aoflagger::AOFlagger* flagger, aoflagger::Strategy& strategy, const aoflagger::ImageSet& input, const aoflagger::FlagMask& existingFlags)
-{ return boost::python::object(flagger->Run(strategy, input, existingFlags)); }
+{
+	aoflagger::FlagMask flags;
+	{
+		aoflagger_python::ReleaseGIL releaseGIL;
+		flags = flagger->Run(strategy, input, existingFlags);
+	}
+	return boost::python::object(std::move(flags));
+}
+
+void CollectStatistics(aoflagger::AOFlagger* flagger, aoflagger::QualityStatistics& destination, const aoflagger::ImageSet& imageSet, const aoflagger::FlagMask& rfiFlags, const aoflagger::FlagMask& correlatorFlags, size_t antenna1, size_t antenna2)
+{
+	aoflagger_python::ReleaseGIL releaseGIL;
+	flagger->CollectStatistics(destination, imageSet, rfiFlags, correlatorFlags, antenna1, antenna2);
+}
 
 boost::python::object MakeQualityStatistics1(aoflagger::AOFlagger* flagger, const boost::python::numpy::ndarray& scanTimes, const boost::python::numpy::ndarray& channelFrequencies, size_t nPolarizations, bool computeHistograms)
 {
@@ -277,11 +342,16 @@ BOOST_PYTHON_MODULE(aoflagger)
 		.def("horizontal_stride", &aoflagger::ImageSet::HorizontalStride)
 		.def("set", &aoflagger::ImageSet::Set, "Set all samples to the specified value")
 		.def("get_image_buffer", GetImageBuffer,
-			"Get access to one of the image sets stored in this object. \n"
+			"Get a copy of one of the image sets stored in this object. \n"
 			"Returns a numpy double array of ntimes x nchannels.")
+		.def("get_image_view", GetImageView,
+			"Get direct access to one of the image sets stored in this object. \n"
+			"Returns a numpy float array of ntimes x nchannels that shares its \n"
+			"data with the image, so changes to the array change the image. The \n"
+			"view is not resized by resize_without_reallocation().")
 		.def("set_image_buffer", SetImageBuffer,
 			"Replace the data of one of the image sets. This function expects\n"
-			"a numpy double array of ntimes x nchannels.")
+			"a numpy float or double array of ntimes x nchannels.")
 		.def("resize_without_reallocation", &aoflagger::ImageSet::ResizeWithoutReallocation);
 	
 	class_<aoflagger::FlagMask>("FlagMask",
@@ -302,7 +372,9 @@ BOOST_PYTHON_MODULE(aoflagger)
 		.def("width", &aoflagger::FlagMask::Width, "Get width (number of time steps) of flag mask")
 		.def("height", &aoflagger::FlagMask::Height, "Get height (number of frequency channels) of flag mask")
 		.def("horizontal_stride", &aoflagger::FlagMask::HorizontalStride)
-		.def("get_buffer", GetBuffer, "Returns the flag mask as a bool numpy array with dimensions ntimes x nchannels.")
+		.def("get_buffer", GetBuffer, "Returns a copy of the flag mask as a bool numpy array with dimensions ntimes x nchannels.")
+		.def("get_buffer_view", GetBufferView, "Returns a bool numpy array with dimensions ntimes x nchannels that shares its data with the flag mask.")
+		.add_property("__array_interface__", GetFlagMaskArrayInterface)
 		.def("set_buffer", SetBuffer, "Sets the flag mask from a bool numpy array with dimensions ntimes x nchannels.");
 		
 	class_<aoflagger::Strategy>("Strategy",
@@ -336,7 +408,7 @@ BOOST_PYTHON_MODULE(aoflagger)
 		.def("run", Run2)
 		.def("make_quality_statistics", MakeQualityStatistics1)
 		.def("make_quality_statistics", MakeQualityStatistics2)
-		.def("collect_statistics", &aoflagger::AOFlagger::CollectStatistics)
+		.def("collect_statistics", CollectStatistics)
 		.def("write_statistics", &aoflagger::AOFlagger::WriteStatistics)
 		.def("get_version_string", &aoflagger::AOFlagger::GetVersionString).staticmethod("get_version_string")
 		.def("get_version_date", &aoflagger::AOFlagger::GetVersionDate).staticmethod("get_version_date");
@@ -3,6 +3,8 @@
 
 #include "loghistogram.h"
 
+#include <algorithm>
+#include <cmath>
 #include <complex>
 #include <map>
 #include <vector>
@@ -53,12 +55,23 @@ class HistogramCollection : public Serializable
 			LogHistogram &totalHistogram = GetTotalHistogram(antenna1, antenna2, polarization);
 			LogHistogram &rfiHistogram = GetRFIHistogram(antenna1, antenna2, polarization);
 			
-			for(size_t i=0;i<sampleCount;++i)
+			// The amplitudes and their bins are calculated once per chunk, and are
+			// used for both histograms.
+			const size_t chunkSize = 256;
+			float amplitudes[chunkSize];
+			int bins[chunkSize];
+			for(size_t chunkStart=0; chunkStart<sampleCount; chunkStart+=chunkSize)
 			{
-				const double amplitude = sqrt(values[i].real()*values[i].real() + values[i].imag()*values[i].imag());
-				totalHistogram.Add(amplitude);
-				if(isRFI[i])
-					rfiHistogram.Add(amplitude);
+				const size_t n = std::min(chunkSize, sampleCount - chunkStart);
+				const float *chunkValues = reinterpret_cast<const float*>(values + chunkStart);
+				for(size_t i=0; i!=n; ++i)
+				{
+					const float r = chunkValues[i*2], c = chunkValues[i*2+1];
+					amplitudes[i] = std::sqrt(r*r + c*c);
+				}
+				LogHistogram::GetBins(amplitudes, bins, n);
+				totalHistogram.AddBins(bins, n);
+				rfiHistogram.AddBins(bins, isRFI + chunkStart, n);
 			}
 		}
 		
@@ -1,8 +1,12 @@
 #ifndef LOGHISTOGRAM_H
 #define LOGHISTOGRAM_H
 
-#include <map>
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
 #include <vector>
 
@@ -14,53 +18,127 @@
 #define exp10(x) exp( (2.3025850929940456840179914546844) * (x) )
 #endif
 
+/**
+ * Histogram with logarithmically spaced bins, 100 per decade. Bin k holds the
+ * amplitudes that are closest to 10^(k/100) on a logarithmic scale. Bins of
+ * positive and negative amplitudes, and the zero bin, are kept separately.
+ *
+ * The bins are stored as consecutive arrays of counts, so that bins can be
+ * found by index and histograms can be added element-wise. Bins are
+ * 'created' when something is added to them, and only created bins are
+ * iterated over, even if their count is zero.
+ */
 class LogHistogram : public Serializable
 {
 	private:
-		class AmplitudeBin : public Serializable
+		/**
+		 * Counts of the consecutive bins [first, first + counts.size()).
+		 */
+		class BinRange
 		{
 		public:
-			AmplitudeBin() :
-				count(0)
+			BinRange() : first(0)
+			{ }
+			
+			bool InRange(int bin) const { return bin >= first && bin < End(); }
+			int Begin() const { return first; }
+			int End() const { return first + int(counts.size()); }
+			bool Exists(int bin) const { return InRange(bin) && exists[bin - first]; }
+			long unsigned Count(int bin) const { return counts[bin - first]; }
+			
+			/**
+			 * Makes sure that bins [binBegin, binEnd) can be indexed. Some extra bins
+			 * are added, so that adding many new bins does not move the data
+			 * every time.
+			 */
+			void Reserve(int binBegin, int binEnd)
 			{
+				if(counts.empty())
+				{
+					first = binBegin;
+					counts.assign(binEnd - binBegin, 0);
+					exists.assign(binEnd - binBegin, 0);
+				}
+				else if(binBegin < first || binEnd > End())
+				{
+					const int margin = 16;
+					const int newFirst = binBegin < first ? binBegin - margin : first;
+					const int newEnd = binEnd > End() ? binEnd + margin : End();
+					std::vector<long unsigned> newCounts(newEnd - newFirst, 0);
+					std::vector<unsigned char> newExists(newEnd - newFirst, 0);
+					std::copy(counts.begin(), counts.end(), newCounts.begin() + (first - newFirst));
+					std::copy(exists.begin(), exists.end(), newExists.begin() + (first - newFirst));
+					first = newFirst;
+					counts.swap(newCounts);
+					exists.swap(newExists);
+				}
 			}
-			long unsigned count;
 			
-			long unsigned GetCount() const
+			long unsigned &Create(int bin)
 			{
-				return count;
+				Reserve(bin, bin + 1);
+				exists[bin - first] = 1;
+				return counts[bin - first];
 			}
 			
-			AmplitudeBin &operator+=(const AmplitudeBin &other)
+			void Increment(int bin)
 			{
-				count += other.count;
-				return *this;
+				++counts[bin - first];
+				exists[bin - first] = 1;
 			}
-			AmplitudeBin &operator-=(const AmplitudeBin &other)
+			
+			void Add(const BinRange &other)
 			{
-				if(count >= other.count)
-					count -= other.count;
-				else
-					count = 0;
-				return *this;
+				if(other.counts.empty())
+					return;
+				Reserve(other.first, other.End());
+				long unsigned *destCounts = &counts[other.first - first];
+				unsigned char *destExists = &exists[other.first - first];
+				for(size_t i=0; i!=other.counts.size(); ++i)
+				{
+					destCounts[i] += other.counts[i];
+					destExists[i] |= other.exists[i];
+				}
 			}
 			
-			virtual void Serialize(std::ostream &stream) const final override
+			/** Index of the first created bin at or after bin, or End(). */
+			int NextExisting(int bin) const
 			{
-				SerializeToUInt64(stream, count);
+				while(bin < End() && !exists[bin - first])
+					++bin;
+				return bin;
 			}
-			virtual void Unserialize(std::istream &stream) final override
+			
+			/** Index of the last created bin at or before bin, or Begin()-1. */
+			int PreviousExisting(int bin) const
 			{
-				count = UnserializeUInt64(stream);
+				while(bin >= first && !exists[bin - first])
+					--bin;
+				return bin;
 			}
+			
+			size_t ExistingCount() const
+			{
+				return std::count(exists.begin(), exists.end(), 1);
+			}
+			
+		private:
+			int first;
+			std::vector<long unsigned> counts;
+			std::vector<unsigned char> exists;
 		};
 		
 	public:
-		LogHistogram()
-		{
-		}
+		/**
+		 * Bin value given by GetBins() for amplitudes that are not counted.
+		 */
+		static const int InvalidBin = INT_MIN;
+		/**
+		 * Bin value given by GetBins() for zero amplitudes.
+		 */
+		static const int ZeroBin = INT_MIN + 1;
 		
-		LogHistogram(const LogHistogram &source) : _amplitudes(source._amplitudes)
+		LogHistogram() : _zeroCount(0), _hasZeroBin(false)
 		{
 		}
 		
@@ -68,68 +146,132 @@ class LogHistogram : public Serializable
 		{
 			if(std::isfinite(amplitude))
 			{
-				const double centralAmp = getCentralAmplitude(amplitude);
-				AmplitudeBin &bin = getBin(centralAmp);
-				++bin.count;
+				if(amplitude > 0.0)
+					_positiveBins.Create(getBinIndex(amplitude))++;
+				else if(amplitude < 0.0)
+					_negativeBins.Create(getBinIndex(-amplitude))++;
+				else
+					createZeroBin()++;
 			}
 		}
 		
-		void Add(const LogHistogram &histogram)
+		/**
+		 * Determines the bins of non-negative amplitudes, for use with AddBins().
+		 * The bin is found from the exponent and mantissa of the value, instead
+		 * of by calculating its logarithm. Negative, infinite and NaN
+		 * amplitudes get bin InvalidBin.
+		 */
+		static void GetBins(const float *amplitudes, int *bins, size_t count)
 		{
-			for(std::map<double, AmplitudeBin>::const_iterator i=histogram._amplitudes.begin(); i!=histogram._amplitudes.end();++i)
+			const BinTables &tables = getBinTables();
+			for(size_t i=0; i!=count; ++i)
 			{
-				AmplitudeBin &bin = getBin(i->first);
-				bin += i->second;
+				uint32_t bits;
+				std::memcpy(&bits, &amplitudes[i], sizeof(bits));
+				const uint32_t
+					exponentBits = bits >> 23, // includes the sign bit
+					mantissaIndex = (bits >> (23 - BinTables::MantissaBits)) & ((1u << BinTables::MantissaBits) - 1);
+				// The estimate is at most 0.05 bin too low, so the rounded estimate
+				// is either the correct bin or the one below.
+				const double estimate = BinsPerLog2 * (double(int(exponentBits) - 127) + tables.log2Mantissa[mantissaIndex]);
+				const int lowerBin = int(std::floor(estimate + 0.5));
+				const bool isNormal = exponentBits != 0 && exponentBits < 255;
+				const int tableIndex = isNormal ? lowerBin + 1 - BinTables::FirstBoundaryBin : 0;
+				const int bin = lowerBin + (amplitudes[i] >= tables.lowerBoundaries[tableIndex] ? 1 : 0);
+				if(isNormal)
+					bins[i] = bin;
+				else if((bits << 1) == 0)
+					bins[i] = ZeroBin;
+				else if(exponentBits == 0)
+					bins[i] = getBinIndex(amplitudes[i]); // subnormal
+				else
+					bins[i] = InvalidBin;
 			}
 		}
 		
+		/**
+		 * Counts amplitudes of which the bins were determined with GetBins().
+		 */
+		void AddBins(const int *bins, size_t count)
+		{
+			addBins(bins, count, [](size_t) { return true; });
+		}
+		
+		/**
+		 * Counts the amplitudes for which selection is true.
+		 */
+		void AddBins(const int *bins, const bool *selection, size_t count)
+		{
+			addBins(bins, count, [selection](size_t i) { return selection[i]; });
+		}
+		
+		void Add(const LogHistogram &histogram)
+		{
+			_positiveBins.Add(histogram._positiveBins);
+			_negativeBins.Add(histogram._negativeBins);
+			if(histogram._hasZeroBin)
+				createZeroBin() += histogram._zeroCount;
+		}
+		
 		void operator-=(const LogHistogram &histogram)
 		{
-			for(std::map<double, AmplitudeBin>::const_iterator i=histogram._amplitudes.begin(); i!=histogram._amplitudes.end();++i)
+			subtract(_positiveBins, histogram._positiveBins);
+			subtract(_negativeBins, histogram._negativeBins);
+			if(histogram._hasZeroBin)
 			{
-				AmplitudeBin &bin = getBin(i->first);
-				bin -= i->second;
+				long unsigned &count = createZeroBin();
+				count = count >= histogram._zeroCount ? count - histogram._zeroCount : 0;
 			}
 		}
 		
 		double MaxAmplitude() const
 		{
-			if(_amplitudes.empty())
+			if(begin() == end())
 				return 0.0;
-			return _amplitudes.rbegin()->first;
+			const_iterator i = end();
+			--i;
+			return i.value();
 		}
 		
 		double MinPositiveAmplitude() const
 		{
-			std::map<double, AmplitudeBin>::const_iterator i = _amplitudes.begin();
-			if(i == _amplitudes.end())
+			const int bin = _positiveBins.NextExisting(_positiveBins.Begin());
+			if(bin == _positiveBins.End())
 				return 0.0;
-			while(i->first <= 0.0)
-			{
-				++i;
-				if(i == _amplitudes.end())
-					return 0.0;
-			}
-			return i->first;
+			return binValue(bin);
 		}
 		
 		double NormalizedCount(double startAmplitude, double endAmplitude) const
 		{
 			unsigned long count = 0;
-			for(std::map<double, class AmplitudeBin>::const_iterator i=_amplitudes.begin();i!=_amplitudes.end();++i)
+			for(const_iterator i=begin();i!=end();++i)
 			{
-				if(i->first >= startAmplitude && i->first < endAmplitude)
-					count += i->second.GetCount();
+				if(i.value() >= startAmplitude && i.value() < endAmplitude)
+					count += i.unnormalizedCount();
 			}
 			return (double) count / (endAmplitude - startAmplitude);
 		}
 		
 		double NormalizedCount(double centreAmplitude) const
 		{
-			const double key = getCentralAmplitude(centreAmplitude);
-			std::map<double, AmplitudeBin>::const_iterator i = _amplitudes.find(key);
-			if(i == _amplitudes.end()) return 0.0;
-			return (double) i->second.GetCount() / (binEnd(centreAmplitude) - binStart(centreAmplitude));
+			long unsigned count;
+			if(centreAmplitude > 0.0)
+			{
+				const int bin = getBinIndex(centreAmplitude);
+				if(!_positiveBins.Exists(bin)) return 0.0;
+				count = _positiveBins.Count(bin);
+			}
+			else if(centreAmplitude < 0.0)
+			{
+				const int bin = getBinIndex(-centreAmplitude);
+				if(!_negativeBins.Exists(bin)) return 0.0;
+				count = _negativeBins.Count(bin);
+			}
+			else {
+				if(!_hasZeroBin) return 0.0;
+				count = _zeroCount;
+			}
+			return (double) count / (binEnd(centreAmplitude) - binStart(centreAmplitude));
 		}
 		
 		double MinNormalizedCount() const
@@ -374,117 +516,265 @@ class LogHistogram : public Serializable
 		{
 			for(std::vector<HistogramTablesFormatter::HistogramItem>::const_iterator i=histogramData.begin(); i!=histogramData.end();++i)
 			{
-				const double b = (i->binStart + i->binEnd) * 0.5; // TODO somewhat inefficient...
-				getBin(getCentralAmplitude(b)).count = (unsigned long) i->count;
+				const double b = (i->binStart + i->binEnd) * 0.5;
+				createBin(b) = (unsigned long) i->count;
 			}
 		}
 		
+		/**
+		 * Multiplies all amplitudes by the given factor. Bins that end up in the
+		 * same bin are summed.
+		 */
 		void Rescale(double factor)
 		{
-			std::map<double, AmplitudeBin> newAmplitudes;
-			std::map<double, AmplitudeBin>::iterator position = newAmplitudes.begin();
-			for(std::map<double, AmplitudeBin>::const_iterator i=_amplitudes.begin();
-					i!=_amplitudes.end();++i)
-			{
-				position = newAmplitudes.insert(position, std::pair<double, AmplitudeBin>(getCentralAmplitude(i->first * factor), i->second));
-			}
-			_amplitudes = newAmplitudes;
+			LogHistogram rescaled;
+			for(const_iterator i=begin(); i!=end(); ++i)
+				rescaled.createBin(i.value() * factor) += i.unnormalizedCount();
+			*this = std::move(rescaled);
 		}
 		
 		class const_iterator
 		{
 			public:
-				const_iterator(const LogHistogram &histogram, std::map<double, AmplitudeBin>::const_iterator iter) :
-					_iterator(iter)
+				// Positions enumerate the negative bins from large to small
+				// amplitude, then the zero bin, then the positive bins.
+				const_iterator(const LogHistogram &histogram, int position) :
+					_histogram(&histogram), _position(position)
 				{ }
-				const_iterator(const const_iterator &source) :
-					_iterator(source._iterator)
-				{ }
-				const_iterator &operator=(const const_iterator &source)
-				{
-					_iterator = source._iterator;
-					return *this;
-				}
-				bool operator==(const const_iterator &other) const { return other._iterator == _iterator; }
-				bool operator!=(const const_iterator &other) const { return other._iterator != _iterator; }
-				const_iterator &operator++() { ++_iterator; return *this; }
-				const_iterator &operator--() { --_iterator; return *this; }
-				double value() const { return _iterator->first; }
-				double normalizedCount() const { return _iterator->second.GetCount() / (binEnd() - binStart()); }
-				long unsigned unnormalizedCount() const { return _iterator->second.GetCount(); }
+				bool operator==(const const_iterator &other) const { return other._position == _position; }
+				bool operator!=(const const_iterator &other) const { return other._position != _position; }
+				const_iterator &operator++() { _position = _histogram->nextPosition(_position + 1); return *this; }
+				const_iterator &operator--() { _position = _histogram->previousPosition(_position - 1); return *this; }
+				double value() const { return _histogram->positionValue(_position); }
+				double normalizedCount() const { return unnormalizedCount() / (binEnd() - binStart()); }
+				long unsigned unnormalizedCount() const { return _histogram->positionCount(_position); }
 				double binStart() const
 				{
-					return _iterator->first>0.0 ?
-						exp10(log10(_iterator->first)-0.005) :
-						-exp10(log10(-_iterator->first)-0.005);
+					const double v = value();
+					return v>0.0 ?
+						exp10(log10(v)-0.005) :
+						-exp10(log10(-v)-0.005);
 				}
 				double binEnd() const
 				{
-					return _iterator->first>0.0 ?
-						exp10(log10(_iterator->first)+0.005) :
-						-exp10(log10(-_iterator->first)+0.005);
+					const double v = value();
+					return v>0.0 ?
+						exp10(log10(v)+0.005) :
+						-exp10(log10(-v)+0.005);
 				}
 			private:
-				std::map<double, AmplitudeBin>::const_iterator _iterator;
+				const LogHistogram *_histogram;
+				int _position;
 		};
 		typedef const_iterator iterator;
 		
 		const_iterator begin() const
 		{
-			return const_iterator(*this, _amplitudes.begin());
+			return const_iterator(*this, nextPosition(0));
 		}
 		
 		const_iterator end() const
 		{
-			return const_iterator(*this, _amplitudes.end());
+			return const_iterator(*this, endPosition());
 		}
 		
+		/**
+		 * Writes the created bins in order of amplitude, as a count followed by
+		 * (central amplitude, count) pairs.
+		 */
 		virtual void Serialize(std::ostream &stream) const final override
 		{
-			SerializeToUInt64(stream, _amplitudes.size());
-			for(std::map<double, AmplitudeBin>::const_iterator i=_amplitudes.begin();i!=_amplitudes.end();++i)
+			const size_t binCount = _positiveBins.ExistingCount() + _negativeBins.ExistingCount() + (_hasZeroBin ? 1 : 0);
+			SerializeToUInt64(stream, binCount);
+			for(const_iterator i=begin(); i!=end(); ++i)
 			{
-				SerializeToDouble(stream, i->first);
-				i->second.Serialize(stream);
+				SerializeToDouble(stream, i.value());
+				SerializeToUInt64(stream, i.unnormalizedCount());
 			}
 		}
 		
 		virtual void Unserialize(std::istream &stream) final override
 		{
-			_amplitudes.clear();
-			size_t mapSize = UnserializeUInt64(stream);
-			std::map<double, AmplitudeBin>::iterator insertPos = _amplitudes.begin();
-			for(size_t i=0;i!=mapSize;++i)
+			*this = LogHistogram();
+			size_t binCount = UnserializeUInt64(stream);
+			for(size_t i=0;i!=binCount;++i)
 			{
-				std::pair<double, AmplitudeBin> p;
-				p.first = UnserializeDouble(stream);
-				p.second.Unserialize(stream);
-				insertPos = _amplitudes.insert(insertPos, p);
+				const double amplitude = UnserializeDouble(stream);
+				createBin(amplitude) = UnserializeUInt64(stream);
 			}
 		}
 		
 		void CreateMissingBins()
 		{
-			double first = MinPositiveAmplitude(), last = MaxAmplitude();
-			for(double i=first; i<last; i *= 1.01)
-			{
-				getBin(getCentralAmplitude(i));
-			}
+			const int
+				first = _positiveBins.NextExisting(_positiveBins.Begin()),
+				last = _positiveBins.PreviousExisting(_positiveBins.End() - 1);
+			for(int bin=first; bin<last; ++bin)
+				_positiveBins.Create(bin);
 		}
 	private:
-		std::map<double, AmplitudeBin> _amplitudes;
+		static constexpr double BinsPerLog2 = 30.102999566398119521373889472449; // 100 * log10(2)
 		
-		AmplitudeBin &getBin(double centralAmplitude)
+		/**
+		 * Tables for finding the bin of a float from its bits.
+		 */
+		struct BinTables
 		{
-			std::map<double, class AmplitudeBin>::iterator element =
-				_amplitudes.find(centralAmplitude);
+			static const int MantissaBits = 10;
+			// The range of bins of normal floats, plus one at each side
+			static const int FirstBoundaryBin = -3795, LastBoundaryBin = 3856;
+			
+			BinTables() :
+				log2Mantissa(1 << MantissaBits),
+				lowerBoundaries(LastBoundaryBin - FirstBoundaryBin + 1)
+			{
+				for(size_t i=0; i!=log2Mantissa.size(); ++i)
+					log2Mantissa[i] = std::log2(1.0 + double(i) / log2Mantissa.size());
+				// The first bin is not used as boundary for normal floats, and compares
+				// false for the other values.
+				lowerBoundaries[0] = std::numeric_limits<double>::infinity();
+				for(int bin=FirstBoundaryBin+1; bin<=LastBoundaryBin; ++bin)
+				{
+					const double approximateBoundary = exp10((bin - 0.5) / 100.0);
+					if(approximateBoundary > std::numeric_limits<float>::max())
+					{
+						lowerBoundaries[bin - FirstBoundaryBin] = std::numeric_limits<float>::infinity();
+					}
+					else {
+						// The smallest float that is rounded to this bin by getBinIndex()
+						float boundary = float(approximateBoundary);
+						while(boundary > 0.0f && getBinIndex(boundary) >= bin)
+							boundary = std::nextafter(boundary, 0.0f);
+						while(getBinIndex(boundary) < bin)
+							boundary = std::nextafter(boundary, std::numeric_limits<float>::max());
+						lowerBoundaries[bin - FirstBoundaryBin] = boundary;
+					}
+				}
+			}
 			
-			if(element == _amplitudes.end())
+			std::vector<double> log2Mantissa;
+			std::vector<float> lowerBoundaries;
+		};
+		
+		BinRange _positiveBins, _negativeBins;
+		long unsigned _zeroCount;
+		bool _hasZeroBin;
+		
+		static const BinTables &getBinTables()
+		{
+			static const BinTables tables;
+			return tables;
+		}
+		
+		template<typename Selection>
+		void addBins(const int *bins, size_t count, Selection selection)
+		{
+			int minBin = INT_MAX, maxBin = INT_MIN;
+			for(size_t i=0; i!=count; ++i)
 			{
-				element = _amplitudes.insert(std::pair<double, AmplitudeBin>(centralAmplitude, AmplitudeBin())).first;
+				if(bins[i] > ZeroBin)
+				{
+					minBin = std::min(minBin, bins[i]);
+					maxBin = std::max(maxBin, bins[i]);
+				}
+			}
+			if(minBin <= maxBin)
+				_positiveBins.Reserve(minBin, maxBin + 1);
+			for(size_t i=0; i!=count; ++i)
+			{
+				if(selection(i))
+				{
+					if(bins[i] > ZeroBin)
+						_positiveBins.Increment(bins[i]);
+					else if(bins[i] == ZeroBin)
+						++createZeroBin();
+				}
 			}
-			return element->second;
 		}
+		
+		long unsigned &createZeroBin()
+		{
+			_hasZeroBin = true;
+			return _zeroCount;
+		}
+		
+		/**
+		 * Returns the bin of the given amplitude, which should be a central
+		 * amplitude or be rounded to one.
+		 */
+		long unsigned &createBin(double amplitude)
+		{
+			if(amplitude > 0.0)
+				return _positiveBins.Create(getBinIndex(amplitude));
+			else if(amplitude < 0.0)
+				return _negativeBins.Create(getBinIndex(-amplitude));
+			else
+				return createZeroBin();
+		}
+		
+		static void subtract(BinRange &destination, const BinRange &source)
+		{
+			for(int bin=source.Begin(); bin!=source.End(); ++bin)
+			{
+				if(source.Exists(bin))
+				{
+					long unsigned &count = destination.Create(bin);
+					count = count >= source.Count(bin) ? count - source.Count(bin) : 0;
+				}
+			}
+		}
+		
+		int negativeSize() const { return _negativeBins.End() - _negativeBins.Begin(); }
+		int endPosition() const { return negativeSize() + 1 + (_positiveBins.End() - _positiveBins.Begin()); }
+		
+		bool positionExists(int position) const
+		{
+			const int n = negativeSize();
+			if(position < n)
+				return _negativeBins.Exists(_negativeBins.End() - 1 - position);
+			else if(position == n)
+				return _hasZeroBin;
+			else
+				return _positiveBins.Exists(_positiveBins.Begin() + position - n - 1);
+		}
+		
+		int nextPosition(int position) const
+		{
+			const int end = endPosition();
+			while(position < end && !positionExists(position))
+				++position;
+			return position;
+		}
+		
+		int previousPosition(int position) const
+		{
+			while(position > 0 && !positionExists(position))
+				--position;
+			return position;
+		}
+		
+		double positionValue(int position) const
+		{
+			const int n = negativeSize();
+			if(position < n)
+				return -binValue(_negativeBins.End() - 1 - position);
+			else if(position == n)
+				return 0.0;
+			else
+				return binValue(_positiveBins.Begin() + position - n - 1);
+		}
+		
+		long unsigned positionCount(int position) const
+		{
+			const int n = negativeSize();
+			if(position < n)
+				return _negativeBins.Count(_negativeBins.End() - 1 - position);
+			else if(position == n)
+				return _zeroCount;
+			else
+				return _positiveBins.Count(_positiveBins.Begin() + position - n - 1);
+		}
+		
 		double binStart(double x) const
 		{
 			return x>0.0 ?
@@ -498,12 +788,17 @@ class LogHistogram : public Serializable
 				-exp10(log10(x)+0.005);
 		}
 		
-		static double getCentralAmplitude(const double amplitude)
+		static double binValue(int bin)
 		{
-			if(amplitude>=0.0)
-				return exp10(round(100.0*log10(amplitude))/100.0);
-			else
-				return -exp10(round(100.0*log10(-amplitude))/100.0);
+			return exp10(bin/100.0);
+		}
+		
+		/**
+		 * Returns the bin of a positive amplitude.
+		 */
+		static int getBinIndex(const double amplitude)
+		{
+			return int(round(100.0*log10(amplitude)));
 		}
 };
 
@@ -1,5 +1,6 @@
 #include "qualitytablesformatter.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <set>
 
@@ -45,6 +46,15 @@ const std::string QualityTablesFormatter::ColumnNameName      = "NAME";
 const std::string QualityTablesFormatter::ColumnNameTime      = "TIME";
 const std::string QualityTablesFormatter::ColumnNameValue     = "VALUE";
 
+const size_t QualityTablesFormatter::BulkRowCount;
+
+namespace {
+	casacore::Slicer rowRange(size_t startRow, size_t rowCount)
+	{
+		return casacore::Slicer(casacore::IPosition(1, startRow), casacore::IPosition(1, rowCount));
+	}
+}
+
 enum QualityTablesFormatter::StatisticKind QualityTablesFormatter::NameToKind(const std::string &kindName)
 {
 	for(unsigned i=0;i<37;++i)
@@ -386,6 +396,133 @@ void QualityTablesFormatter::StoreBaselineTimeValue(unsigned antenna1, unsigned
 	valueColumn.put(newRow, data);
 }
 
+template<typename Position>
+void QualityTablesFormatter::storeKindsAndValues(casacore::Table &table, size_t startRow, const std::vector<std::pair<Position, StatisticalValue> > &entries)
+{
+	const size_t rowCount = entries.size();
+	const unsigned polarizationCount = entries.front().second.PolarizationCount();
+	casacore::Vector<int> kinds(rowCount);
+	casacore::Array<casacore::Complex> values(casacore::IPosition(2, polarizationCount, rowCount));
+	casacore::Complex* valuePtr = values.data();
+	for(size_t i=0; i!=rowCount; ++i)
+	{
+		const StatisticalValue &value = entries[i].second;
+		kinds[i] = value.KindIndex();
+		for(unsigned p=0; p!=polarizationCount; ++p)
+		{
+			*valuePtr = value.Value(p);
+			++valuePtr;
+		}
+	}
+	
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	casacore::ScalarColumn<int> kindColumn(table, ColumnNameKind);
+	casacore::ArrayColumn<casacore::Complex> valueColumn(table, ColumnNameValue);
+	kindColumn.putColumnRange(rows, kinds);
+	valueColumn.putColumnRange(rows, values);
+}
+
+void QualityTablesFormatter::StoreTimeValues(const std::vector<std::pair<TimePosition, StatisticalValue> > &entries)
+{
+	if(entries.empty())
+		return;
+	openTimeTable(true);
+	
+	const size_t startRow = _timeTable->nrow(), rowCount = entries.size();
+	_timeTable->addRow(rowCount);
+	
+	casacore::Vector<double> times(rowCount), frequencies(rowCount);
+	for(size_t i=0; i!=rowCount; ++i)
+	{
+		times[i] = entries[i].first.time;
+		frequencies[i] = entries[i].first.frequency;
+	}
+	
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	casacore::ScalarColumn<double> timeColumn(*_timeTable, ColumnNameTime);
+	casacore::ScalarColumn<double> frequencyColumn(*_timeTable, ColumnNameFrequency);
+	timeColumn.putColumnRange(rows, times);
+	frequencyColumn.putColumnRange(rows, frequencies);
+	storeKindsAndValues(*_timeTable, startRow, entries);
+}
+
+void QualityTablesFormatter::StoreFrequencyValues(const std::vector<std::pair<FrequencyPosition, StatisticalValue> > &entries)
+{
+	if(entries.empty())
+		return;
+	openFrequencyTable(true);
+	
+	const size_t startRow = _frequencyTable->nrow(), rowCount = entries.size();
+	_frequencyTable->addRow(rowCount);
+	
+	casacore::Vector<double> frequencies(rowCount);
+	for(size_t i=0; i!=rowCount; ++i)
+		frequencies[i] = entries[i].first.frequency;
+	
+	casacore::ScalarColumn<double> frequencyColumn(*_frequencyTable, ColumnNameFrequency);
+	frequencyColumn.putColumnRange(rowRange(startRow, rowCount), frequencies);
+	storeKindsAndValues(*_frequencyTable, startRow, entries);
+}
+
+void QualityTablesFormatter::StoreBaselineValues(const std::vector<std::pair<BaselinePosition, StatisticalValue> > &entries)
+{
+	if(entries.empty())
+		return;
+	openBaselineTable(true);
+	
+	const size_t startRow = _baselineTable->nrow(), rowCount = entries.size();
+	_baselineTable->addRow(rowCount);
+	
+	casacore::Vector<int> antenna1s(rowCount), antenna2s(rowCount);
+	casacore::Vector<double> frequencies(rowCount);
+	for(size_t i=0; i!=rowCount; ++i)
+	{
+		antenna1s[i] = entries[i].first.antenna1;
+		antenna2s[i] = entries[i].first.antenna2;
+		frequencies[i] = entries[i].first.frequency;
+	}
+	
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	casacore::ScalarColumn<int> antenna1Column(*_baselineTable, ColumnNameAntenna1);
+	casacore::ScalarColumn<int> antenna2Column(*_baselineTable, ColumnNameAntenna2);
+	casacore::ScalarColumn<double> frequencyColumn(*_baselineTable, ColumnNameFrequency);
+	antenna1Column.putColumnRange(rows, antenna1s);
+	antenna2Column.putColumnRange(rows, antenna2s);
+	frequencyColumn.putColumnRange(rows, frequencies);
+	storeKindsAndValues(*_baselineTable, startRow, entries);
+}
+
+void QualityTablesFormatter::StoreBaselineTimeValues(const std::vector<std::pair<BaselineTimePosition, StatisticalValue> > &entries)
+{
+	if(entries.empty())
+		return;
+	openBaselineTimeTable(true);
+	
+	const size_t startRow = _baselineTimeTable->nrow(), rowCount = entries.size();
+	_baselineTimeTable->addRow(rowCount);
+	
+	casacore::Vector<double> times(rowCount), frequencies(rowCount);
+	casacore::Vector<int> antenna1s(rowCount), antenna2s(rowCount);
+	for(size_t i=0; i!=rowCount; ++i)
+	{
+		times[i] = entries[i].first.time;
+		antenna1s[i] = entries[i].first.antenna1;
+		antenna2s[i] = entries[i].first.antenna2;
+		frequencies[i] = entries[i].first.frequency;
+	}
+	
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	casacore::ScalarColumn<double> timeColumn(*_baselineTimeTable, ColumnNameTime);
+	casacore::ScalarColumn<int> antenna1Column(*_baselineTimeTable, ColumnNameAntenna1);
+	casacore::ScalarColumn<int> antenna2Column(*_baselineTimeTable, ColumnNameAntenna2);
+	casacore::ScalarColumn<double> frequencyColumn(*_baselineTimeTable, ColumnNameFrequency);
+	timeColumn.putColumnRange(rows, times);
+	antenna1Column.putColumnRange(rows, antenna1s);
+	antenna2Column.putColumnRange(rows, antenna2s);
+	frequencyColumn.putColumnRange(rows, frequencies);
+	storeKindsAndValues(*_baselineTimeTable, startRow, entries);
+}
+
 void QualityTablesFormatter::removeStatisticFromStatTable(enum QualityTable qualityTable, enum StatisticKind kind)
 {
 	unsigned kindIndex;
@@ -451,6 +588,11 @@ unsigned QualityTablesFormatter::QueryStatisticEntryCount(enum StatisticDimensio
 	return count;
 }
 
+size_t QualityTablesFormatter::QueryStatisticRowCount(enum StatisticDimension dimension)
+{
+	return getTable(DimensionToTable(dimension), false).nrow();
+}
+
 unsigned QualityTablesFormatter::GetPolarizationCount()
 {
 	casacore::Table &table(getTable(TimeStatisticTable, false));
@@ -458,103 +600,114 @@ unsigned QualityTablesFormatter::GetPolarizationCount()
 	return valueColumn.columnDesc().shape()[0];
 }
 
-void QualityTablesFormatter::QueryTimeStatistic(unsigned kindIndex, std::vector<std::pair<TimePosition, StatisticalValue> > &entries)
+template<typename Position, typename PositionFunction>
+void QualityTablesFormatter::queryStatistic(casacore::Table &table, size_t startRow, size_t rowCount, int kindIndex, std::vector<std::pair<Position, StatisticalValue> > &entries, PositionFunction getPosition)
 {
-	casacore::Table &table(getTable(TimeStatisticTable, false));
-	const unsigned nrRow = table.nrow();
-	
-	casacore::ROScalarColumn<double> timeColumn(table, ColumnNameTime);
-	casacore::ROScalarColumn<double> frequencyColumn(table, ColumnNameFrequency);
 	casacore::ROScalarColumn<int> kindColumn(table, ColumnNameKind);
 	casacore::ROArrayColumn<casacore::Complex> valueColumn(table, ColumnNameValue);
 	
-	int polarizationCount = valueColumn.columnDesc().shape()[0];
+	const unsigned polarizationCount = valueColumn.columnDesc().shape()[0];
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	const casacore::Vector<int> kinds = kindColumn.getColumnRange(rows);
+	const casacore::Array<casacore::Complex> values = valueColumn.getColumnRange(rows);
 	
-	for(unsigned i=0;i<nrRow;++i)
+	const casacore::Complex* valuePtr = values.data();
+	for(size_t i=0; i!=rowCount; ++i)
 	{
-		if(kindColumn(i) == (int) kindIndex)
+		if(kindIndex < 0 || kinds[i] == kindIndex)
 		{
 			StatisticalValue value(polarizationCount);
-			value.SetKindIndex(kindIndex);
-			casacore::Array<casacore::Complex> valueArray = valueColumn(i);
-			casacore::Array<casacore::Complex>::iterator iter = valueArray.begin();
-			for(int p=0;p<polarizationCount;++p)
-			{
-				value.SetValue(p, *iter);
-				++iter;
-			}
-			TimePosition position;
-			position.time = timeColumn(i);
-			position.frequency = frequencyColumn(i);
-			entries.push_back(std::pair<TimePosition, StatisticalValue>(position, value));
+			value.SetKindIndex(kinds[i]);
+			for(unsigned p=0; p!=polarizationCount; ++p)
+				value.SetValue(p, valuePtr[p]);
+			entries.push_back(std::pair<Position, StatisticalValue>(getPosition(i), value));
 		}
+		valuePtr += polarizationCount;
 	}
 }
 
-void QualityTablesFormatter::QueryFrequencyStatistic(unsigned kindIndex, std::vector<std::pair<FrequencyPosition, StatisticalValue> > &entries)
+void QualityTablesFormatter::queryTimeStatistic(int kindIndex, size_t startRow, size_t rowCount, std::vector<std::pair<TimePosition, StatisticalValue> > &entries)
+{
+	casacore::Table &table(getTable(TimeStatisticTable, false));
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	const casacore::Vector<double>
+		times = casacore::ROScalarColumn<double>(table, ColumnNameTime).getColumnRange(rows),
+		frequencies = casacore::ROScalarColumn<double>(table, ColumnNameFrequency).getColumnRange(rows);
+	queryStatistic(table, startRow, rowCount, kindIndex, entries, [&](size_t i) {
+		TimePosition position;
+		position.time = times[i];
+		position.frequency = frequencies[i];
+		return position;
+	});
+}
+
+void QualityTablesFormatter::queryFrequencyStatistic(int kindIndex, size_t startRow, size_t rowCount, std::vector<std::pair<FrequencyPosition, StatisticalValue> > &entries)
 {
 	casacore::Table &table(getTable(FrequencyStatisticTable, false));
-	const unsigned nrRow = table.nrow();
-	
-	casacore::ROScalarColumn<double> frequencyColumn(table, ColumnNameFrequency);
-	casacore::ROScalarColumn<int> kindColumn(table, ColumnNameKind);
-	casacore::ROArrayColumn<casacore::Complex> valueColumn(table, ColumnNameValue);
-	
-	int polarizationCount = valueColumn.columnDesc().shape()[0];
-	
-	for(unsigned i=0;i<nrRow;++i)
-	{
-		if(kindColumn(i) == (int) kindIndex)
-		{
-			StatisticalValue value(polarizationCount);
-			value.SetKindIndex(kindIndex);
-			casacore::Array<casacore::Complex> valueArray = valueColumn(i);
-			casacore::Array<casacore::Complex>::iterator iter = valueArray.begin();
-			for(int p=0;p<polarizationCount;++p)
-			{
-				value.SetValue(p, *iter);
-				++iter;
-			}
-			FrequencyPosition position;
-			position.frequency = frequencyColumn(i);
-			entries.push_back(std::pair<FrequencyPosition, StatisticalValue>(position, value));
-		}
-	}
+	const casacore::Vector<double>
+		frequencies = casacore::ROScalarColumn<double>(table, ColumnNameFrequency).getColumnRange(rowRange(startRow, rowCount));
+	queryStatistic(table, startRow, rowCount, kindIndex, entries, [&](size_t i) {
+		FrequencyPosition position;
+		position.frequency = frequencies[i];
+		return position;
+	});
 }
 
-void QualityTablesFormatter::QueryBaselineStatistic(unsigned kindIndex, std::vector<std::pair<BaselinePosition, StatisticalValue> > &entries)
+void QualityTablesFormatter::queryBaselineStatistic(int kindIndex, size_t startRow, size_t rowCount, std::vector<std::pair<BaselinePosition, StatisticalValue> > &entries)
 {
 	casacore::Table &table(getTable(BaselineStatisticTable, false));
-	const unsigned nrRow = table.nrow();
-	
-	casacore::ROScalarColumn<int> antenna1Column(table, ColumnNameAntenna1);
-	casacore::ROScalarColumn<int> antenna2Column(table, ColumnNameAntenna2);
-	casacore::ROScalarColumn<double> frequencyColumn(table, ColumnNameFrequency);
-	casacore::ROScalarColumn<int> kindColumn(table, ColumnNameKind);
-	casacore::ROArrayColumn<casacore::Complex> valueColumn(table, ColumnNameValue);
-	
-	int polarizationCount = valueColumn.columnDesc().shape()[0];
-	
-	for(unsigned i=0;i<nrRow;++i)
-	{
-		if(kindColumn(i) == (int) kindIndex)
-		{
-			StatisticalValue value(polarizationCount);
-			value.SetKindIndex(kindIndex);
-			casacore::Array<casacore::Complex> valueArray = valueColumn(i);
-			casacore::Array<casacore::Complex>::iterator iter = valueArray.begin();
-			for(int p=0;p<polarizationCount;++p)
-			{
-				value.SetValue(p, *iter);
-				++iter;
-			}
-			BaselinePosition position;
-			position.antenna1 = antenna1Column(i);
-			position.antenna2 = antenna2Column(i);
-			position.frequency = frequencyColumn(i);
-			entries.push_back(std::pair<BaselinePosition, StatisticalValue>(position, value));
-		}
-	}
+	const casacore::Slicer rows = rowRange(startRow, rowCount);
+	const casacore::Vector<int>
+		antenna1s = casacore::ROScalarColumn<int>(table, ColumnNameAntenna1).getColumnRange(rows),
+		antenna2s = casacore::ROScalarColumn<int>(table, ColumnNameAntenna2).getColumnRange(rows);
+	const casacore::Vector<double>
+		frequencies = casacore::ROScalarColumn<double>(table, ColumnNameFrequency).getColumnRange(rows);
+	queryStatistic(table, startRow, rowCount, kindIndex, entries, [&](size_t i) {
+		BaselinePosition position;
+		position.antenna1 = antenna1s[i];
+		position.antenna2 = antenna2s[i];
+		position.frequency = frequencies[i];
+		return position;
+	});
+}
+
+void QualityTablesFormatter::QueryTimeStatistic(unsigned kindIndex, std::vector<std::pair<TimePosition, StatisticalValue> > &entries)
+{
+	const size_t nrRow = QueryStatisticRowCount(TimeDimension);
+	for(size_t row=0; row<nrRow; row+=BulkRowCount)
+		queryTimeStatistic(kindIndex, row, std::min(BulkRowCount, nrRow-row), entries);
+}
+
+void QualityTablesFormatter::QueryFrequencyStatistic(unsigned kindIndex, std::vector<std::pair<FrequencyPosition, StatisticalValue> > &entries)
+{
+	const size_t nrRow = QueryStatisticRowCount(FrequencyDimension);
+	for(size_t row=0; row<nrRow; row+=BulkRowCount)
+		queryFrequencyStatistic(kindIndex, row, std::min(BulkRowCount, nrRow-row), entries);
+}
+
+void QualityTablesFormatter::QueryBaselineStatistic(unsigned kindIndex, std::vector<std::pair<BaselinePosition, StatisticalValue> > &entries)
+{
+	const size_t nrRow = QueryStatisticRowCount(BaselineDimension);
+	for(size_t row=0; row<nrRow; row+=BulkRowCount)
+		queryBaselineStatistic(kindIndex, row, std::min(BulkRowCount, nrRow-row), entries);
+}
+
+void QualityTablesFormatter::QueryTimeStatisticRows(size_t startRow, size_t rowCount, std::vector<std::pair<TimePosition, StatisticalValue> > &entries)
+{
+	if(rowCount != 0)
+		queryTimeStatistic(-1, startRow, rowCount, entries);
+}
+
+void QualityTablesFormatter::QueryFrequencyStatisticRows(size_t startRow, size_t rowCount, std::vector<std::pair<FrequencyPosition, StatisticalValue> > &entries)
+{
+	if(rowCount != 0)
+		queryFrequencyStatistic(-1, startRow, rowCount, entries);
+}
+
+void QualityTablesFormatter::QueryBaselineStatisticRows(size_t startRow, size_t rowCount, std::vector<std::pair<BaselinePosition, StatisticalValue> > &entries)
+{
+	if(rowCount != 0)
+		queryBaselineStatistic(-1, startRow, rowCount, entries);
 }
 
 void QualityTablesFormatter::openMainTable(bool needWrite)
@@ -215,6 +215,17 @@ class QualityTablesFormatter {
 		void StoreBaselineValue(unsigned antenna1, unsigned antenna2, double frequency, const class StatisticalValue &value);
 		void StoreBaselineTimeValue(unsigned antenna1, unsigned antenna2, double time, double frequency, const class StatisticalValue &value);
 		
+		/**
+		 * Append many values to a statistic table at once. The rows are added with
+		 * a single call and each column is written as a whole, which is much faster
+		 * than storing the values one by one, and avoids fragmenting the table files.
+		 * All values should have the polarization count of the table.
+		 */
+		void StoreTimeValues(const std::vector<std::pair<TimePosition, class StatisticalValue> > &entries);
+		void StoreFrequencyValues(const std::vector<std::pair<FrequencyPosition, class StatisticalValue> > &entries);
+		void StoreBaselineValues(const std::vector<std::pair<BaselinePosition, class StatisticalValue> > &entries);
+		void StoreBaselineTimeValues(const std::vector<std::pair<BaselineTimePosition, class StatisticalValue> > &entries);
+		
 		unsigned QueryKindIndex(enum StatisticKind kind);
 		bool QueryKindIndex(enum StatisticKind kind, unsigned &destKindIndex);
 		unsigned StoreOrQueryKindIndex(enum StatisticKind kind)
@@ -228,11 +239,32 @@ class QualityTablesFormatter {
 		
 		unsigned QueryStatisticEntryCount(enum StatisticDimension dimension, unsigned kindIndex);
 		
+		/**
+		 * Number of rows in the table of the given dimension, all kinds together.
+		 */
+		size_t QueryStatisticRowCount(enum StatisticDimension dimension);
+		
 		void QueryTimeStatistic(unsigned kindIndex, std::vector<std::pair<TimePosition, class StatisticalValue> > &entries);
 		void QueryFrequencyStatistic(unsigned kindIndex, std::vector<std::pair<FrequencyPosition, class StatisticalValue> > &entries);
 		void QueryBaselineStatistic(unsigned kindIndex, std::vector<std::pair<BaselinePosition, class StatisticalValue> > &entries);
 		void QueryBaselineTimeStatistic(unsigned kindIndex, std::vector<std::pair<BaselineTimePosition, class StatisticalValue> > &entries);
 		
+		/**
+		 * Read the statistics of all kinds in rows [startRow, startRow+rowCount) of a table, and
+		 * append them to @p entries. The kind of an entry is given by its KindIndex(). The
+		 * columns are read in one go, so loading a table in ranges of BulkRowCount rows is
+		 * much faster than querying the kinds separately.
+		 */
+		void QueryTimeStatisticRows(size_t startRow, size_t rowCount, std::vector<std::pair<TimePosition, class StatisticalValue> > &entries);
+		void QueryFrequencyStatisticRows(size_t startRow, size_t rowCount, std::vector<std::pair<FrequencyPosition, class StatisticalValue> > &entries);
+		void QueryBaselineStatisticRows(size_t startRow, size_t rowCount, std::vector<std::pair<BaselinePosition, class StatisticalValue> > &entries);
+		
+		/**
+		 * Number of rows that are read at once by the per-kind queries. Callers of the
+		 * bulk methods use it as batch size, to limit the size of their buffers.
+		 */
+		static const size_t BulkRowCount = 65536;
+		
 		unsigned GetPolarizationCount();
 	private:
 		QualityTablesFormatter(const QualityTablesFormatter &) = delete; // don't allow copies
@@ -264,6 +296,24 @@ class QualityTablesFormatter {
 		void removeKindNameEntry(enum StatisticKind kind);
 		void removeEntries(enum QualityTable table);
 		
+		/**
+		 * Reads the kind and value columns of a range of rows, and appends the rows of the given
+		 * kind to @p entries. A negative @p kindIndex selects all kinds. The position of
+		 * a row is constructed by calling @p getPosition with the index of the row in the range.
+		 */
+		template<typename Position, typename PositionFunction>
+		void queryStatistic(casacore::Table &table, size_t startRow, size_t rowCount, int kindIndex, std::vector<std::pair<Position, class StatisticalValue> > &entries, PositionFunction getPosition);
+		
+		/**
+		 * Writes the kind and value columns of the rows starting at @p startRow.
+		 */
+		template<typename Position>
+		void storeKindsAndValues(casacore::Table &table, size_t startRow, const std::vector<std::pair<Position, class StatisticalValue> > &entries);
+		
+		void queryTimeStatistic(int kindIndex, size_t startRow, size_t rowCount, std::vector<std::pair<TimePosition, class StatisticalValue> > &entries);
+		void queryFrequencyStatistic(int kindIndex, size_t startRow, size_t rowCount, std::vector<std::pair<FrequencyPosition, class StatisticalValue> > &entries);
+		void queryBaselineStatistic(int kindIndex, size_t startRow, size_t rowCount, std::vector<std::pair<BaselinePosition, class StatisticalValue> > &entries);
+		
 		/**
 			* Add the time column to the table descriptor. Used by create..Table() methods.
 			* It holds "Measure"s of time, which is what casacore defines as a value including
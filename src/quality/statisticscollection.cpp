@@ -1,44 +1,94 @@
 #include "statisticscollection.h"
 
-template<bool IsDiff>
-void StatisticsCollection::addTimeAndBaseline(unsigned antenna1, unsigned antenna2, double time, double centralFrequency, int polarization, const float *reals, const float *imags, const bool *isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags)
-{
-	unsigned long rfiCount = 0;
-	unsigned long count = 0;
-	long double sum_R = 0.0, sum_I = 0.0;
-	long double sumP2_R = 0.0, sumP2_I = 0.0;
-	for(unsigned j=0;j<nsamples;++j)
+#include <cmath>
+#include <limits>
+
+namespace {
+	const unsigned SumLanes = 4;
+	
+	/**
+	 * Sums of the samples of a single row.
+	 */
+	struct RowSums
 	{
-		if (!*origFlags) {
-			if(std::isfinite(*reals) && std::isfinite(*imags))
+		unsigned long count, rfiCount;
+		double sumR, sumI, sumP2R, sumP2I;
+	};
+	
+	/**
+	 * Sums the unflagged, finite samples of a row. The loop has no branches and
+	 * sums into independent lanes, so that it can be vectorized. The sums of a
+	 * row are accumulated in double, which is accurate enough for the float
+	 * samples of a single row; the total over rows is kept in long double.
+	 */
+	RowSums sumRow(const float *reals, const float *imags, const bool *isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags)
+	{
+		// Comparing the absolute value with the maximum is false for NaN and infinity
+		const float maxValue = std::numeric_limits<float>::max();
+		unsigned long count[SumLanes] = { 0 }, rfiCount[SumLanes] = { 0 };
+		double
+			sumR[SumLanes] = { 0.0 }, sumI[SumLanes] = { 0.0 },
+			sumP2R[SumLanes] = { 0.0 }, sumP2I[SumLanes] = { 0.0 };
+		unsigned j = 0;
+		for(; j + SumLanes <= nsamples; j += SumLanes)
+		{
+			for(unsigned l=0; l!=SumLanes; ++l)
 			{
-				if(*isRFI)
-				{
-					++rfiCount;
-				} else {
-					const long double rVal = *reals;
-					const long double iVal = *imags;
-					++count;
-					sum_R += rVal;
-					sum_I += iVal;
-					sumP2_R += rVal*rVal;
-					sumP2_I += iVal*iVal;
-				}
+				const float r = reals[(j+l)*step], i = imags[(j+l)*step];
+				const bool
+					isValid = !origFlags[(j+l)*stepFlags] && std::fabs(r) <= maxValue && std::fabs(i) <= maxValue,
+					rfi = isRFI[(j+l)*stepRFI],
+					isUsed = isValid && !rfi;
+				const double rVal = isUsed ? r : 0.0, iVal = isUsed ? i : 0.0;
+				count[l] += isUsed;
+				rfiCount[l] += isValid && rfi;
+				sumR[l] += rVal;
+				sumI[l] += iVal;
+				sumP2R[l] += rVal*rVal;
+				sumP2I[l] += iVal*iVal;
 			}
 		}
-		reals += step;
-		imags += step;
-		isRFI += stepRFI;
-		origFlags += stepFlags;
+		for(; j!=nsamples; ++j)
+		{
+			const float r = reals[j*step], i = imags[j*step];
+			const bool
+				isValid = !origFlags[j*stepFlags] && std::fabs(r) <= maxValue && std::fabs(i) <= maxValue,
+				rfi = isRFI[j*stepRFI],
+				isUsed = isValid && !rfi;
+			const double rVal = isUsed ? r : 0.0, iVal = isUsed ? i : 0.0;
+			count[0] += isUsed;
+			rfiCount[0] += isValid && rfi;
+			sumR[0] += rVal;
+			sumI[0] += iVal;
+			sumP2R[0] += rVal*rVal;
+			sumP2I[0] += iVal*iVal;
+		}
+		RowSums sums = { 0, 0, 0.0, 0.0, 0.0, 0.0 };
+		for(unsigned l=0; l!=SumLanes; ++l)
+		{
+			sums.count += count[l];
+			sums.rfiCount += rfiCount[l];
+			sums.sumR += sumR[l];
+			sums.sumI += sumI[l];
+			sums.sumP2R += sumP2R[l];
+			sums.sumP2I += sumP2I[l];
+		}
+		return sums;
 	}
+}
+
+template<bool IsDiff>
+void StatisticsCollection::addTimeAndBaseline(unsigned antenna1, unsigned antenna2, double time, BandIndex &bandIndex, int polarization, const float *reals, const float *imags, const bool *isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags)
+{
+	const RowSums sums = sumRow(reals, imags, isRFI, origFlags, nsamples, step, stepRFI, stepFlags);
 	
 	if(antenna1 != antenna2)
 	{
-		DefaultStatistics &timeStat = getTimeStatistic(time, centralFrequency);
-		addToStatistic<IsDiff>(timeStat, polarization, count, sum_R, sum_I, sumP2_R, sumP2_I, rfiCount);
+		DefaultStatistics &timeStat = getTimeStatistic(bandIndex, time);
+		addToStatistic<IsDiff>(timeStat, polarization, sums.count, sums.sumR, sums.sumI, sums.sumP2R, sums.sumP2I, sums.rfiCount);
 	}
-	DefaultStatistics &baselineStat = getBaselineStatistic(antenna1, antenna2, centralFrequency);
-	addToStatistic<IsDiff>(baselineStat, polarization, count, sum_R, sum_I, sumP2_R, sumP2_I, rfiCount);
+	DefaultStatistics &baselineStat = getBaselineStatistic(bandIndex, antenna1, antenna2);
+	addToStatistic<IsDiff>(baselineStat, polarization, sums.count, sums.sumR, sums.sumI, sums.sumP2R, sums.sumP2I, sums.rfiCount);
 }
 
 template<bool IsDiff>
@@ -73,18 +123,17 @@ void StatisticsCollection::Add(unsigned antenna1, unsigned antenna2, double time
 {
 	if(nsamples == 0) return;
 	
-	const double centralFrequency = _centralFrequencies.find(band)->second;
+	BandIndex &bandIndex = getBandIndex(band);
 	
-	addTimeAndBaseline<false>(antenna1, antenna2, time, centralFrequency, polarization, reals, imags, isRFI, origFlags, nsamples, step, stepRFI, stepFlags);
+	addTimeAndBaseline<false>(antenna1, antenna2, time, bandIndex, polarization, reals, imags, isRFI, origFlags, nsamples, step, stepRFI, stepFlags);
 	if(antenna1 != antenna2)
 		addFrequency<false>(band, polarization, reals, imags, isRFI, origFlags, nsamples, step, stepRFI, stepFlags, false);
 	
-	// Allocate vector with length nsamples, so there is
+	// Use buffers with length nsamples, so there is
 	// a diff element, even if nsamples=1.
-	std::vector<float> diffReals(nsamples);
-	std::vector<float> diffImags(nsamples);
-	bool *diffRFIFlags  = new bool[nsamples];
-	bool *diffOrigFlags = new bool[nsamples];
+	prepareDiffBuffers(nsamples);
+	float *diffReals = _diffReals.data(), *diffImags = _diffImags.data();
+	bool *diffRFIFlags = _diffRFIFlags.get(), *diffOrigFlags = _diffOrigFlags.get();
 	for (unsigned i=0;i<nsamples-1;++i)
 	{
 		diffReals[i] = (reals[(i+1)*step] - reals[i*step]) * M_SQRT1_2;
@@ -92,14 +141,12 @@ void StatisticsCollection::Add(unsigned antenna1, unsigned antenna2, double time
 		diffRFIFlags[i] = isRFI[i*stepRFI] | isRFI[(i+1)*stepRFI];
 		diffOrigFlags[i] = origFlags[i*stepFlags] | origFlags[(i+1)*stepFlags];
 	}
-	addTimeAndBaseline<true>(antenna1, antenna2, time, centralFrequency, polarization, &(diffReals[0]), &(diffImags[0]), diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1);
+	addTimeAndBaseline<true>(antenna1, antenna2, time, bandIndex, polarization, diffReals, diffImags, diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1);
 	if(antenna1 != antenna2)
 	{
-		addFrequency<true>(band, polarization, &(diffReals[0]), &(diffImags[0]), diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, false);
-		addFrequency<true>(band, polarization, &(diffReals[0]), &(diffImags[0]), diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, true);
+		addFrequency<true>(band, polarization, diffReals, diffImags, diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, false);
+		addFrequency<true>(band, polarization, diffReals, diffImags, diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, true);
 	}
-	delete[] diffRFIFlags;
-	delete[] diffOrigFlags;
 }
 
 void StatisticsCollection::AddToTimeFrequency(unsigned antenna1, unsigned antenna2, double time, unsigned band, int polarization, const float* reals, const float* imags, const bool* isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags)
@@ -110,12 +157,11 @@ void StatisticsCollection::AddToTimeFrequency(unsigned antenna1, unsigned antenn
 	
 	addToTimeFrequency<false>(time, &_bandFrequencies[band][0], polarization, reals, imags, isRFI, origFlags, nsamples, step, stepRFI, stepFlags, false);
 	
-	// Allocate vector with length nsamples, so there is
+	// Use buffers with length nsamples, so there is
 	// a diff element, even if nsamples=1.
-	std::vector<float> diffReals(nsamples);
-	std::vector<float> diffImags(nsamples);
-	bool *diffRFIFlags  = new bool[nsamples];
-	bool *diffOrigFlags = new bool[nsamples];
+	prepareDiffBuffers(nsamples);
+	float *diffReals = _diffReals.data(), *diffImags = _diffImags.data();
+	bool *diffRFIFlags = _diffRFIFlags.get(), *diffOrigFlags = _diffOrigFlags.get();
 	for (unsigned i=0;i<nsamples-1;++i)
 	{
 		diffReals[i] = (reals[(i+1)*step] - reals[i*step]) * M_SQRT1_2;
@@ -123,23 +169,21 @@ void StatisticsCollection::AddToTimeFrequency(unsigned antenna1, unsigned antenn
 		diffRFIFlags[i] = isRFI[i*stepRFI] | isRFI[(i+1)*stepRFI];
 		diffOrigFlags[i] = origFlags[i*stepFlags] | origFlags[(i+1)*stepFlags];
 	}
-	addToTimeFrequency<true>(time, &_bandFrequencies[band][0], polarization, &(diffReals[0]), &(diffImags[0]), diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, false);
-	addToTimeFrequency<true>(time, &_bandFrequencies[band][0], polarization, &(diffReals[0]), &(diffImags[0]), diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, true);
-	delete[] diffRFIFlags;
-	delete[] diffOrigFlags;
+	addToTimeFrequency<true>(time, &_bandFrequencies[band][0], polarization, diffReals, diffImags, diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, false);
+	addToTimeFrequency<true>(time, &_bandFrequencies[band][0], polarization, diffReals, diffImags, diffRFIFlags, diffOrigFlags, nsamples-1, 1, 1, 1, true);
 }
 
 void StatisticsCollection::AddImage(unsigned antenna1, unsigned antenna2, const double *times, unsigned band, int polarization, const Image2DCPtr &realImage, const Image2DCPtr &imagImage, const Mask2DCPtr &rfiMask, const Mask2DCPtr &correlatorMask)
 {
 	if(realImage->Width() == 0 || realImage->Height() == 0) return;
 
-	const double centralFrequency = _centralFrequencies.find(band)->second;
-	DefaultStatistics &baselineStat = getBaselineStatistic(antenna1, antenna2, centralFrequency);
+	BandIndex &bandIndex = getBandIndex(band);
+	DefaultStatistics &baselineStat = getBaselineStatistic(bandIndex, antenna1, antenna2);
 	std::vector<DefaultStatistics *> &bandStats = _bands.find(band)->second;
 	std::vector<DefaultStatistics *> timeStats(realImage->Width());
 	
 	for(size_t t=0; t!=realImage->Width(); ++t)
-		timeStats[t] = &getTimeStatistic(times[t], centralFrequency);
+		timeStats[t] = &getTimeStatistic(bandIndex, times[t]);
 	
 	for(size_t f=0; f<realImage->Height(); ++f)
 	{
@@ -318,6 +362,7 @@ void StatisticsCollection::saveTime(QualityTablesFormatter &qd) const
 			saveEachStatistic(saver, stat, indices);
 		}
 	}
+	saver.Flush();
 }
 
 void StatisticsCollection::saveFrequency(QualityTablesFormatter &qd) const
@@ -340,6 +385,7 @@ void StatisticsCollection::saveFrequency(QualityTablesFormatter &qd) const
 			
 			saveEachStatistic(saver, stat, indices);
 		}
+		saver.Flush();
 	}
 }
 
@@ -374,6 +420,7 @@ void StatisticsCollection::saveBaseline(QualityTablesFormatter &qd) const
 				saveEachStatistic(saver, stat, indices);
 			}
 		}
+		saver.Flush();
 	}
 }
 
@@ -13,6 +13,11 @@
 #include "qualitytablesformatter.h"
 #include "statisticalvalue.h"
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
 #include <boost/concept_check.hpp>
 
 class StatisticsCollection : public Serializable
@@ -20,11 +25,11 @@ class StatisticsCollection : public Serializable
 	private:
 		typedef std::map<double, DefaultStatistics> DoubleStatMap;
 	public:
-		StatisticsCollection() : _polarizationCount(0), _emptyBaselineStatisticsMap(0)
+		StatisticsCollection() : _polarizationCount(0), _emptyBaselineStatisticsMap(0), _diffFlagsSize(0)
 		{
 		}
 		
-		explicit StatisticsCollection(unsigned polarizationCount) : _polarizationCount(polarizationCount), _emptyBaselineStatisticsMap(polarizationCount)
+		explicit StatisticsCollection(unsigned polarizationCount) : _polarizationCount(polarizationCount), _emptyBaselineStatisticsMap(polarizationCount), _diffFlagsSize(0)
 		{
 		}
 		
@@ -33,7 +38,8 @@ class StatisticsCollection : public Serializable
 			_frequencyStatistics(source._frequencyStatistics),
 			_baselineStatistics(source._baselineStatistics),
 			_polarizationCount(source._polarizationCount),
-			_emptyBaselineStatisticsMap(source._polarizationCount)
+			_emptyBaselineStatisticsMap(source._polarizationCount),
+			_diffFlagsSize(0)
 		{
 		}
 		
@@ -44,6 +50,7 @@ class StatisticsCollection : public Serializable
 			_baselineStatistics = source._baselineStatistics;
 			_polarizationCount = source._polarizationCount;
 			_emptyBaselineStatisticsMap = source._emptyBaselineStatisticsMap;
+			_bandIndices.clear();
 			return *this;
 		}
 
@@ -52,6 +59,7 @@ class StatisticsCollection : public Serializable
 			_timeStatistics.clear();
 			_frequencyStatistics.clear();
 			_baselineStatistics.clear();
+			_bandIndices.clear();
 		}
 		
 		void InitializeBand(unsigned band, const double *frequencies, unsigned channelCount)
@@ -205,6 +213,7 @@ class StatisticsCollection : public Serializable
 				_timeStatistics.clear();
 				_frequencyStatistics.clear();
 				_baselineStatistics.clear();
+				_bandIndices.clear();
 			}
 		}
 		
@@ -220,6 +229,7 @@ class StatisticsCollection : public Serializable
 		{
 			_polarizationCount = UnserializeUInt64(stream);
 			_emptyBaselineStatisticsMap = BaselineStatisticsMap(_polarizationCount);
+			_bandIndices.clear();
 			unserializeTime(stream);
 			unserializeFrequency(stream);
 			unserializeBaselines(stream);
@@ -240,6 +250,7 @@ class StatisticsCollection : public Serializable
 				}
 				
 				_baselineStatistics.clear();
+				_bandIndices.clear();
 				_baselineStatistics.insert(std::pair<double, BaselineStatisticsMap>(frequencySum/size, fullMap));
 			}
 		}
@@ -259,12 +270,14 @@ class StatisticsCollection : public Serializable
 				}
 				
 				_timeStatistics.clear();
+				_bandIndices.clear();
 				_timeStatistics.insert(std::pair<double, DoubleStatMap>(frequencySum/size, fullMap));
 			}
 		}
 		
 		void LowerTimeResolution(size_t maxSteps)
 		{
+			_bandIndices.clear();
 			for(std::map<double, DoubleStatMap>::iterator i=_timeStatistics.begin();i!=_timeStatistics.end();++i)
 			{
 				lowerResolution(i->second, maxSteps);
@@ -286,6 +299,7 @@ class StatisticsCollection : public Serializable
 		{
 			if(_timeStatistics.size() > 1)
 			{
+				_bandIndices.clear();
 				std::map<double, DoubleStatMap>::iterator i = _timeStatistics.begin();
 				const DoubleStatMap &referenceMap = i->second;
 				++i;
@@ -296,6 +310,10 @@ class StatisticsCollection : public Serializable
 			}
 		}
 	private:
+		/**
+		 * Collects the values of one dimension, and stores them in bulk once
+		 * BulkRowCount values have been collected or when Flush() is called.
+		 */
 		struct StatisticSaver
 		{
 			QualityTablesFormatter::StatisticDimension dimension;
@@ -304,25 +322,62 @@ class StatisticsCollection : public Serializable
 			unsigned antenna1;
 			unsigned antenna2;
 			QualityTablesFormatter *qualityData;
+			std::vector<std::pair<QualityTablesFormatter::TimePosition, StatisticalValue> > timeEntries;
+			std::vector<std::pair<QualityTablesFormatter::FrequencyPosition, StatisticalValue> > frequencyEntries;
+			std::vector<std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> > baselineEntries;
+			std::vector<std::pair<QualityTablesFormatter::BaselineTimePosition, StatisticalValue> > baselineTimeEntries;
 			
 			void Save(StatisticalValue &value, unsigned kindIndex)
 			{
 				value.SetKindIndex(kindIndex);
+				size_t entryCount = 0;
 				switch(dimension)
 				{
-					case QualityTablesFormatter::TimeDimension:
-						qualityData->StoreTimeValue(time, frequency, value);
-						break;
-					case QualityTablesFormatter::FrequencyDimension:
-						qualityData->StoreFrequencyValue(frequency, value);
-						break;
-					case QualityTablesFormatter::BaselineDimension:
-						qualityData->StoreBaselineValue(antenna1, antenna2, frequency, value);
-						break;
-					case QualityTablesFormatter::BaselineTimeDimension:
-						qualityData->StoreBaselineTimeValue(antenna1, antenna2, time, frequency, value);
-						break;
+					case QualityTablesFormatter::TimeDimension: {
+						QualityTablesFormatter::TimePosition position;
+						position.time = time;
+						position.frequency = frequency;
+						timeEntries.push_back(std::make_pair(position, value));
+						entryCount = timeEntries.size();
+					} break;
+					case QualityTablesFormatter::FrequencyDimension: {
+						QualityTablesFormatter::FrequencyPosition position;
+						position.frequency = frequency;
+						frequencyEntries.push_back(std::make_pair(position, value));
+						entryCount = frequencyEntries.size();
+					} break;
+					case QualityTablesFormatter::BaselineDimension: {
+						QualityTablesFormatter::BaselinePosition position;
+						position.antenna1 = antenna1;
+						position.antenna2 = antenna2;
+						position.frequency = frequency;
+						baselineEntries.push_back(std::make_pair(position, value));
+						entryCount = baselineEntries.size();
+					} break;
+					case QualityTablesFormatter::BaselineTimeDimension: {
+						QualityTablesFormatter::BaselineTimePosition position;
+						position.time = time;
+						position.antenna1 = antenna1;
+						position.antenna2 = antenna2;
+						position.frequency = frequency;
+						baselineTimeEntries.push_back(std::make_pair(position, value));
+						entryCount = baselineTimeEntries.size();
+					} break;
 				}
+				if(entryCount == QualityTablesFormatter::BulkRowCount)
+					Flush();
+			}
+			
+			void Flush()
+			{
+				qualityData->StoreTimeValues(timeEntries);
+				qualityData->StoreFrequencyValues(frequencyEntries);
+				qualityData->StoreBaselineValues(baselineEntries);
+				qualityData->StoreBaselineTimeValues(baselineTimeEntries);
+				timeEntries.clear();
+				frequencyEntries.clear();
+				baselineEntries.clear();
+				baselineTimeEntries.clear();
 			}
 		};
 		
@@ -348,8 +403,70 @@ class StatisticsCollection : public Serializable
 			}
 		};
 		
+		/**
+		 * Direct pointers to the statistics of a band, so that adding a row does
+		 * not need to search the maps. This is possible because map elements
+		 * are not moved by insertions. The index is cleared whenever elements
+		 * of the maps are removed, and is then rebuilt on the next use.
+		 */
+		struct BandIndex
+		{
+			BandIndex() : timeStatistics(nullptr), baselineStatistics(nullptr), lastTime(0.0), lastTimeStatistic(nullptr)
+			{ }
+			
+			DoubleStatMap *timeStatistics;
+			BaselineStatisticsMap *baselineStatistics;
+			// Rows are mostly added in time order, so the last used timestep is remembered
+			double lastTime;
+			DefaultStatistics *lastTimeStatistic;
+			// Indexed by antenna1, antenna2
+			std::vector<std::vector<DefaultStatistics*>> baselines;
+		};
+		
+		BandIndex &getBandIndex(unsigned band)
+		{
+			if(band >= _bandIndices.size())
+				_bandIndices.resize(band + 1);
+			BandIndex &index = _bandIndices[band];
+			if(index.timeStatistics == nullptr)
+			{
+				const double centralFrequency = _centralFrequencies.find(band)->second;
+				std::map<double, DoubleStatMap>::iterator t = _timeStatistics.find(centralFrequency);
+				if(t == _timeStatistics.end())
+					t = _timeStatistics.insert(std::pair<double, DoubleStatMap>(centralFrequency, DoubleStatMap())).first;
+				index.timeStatistics = &t->second;
+				std::map<double, BaselineStatisticsMap>::iterator b = _baselineStatistics.find(centralFrequency);
+				if(b == _baselineStatistics.end())
+					b = _baselineStatistics.insert(std::pair<double, BaselineStatisticsMap>(centralFrequency, BaselineStatisticsMap(_polarizationCount))).first;
+				index.baselineStatistics = &b->second;
+			}
+			return index;
+		}
+		
+		DefaultStatistics &getTimeStatistic(BandIndex &index, double time)
+		{
+			if(index.lastTimeStatistic == nullptr || index.lastTime != time)
+			{
+				index.lastTime = time;
+				index.lastTimeStatistic = &getDoubleStatMapStatistic(*index.timeStatistics, time);
+			}
+			return *index.lastTimeStatistic;
+		}
+		
+		DefaultStatistics &getBaselineStatistic(BandIndex &index, unsigned antenna1, unsigned antenna2)
+		{
+			if(antenna1 >= index.baselines.size())
+				index.baselines.resize(antenna1 + 1);
+			std::vector<DefaultStatistics*> &row = index.baselines[antenna1];
+			if(antenna2 >= row.size())
+				row.resize(antenna2 + 1, nullptr);
+			if(row[antenna2] == nullptr)
+				row[antenna2] = &index.baselineStatistics->GetStatistics(antenna1, antenna2);
+			return *row[antenna2];
+		}
+		
 		template<bool IsDiff>
-		void addTimeAndBaseline(unsigned antenna1, unsigned antenna2, double time, double centralFrequency, int polarization, const float *reals, const float *imags, const bool *isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags);
+		void addTimeAndBaseline(unsigned antenna1, unsigned antenna2, double time, BandIndex &bandIndex, int polarization, const float *reals, const float *imags, const bool *isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags);
 		
 		template<bool IsDiff>
 		void addToTimeFrequency(double time, const double* frequencies, int polarization, const float *reals, const float *imags, const bool *isRFI, const bool* origFlags, unsigned nsamples, unsigned step, unsigned stepRFI, unsigned stepFlags, bool shiftOneUp);
@@ -523,81 +640,74 @@ class StatisticsCollection : public Serializable
 			}
 		}
 		
-		void forEachDefaultStatistic(QualityTablesFormatter &qd, void (StatisticsCollection::*functionName)(QualityTablesFormatter &, QualityTablesFormatter::StatisticKind))
-		{
-			(this->*functionName)(qd, QualityTablesFormatter::CountStatistic);
-			(this->*functionName)(qd, QualityTablesFormatter::SumStatistic);
-			(this->*functionName)(qd, QualityTablesFormatter::SumP2Statistic);
-			(this->*functionName)(qd, QualityTablesFormatter::DCountStatistic);
-			(this->*functionName)(qd, QualityTablesFormatter::DSumStatistic);
-			(this->*functionName)(qd, QualityTablesFormatter::DSumP2Statistic);
-			(this->*functionName)(qd, QualityTablesFormatter::RFICountStatistic);
+		/**
+		 * Maps the kind indices of the default statistics in the quality tables to their kind.
+		 */
+		static std::map<unsigned, QualityTablesFormatter::StatisticKind> defaultKinds(QualityTablesFormatter &qd)
+		{
+			const QualityTablesFormatter::StatisticKind kinds[] = {
+				QualityTablesFormatter::CountStatistic,
+				QualityTablesFormatter::SumStatistic,
+				QualityTablesFormatter::SumP2Statistic,
+				QualityTablesFormatter::DCountStatistic,
+				QualityTablesFormatter::DSumStatistic,
+				QualityTablesFormatter::DSumP2Statistic,
+				QualityTablesFormatter::RFICountStatistic
+			};
+			std::map<unsigned, QualityTablesFormatter::StatisticKind> kindMap;
+			for(QualityTablesFormatter::StatisticKind kind : kinds)
+				kindMap.insert(std::make_pair(qd.QueryKindIndex(kind), kind));
+			return kindMap;
 		}
 		
-		template<bool AddStatistics>
-		void loadSingleTimeStatistic(QualityTablesFormatter &qd, QualityTablesFormatter::StatisticKind kind)
+		/**
+		 * Reads a statistic table in ranges of rows, and assigns the values of the default
+		 * kinds to the statistic returned by @p getStatistic for the position of the value.
+		 */
+		template<bool AddStatistics, typename Position, typename QueryFunction, typename StatisticFunction>
+		void loadStatistics(QualityTablesFormatter &qd, QualityTablesFormatter::StatisticDimension dimension, QueryFunction queryRows, StatisticFunction getStatistic)
 		{
-			std::vector<std::pair<QualityTablesFormatter::TimePosition, StatisticalValue> > values;
-			unsigned kindIndex = qd.QueryKindIndex(kind);
-			qd.QueryTimeStatistic(kindIndex, values);
-			for(std::vector<std::pair<QualityTablesFormatter::TimePosition, StatisticalValue> >::const_iterator i=values.begin();i!=values.end();++i)
+			const std::map<unsigned, QualityTablesFormatter::StatisticKind> kinds = defaultKinds(qd);
+			const size_t rowCount = qd.QueryStatisticRowCount(dimension);
+			std::vector<std::pair<Position, StatisticalValue> > values;
+			for(size_t row=0; row<rowCount; row+=QualityTablesFormatter::BulkRowCount)
 			{
-				const QualityTablesFormatter::TimePosition &position = i->first;
-				const StatisticalValue &statValue = i->second;
-				
-				DefaultStatistics &stat = getTimeStatistic(position.time, position.frequency);
-				assignStatistic<AddStatistics>(stat, statValue, kind);
+				values.clear();
+				(qd.*queryRows)(row, std::min(QualityTablesFormatter::BulkRowCount, rowCount-row), values);
+				for(typename std::vector<std::pair<Position, StatisticalValue> >::const_iterator i=values.begin();i!=values.end();++i)
+				{
+					std::map<unsigned, QualityTablesFormatter::StatisticKind>::const_iterator kind = kinds.find(i->second.KindIndex());
+					if(kind != kinds.end())
+						assignStatistic<AddStatistics>(getStatistic(i->first), i->second, kind->second);
+				}
 			}
 		}
 		
 		template<bool AddStatistics>
 		void loadTime(QualityTablesFormatter &qd)
 		{
-			forEachDefaultStatistic(qd, &StatisticsCollection::loadSingleTimeStatistic<AddStatistics>);
-		}
-		
-		template<bool AddStatistics>
-		void loadSingleFrequencyStatistic(QualityTablesFormatter &qd, QualityTablesFormatter::StatisticKind kind)
-		{
-			std::vector<std::pair<QualityTablesFormatter::FrequencyPosition, StatisticalValue> > values;
-			unsigned kindIndex = qd.QueryKindIndex(kind);
-			qd.QueryFrequencyStatistic(kindIndex, values);
-			for(std::vector<std::pair<QualityTablesFormatter::FrequencyPosition, StatisticalValue> >::const_iterator i=values.begin();i!=values.end();++i)
-			{
-				const QualityTablesFormatter::FrequencyPosition &position = i->first;
-				const StatisticalValue &statValue = i->second;
-				
-				DefaultStatistics &stat = getFrequencyStatistic(position.frequency);
-				assignStatistic<AddStatistics>(stat, statValue, kind);
-			}
+			loadStatistics<AddStatistics, QualityTablesFormatter::TimePosition>(qd, QualityTablesFormatter::TimeDimension, &QualityTablesFormatter::QueryTimeStatisticRows,
+				[&](const QualityTablesFormatter::TimePosition &position) -> DefaultStatistics& {
+					return getTimeStatistic(position.time, position.frequency);
+				});
 		}
 		
 		template<bool AddStatistics>
 		void loadFrequency(QualityTablesFormatter &qd)
 		{
-			forEachDefaultStatistic(qd, &StatisticsCollection::loadSingleFrequencyStatistic<AddStatistics>);
-		}
-		
-		template<bool AddStatistics>
-		void loadSingleBaselineStatistic(QualityTablesFormatter &qd, QualityTablesFormatter::StatisticKind kind)
-		{
-			std::vector<std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> > values;
-			unsigned kindIndex = qd.QueryKindIndex(kind);
-			qd.QueryBaselineStatistic(kindIndex, values);
-			for(std::vector<std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> >::const_iterator i=values.begin();i!=values.end();++i)
-			{
-				const QualityTablesFormatter::BaselinePosition &position = i->first;
-				const StatisticalValue &statValue = i->second;
-				
-				DefaultStatistics &stat = getBaselineStatistic(position.antenna1, position.antenna2, position.frequency);
-				assignStatistic<AddStatistics>(stat, statValue, kind);
-			}
+			loadStatistics<AddStatistics, QualityTablesFormatter::FrequencyPosition>(qd, QualityTablesFormatter::FrequencyDimension, &QualityTablesFormatter::QueryFrequencyStatisticRows,
+				[&](const QualityTablesFormatter::FrequencyPosition &position) -> DefaultStatistics& {
+					return getFrequencyStatistic(position.frequency);
+				});
 		}
 		
 		template<bool AddStatistics>
 		void loadBaseline(QualityTablesFormatter &qd)
 		{
-			forEachDefaultStatistic(qd, &StatisticsCollection::loadSingleBaselineStatistic<AddStatistics>);
+			loadStatistics<AddStatistics, QualityTablesFormatter::BaselinePosition>(qd, QualityTablesFormatter::BaselineDimension, &QualityTablesFormatter::QueryBaselineStatisticRows,
+				[&](const QualityTablesFormatter::BaselinePosition &position) -> DefaultStatistics& {
+					return getBaselineStatistic(position.antenna1, position.antenna2, position.frequency);
+				});
 		}
 		
 		double centralFrequency() const
@@ -822,6 +932,21 @@ class StatisticsCollection : public Serializable
 		
 		void lowerResolution(DoubleStatMap &map, size_t maxSteps) const;
 		
+		void prepareDiffBuffers(unsigned nsamples)
+		{
+			if(_diffReals.size() < nsamples)
+			{
+				_diffReals.resize(nsamples);
+				_diffImags.resize(nsamples);
+			}
+			if(_diffFlagsSize < nsamples)
+			{
+				_diffRFIFlags.reset(new bool[nsamples]);
+				_diffOrigFlags.reset(new bool[nsamples]);
+				_diffFlagsSize = nsamples;
+			}
+		}
+		
 		static void regrid(const DoubleStatMap &referenceMap, DoubleStatMap &regridMap)
 		{
 			DoubleStatMap newMap;
@@ -863,11 +988,17 @@ class StatisticsCollection : public Serializable
 		std::map<double, BaselineStatisticsMap> _baselineStatistics;
 		
 		std::map<unsigned, std::vector< DefaultStatistics *> > _bands;
+		std::vector<BandIndex> _bandIndices;
 		std::map<unsigned, double> _centralFrequencies;
 		std::map<unsigned, std::vector<double> > _bandFrequencies;
 		
 		unsigned _polarizationCount;
 		BaselineStatisticsMap _emptyBaselineStatisticsMap;
+		
+		// Buffers for the differences between channels, reused between calls to Add()
+		std::vector<float> _diffReals, _diffImags;
+		std::unique_ptr<bool[]> _diffRFIFlags, _diffOrigFlags;
+		size_t _diffFlagsSize;
 };
 
 #endif
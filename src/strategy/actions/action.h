@@ -31,6 +31,7 @@ namespace rfiStrategy {
 		IterationBlockType,
 		NormalizeVarianceActionType,
 		PlotActionType,
+		PythonActionType,
 		QuickCalibrateActionType,
 		ResamplingActionType,
 		SaveHeatMapActionType,
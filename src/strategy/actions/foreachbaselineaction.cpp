@@ -16,6 +16,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
@@ -38,35 +39,9 @@ namespace rfiStrategy {
 			ImageSet& imageSet = artifacts.ImageSet();
 			MSImageSet* msImageSet = dynamic_cast<MSImageSet*>(&imageSet);
 			if(msImageSet)
-			{
-				// Check memory usage
-				std::unique_ptr<ImageSetIndex> tempIndex = msImageSet->StartIndex();
-				size_t timeStepCount = msImageSet->ObservationTimesVector(*tempIndex).size();
-				tempIndex.reset();
-				size_t channelCount = msImageSet->GetBandInfo(0).channels.size();
-				double estMemorySizePerThread =
-					8.0/*bp complex*/ * 4.0 /*polarizations*/ *
-					double(timeStepCount) * double(channelCount) *
-					3.0 /* approx copies of the data that will be made in memory*/;
-				Logger::Debug << "Estimate of memory each thread will use: " << memToStr(estMemorySizePerThread) << ".\n";
-				size_t compThreadCount = _threadCount;
-				if(compThreadCount > 0) --compThreadCount;
-				
-				int64_t memSize = System::TotalMemory();
-				Logger::Debug << "Detected " << memToStr(memSize) << " of system memory.\n";
-				
-				if(estMemorySizePerThread * double(compThreadCount) > memSize)
-				{
-					size_t maxThreads = size_t(memSize / estMemorySizePerThread);
-					if(maxThreads < 1) maxThreads = 1;
-					Logger::Warn <<
-						"This measurement set is TOO LARGE to be processed with " << _threadCount << " threads!\n" <<
-						_threadCount << " threads would require " << memToStr(estMemorySizePerThread*compThreadCount) << " of memory approximately.\n"
-						"Number of threads that will actually be used: " << maxThreads << "\n"
-						"This might hurt performance a lot!\n\n";
-					_threadCount = maxThreads;
-				}
-			}
+				initializeMemoryBudget(*msImageSet);
+			else
+				_memoryLimit = 0;
 			if(dynamic_cast<FilterBankSet*>(&imageSet) != nullptr && _threadCount != 1)
 			{
 				Logger::Info << "This is a Filterbank set -- disabling multi-threading\n";
@@ -104,7 +79,6 @@ namespace rfiStrategy {
 			_initPartIndex = 0;
 			_finishedBaselines = false;
 			_baselineCount = 0;
-			_baselineProgress = 0;
 			_nextIndex = 0;
 			
 			// Count the baselines that are to be processed
@@ -120,21 +94,43 @@ namespace rfiStrategy {
 			
 			// Initialize thread data and threads
 			_loopIndex = imageSet.StartIndex();
-			_threadInfo.assign(_threadCount, ThreadInfo() );
+			const size_t mathThreads = mathThreadCount();
+			_threadInfo = std::vector<ThreadInfo>(mathThreads);
 			progress.OnStartTask(*this, 0, 1, "Initializing");
 
-			std::vector<std::thread> threadGroup;
-			ReaderFunction reader(*this);
-			threadGroup.emplace_back(reader);
-			
-			size_t mathThreads = mathThreadCount();
-			for(unsigned i=0;i<mathThreads;++i)
+			// The reader thread fills the baseline buffer, while the workers of the
+			// pool take baselines from it. Actions inside a baseline can split their
+			// work into sub-tasks, which are stolen by idle workers.
+			WorkStealingPool pool(mathThreads);
+			std::vector<std::unique_ptr<PerformFunction>> performers;
+			for(size_t i=0;i<mathThreads;++i)
+				performers.emplace_back(new PerformFunction(*this, progress, i));
+			_pool = &pool;
+
+			std::thread readerThread(ReaderFunction(*this));
+			pool.Run([&performers](size_t workerIndex) {
+				return performers[workerIndex]->ProcessNextBaseline();
+			});
+			readerThread.join();
+			_pool = nullptr;
+			pool.ReportStatistics();
+			if(_memoryLimit != 0)
 			{
-				PerformFunction function(*this, progress, i);
-				threadGroup.emplace_back(function);
+				Logger::Debug << "Largest working memory of a baseline: " << memToStr(_workingSizePerBaseline.load()) << ", at most "
+					<< _peakBaselinesInBuffer << " baselines were buffered, workers were held back "
+					<< _throttleCount.load() << " times by the memory limit.\n";
 			}
-			for(std::thread& t : threadGroup)
-				t.join();
+			MemoryAccountant::ReportPeaks();
+
+			for(std::unique_ptr<PerformFunction>& performer : performers)
+			{
+				if(performer->_artifacts)
+				{
+					_resultSet = std::move(performer->_artifacts);
+					break;
+				}
+			}
+			performers.clear();
 			progress.OnEndTask(*this);
 
 			if(_resultSet)
@@ -150,6 +146,80 @@ namespace rfiStrategy {
 		}
 	}
 
+	void ForEachBaselineAction::initializeMemoryBudget(MSImageSet& msImageSet)
+	{
+		std::unique_ptr<ImageSetIndex> tempIndex = msImageSet.StartIndex();
+		size_t timeStepCount = msImageSet.ObservationTimesVector(*tempIndex).size();
+		tempIndex.reset();
+		size_t channelCount = msImageSet.GetBandInfo(0).channels.size();
+		// A baseline as it is read: a real value, an imaginary value and a flag per
+		// sample, for (at most) 4 polarizations.
+		_baselineDataSize = 4 * timeStepCount * channelCount * (2*sizeof(num_t) + sizeof(bool));
+		// Until the working memory of a baseline has been measured, it is
+		// estimated from the approximate number of copies that a strategy makes.
+		double estMemorySizePerThread = 3.0 * double(_baselineDataSize);
+		Logger::Debug << "Estimate of memory each thread will use: " << memToStr(estMemorySizePerThread) << ".\n";
+		size_t compThreadCount = _threadCount;
+		if(compThreadCount > 0) --compThreadCount;
+		
+		_memoryLimit = MemoryAccountant::Limit();
+		Logger::Debug << "Memory limit is " << memToStr(_memoryLimit) << ", of which " << memToStr(MemoryAccountant::Used()) << " is in use.\n";
+		
+		double bufferSize = 0.0;
+		if(msImageSet.Reader() != nullptr)
+			bufferSize = double(msImageSet.Reader()->GetMaxRecommendedBufferSize(mathThreadCount())) * double(_baselineDataSize);
+		double available = double(_memoryLimit) - double(MemoryAccountant::Used()) - bufferSize;
+		
+		if(estMemorySizePerThread * double(compThreadCount) > available)
+		{
+			size_t maxThreads = available > 0.0 ? size_t(available / estMemorySizePerThread) : 1;
+			if(maxThreads < 1) maxThreads = 1;
+			Logger::Warn <<
+				"This measurement set is TOO LARGE to be processed with " << _threadCount << " threads!\n" <<
+				_threadCount << " threads would require " << memToStr(estMemorySizePerThread*compThreadCount) << " of memory approximately.\n"
+				"Number of threads that will actually be used: " << maxThreads << "\n"
+				"This might hurt performance a lot!\n\n";
+			_threadCount = maxThreads;
+		}
+		
+		_activeWorkers = 0;
+		_workingSizePerBaseline = 0;
+		_throttleCount = 0;
+		_peakBaselinesInBuffer = 0;
+	}
+	
+	size_t ForEachBaselineAction::limitToMemoryBudget(size_t wantedCount)
+	{
+		if(_memoryLimit == 0 || wantedCount == 0)
+			return wantedCount;
+		std::unique_lock<std::mutex> lock(_mutex);
+		while(true)
+		{
+			// Leave room for one more worker to start on a baseline
+			const size_t reserved = MemoryAccountant::Used() + _workingSizePerBaseline.load(std::memory_order_relaxed);
+			const size_t fitCount = reserved < _memoryLimit ? (_memoryLimit - reserved) / _baselineDataSize : 0;
+			// When the buffer is empty, a baseline is read regardless of the limit,
+			// as the workers could otherwise not continue.
+			if(fitCount != 0 || _baselineBuffer.empty() || _exceptionOccured)
+				return std::min(wantedCount, std::max<size_t>(fitCount, 1));
+			_dataProcessed.wait(lock);
+		}
+	}
+	
+	void ForEachBaselineAction::onBaselineFinished()
+	{
+		_activeWorkers.fetch_sub(1, std::memory_order_relaxed);
+		if(_memoryLimit != 0)
+		{
+			// Memory was freed: the reader and workers that were held back by the
+			// memory limit can continue.
+			std::unique_lock<std::mutex> lock(_mutex);
+			_dataProcessed.notify_all();
+			lock.unlock();
+			_pool->Notify();
+		}
+	}
+
 	bool ForEachBaselineAction::IsBaselineSelected(ImageSetIndex &index)
 	{
 		ImageSet& imageSet = _artifacts->ImageSet();
@@ -227,6 +297,7 @@ namespace rfiStrategy {
 	{
 		std::lock_guard<std::mutex> lock(_mutex);
 		_exceptionOccured = true;
+		_dataProcessed.notify_all();
 	}
 	
 	void ForEachBaselineAction::SetFinishedBaselines()
@@ -235,51 +306,82 @@ namespace rfiStrategy {
 		_finishedBaselines = true;
 	}
 	
-	void ForEachBaselineAction::PerformFunction::operator()()
+	WorkStealingPool::SourceResult ForEachBaselineAction::PerformFunction::ProcessNextBaseline()
 	{
-		std::unique_lock<std::mutex> ioLock(_action._artifacts->IOMutex());
-		std::unique_ptr<ImageSet> privateImageSet = _action._artifacts->ImageSet().Clone();
-		ioLock.unlock();
+		if(!_action.mayStartBaseline())
+		{
+			_action._throttleCount.fetch_add(1, std::memory_order_relaxed);
+			return WorkStealingPool::NoWorkAvailable;
+		}
+		
+		WorkStealingPool::SourceResult status;
+		std::unique_ptr<BaselineData> baseline = _action.TryGetNextBaseline(status);
+		if(baseline == nullptr)
+		{
+			if(status == WorkStealingPool::SourceFinished && !_hasReportedScratch)
+			{
+				std::ostringstream name;
+				name << "Worker " << _threadIndex;
+				ScratchArena::ForCurrentThread().ReportStatistics(name.str());
+				_hasReportedScratch = true;
+			}
+			return status;
+		}
 
+		_action._activeWorkers.fetch_add(1, std::memory_order_relaxed);
 		try {
-			std::unique_lock<std::mutex> lock(_action._mutex);
-			ArtifactSet newArtifacts(*_action._artifacts);
-			lock.unlock();
+			MemoryAccountant::StartThreadMeasurement();
+			if(_artifacts == nullptr)
+			{
+				std::unique_lock<std::mutex> ioLock(_action._artifacts->IOMutex());
+				_privateImageSet = _action._artifacts->ImageSet().Clone();
+				ioLock.unlock();
+				
+				std::lock_guard<std::mutex> lock(_action._mutex);
+				_artifacts.reset(new ArtifactSet(*_action._artifacts));
+			}
 			
-			std::unique_ptr<BaselineData> baseline = _action.GetNextBaseline();
+			baseline->Index().Reattach(*_privateImageSet);
 			
-			while(baseline != nullptr) {
-				baseline->Index().Reattach(*privateImageSet);
-				
-				std::ostringstream progressStr;
-				if(_action._hasInitAntennae)
-					progressStr << "Processing baseline " << baseline->MetaData()->Antenna1().name << " x " << baseline->MetaData()->Antenna2().name;
-				else
-					progressStr << "Processing next baseline";
-				_action.SetProgress(_progress, _action.BaselineProgress(), _action._baselineCount, progressStr.str(), _threadIndex);
-	
-				newArtifacts.SetOriginalData(baseline->Data());
-				newArtifacts.SetContaminatedData(baseline->Data());
-				TimeFrequencyData zero(baseline->Data());
-				zero.SetImagesToZero();
-				newArtifacts.SetRevisedData(zero);
-				newArtifacts.SetImageSetIndex(baseline->Index().Clone());
-				newArtifacts.SetMetaData(baseline->MetaData());
+			std::ostringstream progressStr;
+			if(_action._hasInitAntennae)
+				progressStr << "Processing baseline " << baseline->MetaData()->Antenna1().name << " x " << baseline->MetaData()->Antenna2().name;
+			else
+				progressStr << "Processing next baseline";
+			_action.SetProgress(_progress, _action.BaselineProgress(), _action._baselineCount, progressStr.str(), _threadIndex);
 
-				_action.ActionBlock::Perform(newArtifacts, *this);
-	
-				baseline = _action.GetNextBaseline();
-				_action.IncBaselineProgress();
-			}
-	
-			if(_threadIndex == 0)
-				_action._resultSet.reset(new ArtifactSet(newArtifacts));
+			_artifacts->SetOriginalData(baseline->Data());
+			_artifacts->SetContaminatedData(baseline->Data());
+			TimeFrequencyData zero(baseline->Data());
+			zero.SetImagesToZero();
+			_artifacts->SetRevisedData(zero);
+			_artifacts->SetImageSetIndex(baseline->Index().Clone());
+			_artifacts->SetMetaData(baseline->MetaData());
+
+			_action.ActionBlock::Perform(*_artifacts, *this);
+			_artifacts->Scratch().Reset();
+
+			const size_t workingSize = MemoryAccountant::ThreadPeak();
+			size_t largest = _action._workingSizePerBaseline.load(std::memory_order_relaxed);
+			while(workingSize > largest && !_action._workingSizePerBaseline.compare_exchange_weak(largest, workingSize, std::memory_order_relaxed))
+			{ }
 
+			_action._threadInfo[_threadIndex].processedBaselines.fetch_add(1, std::memory_order_relaxed);
 		} catch(std::exception &e)
 		{
 			_progress.OnException(_action, e);
 			_action.SetExceptionOccured();
+			status = WorkStealingPool::SourceFinished;
+		} catch(...)
+		{
+			std::runtime_error e("An unknown exception occurred while flagging a baseline");
+			_progress.OnException(_action, e);
+			_action.SetExceptionOccured();
+			status = WorkStealingPool::SourceFinished;
 		}
+		baseline.reset();
+		_action.onBaselineFinished();
+		return status;
 	}
 
 	void ForEachBaselineAction::PerformFunction::OnStartTask(const Action &/*action*/, size_t /*taskNo*/, size_t /*taskCount*/, const std::string &/*description*/, size_t /*weight*/)
@@ -319,7 +421,7 @@ namespace rfiStrategy {
 			watch.Pause();
 			_action.WaitForBufferAvailable(minRecommendedBufferSize);
 			
-			size_t wantedCount = maxRecommendedBufferSize - _action.GetBaselinesInBufferCount();
+			size_t wantedCount = _action.limitToMemoryBudget(maxRecommendedBufferSize - _action.GetBaselinesInBufferCount());
 			size_t requestedCount = 0;
 			
 			std::unique_lock<std::mutex> lock(_action._artifacts->IOMutex());
@@ -349,35 +451,29 @@ namespace rfiStrategy {
 					
 					std::lock_guard<std::mutex> bufferLock(_action._mutex);
 					_action._baselineBuffer.emplace(std::move(baseline));
+					_action._peakBaselinesInBuffer = std::max(_action._peakBaselinesInBuffer, _action._baselineBuffer.size());
 				}
 			}
 			
 			lock.unlock();
 			
-			_action._dataAvailable.notify_all();
+			_action._pool->Notify();
 			watch.Start();
 		} while(!finished);
 		_action.SetFinishedBaselines();
-		_action._dataAvailable.notify_all();
+		_action._pool->Notify();
 		watch.Pause();
 		Logger::Debug << "Time spent on reading: " << watch.ToString() << '\n';
 	}
 
 	void ForEachBaselineAction::SetProgress(ProgressListener &progress, int no, int count, const std::string& taskName, int threadId)
 	{
-	  std::lock_guard<std::mutex> lock(_mutex);
-		_threadInfo[threadId].progressTaskNo = no;
-		_threadInfo[threadId].progressTaskCount = count;
-		size_t totalCount = 0, totalNo = 0;
-		for(size_t i=0;i<_threadCount;++i)
-		{
-			totalCount += _threadInfo[threadId].progressTaskCount;
-			totalNo += _threadInfo[threadId].progressTaskNo;
-		}
-		progress.OnEndTask(*this);
 		std::stringstream str;
 		str << "T" << threadId << ": " << taskName;
-		progress.OnStartTask(*this, totalNo, totalCount, str.str());
+		// Only the listener needs to be protected: the progress counters are per thread
+		std::lock_guard<std::mutex> lock(_progressMutex);
+		progress.OnEndTask(*this);
+		progress.OnStartTask(*this, no, count, str.str());
 	}
 	
 	std::string ForEachBaselineAction::memToStr(double memSize)
@@ -6,12 +6,15 @@
 
 #include "../imagesets/imageset.h"
 
+#include <atomic>
 #include <stack>
 #include <set>
 #include <mutex>
 #include <condition_variable>
 
+#include "../../util/memoryaccountant.h"
 #include "../../util/progresslistener.h"
+#include "../../util/workstealingpool.h"
 
 namespace rfiStrategy {
 
@@ -27,7 +30,13 @@ namespace rfiStrategy {
 				_resultSet(nullptr),
 				_finishedBaselines(false),
 				_exceptionOccured(false),
-				_baselineProgress(0),
+				_pool(nullptr),
+				_memoryLimit(0),
+				_baselineDataSize(0),
+				_activeWorkers(0),
+				_workingSizePerBaseline(0),
+				_throttleCount(0),
+				_peakBaselinesInBuffer(0),
 				_hasInitAntennae(false),
 				_initPartIndex(0)
 			{
@@ -82,15 +91,16 @@ namespace rfiStrategy {
 					return _threadCount;
 			}
 
-			size_t BaselineProgress()
+			/**
+			 * Number of baselines that have been processed. Each thread counts its
+			 * own baselines, so that no lock is required.
+			 */
+			size_t BaselineProgress() const
 			{
-				std::lock_guard<std::mutex> lock(_mutex);
-				return _baselineProgress;
-			}
-			void IncBaselineProgress()
-			{
-				std::lock_guard<std::mutex> lock(_mutex);
-				++_baselineProgress;
+				size_t progress = 0;
+				for(const ThreadInfo& info : _threadInfo)
+					progress += info.processedBaselines.load(std::memory_order_relaxed);
+				return progress;
 			}
 			
 			void WaitForBufferAvailable(size_t maxSize)
@@ -100,18 +110,29 @@ namespace rfiStrategy {
 					_dataProcessed.wait(lock);
 			}
 			
-			std::unique_ptr<BaselineData> GetNextBaseline()
+			/**
+			 * Takes the next baseline from the buffer without waiting. When the
+			 * buffer is empty, status tells whether more baselines will follow.
+			 */
+			std::unique_ptr<BaselineData> TryGetNextBaseline(WorkStealingPool::SourceResult& status)
 			{
-				std::unique_lock<std::mutex> lock(_mutex);
-				while(_baselineBuffer.size() == 0 && !_exceptionOccured && !_finishedBaselines)
-					_dataAvailable.wait(lock);
-				if((_finishedBaselines && _baselineBuffer.size() == 0) || _exceptionOccured)
+				std::lock_guard<std::mutex> lock(_mutex);
+				if(_exceptionOccured || (_finishedBaselines && _baselineBuffer.empty()))
+				{
+					status = WorkStealingPool::SourceFinished;
+					return nullptr;
+				}
+				else if(_baselineBuffer.empty())
+				{
+					status = WorkStealingPool::NoWorkAvailable;
 					return nullptr;
+				}
 				else
 				{
 					std::unique_ptr<BaselineData> next = std::move(_baselineBuffer.top());
 					_baselineBuffer.pop();
 					_dataProcessed.notify_one();
+					status = WorkStealingPool::WorkDone;
 					return next;
 				}
 			}
@@ -122,20 +143,40 @@ namespace rfiStrategy {
 				return _baselineBuffer.size();
 			}
 			
+			/**
+			 * Whether a worker may start on another baseline without exceeding the
+			 * memory limit, given the largest working memory of a baseline so far.
+			 * A worker may always start when no other worker is active, so that
+			 * there is always progress.
+			 */
+			bool mayStartBaseline() const
+			{
+				if(_memoryLimit == 0 || _activeWorkers.load(std::memory_order_relaxed) == 0)
+					return true;
+				return MemoryAccountant::Used() + _workingSizePerBaseline.load(std::memory_order_relaxed) <= _memoryLimit;
+			}
+			
+			size_t limitToMemoryBudget(size_t wantedCount);
+			void initializeMemoryBudget(class MSImageSet& msImageSet);
+			void onBaselineFinished();
+			
+			/**
+			 * Processes baselines for one of the workers of the pool. The private
+			 * image set and artifacts are created on the first baseline.
+			 */
 			struct PerformFunction : public ProgressListener
 			{
 				PerformFunction(ForEachBaselineAction &action, ProgressListener &progress, size_t threadIndex)
-				  : _action(action), _progress(progress), _threadIndex(threadIndex)
-				{
-				}
-				PerformFunction(const PerformFunction &source)
-					: ProgressListener(source), _action(source._action), _progress(source._progress), _threadIndex(source._threadIndex)
+				  : _action(action), _progress(progress), _threadIndex(threadIndex), _hasReportedScratch(false)
 				{
 				}
 				ForEachBaselineAction &_action;
 				ProgressListener &_progress;
 				size_t _threadIndex;
-				void operator()();
+				bool _hasReportedScratch;
+				std::unique_ptr<ImageSet> _privateImageSet;
+				std::unique_ptr<ArtifactSet> _artifacts;
+				WorkStealingPool::SourceResult ProcessNextBaseline();
 				virtual void OnStartTask(const Action &action, size_t taskNo, size_t taskCount, const std::string &description, size_t weight=1) final override;
 				virtual void OnEndTask(const Action &action) final override;
 				virtual void OnProgress(const Action &action, size_t progres, size_t maxProgress) final override;
@@ -162,16 +203,23 @@ namespace rfiStrategy {
 			std::unique_ptr<ArtifactSet> _resultSet;
 			
 			std::mutex _mutex;
-			std::condition_variable _dataAvailable, _dataProcessed;
+			std::condition_variable _dataProcessed;
 			std::stack<std::unique_ptr<BaselineData>> _baselineBuffer;
 			bool _finishedBaselines;
 
 			struct ThreadInfo {
-				int progressTaskNo, progressTaskCount;
+				ThreadInfo() : processedBaselines(0) { }
+				std::atomic<size_t> processedBaselines;
 			};
 			std::vector<ThreadInfo> _threadInfo;
 			bool _exceptionOccured;
-			size_t _baselineProgress;
+			std::mutex _progressMutex;
+			WorkStealingPool* _pool;
+			
+			// Memory budget; zero limit means no budget
+			size_t _memoryLimit, _baselineDataSize;
+			std::atomic<size_t> _activeWorkers, _workingSizePerBaseline, _throttleCount;
+			size_t _peakBaselinesInBuffer;
 			
 			// Initial data
 			AntennaInfo _initAntenna1, _initAntenna2;
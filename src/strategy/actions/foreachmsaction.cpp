@@ -16,6 +16,7 @@
 #include "../../util/logger.h"
 #include "../../util/progresslistener.h"
 
+#include <algorithm>
 #include <memory>
 
 namespace rfiStrategy {
@@ -72,6 +73,7 @@ void ForEachMSAction::processMS(const std::string& filename, ArtifactSet& artifa
 				msImageSet->SetDataColumnName(_dataColumnName);
 				msImageSet->SetSubtractModel(_subtractModel);
 				msImageSet->SetReadUVW(_readUVW);
+				msImageSet->SetReadAheadSize(_readAheadSize);
 				// during the first iteration, the nr of intervals hasn't been calculated yet. Do that now.
 				if(intervalIndex == 0)
 				{
@@ -100,8 +102,21 @@ void ForEachMSAction::processMS(const std::string& filename, ArtifactSet& artifa
 					size_t nTimes = resolvedIntEnd - resolvedIntStart;
 					size_t start = resolvedIntStart + intervalIndex*nTimes/nIntervals;
 					size_t end = resolvedIntStart + (intervalIndex+1)*nTimes/nIntervals;
-					Logger::Info << "Starting flagging of interval " << intervalIndex << ", timesteps " << start << " - " << end << '\n';
-					msImageSet->SetInterval(start, end);
+					if(_intervalGuardSize == 0)
+					{
+						Logger::Info << "Starting flagging of interval " << intervalIndex << ", timesteps " << start << " - " << end << '\n';
+						msImageSet->SetInterval(start, end);
+					}
+					else {
+						// Read a few extra timesteps on both sides, so that the flagger
+						// has context at the interval borders, but only write the flags
+						// of the interval itself.
+						size_t guardedStart = std::max(resolvedIntStart + _intervalGuardSize, start) - _intervalGuardSize;
+						size_t guardedEnd = std::min(resolvedIntEnd, end + _intervalGuardSize);
+						Logger::Info << "Starting flagging of interval " << intervalIndex << ", timesteps " << start << " - " << end << " (reading " << guardedStart << " - " << guardedEnd << ")\n";
+						msImageSet->SetInterval(guardedStart, guardedEnd);
+						msImageSet->SetFlagWriteInterval(start, end);
+					}
 				}
 				if(_combineSPWs)
 				{
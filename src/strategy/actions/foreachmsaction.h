@@ -21,7 +21,8 @@ namespace rfiStrategy {
 			_skipIfAlreadyProcessed(false),
 			_loadOptimizedStrategy(false),
 			_baselineIOMode(AutoReadMode),
-			_threadCount(0)
+			_threadCount(0),
+			_intervalGuardSize(0)
 			{
 			}
 			~ForEachMSAction()
@@ -61,6 +62,18 @@ namespace rfiStrategy {
 			{
 				_maxIntervalSize = maxIntervalSize;
 			}
+			/**
+			 * Number of timesteps that are read in addition on both sides of an
+			 * interval when the set is split with SetMaxIntervalSize(). The flags
+			 * of these timesteps are not written.
+			 */
+			void SetIntervalGuardSize(size_t guardSize) { _intervalGuardSize = guardSize; }
+			
+			/**
+			 * Bytes of memory for baselines that are read ahead in direct read mode.
+			 * When not set, the reader's default is used.
+			 */
+			void SetReadAheadSize(boost::optional<size_t> readAheadSize) { _readAheadSize = readAheadSize; }
 			
 			bool CombineSPWs() const { return _combineSPWs; }
 			void SetCombineSPWs(bool combineSPWs) { _combineSPWs = combineSPWs; }
@@ -96,6 +109,7 @@ namespace rfiStrategy {
 			bool _readUVW;
 			std::string _dataColumnName;
 			boost::optional<size_t> _intervalStart, _intervalEnd, _maxIntervalSize;
+			boost::optional<size_t> _readAheadSize;
 			bool _subtractModel;
 			std::string _commandLineForHistory;
 			bool _combineSPWs;
@@ -104,6 +118,7 @@ namespace rfiStrategy {
 			bool _loadOptimizedStrategy;
 			BaselineIOMode _baselineIOMode;
 			size_t _threadCount;
+			size_t _intervalGuardSize;
 			std::set<size_t> _fields;
 			std::set<size_t> _bands;
 	};
@@ -8,6 +8,11 @@
 
 #include "../../structures/timefrequencydata.h"
 
+#include "../../util/progresslistener.h"
+#include "../../util/workstealingpool.h"
+
+#include <vector>
+
 namespace rfiStrategy {
 
 	class ForEachPolarisationBlock : public ActionBlock
@@ -158,6 +163,22 @@ namespace rfiStrategy {
 				bool changeRevised = (oldRevisedData.Polarizations() == oldContaminatedData.Polarizations());
 				unsigned count = oldContaminatedData.PolarizationCount();
 
+				std::vector<unsigned> selected;
+				for(unsigned polarizationIndex = 0; polarizationIndex < count; ++polarizationIndex)
+				{
+					if(isDirectPolarizationSelected(oldContaminatedData.GetPolarization(polarizationIndex)))
+						selected.push_back(polarizationIndex);
+				}
+				
+				// When the revised data has other polarizations, it is passed on from
+				// one polarization to the next, so these have to run in order.
+				WorkStealingPool* pool = WorkStealingPool::Current();
+				if(pool != nullptr && pool->WorkerCount() > 1 && selected.size() > 1 && changeRevised && !artifacts.CanVisualize())
+				{
+					performDirectPolarizationsInParallel(artifacts, progress, *pool, selected);
+					return;
+				}
+
 				for(unsigned polarizationIndex = 0; polarizationIndex < count; ++polarizationIndex)
 				{
 					if(isDirectPolarizationSelected(oldContaminatedData.GetPolarization(polarizationIndex)))
@@ -194,6 +215,64 @@ namespace rfiStrategy {
 				artifacts.SetOriginalData(oldOriginalData);
 			}
 
+			/**
+			 * Processes each selected polarization in its own copy of the artifacts.
+			 * All but the first polarization are submitted as tasks to the pool, so
+			 * that idle workers can take them. Visualizations are not supported,
+			 * because they are collected in the artifact set. Each polarization
+			 * gets the same polarization of the revised data, as in
+			 * performDirectPolarizations(), so the revised data must have the same
+			 * polarizations as the contaminated data.
+			 */
+			void performDirectPolarizationsInParallel(ArtifactSet &artifacts, ProgressListener &progress, WorkStealingPool &pool, const std::vector<unsigned>& selected)
+			{
+				TimeFrequencyData
+					oldContaminatedData = artifacts.ContaminatedData(),
+					oldRevisedData = artifacts.RevisedData(),
+					oldOriginalData = artifacts.OriginalData();
+				
+				std::vector<ArtifactSet> polArtifacts(selected.size(), artifacts);
+				for(size_t i=0; i!=selected.size(); ++i)
+				{
+					polArtifacts[i].SetContaminatedData(oldContaminatedData.MakeFromPolarizationIndex(selected[i]));
+					polArtifacts[i].SetOriginalData(oldOriginalData.MakeFromPolarizationIndex(selected[i]));
+					polArtifacts[i].SetRevisedData(oldRevisedData.MakeFromPolarizationIndex(selected[i]));
+				}
+				
+				progress.OnStartTask(*this, 0, 1, "For each polarisation (parallel)");
+				// Progress of the sub-tasks can not be reported by several threads at once
+				DummyProgressListener taskProgress;
+				WorkStealingPool::TaskGroup group;
+				for(size_t i=1; i!=selected.size(); ++i)
+				{
+					ArtifactSet* taskArtifacts = &polArtifacts[i];
+					pool.Submit(group, [this, taskArtifacts, &taskProgress]() {
+						ActionBlock::Perform(*taskArtifacts, taskProgress);
+					});
+				}
+				try {
+					ActionBlock::Perform(polArtifacts[0], taskProgress);
+				} catch(...) {
+					// The tasks refer to local data, so they have to finish first
+					try { pool.Wait(group); } catch(...) { }
+					throw;
+				}
+				pool.Wait(group);
+				
+				for(size_t i=0; i!=selected.size(); ++i)
+				{
+					setPolarizationData(selected[i], oldContaminatedData, polArtifacts[i].ContaminatedData());
+					setPolarizationData(selected[i], oldOriginalData, polArtifacts[i].OriginalData());
+					if(_changeRevised)
+						setPolarizationData(selected[i], oldRevisedData, polArtifacts[i].RevisedData());
+				}
+				progress.OnEndTask(*this);
+				
+				artifacts.SetContaminatedData(oldContaminatedData);
+				artifacts.SetRevisedData(oldRevisedData);
+				artifacts.SetOriginalData(oldOriginalData);
+			}
+
 			void performStokesIteration(ArtifactSet &artifacts, ProgressListener &progress)
 			{
 				TimeFrequencyData
@@ -22,7 +22,7 @@ void HighPassFilterAction::Perform(ArtifactSet &artifacts, ProgressListener &pro
 	case StoreContaminated:
 		for(size_t i=0;i<imageCount;++i)
 		{
-			data.SetImage(i, filter.ApplyHighPass(data.GetImage(i), mask));
+			data.SetImage(i, filter.ApplyHighPass(data.GetImage(i), mask, artifacts.Scratch()));
 		}
 		break;
 		
@@ -33,7 +33,7 @@ void HighPassFilterAction::Perform(ArtifactSet &artifacts, ProgressListener &pro
 		TimeFrequencyData revisedData = data;
 		for(size_t i=0;i<imageCount;++i)
 		{
-			revisedData.SetImage(i, filter.ApplyLowPass(revisedData.GetImage(i), mask));
+			revisedData.SetImage(i, filter.ApplyLowPass(revisedData.GetImage(i), mask, artifacts.Scratch()));
 		}
 		artifacts.SetRevisedData(revisedData);
 		break;
@@ -21,12 +21,12 @@ namespace rfiStrategy {
 		{
 			TimeFrequencyData& original = artifacts.OriginalData();
 			Mask2DCPtr originalMask = original.GetSingleMask();
-			SIROperator::OperateHorizontallyMissing(*mask, *originalMask, _minimumGoodTimeRatio);
-			SIROperator::OperateVerticallyMissing(*mask, *originalMask, _minimumGoodFrequencyRatio);
+			SIROperator::OperateHorizontallyMissing(*mask, *originalMask, _minimumGoodTimeRatio, artifacts.Scratch());
+			SIROperator::OperateVerticallyMissing(*mask, *originalMask, _minimumGoodFrequencyRatio, artifacts.Scratch());
 		}
 		else {
-			SIROperator::OperateHorizontally(*mask, _minimumGoodTimeRatio);
-			SIROperator::OperateVertically(*mask, _minimumGoodFrequencyRatio);
+			SIROperator::OperateHorizontally(*mask, _minimumGoodTimeRatio, artifacts.Scratch());
+			SIROperator::OperateVertically(*mask, _minimumGoodFrequencyRatio, artifacts.Scratch());
 		}
 		
 		if(_minAvailableTimesRatio > 0)
@@ -0,0 +1,32 @@
+#include "../../util/progresslistener.h"
+
+#include "pythonaction.h"
+
+#include "../control/artifactset.h"
+#include "../control/pythonstrategy.h"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace rfiStrategy {
+
+	PythonAction::PythonAction(const std::string& code) :
+		_strategy(new PythonStrategy(code))
+	{ }
+	
+	PythonAction::~PythonAction()
+	{ }
+	
+	void PythonAction::Perform(ArtifactSet &artifacts, class ProgressListener &listener)
+	{
+		TimeFrequencyData data(artifacts.ContaminatedData());
+		_strategy->Execute(data);
+		artifacts.ContaminatedData().SetMask(data);
+		listener.OnProgress(*this, 1, 1);
+	}
+	
+	bool PythonAction::IsPythonFile(const std::string& filename)
+	{
+		return boost::algorithm::iends_with(filename, ".py");
+	}
+
+} // namespace rfiStrategy
@@ -0,0 +1,39 @@
+#ifndef PYTHONACTION_H
+#define PYTHONACTION_H 
+
+#include "action.h"
+
+#include <memory>
+#include <string>
+
+class PythonStrategy;
+
+namespace rfiStrategy {
+
+	/**
+	 * Flags the contaminated data with the flag function of a Python strategy.
+	 * The aoflagger command line program puts this action in a
+	 * ForEachBaselineAction when it is given a .py strategy, so that the
+	 * flag function runs for several baselines in parallel.
+	 */
+	class PythonAction : public Action
+	{
+		public:
+			explicit PythonAction(const std::string& code);
+			~PythonAction();
+			std::string Description() final override
+			{
+				return "Python strategy";
+			}
+			void Perform(class ArtifactSet &artifacts, class ProgressListener &listener) final override;
+			ActionType Type() const final override { return PythonActionType; }
+			
+			static bool IsPythonFile(const std::string& filename);
+			
+		private:
+			std::unique_ptr<PythonStrategy> _strategy;
+	};
+
+}
+
+#endif // PYTHONACTION_H
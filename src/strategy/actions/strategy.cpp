@@ -49,8 +49,7 @@ namespace rfiStrategy {
 			if(i->Type() == WriteFlagsActionType)
 			{
 				WriteFlagsAction& writeAction = static_cast<WriteFlagsAction&>(*i);
-				writeAction.SetMaxBufferItems(threadCount*5);
-				writeAction.SetMinBufferItemsForWriting(threadCount*4);
+				writeAction.SetThreadCount(threadCount);
 			}
 			++i;
 		}
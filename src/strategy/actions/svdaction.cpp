@@ -13,6 +13,8 @@ namespace rfiStrategy {
 		SVDMitigater mitigater;
 		mitigater.Initialize(artifacts.ContaminatedData());
 		mitigater.SetRemoveCount(_singularValueCount);
+		mitigater.SetRandomized(_randomized);
+		mitigater.SetTimeBlockSize(_timeBlockSize);
 		mitigater.PerformFit();
 		listener.OnProgress(*this, 1, 1);
 
@@ -8,7 +8,7 @@ namespace rfiStrategy {
 	class SVDAction : public Action
 	{
 		public:
-			SVDAction() : _singularValueCount(1) { }
+			SVDAction() : _singularValueCount(1), _randomized(false), _timeBlockSize(0) { }
 			std::string Description() final override
 			{
 				return "Singular value decomposition";
@@ -18,9 +18,25 @@ namespace rfiStrategy {
 
 			size_t SingularValueCount() const { return _singularValueCount; }
 			void SetSingularValueCount(size_t svCount) { _singularValueCount = svCount; }
+
+			/**
+			 * Whether only the removed singular vectors are computed, with a
+			 * randomized decomposition.
+			 */
+			bool Randomized() const { return _randomized; }
+			void SetRandomized(bool randomized) { _randomized = randomized; }
+
+			/**
+			 * Number of timesteps that are decomposed together, or zero to
+			 * decompose the full time range at once.
+			 */
+			size_t TimeBlockSize() const { return _timeBlockSize; }
+			void SetTimeBlockSize(size_t timeBlockSize) { _timeBlockSize = timeBlockSize; }
 			
 		private:
 			size_t _singularValueCount;
+			bool _randomized;
+			size_t _timeBlockSize;
 	};
 
 }
@@ -1,18 +1,23 @@
 #include "writeflagsaction.h"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <thread>
 
 #include "../../util/logger.h"
+#include "../../util/memoryaccountant.h"
+#include "../../util/stopwatch.h"
 
 #include "../control/artifactset.h"
 
 #include "../imagesets/imageset.h"
+#include "../imagesets/indexableset.h"
 
 
 namespace rfiStrategy {
 
-	WriteFlagsAction::WriteFlagsAction() : _ioMutex(nullptr), _flusher(), _isFinishing(false), _maxBufferItems(18), _minBufferItemsForWriting(12), _imageSet()
+	WriteFlagsAction::WriteFlagsAction() : _ioMutex(nullptr), _flusher(), _isFinishing(false), _maxBufferItems(0), _minBufferItemsForWriting(0), _threadCount(4), _bufferCapacity(0), _writeThreshold(0), _imageSet()
 	{
 	}
 	
@@ -35,6 +40,7 @@ namespace rfiStrategy {
 			_imageSet = artifacts.ImageSet().Clone();
 			iolock.unlock();
 			_isFinishing = false;
+			_bufferCapacity = 0;
 			FlushFunction flushFunction;
 			flushFunction._parent = this;
 			_flusher.reset( new std::thread(flushFunction) );
@@ -46,50 +52,114 @@ namespace rfiStrategy {
 		{
 			masks.emplace_back(artifacts.ContaminatedData().GetMask(i));
 		}
-		BufferItem newItem(masks, artifacts.ImageSetIndex());
-		pushInBuffer(newItem);
+		pushInBuffer(BufferItem(masks, artifacts.ImageSetIndex()));
+	}
+	
+	void WriteFlagsAction::sizeBuffer(size_t itemSize)
+	{
+		if(_maxBufferItems != 0)
+			_bufferCapacity = _maxBufferItems;
+		else
+			_bufferCapacity = std::max(_threadCount * 2, MaxBufferSize / std::max<size_t>(itemSize, 1));
+		if(_minBufferItemsForWriting != 0)
+			_writeThreshold = std::min(_minBufferItemsForWriting, _bufferCapacity);
+		else
+			_writeThreshold = std::max<size_t>(1, _bufferCapacity * 2 / 3);
+		Logger::Debug << "Flag buffer holds " << _bufferCapacity << " baselines of " << (itemSize+1023)/1024
+			<< " KB, and is written when it has " << _writeThreshold << " baselines.\n";
+		_bufferChange.notify_all();
+	}
+	
+	void WriteFlagsAction::sortInRowOrder(std::vector<BufferItem>& items)
+	{
+		// Baselines are stored in the measurement set in the order of their
+		// antennas (within each timestep), so writing them in that order lets the
+		// readers write consecutive rows together.
+		IndexableSet* indexableSet = dynamic_cast<IndexableSet*>(_imageSet.get());
+		if(indexableSet == nullptr)
+			return;
+		typedef std::array<size_t, 4> Key;
+		std::vector<std::pair<Key, size_t>> keys(items.size());
+		for(size_t i=0; i!=items.size(); ++i)
+		{
+			const ImageSetIndex& index = *items[i]._index;
+			keys[i].first = Key{{
+				indexableSet->GetSequenceId(index), indexableSet->GetBand(index),
+				indexableSet->GetAntenna1(index), indexableSet->GetAntenna2(index) }};
+			keys[i].second = i;
+		}
+		std::sort(keys.begin(), keys.end());
+		std::vector<BufferItem> sorted;
+		sorted.reserve(items.size());
+		for(const std::pair<Key, size_t>& key : keys)
+			sorted.emplace_back(std::move(items[key.second]));
+		items = std::move(sorted);
 	}
 
 	void WriteFlagsAction::FlushFunction::operator()()
 	{
 		std::unique_lock<std::mutex> lock(_parent->_mutex);
+		std::vector<BufferItem> batch;
 		do {
-			while(_parent->_buffer.size() < _parent->_minBufferItemsForWriting && !_parent->_isFinishing)
+			while((_parent->_bufferCapacity == 0 || _parent->_buffer.size() < _parent->_writeThreshold) && !_parent->_isFinishing)
 				_parent->_bufferChange.wait(lock);
 
-			std::stack<BufferItem> bufferCopy;
-			while(!_parent->_buffer.empty())
-			{
-				BufferItem item = _parent->_buffer.top();
-				_parent->_buffer.pop();
-				item._index->Reattach(*_parent->_imageSet);
-				bufferCopy.push(item);
-			}
+			// Take over the whole buffer at once, so that the flagging threads
+			// can continue to fill it while this batch is written.
+			batch.clear();
+			std::swap(batch, _parent->_buffer);
 			_parent->_bufferChange.notify_all();
-			if(bufferCopy.size() >= _parent->_minBufferItemsForWriting)
-				Logger::Debug << "Flag buffer has reached minimal writing size, flushing flags...\n";
-			else
-				Logger::Debug << "Flushing flags...\n";
 			lock.unlock();
-
-			std::unique_lock<std::mutex> ioLock(*_parent->_ioMutex);
-			while(!bufferCopy.empty())
+			
+			if(!batch.empty())
 			{
-				BufferItem item = bufferCopy.top();
-				bufferCopy.pop();
-				Logger::Debug << "Add writing " << item._masks.size() << " masks.\n";
-				Logger::Debug << "Desc: " << item._index->Description() << "\n";
-				Logger::Debug << "ImageSet: " << _parent->_imageSet->Name() << "\n";
-				_parent->_imageSet->AddWriteFlagsTask(*item._index, item._masks);
+				Stopwatch watch(true);
+				for(BufferItem& item : batch)
+					item._index->Reattach(*_parent->_imageSet);
+				_parent->sortInRowOrder(batch);
+				// The batch can be many times larger once unpacked, so it is unpacked
+				// and written one group of baselines at a time. Consecutive baselines
+				// are grouped, which keeps the row order.
+				const size_t maxGroupSize = std::min(MaxWriteGroupSize, MemoryAccountant::Limit() / 16);
+				size_t groupCount = 0;
+				std::vector<BufferItem>::const_iterator groupStart = batch.begin();
+				size_t groupSize = 0;
+				for(std::vector<BufferItem>::const_iterator i=batch.begin(); i!=batch.end(); ++i)
+				{
+					const size_t itemSize = i->UnpackedSize();
+					if(i != groupStart && groupSize + itemSize > maxGroupSize)
+					{
+						_parent->writeGroup(groupStart, i);
+						++groupCount;
+						groupStart = i;
+						groupSize = 0;
+					}
+					groupSize += itemSize;
+				}
+				_parent->writeGroup(groupStart, batch.end());
+				++groupCount;
+				Logger::Debug << "Wrote flags of " << batch.size() << " baselines in " << groupCount << " groups in " << watch.ToString() << ".\n";
 			}
-				Logger::Debug << "Writing.\n";
-			_parent->_imageSet->PerformWriteFlagsTask();
-			ioLock.unlock();
 
 			lock.lock();
 		} while(!_parent->_isFinishing || !_parent->_buffer.empty());
 	}
 
+	void WriteFlagsAction::writeGroup(std::vector<BufferItem>::const_iterator begin, std::vector<BufferItem>::const_iterator end)
+	{
+		std::vector<std::vector<Mask2DCPtr>> masks;
+		masks.reserve(end - begin);
+		for(std::vector<BufferItem>::const_iterator i=begin; i!=end; ++i)
+			masks.emplace_back(i->UnpackMasks());
+
+		// Only the access to the set itself needs to be synchronized with the
+		// reading.
+		std::unique_lock<std::mutex> ioLock(*_ioMutex);
+		for(std::vector<BufferItem>::const_iterator i=begin; i!=end; ++i)
+			_imageSet->AddWriteFlagsTask(*i->_index, masks[i - begin]);
+		_imageSet->PerformWriteFlagsTask();
+	}
+
 	void WriteFlagsAction::Finish()
 	{
 		std::unique_lock<std::mutex> lock(_mutex);
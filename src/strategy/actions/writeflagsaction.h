@@ -6,11 +6,12 @@
 #include "../imagesets/imageset.h"
 
 #include <condition_variable>
-#include <stack>
 #include <mutex>
 #include <thread>
 #include <memory>
+#include <vector>
 
+#include "../../structures/bitmask2d.h"
 #include "../../structures/mask2d.h"
 
 namespace rfiStrategy {
@@ -30,17 +31,51 @@ namespace rfiStrategy {
 			virtual void Finish() final override;
 			virtual void Sync() final override { Finish(); Initialize(); }
 
+			/**
+			 * Sets the maximum number of baselines in the buffer. By default (zero),
+			 * it is determined from the size of the flags of a baseline, such that
+			 * the buffer takes about MaxBufferSize bytes.
+			 */
 			void SetMaxBufferItems(size_t maxBufferItems) { _maxBufferItems = maxBufferItems; }
+			/**
+			 * Sets the number of baselines after which the buffer is written. By
+			 * default (zero), this is two thirds of the maximum.
+			 */
 			void SetMinBufferItemsForWriting(size_t minBufferItemsForWriting) { _minBufferItemsForWriting = minBufferItemsForWriting; }
+			/**
+			 * The buffer holds at least twice this number of baselines, so that the
+			 * flagging threads rarely have to wait for the writer.
+			 */
+			void SetThreadCount(size_t threadCount) { _threadCount = threadCount; }
+			
+			static const size_t MaxBufferSize = 256*1024*1024;
+			
+			/**
+			 * The image set keeps the unpacked masks of all baselines that are
+			 * written together, so the buffer is written in groups of baselines that
+			 * take at most this number of bytes when unpacked, or a sixteenth of the
+			 * memory limit if that is less.
+			 */
+			static const size_t MaxWriteGroupSize = 256*1024*1024;
 		private:
+			/**
+			 * The flags of one baseline that are waiting to be written. The masks
+			 * are stored bit-packed, because the buffer can hold many items.
+			 */
 			struct BufferItem {
 				BufferItem(const std::vector<Mask2DCPtr> &masks, const ImageSetIndex &index)
-					: _masks(masks), _index(index.Clone())
+					: _masks(), _index(index.Clone())
 				{
+					_masks.reserve(masks.size());
+					for(const Mask2DCPtr& mask : masks)
+						_masks.emplace_back(*mask);
 				}
 				BufferItem(const BufferItem &source) : _masks(source._masks), _index(source._index->Clone())
 				{
 				}
+				BufferItem(BufferItem &&source) noexcept : _masks(std::move(source._masks)), _index(std::move(source._index))
+				{
+				}
 				~BufferItem()
 				{
 				}
@@ -49,7 +84,29 @@ namespace rfiStrategy {
 					_masks = source._masks;
 					_index = source._index->Clone();
 				}
-				std::vector<Mask2DCPtr> _masks;
+				std::vector<Mask2DCPtr> UnpackMasks() const
+				{
+					std::vector<Mask2DCPtr> masks;
+					masks.reserve(_masks.size());
+					for(const BitMask2D& mask : _masks)
+						masks.emplace_back(Mask2D::MakePtr(mask.ToMask2D()));
+					return masks;
+				}
+				size_t PackedSize() const
+				{
+					size_t size = 0;
+					for(const BitMask2D& mask : _masks)
+						size += mask.WordsPerRow() * mask.Height() * sizeof(uint64_t);
+					return size;
+				}
+				size_t UnpackedSize() const
+				{
+					size_t size = 0;
+					for(const BitMask2D& mask : _masks)
+						size += mask.Width() * mask.Height() * sizeof(bool);
+					return size;
+				}
+				std::vector<BitMask2D> _masks;
 				std::unique_ptr<ImageSetIndex> _index;
 			};
 
@@ -59,14 +116,20 @@ namespace rfiStrategy {
 				void operator()();
 			};
 
-			void pushInBuffer(const BufferItem &newItem)
+			void pushInBuffer(BufferItem &&newItem)
 			{
 				std::unique_lock<std::mutex> lock(_mutex);
-				while(_buffer.size() >= _maxBufferItems)
+				if(_bufferCapacity == 0)
+					sizeBuffer(newItem.PackedSize());
+				while(_buffer.size() >= _bufferCapacity)
 					_bufferChange.wait(lock);
-				_buffer.emplace(newItem);
+				_buffer.emplace_back(std::move(newItem));
 				_bufferChange.notify_all();
 			}
+			
+			void sizeBuffer(size_t itemSize);
+			void sortInRowOrder(std::vector<BufferItem>& items);
+			void writeGroup(std::vector<BufferItem>::const_iterator begin, std::vector<BufferItem>::const_iterator end);
 
 			std::mutex _mutex;
 			std::mutex *_ioMutex;
@@ -76,8 +139,11 @@ namespace rfiStrategy {
 
 			size_t _maxBufferItems;
 			size_t _minBufferItemsForWriting;
+			size_t _threadCount;
+			// The sizes that are in use, determined from the above settings
+			size_t _bufferCapacity, _writeThreshold;
 
-			std::stack<BufferItem> _buffer;
+			std::vector<BufferItem> _buffer;
 			std::unique_ptr<ImageSet> _imageSet;
 	};
 }
@@ -2,6 +2,7 @@
 
 #include "../../util/rng.h"
 
+#include <algorithm>
 #include <cmath>
 
 #ifdef __SSE__
@@ -12,17 +13,23 @@
 #include <xmmintrin.h>
 #endif
 
+#ifdef HAVE_AVX_KERNELS
+#include <immintrin.h>
+#endif
+
 HighPassFilter::~HighPassFilter()
 {
 	delete[] _hKernel;
 	delete[] _vKernel;
 }
 
-void HighPassFilter::applyLowPassSimple(const Image2DPtr &image)
+void HighPassFilter::applyLowPassSimple(const Image2DPtr &image, ScratchArena& arena)
 {
 	// Guassian convolution can be separated in two 1D convolution
 	// because of properties of the 2D Gaussian function.
-	Image2DPtr temp = Image2D::CreateZeroImagePtr(image->Width(), image->Height());
+	ScratchArena::Scope scope(arena);
+	num_t* temp = allocateTemporaryImage(*image, arena);
+	const size_t stride = image->Stride();
 	size_t hKernelMid = _hWindowSize/2;
 	for(size_t i=0; i<_hWindowSize; ++i) {
 		const num_t kernelValue = _hKernel[i];
@@ -31,7 +38,7 @@ void HighPassFilter::applyLowPassSimple(const Image2DPtr &image)
 			xEnd = (i <= hKernelMid) ? image->Width() : (image->Width()+hKernelMid > i ? (image->Width()-i+hKernelMid) : 0);
 		for(unsigned y=0;y<image->Height();++y) {
 			for(unsigned x=xStart;x<xEnd;++x)	
-				temp->AddValue(x, y, image->Value(x+i-hKernelMid, y)*kernelValue);
+				temp[y*stride + x] += image->Value(x+i-hKernelMid, y)*kernelValue;
 		}
 	}
 	
@@ -44,15 +51,17 @@ void HighPassFilter::applyLowPassSimple(const Image2DPtr &image)
 			yEnd = (i <= vKernelMid) ? image->Height() : ((image->Height()+vKernelMid>i) ? (image->Height()-i+vKernelMid) : 0);
 		for(unsigned y=yStart;y<yEnd;++y) {
 			for(unsigned x=0;x<image->Width();++x)
-				image->AddValue(x, y, temp->Value(x, y+i-vKernelMid)*kernelValue);
+				image->AddValue(x, y, temp[(y+i-vKernelMid)*stride + x]*kernelValue);
 		}
 	}
 }
 
-void HighPassFilter::applyLowPassSSE(const Image2DPtr &image)
+void HighPassFilter::applyLowPassSSE(const Image2DPtr &image, ScratchArena& arena)
 {
 #ifdef USE_INTRINSICS
-	Image2DPtr temp = Image2D::CreateZeroImagePtr(image->Width(), image->Height());
+	ScratchArena::Scope scope(arena);
+	num_t* temp = allocateTemporaryImage(*image, arena);
+	const size_t stride = image->Stride();
 	unsigned hKernelMid = _hWindowSize/2;
 	for(unsigned i=0; i<_hWindowSize; ++i) {
 		
@@ -66,7 +75,7 @@ void HighPassFilter::applyLowPassSSE(const Image2DPtr &image)
 		
 		for(unsigned y=0;y<image->Height();++y) {
 			
-			float *tempPtr = temp->ValuePtr(xStart, y);
+			float *tempPtr = &temp[y*stride + xStart];
 			const float *imagePtr = image->ValuePtr(xStart+i-hKernelMid, y);
 			
 			unsigned x = xStart;
@@ -99,7 +108,7 @@ void HighPassFilter::applyLowPassSSE(const Image2DPtr &image)
 			yEnd = (i <= vKernelMid) ? image->Height() : ((image->Height()+vKernelMid>i) ? (image->Height()-i+vKernelMid) : 0);
 		for(unsigned y=yStart;y<yEnd;++y) {
 			
-			const float *tempPtr = temp->ValuePtr(0, y+i-vKernelMid);
+			const float *tempPtr = &temp[(y+i-vKernelMid)*stride];
 			float *imagePtr = image->ValuePtr(0, y);
 			
 			unsigned x=0;
@@ -127,27 +136,39 @@ void HighPassFilter::applyLowPassSSE(const Image2DPtr &image)
 #endif
 }
 
-Image2DPtr HighPassFilter::ApplyHighPass(const Image2DCPtr &image, const Mask2DCPtr &mask)
+Image2DPtr HighPassFilter::ApplyHighPass(const Image2DCPtr &image, const Mask2DCPtr &mask, ScratchArena& arena)
 {
-	Image2DPtr outputImage = ApplyLowPass(image, mask);
+	Image2DPtr outputImage = ApplyLowPass(image, mask, arena);
 	outputImage->SubtractAsRHS(image);
 	return outputImage;
 }
 
-Image2DPtr HighPassFilter::ApplyLowPass(const Image2DCPtr &image, const Mask2DCPtr &mask)
+Image2DPtr HighPassFilter::ApplyLowPass(const Image2DCPtr &image, const Mask2DCPtr &mask, ScratchArena& arena)
 {
 	initializeKernel();
 	Image2DPtr
 		outputImage = Image2D::CreateUnsetImagePtr(image->Width(), image->Height()),
 		weights = Image2D::CreateUnsetImagePtr(image->Width(), image->Height());
 	setFlaggedValuesToZeroAndMakeWeights(image, outputImage, mask, weights);
-	applyLowPass(outputImage);
-	applyLowPass(weights);
+	applyLowPass(outputImage, arena);
+	applyLowPass(weights, arena);
 	elementWiseDivide(outputImage, weights);
 	weights.reset();
 	return outputImage;
 }
 
+/**
+ * Returns a zeroed buffer with the same size and stride as the image, such
+ * that rows have the same alignment as the rows of the image.
+ */
+num_t* HighPassFilter::allocateTemporaryImage(const Image2D& image, ScratchArena& arena)
+{
+	const size_t size = image.Stride() * image.Height();
+	num_t* temp = arena.Allocate<num_t>(size);
+	std::fill_n(temp, size, 0.0);
+	return temp;
+}
+
 void HighPassFilter::initializeKernel()
 {
 	if(_hKernel == 0)
@@ -270,3 +291,158 @@ void HighPassFilter::elementWiseDivideSSE(const Image2DPtr &leftHand, const Imag
 #endif
 }
 
+
+#ifdef HAVE_AVX_KERNELS
+/**
+ * AVX2 version of applyLowPassSSE(), processing 8 samples at a time. The
+ * same operations are performed in the same order, so the result is equal
+ * to the SSE version.
+ */
+AVX2_TARGET void HighPassFilter::applyLowPassAVX(const Image2DPtr &image, ScratchArena& arena)
+{
+	ScratchArena::Scope scope(arena);
+	num_t* temp = allocateTemporaryImage(*image, arena);
+	const size_t stride = image->Stride();
+	const unsigned width = image->Width();
+	unsigned hKernelMid = _hWindowSize/2;
+	for(unsigned i=0; i<_hWindowSize; ++i) {
+		
+		const num_t k = _hKernel[i];
+		const __m256 k8 = _mm256_set1_ps(k);
+		unsigned
+			xStart = (i >= hKernelMid) ? 0 : (hKernelMid-i),
+			xEnd = (i <= hKernelMid) ? width : (width+hKernelMid > i ? (width-i+hKernelMid) : 0);
+		
+		for(unsigned y=0;y<image->Height();++y) {
+			
+			float *tempPtr = &temp[y*stride + xStart];
+			const float *imagePtr = image->ValuePtr(xStart+i-hKernelMid, y);
+			
+			unsigned x = xStart;
+			for(;x+8<=xEnd;x+=8) {
+				const __m256
+					imageVal = _mm256_loadu_ps(imagePtr),
+					tempVal = _mm256_loadu_ps(tempPtr);
+
+				// *tempPtr += k * (*imagePtr);
+				_mm256_storeu_ps(tempPtr, _mm256_add_ps(tempVal, _mm256_mul_ps(imageVal, k8)));
+				
+				tempPtr += 8;
+				imagePtr += 8;
+			}
+			for(;x<xEnd;++x) {
+				*tempPtr += k * (*imagePtr);
+				++tempPtr;
+				++imagePtr;
+			}
+		}
+	}
+	
+	image->SetAll(0.0);
+	unsigned vKernelMid = _vWindowSize/2;
+	for(unsigned i=0; i<_vWindowSize; ++i) {
+		const num_t k = _vKernel[i];
+		const __m256 k8 = _mm256_set1_ps(k);
+		const unsigned
+			yStart = (i >= vKernelMid) ? 0 : (vKernelMid-i),
+			yEnd = (i <= vKernelMid) ? image->Height() : ((image->Height()+vKernelMid>i) ? (image->Height()-i+vKernelMid) : 0);
+		for(unsigned y=yStart;y<yEnd;++y) {
+			
+			const float *tempPtr = &temp[(y+i-vKernelMid)*stride];
+			float *imagePtr = image->ValuePtr(0, y);
+			
+			// Rows are 32-byte aligned, so aligned loads can be used
+			unsigned x=0;
+			for(;x+8<=width;x += 8) {
+				
+				const __m256
+					imageVal = _mm256_load_ps(imagePtr),
+					tempVal = _mm256_load_ps(tempPtr);
+				
+				// *imagePtr += k * (*tempPtr);
+				_mm256_store_ps(imagePtr, _mm256_add_ps(imageVal, _mm256_mul_ps(tempVal, k8)));
+				
+				tempPtr += 8;
+				imagePtr += 8;
+			}
+			for(;x<width;++x) {
+				*imagePtr += k * (*tempPtr);
+				++tempPtr;
+				++imagePtr;
+			}
+		}
+	}
+}
+
+AVX2_TARGET void HighPassFilter::setFlaggedValuesToZeroAndMakeWeightsAVX(const Image2DCPtr &inputImage, const Image2DPtr &outputImage, const Mask2DCPtr &inputMask, const Image2DPtr &weightsOutput)
+{
+	const size_t width = inputImage->Width();
+	const __m256 zero8 = _mm256_setzero_ps();
+	const __m256 one8 = _mm256_set1_ps(1.0);
+	for(size_t y=0;y<inputImage->Height();++y)
+	{
+		const bool *rowPtr = inputMask->ValuePtr(0, y);
+		const float *inputPtr = inputImage->ValuePtr(0, y);
+		float *outputPtr = outputImage->ValuePtr(0, y);
+		float *weightsPtr = weightsOutput->ValuePtr(0, y);
+		size_t x = 0;
+		for(;x+8<=width;x+=8)
+		{
+			// Widen 8 bools to 8 integers, and convert false to 0xFFFFFFFF and true to 0
+			const __m256 unflagged = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+				_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rowPtr))),
+				_mm256_setzero_si256()));
+			const __m256 values = _mm256_load_ps(inputPtr);
+			// v - v is zero for finite values, and NaN for NaN and infinite values
+			const __m256 finite = _mm256_cmp_ps(_mm256_sub_ps(values, values), zero8, _CMP_EQ_OQ);
+			const __m256 conditionMask = _mm256_and_ps(unflagged, finite);
+			
+			_mm256_store_ps(weightsPtr, _mm256_and_ps(conditionMask, one8));
+			_mm256_store_ps(outputPtr, _mm256_and_ps(conditionMask, values));
+			
+			rowPtr += 8;
+			outputPtr += 8;
+			inputPtr += 8;
+			weightsPtr += 8;
+		}
+		for(;x<width;++x)
+		{
+			if(*rowPtr || !std::isfinite(*inputPtr))
+			{
+				*outputPtr = 0.0;
+				*weightsPtr = 0.0;
+			} else {
+				*outputPtr = *inputPtr;
+				*weightsPtr = 1.0;
+			}
+			++rowPtr;
+			++outputPtr;
+			++inputPtr;
+			++weightsPtr;
+		}
+	}
+}
+
+AVX2_TARGET void HighPassFilter::elementWiseDivideAVX(const Image2DPtr &leftHand, const Image2DCPtr &rightHand)
+{
+	const __m256 zero8 = _mm256_setzero_ps();
+	
+	for(unsigned y=0;y<leftHand->Height();++y) {
+		float *leftHandPtr = leftHand->ValuePtr(0, y);
+		const float *rightHandPtr = rightHand->ValuePtr(0, y);
+		// The stride of an image is a multiple of 8, so the last step does not
+		// exceed the row.
+		float *end = leftHandPtr + leftHand->Width();
+		while(leftHandPtr < end)
+		{
+			__m256
+				l = _mm256_load_ps(leftHandPtr),
+				r = _mm256_load_ps(rightHandPtr);
+			__m256 conditionMask = _mm256_cmp_ps(r, zero8, _CMP_EQ_OQ);
+			_mm256_store_ps(leftHandPtr, _mm256_andnot_ps(conditionMask, _mm256_div_ps(l, r)));
+			leftHandPtr += 8;
+			rightHandPtr += 8;
+		}
+	}
+}
+#endif // HAVE_AVX_KERNELS
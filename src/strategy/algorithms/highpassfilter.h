@@ -4,6 +4,9 @@
 #include "../../structures/image2d.h"
 #include "../../structures/mask2d.h"
 
+#include "../../util/scratcharena.h"
+#include "../../util/simdsupport.h"
+
 #ifdef __SSE__
 #define USE_INTRINSICS
 #endif
@@ -42,15 +45,15 @@ class HighPassFilter
 		
 		/**
 		 * Apply a Gaussian high-pass filter on the given image, ignoring
-		 * flagged samples.
+		 * flagged samples. Temporary buffers are taken from @p arena.
 		 */
-		Image2DPtr ApplyHighPass(const Image2DCPtr &image, const Mask2DCPtr &mask);
+		Image2DPtr ApplyHighPass(const Image2DCPtr &image, const Mask2DCPtr &mask, ScratchArena& arena = ScratchArena::ForCurrentThread());
 		
 		/**
 		 * Apply a Gaussian low-pass filter on the given image, ignoring
-		 * flagged samples.
+		 * flagged samples. Temporary buffers are taken from @p arena.
 		 */
-		Image2DPtr ApplyLowPass(const Image2DCPtr &image, const Mask2DCPtr &mask);
+		Image2DPtr ApplyLowPass(const Image2DCPtr &image, const Mask2DCPtr &mask, ScratchArena& arena = ScratchArena::ForCurrentThread());
 		
 		/**
 		 * Set the horizontal size of the sliding window in samples. Must be odd: if the given
@@ -146,21 +149,39 @@ class HighPassFilter
 		 * Applies the low-pass convolution. Kernel has to be initialized
 		 * before calling.
 		 */
-		void applyLowPass(const Image2DPtr &image)
+		void applyLowPass(const Image2DPtr &image, ScratchArena& arena)
 		{
+#ifdef HAVE_AVX_KERNELS
+			if(SIMDSupport::Has(SIMDSupport::AVX2))
+			{
+				applyLowPassAVX(image, arena);
+				return;
+			}
+#endif
 #ifdef USE_INTRINSICS
-			applyLowPassSSE(image);
+			applyLowPassSSE(image, arena);
 #else
-			applyLowPassSimple(image);
+			applyLowPassSimple(image, arena);
 #endif
 		}
-		void applyLowPassSimple(const Image2DPtr &image);
-		void applyLowPassSSE(const Image2DPtr &image);
+		void applyLowPassSimple(const Image2DPtr &image, ScratchArena& arena);
+		void applyLowPassSSE(const Image2DPtr &image, ScratchArena& arena);
+#ifdef HAVE_AVX_KERNELS
+		AVX2_TARGET void applyLowPassAVX(const Image2DPtr &image, ScratchArena& arena);
+#endif
+		static num_t* allocateTemporaryImage(const Image2D& image, ScratchArena& arena);
 		
 		void initializeKernel();
 		
 		void setFlaggedValuesToZeroAndMakeWeights(const Image2DCPtr &inputImage, const Image2DPtr &outputImage, const Mask2DCPtr &inputMask, const Image2DPtr &weightsOutput)
 		{
+#ifdef HAVE_AVX_KERNELS
+			if(SIMDSupport::Has(SIMDSupport::AVX2))
+			{
+				setFlaggedValuesToZeroAndMakeWeightsAVX(inputImage, outputImage, inputMask, weightsOutput);
+				return;
+			}
+#endif
 #ifdef USE_INTRINSICS
 			setFlaggedValuesToZeroAndMakeWeightsSSE(inputImage, outputImage, inputMask, weightsOutput);
 #else
@@ -169,9 +190,19 @@ class HighPassFilter
 		}
 		void setFlaggedValuesToZeroAndMakeWeightsSimple(const Image2DCPtr &inputImage, const Image2DPtr &outputImage, const Mask2DCPtr &inputMask, const Image2DPtr &weightsOutput);
 		void setFlaggedValuesToZeroAndMakeWeightsSSE(const Image2DCPtr &inputImage, const Image2DPtr &outputImage, const Mask2DCPtr &inputMask, const Image2DPtr &weightsOutput);
+#ifdef HAVE_AVX_KERNELS
+		AVX2_TARGET void setFlaggedValuesToZeroAndMakeWeightsAVX(const Image2DCPtr &inputImage, const Image2DPtr &outputImage, const Mask2DCPtr &inputMask, const Image2DPtr &weightsOutput);
+#endif
 		
 		void elementWiseDivide(const Image2DPtr &leftHand, const Image2DCPtr &rightHand)
 		{
+#ifdef HAVE_AVX_KERNELS
+			if(SIMDSupport::Has(SIMDSupport::AVX2))
+			{
+				elementWiseDivideAVX(leftHand, rightHand);
+				return;
+			}
+#endif
 #ifdef USE_INTRINSICS
 			elementWiseDivideSSE(leftHand, rightHand);
 #else
@@ -180,6 +211,9 @@ class HighPassFilter
 		}
 		void elementWiseDivideSimple(const Image2DPtr &leftHand, const Image2DCPtr &rightHand);
 		void elementWiseDivideSSE(const Image2DPtr &leftHand, const Image2DCPtr &rightHand);
+#ifdef HAVE_AVX_KERNELS
+		AVX2_TARGET void elementWiseDivideAVX(const Image2DPtr &leftHand, const Image2DCPtr &rightHand);
+#endif
 		
 		/**
 		 * The values of the kernel used in the convolution. This kernel is applied horizontally.
@@ -1,5 +1,7 @@
 #include "morphologicalflagger.h"
 
+#include "../../structures/bitmask2d.h"
+
 bool MorphologicalFlagger::SquareContainsFlag(const Mask2D* mask, size_t xLeft, size_t yTop, size_t xRight, size_t yBottom)
 {
 	for(size_t y=yTop;y<=yBottom;++y)
@@ -17,43 +19,11 @@ void MorphologicalFlagger::DilateFlagsHorizontally(Mask2D* mask, size_t timeSize
 {
 	if(timeSize != 0)
 	{
-		Mask2D destination(Mask2D::MakeUnsetMask(mask->Width(), mask->Height()));
-		if(timeSize > mask->Width()) timeSize = mask->Width();
-		const int intSize = (int) timeSize;
-		
-		for(size_t y=0;y<mask->Height();++y)
-		{
-			int dist = intSize + 1;
-			for(size_t x=0;x<timeSize;++x)
-			{
-				if(mask->Value(x, y))
-					dist = - intSize;
-				dist++;
-			}
-			for(size_t x=0;x<mask->Width() - timeSize;++x)
-			{
-				if(mask->Value(x + timeSize, y))
-					dist = -intSize;
-				if(dist <= intSize)
-				{
-					destination.SetValue(x, y, true);
-					dist++;
-				} else {
-					destination.SetValue(x, y, false);
-				}
-			}
-			for(size_t x=mask->Width() - timeSize;x<mask->Width();++x)
-			{
-				if(dist <= intSize)
-				{
-					destination.SetValue(x, y, true);
-					dist++;
-				} else {
-					destination.SetValue(x, y, false);
-				}
-			}
-		}
-		*mask = std::move(destination);
+		// In the packed representation, the dilation can be done by shifting
+		// and or-ing whole words, which is much faster than scanning the samples.
+		BitMask2D bitMask(*mask);
+		bitMask.DilateHorizontally(timeSize);
+		bitMask.CopyTo(*mask);
 	}
 }
 
@@ -276,25 +246,36 @@ void MorphologicalFlagger::ApplyMarksInFrequency(Mask2D* mask, int **flagMarks)
 	}
 }
 
-void MorphologicalFlagger::DensityTimeFlagger(Mask2D* mask, num_t minimumGoodDataRatio)
+/**
+ * Returns a row-indexed array of int rows with the size of the mask.
+ */
+int** MorphologicalFlagger::allocateRows(const Mask2D* mask, ScratchArena& arena)
+{
+	int** rows = arena.Allocate<int*>(mask->Height());
+	int* values = arena.Allocate<int>(mask->Width() * mask->Height());
+	for(size_t y=0;y<mask->Height();++y)
+		rows[y] = values + y * mask->Width();
+	return rows;
+}
+
+void MorphologicalFlagger::DensityTimeFlagger(Mask2D* mask, num_t minimumGoodDataRatio, ScratchArena& arena)
 {
+	ScratchArena::Scope scope(arena);
 	num_t width = 2.0;
 	size_t iterations = 0, step = 1;
 	bool reverse = false;
 	
 	//"sums represents the number of flags in a certain range
-	int **sums = new int*[mask->Height()];
+	int **sums = allocateRows(mask, arena);
 	
 	// flagMarks are integers that represent the number of times an area is marked as the
 	// start or end of a flagged area. For example, if flagMarks[0][0] = 0, it is not the start or
 	// end of an area. If it is 1, it is the start. If it is -1, it is the end. A range of
 	// [2 0 -1 -1 0] produces a flag mask [T T T T F].
-	int **flagMarks = new int*[mask->Height()];
+	int **flagMarks = allocateRows(mask, arena);
 	
 	for(size_t y=0;y<mask->Height();++y)
 	{
-		sums[y] = new int[mask->Width()];
-		flagMarks[y] = new int[mask->Width()];
 		for(size_t x=0;x<mask->Width();++x)
 			flagMarks[y][x] = 0;
 	}
@@ -317,31 +298,20 @@ void MorphologicalFlagger::DensityTimeFlagger(Mask2D* mask, num_t minimumGoodDat
 	}
 	
 	ApplyMarksInTime(mask, flagMarks);
-
-	for(size_t y=0;y<mask->Height();++y)
-	{
-		delete[] sums[y];
-		delete[] flagMarks[y];
-	}
-	delete[] sums;
-	delete[] flagMarks;
 }
 
-void MorphologicalFlagger::DensityFrequencyFlagger(Mask2D* mask, num_t minimumGoodDataRatio)
+void MorphologicalFlagger::DensityFrequencyFlagger(Mask2D* mask, num_t minimumGoodDataRatio, ScratchArena& arena)
 {
+	ScratchArena::Scope scope(arena);
 	num_t width = 2.0;
 	size_t iterations = 0, step = 1;
 	bool reverse = false;
 	
-	Mask2DPtr newMask(new Mask2D(*mask));
-	
-	int **sums = new int*[mask->Height()];
-	int **flagMarks = new int*[mask->Height()];
+	int **sums = allocateRows(mask, arena);
+	int **flagMarks = allocateRows(mask, arena);
 	
 	for(size_t y=0;y<mask->Height();++y)
 	{
-		sums[y] = new int[mask->Width()];
-		flagMarks[y] = new int[mask->Width()];
 		for(size_t x=0;x<mask->Width();++x)
 			flagMarks[y][x] = 0;
 	}
@@ -364,12 +334,4 @@ void MorphologicalFlagger::DensityFrequencyFlagger(Mask2D* mask, num_t minimumGo
 	}
 
 	ApplyMarksInFrequency(mask, flagMarks);
-
-	for(size_t y=0;y<mask->Height();++y)
-	{
-		delete[] sums[y];
-		delete[] flagMarks[y];
-	}
-	delete[] sums;
-	delete[] flagMarks;
 }
@@ -5,6 +5,8 @@
 
 #include "../../structures/mask2d.h"
 
+#include "../../util/scratcharena.h"
+
 class MorphologicalFlagger {
 	public:
 		static inline bool SquareContainsFlag(const Mask2D* mask, size_t xLeft, size_t yTop, size_t xRight, size_t yBottom);
@@ -16,8 +18,8 @@ class MorphologicalFlagger {
 		static void DilateFlagsHorizontally(Mask2D* mask, size_t timeSize);
 		static void DilateFlagsVertically(Mask2D* mask, size_t frequencySize);
 		static void LineRemover(Mask2D* mask, size_t maxTimeContamination, size_t maxFreqContamination);
-		static void DensityTimeFlagger(Mask2D* mask, num_t minimumGoodDataRatio);
-		static void DensityFrequencyFlagger(Mask2D* mask, num_t minimumGoodDataRatio);
+		static void DensityTimeFlagger(Mask2D* mask, num_t minimumGoodDataRatio, ScratchArena& arena = ScratchArena::ForCurrentThread());
+		static void DensityFrequencyFlagger(Mask2D* mask, num_t minimumGoodDataRatio, ScratchArena& arena = ScratchArena::ForCurrentThread());
 		
 	private:
 		static void FlagTime(Mask2D* mask, size_t x);
@@ -28,6 +30,7 @@ class MorphologicalFlagger {
 		static void ThresholdTime(const Mask2D* mask, int **flagMarks, int **sums, int thresholdLevel, int width);
 		static void ThresholdFrequency(const Mask2D* mask, int **flagMarks, int **sums, int thresholdLevel, int width);
 		static void ApplyMarksInTime(Mask2D* mask, int **flagMarks);
+		static int** allocateRows(const Mask2D* mask, ScratchArena& arena);
 		static void ApplyMarksInFrequency(Mask2D* mask, int **flagMarks);
 };
 
@@ -5,6 +5,8 @@
 #include "../../structures/types.h"
 #include "../../structures/xyswappedmask2d.h"
 
+#include "../../util/scratcharena.h"
+
 /**
  * This class contains functions that implement an algorithm to dilate
  * a flag mask: the "scale-invariant rank (SIR) operator".
@@ -118,10 +120,11 @@ public:
 		* @param [in,out] mask The input flag mask to be dilated.
 		* @param [in] eta The η parameter that specifies the minimum number of good data
 		* that any subsequence should have.
+		* @param [in] arena Memory for the temporary arrays.
 		*/
-	static void OperateHorizontally(Mask2D& mask, num_t eta)
+	static void OperateHorizontally(Mask2D& mask, num_t eta, ScratchArena& arena = ScratchArena::ForCurrentThread())
 	{
-		operateHorizontally<Mask2D>(mask, eta);
+		operateHorizontally<Mask2D>(mask, eta, arena);
 	}
 	
 	
@@ -137,10 +140,11 @@ public:
 		* @param [in] missing Flag mask that identifies missing values.
 		* @param [in] eta The η parameter that specifies the minimum number of good data
 		* that any subsequence should have.
+		* @param [in] arena Memory for the temporary arrays.
 		*/
-	static void OperateHorizontallyMissing(Mask2D& mask, const Mask2D& missing, num_t eta)
+	static void OperateHorizontallyMissing(Mask2D& mask, const Mask2D& missing, num_t eta, ScratchArena& arena = ScratchArena::ForCurrentThread())
 	{
-		operateHorizontallyMissing<Mask2D>(mask, missing, eta);
+		operateHorizontallyMissing<Mask2D>(mask, missing, eta, arena);
 	}
 	
 	/**
@@ -149,11 +153,12 @@ public:
 		* @param [in,out] mask The input flag mask to be dilated.
 		* @param [in] eta The η parameter that specifies the minimum number of good data
 		* that any subsequence should have.
+		* @param [in] arena Memory for the temporary arrays.
 		*/
-	static void OperateVertically(Mask2D& mask, num_t eta)
+	static void OperateVertically(Mask2D& mask, num_t eta, ScratchArena& arena = ScratchArena::ForCurrentThread())
 	{
 		XYSwappedMask2D<Mask2D> swappedMask(mask);
-		operateHorizontally<XYSwappedMask2D<Mask2D>>(swappedMask, eta);
+		operateHorizontally<XYSwappedMask2D<Mask2D>>(swappedMask, eta, arena);
 	}
 	
 	/**
@@ -164,12 +169,13 @@ public:
 		* @param [in] missing Flag mask that identifies missing values.
 		* @param [in] eta The η parameter that specifies the minimum number of good data
 		* that any subsequence should have.
+		* @param [in] arena Memory for the temporary arrays.
 		*/
-	static void OperateVerticallyMissing(Mask2D& mask, const Mask2D& missing, num_t eta)
+	static void OperateVerticallyMissing(Mask2D& mask, const Mask2D& missing, num_t eta, ScratchArena& arena = ScratchArena::ForCurrentThread())
 	{
 		XYSwappedMask2D<Mask2D> swappedMask(mask);
 		XYSwappedMask2D<const Mask2D> swappedMissing(missing);
-		operateHorizontallyMissing(swappedMask, swappedMissing, eta);
+		operateHorizontallyMissing(swappedMask, swappedMissing, eta, arena);
 	}
 private:
 	SIROperator() = delete;
@@ -183,17 +189,18 @@ private:
 		* that any subsequence should have.
 		*/
 	template<typename MaskLike>
-	static void operateHorizontally(MaskLike &mask, num_t eta)
+	static void operateHorizontally(MaskLike &mask, num_t eta, ScratchArena& arena)
 	{
+		ScratchArena::Scope scope(arena);
 		const unsigned
 			width = mask.Width(),
 			wSize = width+1;
-		std::unique_ptr<num_t[]>
-			values(new num_t[width]),
-			w(new num_t[wSize]);
-		std::unique_ptr<unsigned[]>
-			minIndices(new unsigned[wSize]),
-			maxIndices(new unsigned[wSize]);
+		num_t
+			*values = arena.Allocate<num_t>(width),
+			*w = arena.Allocate<num_t>(wSize);
+		unsigned
+			*minIndices = arena.Allocate<unsigned>(wSize),
+			*maxIndices = arena.Allocate<unsigned>(wSize);
 		
 		for(unsigned row=0;row<mask.Height();++row)
 		{
@@ -250,17 +257,18 @@ private:
 		* that any subsequence should have.
 		*/
 	template<typename MaskLikeA, typename MaskLikeB>
-	static void operateHorizontallyMissing(MaskLikeA& mask, const MaskLikeB& missing, num_t eta)
+	static void operateHorizontallyMissing(MaskLikeA& mask, const MaskLikeB& missing, num_t eta, ScratchArena& arena)
 	{
+		ScratchArena::Scope scope(arena);
 		const unsigned
 			width = mask.Width(),
 			maxWSize = width+1;
-		std::unique_ptr<num_t[]>
-			values(new num_t[width]),
-			w(new num_t[maxWSize]);
-		std::unique_ptr<unsigned[]>
-			minIndices(new unsigned[maxWSize]),
-			maxIndices(new unsigned[maxWSize]);
+		num_t
+			*values = arena.Allocate<num_t>(width),
+			*w = arena.Allocate<num_t>(maxWSize);
+		unsigned
+			*minIndices = arena.Allocate<unsigned>(maxWSize),
+			*maxIndices = arena.Allocate<unsigned>(maxWSize);
 		
 		for(unsigned row=0;row<mask.Height();++row)
 		{
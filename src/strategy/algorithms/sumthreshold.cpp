@@ -12,6 +12,10 @@
 
 #endif
 
+#ifdef HAVE_AVX_KERNELS
+#include <immintrin.h>
+#endif
+
 template<size_t Length>
 void SumThreshold::Horizontal(const Image2D* input, Mask2D* mask, num_t threshold)
 {
@@ -62,6 +66,96 @@ void SumThreshold::Vertical(const Image2D* input, Mask2D* mask, num_t threshold)
 	}
 }
 
+/**
+ * Reference horizontal SumThreshold of a single row. This is also used by the
+ * vectorized versions for the rows that do not fill a complete vector.
+ */
+template<size_t Length>
+static void horizontalLargeRow(const Image2D* input, const Mask2D* mask, Mask2D* scratch, size_t y, num_t threshold)
+{
+	const size_t width = mask->Width();
+	num_t sum = 0.0;
+	size_t count = 0, xLeft, xRight;
+
+	for(xRight=0;xRight<Length-1;++xRight)
+	{
+		if(!mask->Value(xRight, y))
+		{
+			sum += input->Value(xRight, y);
+			count++;
+		}
+	}
+
+	xLeft = 0;
+	while(xRight < width)
+	{
+		// add the sample at the right
+		if(!mask->Value(xRight, y))
+		{
+			sum += input->Value(xRight, y);
+			++count;
+		}
+		// Check
+		if(count>0 && fabs(sum/count) > threshold)
+		{
+			scratch->SetHorizontalValues(xLeft, y, true, Length);
+		}
+		// subtract the sample at the left
+		if(!mask->Value(xLeft, y))
+		{
+			sum -= input->Value(xLeft, y);
+			--count;
+		}
+		++xLeft;
+		++xRight;
+	}
+}
+
+/**
+ * Reference vertical SumThreshold of a single column, see horizontalLargeRow().
+ */
+template<size_t Length>
+static void verticalLargeColumn(const Image2D* input, const Mask2D* mask, Mask2D* scratch, size_t x, num_t threshold)
+{
+	const size_t height = mask->Height();
+	num_t sum = 0.0;
+	size_t count = 0, yTop, yBottom;
+
+	for(yBottom=0;yBottom<Length-1;++yBottom)
+	{
+		if(!mask->Value(x, yBottom))
+		{
+			sum += input->Value(x, yBottom);
+			++count;
+		}
+	}
+
+	yTop = 0;
+	while(yBottom < height)
+	{
+		// add the sample at the bottom
+		if(!mask->Value(x, yBottom))
+		{
+			sum += input->Value(x, yBottom);
+			++count;
+		}
+		// Check
+		if(count>0 && fabs(sum/count) > threshold)
+		{
+			for(size_t i=0;i<Length;++i)
+				scratch->SetValue(x, yTop + i, true);
+		}
+		// subtract the sample at the top
+		if(!mask->Value(x, yTop))
+		{
+			sum -= input->Value(x, yTop);
+			--count;
+		}
+		++yTop;
+		++yBottom;
+	}
+}
+
 template<size_t Length>
 void SumThreshold::HorizontalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold)
 {
@@ -70,43 +164,7 @@ void SumThreshold::HorizontalLarge(const Image2D* input, Mask2D* mask, Mask2D* s
 	if(Length <= width)
 	{
 		for(size_t y=0;y<height;++y)
-		{
-			num_t sum = 0.0;
-			size_t count = 0, xLeft, xRight;
-
-			for(xRight=0;xRight<Length-1;++xRight)
-			{
-				if(!mask->Value(xRight, y))
-				{
-					sum += input->Value(xRight, y);
-					count++;
-				}
-			}
-
-			xLeft = 0;
-			while(xRight < width)
-			{
-				// add the sample at the right
-				if(!mask->Value(xRight, y))
-				{
-					sum += input->Value(xRight, y);
-					++count;
-				}
-				// Check
-				if(count>0 && fabs(sum/count) > threshold)
-				{
-					scratch->SetHorizontalValues(xLeft, y, true, Length);
-				}
-				// subtract the sample at the left
-				if(!mask->Value(xLeft, y))
-				{
-					sum -= input->Value(xLeft, y);
-					--count;
-				}
-				++xLeft;
-				++xRight;
-			}
-		}
+			horizontalLargeRow<Length>(input, mask, scratch, y, threshold);
 	}
 	*mask = std::move(*scratch);
 }
@@ -119,46 +177,120 @@ void SumThreshold::VerticalLarge(const Image2D* input, Mask2D* mask, Mask2D* scr
 	if(Length <= height)
 	{
 		for(size_t x=0;x<width;++x)
-		{
-			num_t sum = 0.0;
-			size_t count = 0, yTop, yBottom;
+			verticalLargeColumn<Length>(input, mask, scratch, x, threshold);
+	}
+	*mask = std::move(*scratch);
+}
 
-			for(yBottom=0;yBottom<Length-1;++yBottom)
-			{
-				if(!mask->Value(x, yBottom))
-				{
-					sum += input->Value(x, yBottom);
-					++count;
-				}
-			}
+size_t SumThreshold::lengthIndex(size_t length)
+{
+	switch(length)
+	{
+		case 1: return 0;
+		case 2: return 1;
+		case 4: return 2;
+		case 8: return 3;
+		case 16: return 4;
+		case 32: return 5;
+		case 64: return 6;
+		case 128: return 7;
+		case 256: return 8;
+		default: throw BadUsageException("Invalid value for length");
+	}
+}
 
-			yTop = 0;
-			while(yBottom < height)
-			{
-				// add the sample at the bottom
-				if(!mask->Value(x, yBottom))
-				{
-					sum += input->Value(x, yBottom);
-					++count;
-				}
-				// Check
-				if(count>0 && fabs(sum/count) > threshold)
-				{
-					for(size_t i=0;i<Length;++i)
-						scratch->SetValue(x, yTop + i, true);
-				}
-				// subtract the sample at the top
-				if(!mask->Value(x, yTop))
-				{
-					sum -= input->Value(x, yTop);
-					--count;
-				}
-				++yTop;
-				++yBottom;
-			}
-		}
+SumThreshold::KernelTable SumThreshold::MakeKernelTable(SIMDSupport::Level level)
+{
+	KernelTable table;
+	table.level = level;
+	table.horizontal[0] = &horizontalSmall<1>;
+	table.vertical[0] = &verticalSmall<1>;
+	
+	table.horizontal[1] = &HorizontalLarge<2>;
+	table.horizontal[2] = &HorizontalLarge<4>;
+	table.horizontal[3] = &HorizontalLarge<8>;
+	table.horizontal[4] = &HorizontalLarge<16>;
+	table.horizontal[5] = &HorizontalLarge<32>;
+	table.horizontal[6] = &HorizontalLarge<64>;
+	table.horizontal[7] = &HorizontalLarge<128>;
+	table.horizontal[8] = &HorizontalLarge<256>;
+	
+	table.vertical[1] = &VerticalLarge<2>;
+	table.vertical[2] = &VerticalLarge<4>;
+	table.vertical[3] = &VerticalLarge<8>;
+	table.vertical[4] = &VerticalLarge<16>;
+	table.vertical[5] = &VerticalLarge<32>;
+	table.vertical[6] = &VerticalLarge<64>;
+	table.vertical[7] = &VerticalLarge<128>;
+	table.vertical[8] = &VerticalLarge<256>;
+	
+#ifdef __SSE__
+	if(level >= SIMDSupport::SSE)
+	{
+		table.horizontal[1] = &HorizontalLargeSSE<2>;
+		table.horizontal[2] = &HorizontalLargeSSE<4>;
+		table.horizontal[3] = &HorizontalLargeSSE<8>;
+		table.horizontal[4] = &HorizontalLargeSSE<16>;
+		table.horizontal[5] = &HorizontalLargeSSE<32>;
+		table.horizontal[6] = &HorizontalLargeSSE<64>;
+		table.horizontal[7] = &HorizontalLargeSSE<128>;
+		table.horizontal[8] = &HorizontalLargeSSE<256>;
+		
+		table.vertical[1] = &VerticalLargeSSE<2>;
+		table.vertical[2] = &VerticalLargeSSE<4>;
+		table.vertical[3] = &VerticalLargeSSE<8>;
+		table.vertical[4] = &VerticalLargeSSE<16>;
+		table.vertical[5] = &VerticalLargeSSE<32>;
+		table.vertical[6] = &VerticalLargeSSE<64>;
+		table.vertical[7] = &VerticalLargeSSE<128>;
+		table.vertical[8] = &VerticalLargeSSE<256>;
 	}
-	*mask = std::move(*scratch);
+#endif
+	
+#ifdef HAVE_AVX_KERNELS
+	if(level >= SIMDSupport::AVX2)
+	{
+		table.horizontal[1] = &HorizontalLargeAVX<2>;
+		table.horizontal[2] = &HorizontalLargeAVX<4>;
+		table.horizontal[3] = &HorizontalLargeAVX<8>;
+		table.horizontal[4] = &HorizontalLargeAVX<16>;
+		table.horizontal[5] = &HorizontalLargeAVX<32>;
+		table.horizontal[6] = &HorizontalLargeAVX<64>;
+		table.horizontal[7] = &HorizontalLargeAVX<128>;
+		table.horizontal[8] = &HorizontalLargeAVX<256>;
+		
+		table.vertical[1] = &VerticalLargeAVX<2>;
+		table.vertical[2] = &VerticalLargeAVX<4>;
+		table.vertical[3] = &VerticalLargeAVX<8>;
+		table.vertical[4] = &VerticalLargeAVX<16>;
+		table.vertical[5] = &VerticalLargeAVX<32>;
+		table.vertical[6] = &VerticalLargeAVX<64>;
+		table.vertical[7] = &VerticalLargeAVX<128>;
+		table.vertical[8] = &VerticalLargeAVX<256>;
+	}
+	
+	if(level >= SIMDSupport::AVX512)
+	{
+		table.horizontal[1] = &HorizontalLargeAVX512<2>;
+		table.horizontal[2] = &HorizontalLargeAVX512<4>;
+		table.horizontal[3] = &HorizontalLargeAVX512<8>;
+		table.horizontal[4] = &HorizontalLargeAVX512<16>;
+		table.horizontal[5] = &HorizontalLargeAVX512<32>;
+		table.horizontal[6] = &HorizontalLargeAVX512<64>;
+		table.horizontal[7] = &HorizontalLargeAVX512<128>;
+		table.horizontal[8] = &HorizontalLargeAVX512<256>;
+		
+		table.vertical[1] = &VerticalLargeAVX512<2>;
+		table.vertical[2] = &VerticalLargeAVX512<4>;
+		table.vertical[3] = &VerticalLargeAVX512<8>;
+		table.vertical[4] = &VerticalLargeAVX512<16>;
+		table.vertical[5] = &VerticalLargeAVX512<32>;
+		table.vertical[6] = &VerticalLargeAVX512<64>;
+		table.vertical[7] = &VerticalLargeAVX512<128>;
+		table.vertical[8] = &VerticalLargeAVX512<256>;
+	}
+#endif
+	return table;
 }
 
 void SumThreshold::HorizontalLargeReference(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
@@ -231,7 +363,7 @@ void SumThreshold::HorizontalLargeSSE(const Image2D* input, Mask2D* mask, Mask2D
 }
 #endif // SSE
 
-#ifdef __AVX2__
+#ifdef HAVE_AVX_KERNELS
 void SumThreshold::VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
 {
 	switch(length)
@@ -248,7 +380,58 @@ void SumThreshold::VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D*
 		default: throw BadUsageException("Invalid value for length");
 	}
 }
-#endif // AVX2
+
+void SumThreshold::HorizontalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
+{
+	switch(length)
+	{
+		case 1: Horizontal<1>(input, mask, threshold); break;
+		case 2: HorizontalLargeAVX<2>(input, mask, scratch, threshold); break;
+		case 4: HorizontalLargeAVX<4>(input, mask, scratch, threshold); break;
+		case 8: HorizontalLargeAVX<8>(input, mask, scratch, threshold); break;
+		case 16: HorizontalLargeAVX<16>(input, mask, scratch, threshold); break;
+		case 32: HorizontalLargeAVX<32>(input, mask, scratch, threshold); break;
+		case 64: HorizontalLargeAVX<64>(input, mask, scratch, threshold); break;
+		case 128: HorizontalLargeAVX<128>(input, mask, scratch, threshold); break;
+		case 256: HorizontalLargeAVX<256>(input, mask, scratch, threshold); break;
+		default: throw BadUsageException("Invalid value for length");
+	}
+}
+
+void SumThreshold::VerticalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
+{
+	switch(length)
+	{
+		case 1: Vertical<1>(input, mask, threshold); break;
+		case 2: VerticalLargeAVX512<2>(input, mask, scratch, threshold); break;
+		case 4: VerticalLargeAVX512<4>(input, mask, scratch, threshold); break;
+		case 8: VerticalLargeAVX512<8>(input, mask, scratch, threshold); break;
+		case 16: VerticalLargeAVX512<16>(input, mask, scratch, threshold); break;
+		case 32: VerticalLargeAVX512<32>(input, mask, scratch, threshold); break;
+		case 64: VerticalLargeAVX512<64>(input, mask, scratch, threshold); break;
+		case 128: VerticalLargeAVX512<128>(input, mask, scratch, threshold); break;
+		case 256: VerticalLargeAVX512<256>(input, mask, scratch, threshold); break;
+		default: throw BadUsageException("Invalid value for length");
+	}
+}
+
+void SumThreshold::HorizontalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
+{
+	switch(length)
+	{
+		case 1: Horizontal<1>(input, mask, threshold); break;
+		case 2: HorizontalLargeAVX512<2>(input, mask, scratch, threshold); break;
+		case 4: HorizontalLargeAVX512<4>(input, mask, scratch, threshold); break;
+		case 8: HorizontalLargeAVX512<8>(input, mask, scratch, threshold); break;
+		case 16: HorizontalLargeAVX512<16>(input, mask, scratch, threshold); break;
+		case 32: HorizontalLargeAVX512<32>(input, mask, scratch, threshold); break;
+		case 64: HorizontalLargeAVX512<64>(input, mask, scratch, threshold); break;
+		case 128: HorizontalLargeAVX512<128>(input, mask, scratch, threshold); break;
+		case 256: HorizontalLargeAVX512<256>(input, mask, scratch, threshold); break;
+		default: throw BadUsageException("Invalid value for length");
+	}
+}
+#endif // HAVE_AVX_KERNELS
 
 #ifdef __SSE__
 /**
@@ -594,12 +777,10 @@ void SumThreshold::HorizontalLargeSSE<256>(const Image2D* input, Mask2D* mask, M
 
 #endif
 
-#ifdef __AVX2__
-
-#include <immintrin.h>
+#ifdef HAVE_AVX_KERNELS
 
 template<size_t Length>
-void SumThreshold::VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold)
+AVX2_TARGET void SumThreshold::VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold)
 {
 	*scratch = *mask;
 	const size_t width = mask->Width(), height = mask->Height();
@@ -858,6 +1039,372 @@ void SumThreshold::VerticalLargeAVX<128>(const Image2D* input, Mask2D* mask, Mas
 template
 void SumThreshold::VerticalLargeAVX<256>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
 
-#else
-#warning "AVX2 optimization of SumThreshold algorithm is not used"
+/**
+ * Transposes an 8x8 block of floats that is stored in 8 registers.
+ */
+AVX2_TARGET static inline void transpose8x8AVX(__m256 r[8])
+{
+	const __m256
+		t0 = _mm256_unpacklo_ps(r[0], r[1]),
+		t1 = _mm256_unpackhi_ps(r[0], r[1]),
+		t2 = _mm256_unpacklo_ps(r[2], r[3]),
+		t3 = _mm256_unpackhi_ps(r[2], r[3]),
+		t4 = _mm256_unpacklo_ps(r[4], r[5]),
+		t5 = _mm256_unpackhi_ps(r[4], r[5]),
+		t6 = _mm256_unpacklo_ps(r[6], r[7]),
+		t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	const __m256
+		s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0)),
+		s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2)),
+		s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0)),
+		s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2)),
+		s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0)),
+		s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2)),
+		s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0)),
+		s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+/**
+ * Reads a block of 8 columns of 8 rows, starting at (x, y), and transposes it, such
+ * that values[i] holds column x+i of the 8 rows. Flagged values are set to zero,
+ * and conditions[i] is 0xFFFFFFFF for unflagged and 0 for flagged values. x should
+ * be a multiple of 8.
+ */
+AVX2_TARGET static inline void loadTransposedBlockAVX(const Image2D* input, const Mask2D* mask, size_t x, size_t y, __m256 values[8], __m256 conditions[8])
+{
+	const __m256i zero8i = _mm256_setzero_si256();
+	for(size_t i=0; i!=8; ++i)
+	{
+		__m128i flags;
+		const bool* flagPtr = mask->ValuePtr(x, y+i);
+		if(x + 8 <= mask->Stride())
+			flags = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(flagPtr));
+		else {
+			// The mask stride is only a multiple of 4: the last block of a row
+			// can extend beyond the row. These samples are treated as flagged.
+			uint64_t partial = 0x0101010101010101ULL;
+			memcpy(&partial, flagPtr, mask->Stride() - x);
+			flags = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&partial));
+		}
+		conditions[i] = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(flags), zero8i));
+		values[i] = _mm256_and_ps(_mm256_loadu_ps(input->ValuePtr(x, y+i)), conditions[i]);
+	}
+	transpose8x8AVX(values);
+	transpose8x8AVX(conditions);
+}
+
+/**
+ * Horizontal SumThreshold of 8 rows starting at row y. The 8 rows are
+ * read as 8x8 blocks that are transposed in registers, such that the
+ * sliding window is moved over the 8 rows simultaneously. The transposed
+ * blocks are kept in a small ring buffer, so that the samples that leave
+ * the window do not have to be read and transposed again.
+ *
+ * Rows are allocated in multiples of 4, so y+8 may extend at most 4 rows beyond
+ * the height of the image; these rows are never flagged.
+ */
+template<size_t Length>
+AVX2_TARGET static void horizontalLargeRowsAVX(const Image2D* input, const Mask2D* mask, Mask2D* scratch, size_t y, num_t threshold)
+{
+	const size_t RingBlocks = (Length + 6) / 8 + 2;
+	const size_t width = mask->Width(), height = mask->Height();
+	const unsigned rowMask = (y + 8 <= height) ? 0xFF : ((1u << (height - y)) - 1);
+	const __m256i zero8i = _mm256_setzero_si256();
+	const __m256 threshold8Pos = _mm256_set1_ps(threshold);
+	const __m256 threshold8Neg = _mm256_set1_ps(-threshold);
+	__m256 values[RingBlocks][8], conditions[RingBlocks][8];
+	__m256 sum8 = _mm256_setzero_ps();
+	__m256i count8 = zero8i;
+	for(size_t blockX=0; blockX<width; blockX+=8)
+	{
+		const size_t block = (blockX / 8) % RingBlocks;
+		loadTransposedBlockAVX(input, mask, blockX, y, values[block], conditions[block]);
+		const size_t blockWidth = std::min<size_t>(8, width - blockX);
+		for(size_t i=0; i!=blockWidth; ++i)
+		{
+			// ** Add the samples at the right **
+			const size_t xRight = blockX + i;
+			sum8 = _mm256_add_ps(sum8, values[block][i]);
+			// Conditions are -1 for unflagged samples
+			count8 = _mm256_sub_epi32(count8, _mm256_castps_si256(conditions[block][i]));
+			
+			if(xRight + 1 >= Length)
+			{
+				// ** Check sum **
+				
+				// if count > 0 && (sum/count > threshold || sum/count < -threshold)
+				const size_t xLeft = xRight + 1 - Length;
+				const __m256 avg8 = _mm256_div_ps(sum8, _mm256_cvtepi32_ps(count8));
+				const unsigned flagConditions = rowMask &
+					(_mm256_movemask_ps(_mm256_cmp_ps(avg8, threshold8Pos, _CMP_GT_OQ)) |
+					_mm256_movemask_ps(_mm256_cmp_ps(avg8, threshold8Neg, _CMP_LT_OQ))) &
+					_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(count8, zero8i)));
+				if(flagConditions != 0)
+				{
+					for(size_t j=0; j!=8; ++j)
+					{
+						if((flagConditions & (1u << j)) != 0)
+							scratch->SetHorizontalValues(xLeft, y+j, true, Length);
+					}
+				}
+				
+				// ** Subtract the samples at the left **
+				const size_t leftBlock = (xLeft / 8) % RingBlocks, l = xLeft % 8;
+				sum8 = _mm256_sub_ps(sum8, values[leftBlock][l]);
+				count8 = _mm256_add_epi32(count8, _mm256_castps_si256(conditions[leftBlock][l]));
+			}
+		}
+	}
+}
+
+template<size_t Length>
+AVX2_TARGET void SumThreshold::HorizontalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold)
+{
+	*scratch = *mask;
+	const size_t width = mask->Width(), height = mask->Height();
+	if(Length <= width)
+	{
+		const size_t allocHeight = ((height + 3) / 4) * 4;
+		size_t y = 0;
+		for(; y + 8 <= allocHeight; y += 8)
+			horizontalLargeRowsAVX<Length>(input, mask, scratch, y, threshold);
+		for(; y < height; ++y)
+			horizontalLargeRow<Length>(input, mask, scratch, y, threshold);
+	}
+	std::swap(*mask, *scratch);
+}
+
+// The AVX-512 conversion intrinsics of some gcc versions trigger
+// false 'may be used uninitialized' warnings inside the intrinsic headers.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
 #endif
+
+/**
+ * Horizontal SumThreshold of 16 rows starting at row y. This works like
+ * horizontalLargeRowsAVX(), but combines two transposed 8x8 blocks into
+ * 16-lane vectors.
+ */
+template<size_t Length>
+AVX512_TARGET static void horizontalLargeRowsAVX512(const Image2D* input, const Mask2D* mask, Mask2D* scratch, size_t y, num_t threshold)
+{
+	const size_t RingBlocks = (Length + 6) / 8 + 2;
+	const size_t width = mask->Width(), height = mask->Height();
+	const unsigned rowMask = (y + 16 <= height) ? 0xFFFF : ((1u << (height - y)) - 1);
+	const __m512i zero16i = _mm512_setzero_si512();
+	const __m512i ones16 = _mm512_set1_epi32(1);
+	const __m512 threshold16Pos = _mm512_set1_ps(threshold);
+	const __m512 threshold16Neg = _mm512_set1_ps(-threshold);
+	__m256 lowValues[8], lowConditions[8], highValues[8], highConditions[8];
+	__m512 values[RingBlocks][8];
+	__mmask16 conditions[RingBlocks][8];
+	__m512 sum16 = _mm512_setzero_ps();
+	__m512i count16 = zero16i;
+	for(size_t blockX=0; blockX<width; blockX+=8)
+	{
+		const size_t block = (blockX / 8) % RingBlocks;
+		loadTransposedBlockAVX(input, mask, blockX, y, lowValues, lowConditions);
+		loadTransposedBlockAVX(input, mask, blockX, y+8, highValues, highConditions);
+		for(size_t i=0; i!=8; ++i)
+		{
+			values[block][i] = _mm512_castpd_ps(_mm512_insertf64x4(
+				_mm512_castpd256_pd512(_mm256_castps_pd(lowValues[i])), _mm256_castps_pd(highValues[i]), 1));
+			conditions[block][i] = _mm256_movemask_ps(lowConditions[i]) | (_mm256_movemask_ps(highConditions[i]) << 8);
+		}
+		
+		const size_t blockWidth = std::min<size_t>(8, width - blockX);
+		for(size_t i=0; i!=blockWidth; ++i)
+		{
+			// ** Add the samples at the right **
+			const size_t xRight = blockX + i;
+			sum16 = _mm512_add_ps(sum16, values[block][i]);
+			count16 = _mm512_mask_add_epi32(count16, conditions[block][i], count16, ones16);
+			
+			if(xRight + 1 >= Length)
+			{
+				// ** Check sum **
+				const size_t xLeft = xRight + 1 - Length;
+				const __m512 avg16 = _mm512_div_ps(sum16, _mm512_cvtepi32_ps(count16));
+				const unsigned flagConditions = rowMask &
+					(_mm512_cmp_ps_mask(avg16, threshold16Pos, _CMP_GT_OQ) |
+					_mm512_cmp_ps_mask(avg16, threshold16Neg, _CMP_LT_OQ)) &
+					_mm512_cmpgt_epi32_mask(count16, zero16i);
+				if(flagConditions != 0)
+				{
+					for(size_t j=0; j!=16; ++j)
+					{
+						if((flagConditions & (1u << j)) != 0)
+							scratch->SetHorizontalValues(xLeft, y+j, true, Length);
+					}
+				}
+				
+				// ** Subtract the samples at the left **
+				const size_t leftBlock = (xLeft / 8) % RingBlocks, l = xLeft % 8;
+				sum16 = _mm512_sub_ps(sum16, values[leftBlock][l]);
+				count16 = _mm512_mask_sub_epi32(count16, conditions[leftBlock][l], count16, ones16);
+			}
+		}
+	}
+}
+
+template<size_t Length>
+AVX512_TARGET void SumThreshold::HorizontalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold)
+{
+	*scratch = *mask;
+	const size_t width = mask->Width(), height = mask->Height();
+	if(Length <= width)
+	{
+		const size_t allocHeight = ((height + 3) / 4) * 4;
+		size_t y = 0;
+		for(; y + 16 <= allocHeight; y += 16)
+			horizontalLargeRowsAVX512<Length>(input, mask, scratch, y, threshold);
+		for(; y + 8 <= allocHeight; y += 8)
+			horizontalLargeRowsAVX<Length>(input, mask, scratch, y, threshold);
+		for(; y < height; ++y)
+			horizontalLargeRow<Length>(input, mask, scratch, y, threshold);
+	}
+	std::swap(*mask, *scratch);
+}
+
+/**
+ * Vertical SumThreshold of the 16 columns starting at column x. x+16 should
+ * not be larger than the width.
+ */
+template<size_t Length>
+AVX512_TARGET static void verticalLargeColumnsAVX512(const Image2D* input, const Mask2D* mask, Mask2D* scratch, size_t x, num_t threshold)
+{
+	const size_t height = mask->Height();
+	const __m512i zero16i = _mm512_setzero_si512();
+	const __m512i ones16 = _mm512_set1_epi32(1);
+	const __m512 threshold16Pos = _mm512_set1_ps(threshold);
+	const __m512 threshold16Neg = _mm512_set1_ps(-threshold);
+	__m512 sum16 = _mm512_setzero_ps();
+	__m512i count16 = zero16i;
+	size_t yBottom;
+	
+	for(yBottom=0; yBottom+1<Length; ++yBottom)
+	{
+		const __mmask16 unflagged = _mm512_cmpeq_epi32_mask(_mm512_cvtepu8_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask->ValuePtr(x, yBottom)))), zero16i);
+		sum16 = _mm512_mask_add_ps(sum16, unflagged, sum16, _mm512_loadu_ps(input->ValuePtr(x, yBottom)));
+		count16 = _mm512_mask_add_epi32(count16, unflagged, count16, ones16);
+	}
+	
+	size_t yTop = 0;
+	while(yBottom < height)
+	{
+		// ** Add the 16 samples at the bottom **
+		__mmask16 unflagged = _mm512_cmpeq_epi32_mask(_mm512_cvtepu8_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask->ValuePtr(x, yBottom)))), zero16i);
+		sum16 = _mm512_mask_add_ps(sum16, unflagged, sum16, _mm512_loadu_ps(input->ValuePtr(x, yBottom)));
+		count16 = _mm512_mask_add_epi32(count16, unflagged, count16, ones16);
+		
+		// ** Check sum **
+		const __m512 avg16 = _mm512_div_ps(sum16, _mm512_cvtepi32_ps(count16));
+		const __mmask16 flagConditions =
+			(_mm512_cmp_ps_mask(avg16, threshold16Pos, _CMP_GT_OQ) |
+			_mm512_cmp_ps_mask(avg16, threshold16Neg, _CMP_LT_OQ)) &
+			_mm512_cmpgt_epi32_mask(count16, zero16i);
+		if(flagConditions != 0)
+		{
+			// Convert the 16 conditions to 16 bools
+			const __m128i flagBytes = _mm512_cvtepi32_epi8(_mm512_maskz_mov_epi32(flagConditions, ones16));
+			for(size_t i=0; i!=Length; ++i)
+			{
+				__m128i* outputPtr = reinterpret_cast<__m128i*>(scratch->ValuePtr(x, yTop + i));
+				_mm_storeu_si128(outputPtr, _mm_or_si128(_mm_loadu_si128(outputPtr), flagBytes));
+			}
+		}
+		
+		// ** Subtract the samples at the top **
+		unflagged = _mm512_cmpeq_epi32_mask(_mm512_cvtepu8_epi32(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask->ValuePtr(x, yTop)))), zero16i);
+		sum16 = _mm512_mask_sub_ps(sum16, unflagged, sum16, _mm512_loadu_ps(input->ValuePtr(x, yTop)));
+		count16 = _mm512_mask_sub_epi32(count16, unflagged, count16, ones16);
+		
+		++yTop;
+		++yBottom;
+	}
+}
+
+template<size_t Length>
+AVX512_TARGET void SumThreshold::VerticalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold)
+{
+	*scratch = *mask;
+	const size_t width = mask->Width(), height = mask->Height();
+	if(Length <= height)
+	{
+		size_t x = 0;
+		for(; x + 16 <= width; x += 16)
+			verticalLargeColumnsAVX512<Length>(input, mask, scratch, x, threshold);
+		for(; x < width; ++x)
+			verticalLargeColumn<Length>(input, mask, scratch, x, threshold);
+	}
+	std::swap(*mask, *scratch);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+template
+void SumThreshold::HorizontalLargeAVX<2>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<4>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<8>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<16>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<32>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<64>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<128>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX<256>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+template
+void SumThreshold::VerticalLargeAVX512<2>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<4>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<8>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<16>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<32>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<64>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<128>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::VerticalLargeAVX512<256>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+template
+void SumThreshold::HorizontalLargeAVX512<2>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<4>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<8>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<16>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<32>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<64>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<128>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+template
+void SumThreshold::HorizontalLargeAVX512<256>(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+#endif // HAVE_AVX_KERNELS
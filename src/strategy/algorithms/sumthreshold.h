@@ -7,69 +7,145 @@
 #include "../../structures/image2d.h"
 #include "../../structures/mask2d.h"
 
+#include "../../util/simdsupport.h"
+
 class SumThreshold
 {
 public:
+	/**
+	 * Signature of a SumThreshold kernel for one specific length.
+	 */
+	typedef void (*LargeKernel)(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+	/**
+	 * Table with a horizontal and vertical kernel for each of the supported
+	 * lengths 1, 2, 4, ..., 256. The index in the arrays is log2(length).
+	 */
+	struct KernelTable
+	{
+		enum { LengthCount = 9 };
+		LargeKernel horizontal[LengthCount];
+		LargeKernel vertical[LengthCount];
+		SIMDSupport::Level level;
+	};
+
 	template<size_t Length>
 	static void Horizontal(const Image2D* input, Mask2D* mask, num_t threshold);
-	
+
 	template<size_t Length>
 	static void Vertical(const Image2D* input, Mask2D* mask, num_t threshold);
-	
+
 	template<size_t Length>
 	static void HorizontalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
 
 #ifdef __SSE__
 	template<size_t Length>
 	static void VerticalLargeSSE(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
-	
+
 	static void VerticalLargeSSE(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
 
 	template<size_t Length>
 	static void HorizontalLargeSSE(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
-	
+
 	static void HorizontalLargeSSE(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
 #endif
-	
-#ifdef __AVX2__
+
+#ifdef HAVE_AVX_KERNELS
+	/**
+	 * AVX2 kernels. These are always compiled on x86, but may only be called
+	 * when SIMDSupport::Has(SIMDSupport::AVX2) is true.
+	 */
 	template<size_t Length>
-	static void VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
-	
+	AVX2_TARGET static void VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
 	static void VerticalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
+
+	/**
+	 * Horizontal AVX2 kernel that processes 8 rows (channels) at a time. The
+	 * result is bit-identical to HorizontalLargeReference().
+	 */
+	template<size_t Length>
+	AVX2_TARGET static void HorizontalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+	static void HorizontalLargeAVX(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
+
+	/**
+	 * AVX-512 kernels that process 16 rows or columns at a time. These may only be
+	 * called when SIMDSupport::Has(SIMDSupport::AVX512) is true. The results are
+	 * bit-identical to the reference kernels.
+	 */
+	template<size_t Length>
+	AVX512_TARGET static void VerticalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+	static void VerticalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
+
+	template<size_t Length>
+	AVX512_TARGET static void HorizontalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
+
+	static void HorizontalLargeAVX512(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
 #endif
-	
+
 	template<size_t Length>
 	static void VerticalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch, num_t threshold);
-	
+
 	template<size_t Length>
 	static void Large(const Image2D* input, Mask2D* mask, num_t hThreshold, num_t vThreshold)
 	{
 		HorizontalLarge<Length>(input, mask, hThreshold);
 		VerticalLarge<Length>(input, mask, vThreshold);
 	}
-	
+
+	/**
+	 * Performs the vertical SumThreshold operation with the fastest kernel
+	 * that the processor supports.
+	 */
 	static void VerticalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
 	{
-#if defined(__AVX2__)
-		VerticalLargeAVX(input, mask, scratch, length, threshold);
-#elif defined(__SSE__)
-		VerticalLargeSSE(input, mask, scratch, length, threshold);
-#else
-		VerticalLargeReference(input, mask, scratch, length, threshold);
-#endif
+		Kernels().vertical[lengthIndex(length)](input, mask, scratch, threshold);
 	}
-	
+
 	static void VerticalLargeReference(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
-	
+
 	static void HorizontalLargeReference(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
-	
+
+	/**
+	 * Performs the horizontal SumThreshold operation with the fastest kernel
+	 * that the processor supports.
+	 */
 	static void HorizontalLarge(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold)
 	{
-#ifdef __SSE__
-		HorizontalLargeSSE(input, mask, scratch, length, threshold);
-#else
-		HorizontalLargeReference(input, mask, scratch, length, threshold);
-#endif
+		Kernels().horizontal[lengthIndex(length)](input, mask, scratch, threshold);
+	}
+
+	/**
+	 * The kernel table for the highest SIMD level that is available. It is
+	 * selected on first use.
+	 */
+	static const KernelTable& Kernels()
+	{
+		static const KernelTable table = MakeKernelTable(SIMDSupport::Selected());
+		return table;
+	}
+
+	/**
+	 * Constructs the kernel table for the given SIMD level. Levels that have no
+	 * specialized kernel for some direction use the best lower-level kernel.
+	 */
+	static KernelTable MakeKernelTable(SIMDSupport::Level level);
+
+private:
+	static size_t lengthIndex(size_t length);
+
+	template<size_t Length>
+	static void horizontalSmall(const Image2D* input, Mask2D* mask, Mask2D*, num_t threshold)
+	{
+		Horizontal<Length>(input, mask, threshold);
+	}
+
+	template<size_t Length>
+	static void verticalSmall(const Image2D* input, Mask2D* mask, Mask2D*, num_t threshold)
+	{
+		Vertical<Length>(input, mask, threshold);
 	}
 };
 
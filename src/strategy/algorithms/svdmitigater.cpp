@@ -2,6 +2,10 @@
 
 #include "svdmitigater.h"
 
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
 #ifdef HAVE_GTKMM
  #include "../../plot/plot2d.h"
 #endif
@@ -11,9 +15,59 @@ extern "C" {
 	      doublecomplex *a, integer *lda, doublereal *s, doublecomplex *u, 
 	      integer *ldu, doublecomplex *vt, integer *ldvt, doublecomplex *work, 
 	      integer *lwork, doublereal *rwork, integer *info);
+  int zgemm_(char *transa, char *transb, integer *m, integer *n, integer *k,
+	      doublecomplex *alpha, doublecomplex *a, integer *lda, doublecomplex *b,
+	      integer *ldb, doublecomplex *beta, doublecomplex *c, integer *ldc);
+  int zgeqrf_(integer *m, integer *n, doublecomplex *a, integer *lda,
+	      doublecomplex *tau, doublecomplex *work, integer *lwork, integer *info);
+  int zungqr_(integer *m, integer *n, integer *k, doublecomplex *a, integer *lda,
+	      doublecomplex *tau, doublecomplex *work, integer *lwork, integer *info);
+}
+
+namespace {
+	/**
+	 * Number of extra dimensions of the random subspace, and number of power
+	 * iterations of the randomized decomposition. These are the values
+	 * recommended by Halko et al. for matrices with a slowly decaying spectrum.
+	 */
+	const integer Oversampling = 10, PowerIterations = 2;
+
+	/**
+	 * c = alpha op(a) op(b) + beta c, with column-major matrices.
+	 */
+	void multiply(char transA, char transB, integer m, integer n, integer k, double alpha, const doublecomplex* a, integer lda, const doublecomplex* b, integer ldb, double beta, doublecomplex* c, integer ldc)
+	{
+		doublecomplex complexAlpha = { alpha, 0.0 }, complexBeta = { beta, 0.0 };
+		zgemm_(&transA, &transB, &m, &n, &k, &complexAlpha, const_cast<doublecomplex*>(a), &lda, const_cast<doublecomplex*>(b), &ldb, &complexBeta, c, &ldc);
+	}
+
+	/**
+	 * Replaces the columns of the (rows x cols) matrix a by an orthonormal basis
+	 * for them, using a QR decomposition.
+	 */
+	void orthonormalize(std::vector<doublecomplex>& a, integer rows, integer cols)
+	{
+		std::vector<doublecomplex> tau(cols);
+		integer info = 0, workSize = -1;
+		doublecomplex optimalWorkSize;
+		zgeqrf_(&rows, &cols, a.data(), &rows, tau.data(), &optimalWorkSize, &workSize, &info);
+		std::vector<doublecomplex> work(std::max<integer>(1, optimalWorkSize.r));
+		workSize = work.size();
+		zgeqrf_(&rows, &cols, a.data(), &rows, tau.data(), work.data(), &workSize, &info);
+		if(info == 0)
+		{
+			workSize = -1;
+			zungqr_(&rows, &cols, &cols, a.data(), &rows, tau.data(), &optimalWorkSize, &workSize, &info);
+			work.resize(std::max<integer>(1, optimalWorkSize.r));
+			workSize = work.size();
+			zungqr_(&rows, &cols, &cols, a.data(), &rows, tau.data(), work.data(), &workSize, &info);
+		}
+		if(info != 0)
+			throw std::runtime_error("QR decomposition failed in SVD mitigater");
+	}
 }
 
-SVDMitigater::SVDMitigater() : _background(0), _singularValues(0), _leftSingularVectors(0), _rightSingularVectors(0), _m(0), _n(0), _iteration(0), _removeCount(10),  _verbose(false)
+SVDMitigater::SVDMitigater() : _background(0), _m(0), _n(0), _iteration(0), _removeCount(10),  _verbose(false), _randomized(false), _timeBlockSize(0)
 {
 }
 
@@ -25,125 +79,206 @@ SVDMitigater::~SVDMitigater()
 
 void SVDMitigater::Clear()
 {
-	if(IsDecomposed()) {
-		delete[] _singularValues;
-		delete[] _leftSingularVectors;
-		delete[] _rightSingularVectors;
-		_singularValues = 0;
-		_leftSingularVectors = 0;
-		_rightSingularVectors = 0;
-	}
+	_singularValues.clear();
 	if(_background != 0)
+	{
 		delete _background;
+		_background = 0;
+	}
 }
 
-// lda = leading dimension
-
-/*int cgebrd_(integer *m, integer *n, complex *a, integer *lda,
-         real *d__, real *e, complex *tauq, complex *taup, complex *work,
-        integer *lwork, integer *info);*/
-
-void SVDMitigater::Decompose()
+/**
+ * Returns the data as a column-major (frequency x time) matrix, i.e., time is
+ * along the horizontal axis and the values of a timestep are consecutive.
+ */
+std::vector<doublecomplex> SVDMitigater::getMatrix() const
 {
-	if(_verbose)
-		std::cout << "Decomposing..." << std::endl;
-	Stopwatch watch;
-	watch.Start();
-	Clear();
-
-	// Remember that the axes have to be turned; in 'a', time is along the vertical axis.
-	_m = _data.ImageHeight();
-	_n = _data.ImageWidth();
-	int minmn = _m<_n ? _m : _n;
-	char rowsOfU = 'A'; // all rows of u
-	char rowsOfVT = 'A'; // all rows of VT
-	doublecomplex *a = new doublecomplex[_m * _n];
+	const size_t m = _data.ImageHeight(), n = _data.ImageWidth();
+	std::vector<doublecomplex> a(m * n);
 	Image2DCPtr
 		real = _data.GetRealPart(),
 		imaginary = _data.GetImaginaryPart();
-	for(int t=0;t<_n;++t) {
-		for(int f=0;f<_m; ++f) {
-			a[t*_m + f].r = real->Value(t, f);
-			a[t*_m + f].i = imaginary->Value(t, f);
+	for(size_t f=0;f<m; ++f) {
+		const num_t
+			*realPtr = real->ValuePtr(0, f),
+			*imaginaryPtr = imaginary->ValuePtr(0, f);
+		for(size_t t=0;t<n;++t) {
+			a[t*m + f].r = realPtr[t];
+			a[t*m + f].i = imaginaryPtr[t];
 		}
 	}
-	long int lda = _m;
-	_singularValues = new double[minmn];
-	for(int i=0;i<minmn;++i)
-		_singularValues[i] = 0.0;
-	_leftSingularVectors = new doublecomplex[_m*_m];
-	for(int i=0;i<_m*_m;++i) {
-		_leftSingularVectors[i].r = 0.0;
-		_leftSingularVectors[i].i = 0.0;
-	}
-	_rightSingularVectors = new doublecomplex[_n*_n];
-	for(int i=0;i<_n*_n;++i) {
-		_rightSingularVectors[i].r = 0.0;
-		_rightSingularVectors[i].i = 0.0;
-	}
-	long int info = 0;
-	doublecomplex complexWorkAreaSize;
-	long int workAreaSize = -1;
-	double *workArea2 = new double[5 * minmn];
-
-	// Determine optimal workareasize
-	zgesvd_(&rowsOfU, &rowsOfVT, &_m, &_n, a, &lda, _singularValues, _leftSingularVectors, &_m, _rightSingularVectors, &_n, &complexWorkAreaSize, &workAreaSize, workArea2, &info);
+	return a;
+}
 
+/**
+ * Only calculates the singular values of the full matrix.
+ */
+void SVDMitigater::Decompose()
+{
+	Clear();
+	_m = _data.ImageHeight();
+	_n = _data.ImageWidth();
+	std::vector<doublecomplex> a = getMatrix();
+	integer minmn = std::min(_m, _n), info = 0, workAreaSize = -1;
+	char noVectors = 'N';
+	_singularValues.assign(1, std::vector<double>(minmn, 0.0));
+	std::vector<double>& singularValues = _singularValues.front();
+	std::vector<double> realWorkArea(5 * minmn);
+	doublecomplex complexWorkAreaSize, unused;
+	integer one = 1;
+	zgesvd_(&noVectors, &noVectors, &_m, &_n, a.data(), &_m, singularValues.data(), &unused, &one, &unused, &one, &complexWorkAreaSize, &workAreaSize, realWorkArea.data(), &info);
 	if(info == 0)
 	{
-		if(_verbose)
-			std::cout << "zgesvd_..." << std::endl;
-		workAreaSize = (int) complexWorkAreaSize.r;
-		doublecomplex *workArea1 = new doublecomplex[workAreaSize];
-		zgesvd_(&rowsOfU, &rowsOfVT, &_m, &_n, a, &lda, _singularValues, _leftSingularVectors, &_m, _rightSingularVectors, &_n, workArea1, &workAreaSize, workArea2, &info);
-
-		delete[] workArea1;
-	}
-	delete[] workArea2;
-	delete[] a;
-
-	if(_verbose) {
-		for(int i=0;i<minmn;++i)
-			std::cout << _singularValues[i] << ",";
-		std::cout << std::endl;
-		std::cout << watch.ToString() << std::endl;
+		std::vector<doublecomplex> workArea(std::max<integer>(1, complexWorkAreaSize.r));
+		workAreaSize = workArea.size();
+		zgesvd_(&noVectors, &noVectors, &_m, &_n, a.data(), &_m, singularValues.data(), &unused, &one, &unused, &one, workArea.data(), &workAreaSize, realWorkArea.data(), &info);
 	}
 }
 
-void SVDMitigater::Compose()
+void SVDMitigater::RemoveSingularValues(unsigned singularValueCount)
 {
 	if(_verbose)
-		std::cout << "Composing..." << std::endl;
+		std::cout << "Decomposing..." << std::endl;
 	Stopwatch watch;
 	watch.Start();
+	Clear();
+	_m = _data.ImageHeight();
+	_n = _data.ImageWidth();
+	std::vector<doublecomplex> a = getMatrix();
+	
+	const integer blockSize = (_timeBlockSize == 0 || integer(_timeBlockSize) > _n) ? _n : integer(_timeBlockSize);
+	_singularValues.resize((_n + blockSize - 1) / blockSize);
+	for(integer t=0; t<_n; t+=blockSize)
+		removeComponents(&a[t*_m], std::min(blockSize, _n - t), singularValueCount, _singularValues[t / blockSize]);
+	
 	Image2DPtr real = Image2D::CreateUnsetImagePtr(_data.ImageWidth(), _data.ImageHeight());
 	Image2DPtr imaginary = Image2D::CreateUnsetImagePtr(_data.ImageWidth(), _data.ImageHeight());
-	int minmn = _m<_n ? _m : _n;
-	for(int t=0;t<_n;++t) {
-		for(int f=0;f<_m; ++f) {
-			double a_tf_r = 0.0;
-			double a_tf_i = 0.0;
-			// A = U S V^T , so:
-			// a_tf = \sum_{g=0}^{minmn} U_{gf} S_{gg} V^T_{tg}
-			// Note that _rightSingularVectors=V^T, thus is already stored rowwise
-			for(int g=0;g<minmn;++g) {
-				double u_r = _leftSingularVectors[g*_m + f].r;
-				double u_i = _leftSingularVectors[g*_m + f].i;
-				double s = _singularValues[g];
-				double v_r = _rightSingularVectors[t*_n + g].r;
-				double v_i = _rightSingularVectors[t*_n + g].i;
-				a_tf_r += s * (u_r * v_r - u_i * v_i);
-				a_tf_i += s * (u_r * v_i + u_i * v_r);
-			}
-			real->SetValue(t, f, a_tf_r);
-			imaginary->SetValue(t, f, a_tf_i);
+	for(integer f=0;f<_m; ++f) {
+		num_t
+			*realPtr = real->ValuePtr(0, f),
+			*imaginaryPtr = imaginary->ValuePtr(0, f);
+		for(integer t=0;t<_n;++t) {
+			realPtr[t] = a[t*_m + f].r;
+			imaginaryPtr[t] = a[t*_m + f].i;
 		}
 	}
-	if(_background != 0)
-		delete _background;
 	_background = new TimeFrequencyData(Polarization::StokesI, real, imaginary);
-	if(_verbose)
+	
+	if(_verbose) {
+		for(const std::vector<double>& blockValues : _singularValues)
+		{
+			for(double value : blockValues)
+				std::cout << value << ",";
+			std::cout << std::endl;
+		}
 		std::cout << watch.ToString() << std::endl;
+	}
+}
+
+/**
+ * Subtracts the strongest components of the (_m x n) block of timesteps
+ * from the block: a = a - U_k S_k V^T_k.
+ */
+void SVDMitigater::removeComponents(doublecomplex* a, integer n, unsigned count, std::vector<double>& singularValues)
+{
+	const integer rank = std::min<integer>(count, std::min(_m, n));
+	if(rank == 0)
+		return;
+	
+	std::vector<doublecomplex> u, vt;
+	integer ldvt;
+	// The projection only pays off when the subspace is much smaller than the matrix
+	if(_randomized && (rank + Oversampling) * 2 < std::min(_m, n))
+		decomposeRandomized(a, n, rank + Oversampling, singularValues, u, vt, ldvt);
+	else
+		decomposeFully(a, n, singularValues, u, vt, ldvt);
+	
+	for(integer g=0; g!=rank; ++g)
+	{
+		for(integer f=0; f!=_m; ++f)
+		{
+			u[g*_m + f].r *= singularValues[g];
+			u[g*_m + f].i *= singularValues[g];
+		}
+	}
+	multiply('N', 'N', _m, n, rank, -1.0, u.data(), _m, vt.data(), ldvt, 1.0, a, _m);
+}
+
+void SVDMitigater::decomposeFully(const doublecomplex* a, integer n, std::vector<double>& singularValues, std::vector<doublecomplex>& u, std::vector<doublecomplex>& vt, integer& ldvt)
+{
+	// zgesvd overwrites its input
+	std::vector<doublecomplex> input(a, a + _m * n);
+	integer minmn = std::min(_m, n), info = 0, workAreaSize = -1;
+	char someVectors = 'S'; // only the first min(m,n) vectors
+	singularValues.assign(minmn, 0.0);
+	u.resize(_m * minmn);
+	vt.resize(minmn * n);
+	ldvt = minmn;
+	std::vector<double> realWorkArea(5 * minmn);
+	doublecomplex complexWorkAreaSize;
+	zgesvd_(&someVectors, &someVectors, &_m, &n, input.data(), &_m, singularValues.data(), u.data(), &_m, vt.data(), &ldvt, &complexWorkAreaSize, &workAreaSize, realWorkArea.data(), &info);
+	if(info == 0)
+	{
+		std::vector<doublecomplex> workArea(std::max<integer>(1, complexWorkAreaSize.r));
+		workAreaSize = workArea.size();
+		zgesvd_(&someVectors, &someVectors, &_m, &n, input.data(), &_m, singularValues.data(), u.data(), &_m, vt.data(), &ldvt, workArea.data(), &workAreaSize, realWorkArea.data(), &info);
+	}
+	if(info != 0)
+		throw std::runtime_error("Singular value decomposition did not converge");
+}
+
+/**
+ * Approximates the @p sampleCount strongest components of the (_m x n) matrix a.
+ * The range of a is sampled with a random matrix and refined with power
+ * iterations, after which the small projected matrix Q^H a is decomposed.
+ */
+void SVDMitigater::decomposeRandomized(const doublecomplex* a, integer n, integer sampleCount, std::vector<double>& singularValues, std::vector<doublecomplex>& u, std::vector<doublecomplex>& vt, integer& ldvt)
+{
+	const integer l = sampleCount;
+	std::mt19937 rng(_iteration);
+	std::normal_distribution<double> gaussian;
+	std::vector<doublecomplex> omega(n * l);
+	for(doublecomplex& value : omega)
+	{
+		value.r = gaussian(rng);
+		value.i = gaussian(rng);
+	}
+	
+	// q = orth(a omega), refined by q = orth(a orth(a^H q))
+	std::vector<doublecomplex> q(_m * l), z(n * l);
+	multiply('N', 'N', _m, l, n, 1.0, a, _m, omega.data(), n, 0.0, q.data(), _m);
+	orthonormalize(q, _m, l);
+	for(integer i=0; i!=PowerIterations; ++i)
+	{
+		multiply('C', 'N', n, l, _m, 1.0, a, _m, q.data(), _m, 0.0, z.data(), n);
+		orthonormalize(z, n, l);
+		multiply('N', 'N', _m, l, n, 1.0, a, _m, z.data(), n, 0.0, q.data(), _m);
+		orthonormalize(q, _m, l);
+	}
+	
+	// b = q^H a is (l x n); its decomposition gives the right vectors directly
+	std::vector<doublecomplex> b(l * n), ub(l * l);
+	multiply('C', 'N', l, n, _m, 1.0, q.data(), _m, a, _m, 0.0, b.data(), l);
+	integer info = 0, workAreaSize = -1, ldb = l;
+	char someVectors = 'S';
+	singularValues.assign(l, 0.0);
+	vt.resize(l * n);
+	ldvt = l;
+	std::vector<double> realWorkArea(5 * l);
+	doublecomplex complexWorkAreaSize;
+	zgesvd_(&someVectors, &someVectors, &ldb, &n, b.data(), &ldb, singularValues.data(), ub.data(), &ldb, vt.data(), &ldvt, &complexWorkAreaSize, &workAreaSize, realWorkArea.data(), &info);
+	if(info == 0)
+	{
+		std::vector<doublecomplex> workArea(std::max<integer>(1, complexWorkAreaSize.r));
+		workAreaSize = workArea.size();
+		zgesvd_(&someVectors, &someVectors, &ldb, &n, b.data(), &ldb, singularValues.data(), ub.data(), &ldb, vt.data(), &ldvt, workArea.data(), &workAreaSize, realWorkArea.data(), &info);
+	}
+	if(info != 0)
+		throw std::runtime_error("Singular value decomposition did not converge");
+	
+	// The left vectors are q ub
+	u.resize(_m * l);
+	multiply('N', 'N', _m, l, l, 1.0, q.data(), _m, ub.data(), l, 0.0, u.data(), _m);
 }
 
 
@@ -160,7 +295,7 @@ void SVDMitigater::CreateSingularValueGraph(const TimeFrequencyData& data, Plot2
 		SVDMitigater svd;
 		svd.Initialize(polarizationData);
 		svd.Decompose();
-		size_t minmn = svd._m<svd._n ? svd._m : svd._n;
+		size_t minmn = svd._singularValues.front().size();
 		
 		Plot2DPointSet &pointSet = plot.StartLine(polarizationData.Description());
 		pointSet.SetXDesc("Singular value index");
@@ -2,6 +2,7 @@
 #define SVDMITIGATER_H
 
 #include <iostream>
+#include <vector>
 
 #include "../../structures/image2d.h"
 
@@ -10,6 +11,17 @@
 // Needs to be included LAST
 #include "../../f2c.h"
 
+/**
+ * Removes the strongest components of a time-frequency matrix, as found
+ * by a singular value decomposition. The background is the data minus the
+ * removed components.
+ *
+ * Only the removed components are needed. With the randomized method, only
+ * these are computed, by decomposing a projection of the matrix on a small
+ * random subspace (Halko, Martinsson & Tropp 2011). The background is
+ * constructed with a single matrix multiplication. Optionally, the
+ * matrix is split into blocks of timesteps that are decomposed separately.
+ */
 class SVDMitigater final : public SurfaceFitMethod {
 	public:
 		SVDMitigater();
@@ -30,14 +42,7 @@ class SVDMitigater final : public SurfaceFitMethod {
 			PerformFit();
 		}
 
-		void RemoveSingularValues(unsigned singularValueCount)
-		{
-			if(!IsDecomposed())
-				Decompose();
-			for(unsigned i=0;i<singularValueCount;++i)
-				SetSingularValue(i, 0.0);
-			Compose();
-		}
+		void RemoveSingularValues(unsigned singularValueCount);
 
 		TimeFrequencyData Background() const
 		{
@@ -49,26 +54,53 @@ class SVDMitigater final : public SurfaceFitMethod {
 			return TimeFrequencyData::ComplexParts;
 		}
 
-		bool IsDecomposed() const throw() { return _singularValues != 0 ; }
-		double SingularValue(unsigned index) const throw() { return _singularValues[index]; }
+		bool IsDecomposed() const throw() { return !_singularValues.empty(); }
+
+		/**
+		 * Number of blocks of timesteps that were decomposed separately; one
+		 * unless a time block size is set.
+		 */
+		size_t BlockCount() const throw() { return _singularValues.size(); }
+
+		/**
+		 * Returns a singular value of the given block of timesteps. Only the
+		 * values of the removed components are known with the randomized method.
+		 */
+		double SingularValue(unsigned index, size_t block = 0) const throw() { return _singularValues[block][index]; }
 		void SetRemoveCount(unsigned removeCount) throw() { _removeCount = removeCount; }
 		void SetVerbose(bool verbose) throw() { _verbose = verbose; }
+
+		/**
+		 * Compute only the removed components with a randomized decomposition,
+		 * instead of performing a full decomposition.
+		 */
+		void SetRandomized(bool randomized) throw() { _randomized = randomized; }
+
+		/**
+		 * Decompose blocks of the given number of timesteps separately. Zero
+		 * means that the full matrix is decomposed.
+		 */
+		void SetTimeBlockSize(size_t timeBlockSize) throw() { _timeBlockSize = timeBlockSize; }
+
 		static void CreateSingularValueGraph(const TimeFrequencyData &data, class Plot2D &plot);
 	private:
 		void Clear();
 		void Decompose();
-		void Compose();
-		void SetSingularValue(unsigned index, double newValue) throw() { _singularValues[index] = newValue; }
+		std::vector<doublecomplex> getMatrix() const;
+		void removeComponents(doublecomplex* a, integer n, unsigned count, std::vector<double>& singularValues);
+		void decomposeFully(const doublecomplex* a, integer n, std::vector<double>& singularValues, std::vector<doublecomplex>& u, std::vector<doublecomplex>& vt, integer& ldvt);
+		void decomposeRandomized(const doublecomplex* a, integer n, integer rank, std::vector<double>& singularValues, std::vector<doublecomplex>& u, std::vector<doublecomplex>& vt, integer& ldvt);
 
 		TimeFrequencyData _data;
 		TimeFrequencyData *_background;
-		double *_singularValues;
-		doublecomplex *_leftSingularVectors;
-		doublecomplex *_rightSingularVectors;
+		// For each block of timesteps, the singular values of that block
+		std::vector<std::vector<double>> _singularValues;
 		long int _m, _n;
 		unsigned _iteration;
 		unsigned _removeCount;
 		bool _verbose;
+		bool _randomized;
+		size_t _timeBlockSize;
 };
 
 #endif
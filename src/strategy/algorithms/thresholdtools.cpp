@@ -5,9 +5,48 @@
 #include <boost/numeric/conversion/bounds.hpp>
 
 #include "../../util/rng.h"
+#include "../../util/scratcharena.h"
 
 #include "thresholdtools.h"
 
+namespace {
+	/**
+	 * Finds the values that would be at positions lowIndex and highIndex if the
+	 * data were sorted, in linear time. The data is partially reordered.
+	 */
+	template<typename T, typename LessThan>
+	void selectTwo(T* data, size_t count, size_t lowIndex, size_t highIndex, LessThan lessThan, T& lowValue, T& highValue)
+	{
+		std::nth_element(data, data + lowIndex, data + count, lessThan);
+		lowValue = data[lowIndex];
+		std::nth_element(data, data + highIndex, data + count, lessThan);
+		highValue = data[highIndex];
+	}
+
+	/**
+	 * Copies all finite values that are not flagged to the data buffer, and
+	 * returns the number of copied values.
+	 */
+	template<typename IsFlagged>
+	size_t gatherUnflagged(const Image2D* image, num_t* data, IsFlagged isFlagged)
+	{
+		size_t unflaggedCount = 0;
+		for(size_t y=0;y<image->Height();++y)
+		{
+			const num_t* row = image->ValuePtr(0, y);
+			for(size_t x=0;x<image->Width();++x)
+			{
+				if(!isFlagged(x, y) && std::isfinite(row[x]))
+				{
+					data[unflaggedCount] = row[x];
+					++unflaggedCount;
+				}
+			}
+		}
+		return unflaggedCount;
+	}
+}
+
 void ThresholdTools::MeanAndStdDev(const Image2D* image, const Mask2D* mask, num_t &mean, num_t &stddev)
 {
 	// Calculate mean
@@ -41,14 +80,14 @@ void ThresholdTools::MeanAndStdDev(const Image2D* image, const Mask2D* mask, num
 void ThresholdTools::WinsorizedMeanAndStdDev(const Image2D* image, num_t &mean, num_t &stddev)
 {
 	size_t size = image->Width() * image->Height();
-	num_t *data = new num_t[size];
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	num_t *data = arena.Allocate<num_t>(size);
 	image->CopyData(data);
-	std::sort(data, data + size, numLessThanOperator);
 	size_t lowIndex = (size_t) floor(0.1 * size);
 	size_t highIndex = (size_t) ceil(0.9 * size)-1;
-	num_t lowValue = data[lowIndex];
-	num_t highValue = data[highIndex];
-	delete[] data;
+	num_t lowValue, highValue;
+	selectTwo(data, size, lowIndex, highIndex, numLessThanOperator, lowValue, highValue);
 
 	// Calculate mean
 	mean = 0.0;
@@ -107,18 +146,20 @@ void ThresholdTools::TrimmedMeanAndStdDev(const std::vector<T> &input, T &mean,
 			stddev = 0.0;
 			return;
 		}
-	std::vector<T> data(input);
-	std::sort(data.begin(), data.end(), numLessThanOperator);
-	size_t lowIndex = (size_t) floor(0.25 * data.size());
-	size_t highIndex = (size_t) ceil(0.75 * data.size())-1;
-	T lowValue = data[lowIndex];
-	T highValue = data[highIndex];
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	T* data = arena.Allocate<T>(input.size());
+	std::copy(input.begin(), input.end(), data);
+	size_t lowIndex = (size_t) floor(0.25 * input.size());
+	size_t highIndex = (size_t) ceil(0.75 * input.size())-1;
+	T lowValue, highValue;
+	selectTwo(data, input.size(), lowIndex, highIndex, numLessThanOperator, lowValue, highValue);
 
 	// Calculate mean
 	mean = 0.0;
 	size_t count = 0;
-	for(typename std::vector<T>::const_iterator i=data.begin();
-		i!=data.end();++i) {
+	for(typename std::vector<T>::const_iterator i=input.begin();
+		i!=input.end();++i) {
 		if(std::isfinite(*i) && *i > lowValue && *i < highValue)
 		{
 			mean += *i;
@@ -130,7 +171,7 @@ void ThresholdTools::TrimmedMeanAndStdDev(const std::vector<T> &input, T &mean,
 	// Calculate variance
 	stddev = 0.0;
 	count = 0;
-	for(typename std::vector<T>::const_iterator i=data.begin();i!=data.end();++i) {
+	for(typename std::vector<T>::const_iterator i=input.begin();i!=input.end();++i) {
 		if(std::isfinite(*i) && *i >= lowValue && *i <= highValue)
 		{
 			stddev += (*i-mean)*(*i-mean);
@@ -154,18 +195,20 @@ void ThresholdTools::WinsorizedMeanAndStdDev(const std::vector<T> &input, T &mea
 		mean = 0.0;
 		stddev = 0.0;
 	} else {
-		std::vector<T> data(input);
-		std::sort(data.begin(), data.end(), numLessThanOperator);
-		size_t lowIndex = (size_t) floor(0.1 * data.size());
-		size_t highIndex = (size_t) ceil(0.9 * data.size())-1;
-		T lowValue = data[lowIndex];
-		T highValue = data[highIndex];
+		ScratchArena& arena = ScratchArena::ForCurrentThread();
+		ScratchArena::Scope scope(arena);
+		T* data = arena.Allocate<T>(input.size());
+		std::copy(input.begin(), input.end(), data);
+		size_t lowIndex = (size_t) floor(0.1 * input.size());
+		size_t highIndex = (size_t) ceil(0.9 * input.size())-1;
+		T lowValue, highValue;
+		selectTwo(data, input.size(), lowIndex, highIndex, numLessThanOperator, lowValue, highValue);
 
 		// Calculate mean
 		mean = 0.0;
 		size_t count = 0;
-		for(typename std::vector<T>::const_iterator i=data.begin();
-			i!=data.end();++i) {
+		for(typename std::vector<T>::const_iterator i=input.begin();
+			i!=input.end();++i) {
 			if(std::isfinite(*i)) {
 				if(*i < lowValue)
 					mean += lowValue;
@@ -181,7 +224,7 @@ void ThresholdTools::WinsorizedMeanAndStdDev(const std::vector<T> &input, T &mea
 		// Calculate variance
 		stddev = 0.0;
 		count = 0;
-		for(typename std::vector<T>::const_iterator i=data.begin();i!=data.end();++i) {
+		for(typename std::vector<T>::const_iterator i=input.begin();i!=input.end();++i) {
 			if(std::isfinite(*i)) {
 				if(*i < lowValue)
 					stddev += (lowValue-mean)*(lowValue-mean);
@@ -204,27 +247,16 @@ template void ThresholdTools::WinsorizedMeanAndStdDev(const std::vector<double>
 
 void ThresholdTools::WinsorizedMeanAndStdDev(const Image2D* image, const Mask2D* mask, num_t &mean, num_t &stddev)
 {
-	num_t *data = new num_t[image->Width() * image->Height()];
-	size_t unflaggedCount = 0;
-	for(size_t y=0;y<image->Height();++y)
-	{
-		for(size_t x=0;x<image->Width();++x)
-		{
-			num_t val = image->Value(x, y);
-			if(!mask->Value(x, y) && std::isfinite(val))
-			{
-				data[unflaggedCount] = image->Value(x, y);
-				++unflaggedCount;
-			}
-		}
-	}
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	num_t *data = arena.Allocate<num_t>(image->Width() * image->Height());
+	size_t unflaggedCount = gatherUnflagged(image, data,
+		[mask](size_t x, size_t y) { return mask->Value(x, y); });
 	size_t lowIndex = (size_t) floor(0.1 * unflaggedCount);
 	size_t highIndex = (size_t) ceil(0.9 * unflaggedCount);
 	if(highIndex > 0) --highIndex;
-	std::nth_element(data, data + lowIndex, data + unflaggedCount, numLessThanOperator);
-	num_t lowValue = data[lowIndex];
-	std::nth_element(data, data + highIndex, data + unflaggedCount, numLessThanOperator);
-	num_t highValue = data[highIndex];
+	num_t lowValue, highValue;
+	selectTwo(data, unflaggedCount, lowIndex, highIndex, numLessThanOperator, lowValue, highValue);
 
 	// Calculate mean
 	mean = 0.0;
@@ -250,7 +282,6 @@ void ThresholdTools::WinsorizedMeanAndStdDev(const Image2D* image, const Mask2D*
 		else
 			stddev += (value-mean)*(value-mean);
 	}
-	delete[] data;
 	if(unflaggedCount > 0)
 		stddev = sqrtn(1.54 * stddev / (num_t) unflaggedCount);
 	else
@@ -259,27 +290,16 @@ void ThresholdTools::WinsorizedMeanAndStdDev(const Image2D* image, const Mask2D*
 
 void ThresholdTools::WinsorizedMeanAndStdDev(const Image2D* image, const Mask2D* maskA, const Mask2D* maskB, num_t &mean, num_t &stddev)
 {
-	std::unique_ptr<num_t[]> data(new num_t[image->Width() * image->Height()]);
-	size_t unflaggedCount = 0;
-	for(size_t y=0;y<image->Height();++y)
-	{
-		for(size_t x=0;x<image->Width();++x)
-		{
-			num_t val = image->Value(x, y);
-			if(!maskA->Value(x, y) && !maskB->Value(x, y) && std::isfinite(val))
-			{
-				data[unflaggedCount] = image->Value(x, y);
-				++unflaggedCount;
-			}
-		}
-	}
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	num_t *data = arena.Allocate<num_t>(image->Width() * image->Height());
+	size_t unflaggedCount = gatherUnflagged(image, data,
+		[maskA, maskB](size_t x, size_t y) { return maskA->Value(x, y) || maskB->Value(x, y); });
 	size_t lowIndex = (size_t) floor(0.1 * unflaggedCount);
 	size_t highIndex = (size_t) ceil(0.9 * unflaggedCount);
 	if(highIndex > 0) --highIndex;
-	std::nth_element(data.get(), data.get() + lowIndex, data.get() + unflaggedCount, numLessThanOperator);
-	num_t lowValue = data[lowIndex];
-	std::nth_element(data.get(), data.get() + highIndex, data.get() + unflaggedCount, numLessThanOperator);
-	num_t highValue = data[highIndex];
+	num_t lowValue, highValue;
+	selectTwo(data, unflaggedCount, lowIndex, highIndex, numLessThanOperator, lowValue, highValue);
 
 	// Calculate mean
 	mean = 0.0;
@@ -318,17 +338,19 @@ double ThresholdTools::WinsorizedRMS(const std::vector<std::complex<T>> &input)
 	{
 		return 0.0;
 	} else {
-		std::vector<std::complex<T>> data(input);
-		std::sort(data.begin(), data.end(), complexLessThanOperator<T>);
-		size_t lowIndex = (size_t) floor(0.1 * data.size());
-		size_t highIndex = (size_t) ceil(0.9 * data.size())-1;
-		std::complex<T> lowValue = data[lowIndex];
-		std::complex<T> highValue = data[highIndex];
+		ScratchArena& arena = ScratchArena::ForCurrentThread();
+		ScratchArena::Scope scope(arena);
+		std::complex<T>* data = arena.Allocate<std::complex<T>>(input.size());
+		std::copy(input.begin(), input.end(), data);
+		size_t lowIndex = (size_t) floor(0.1 * input.size());
+		size_t highIndex = (size_t) ceil(0.9 * input.size())-1;
+		std::complex<T> lowValue, highValue;
+		selectTwo(data, input.size(), lowIndex, highIndex, complexLessThanOperator<T>, lowValue, highValue);
 
 		// Calculate RMS
 		double rms = 0.0;
 		size_t count = 0;
-		for(const std::complex<T>& val : data) {
+		for(const std::complex<T>& val : input) {
 			if(std::isfinite(val.real()) && std::isfinite(val.imag())) {
 				if(complexLessThanOperator<T>(val, lowValue))
 					rms += (lowValue*std::conj(lowValue)).real();
@@ -526,20 +548,11 @@ numl_t ThresholdTools::RMS(const Image2D* image, const Mask2D* mask)
 
 num_t ThresholdTools::WinsorizedMode(const Image2D* image, const Mask2D* mask)
 {
-	num_t *data = new num_t[image->Width() * image->Height()];
-	size_t unflaggedCount = 0;
-	for(size_t y=0;y<image->Height();++y)
-	{
-		for(size_t x=0;x<image->Width();++x)
-		{
-			num_t val = image->Value(x, y);
-			if(!mask->Value(x, y) && std::isfinite(val))
-			{
-				data[unflaggedCount] = val;
-				++unflaggedCount;
-			}
-		}
-	}
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	num_t *data = arena.Allocate<num_t>(image->Width() * image->Height());
+	size_t unflaggedCount = gatherUnflagged(image, data,
+		[mask](size_t x, size_t y) { return mask->Value(x, y); });
 	size_t highIndex = (size_t) floor(0.9 * unflaggedCount);
 	std::nth_element(data, data + highIndex, data + unflaggedCount);
 	num_t highValue = data[highIndex];
@@ -552,7 +565,6 @@ num_t ThresholdTools::WinsorizedMode(const Image2D* image, const Mask2D* mask)
 		else
 			mode += value * value;
 	}
-	delete[] data;
 	// The correction factor 1.0541 was found by running simulations
 	// It corresponds with the correction factor needed when winsorizing 10% of the 
 	// data, meaning that the highest 10% is set to the value exactly at the
@@ -565,22 +577,13 @@ num_t ThresholdTools::WinsorizedMode(const Image2D* image, const Mask2D* mask)
 
 num_t ThresholdTools::WinsorizedMode(const Image2D* image, const Mask2D* maskA, const Mask2D* maskB)
 {
-	std::unique_ptr<num_t[]> data(new num_t[image->Width() * image->Height()]);
-	size_t unflaggedCount = 0;
-	for(size_t y=0;y<image->Height();++y)
-	{
-		for(size_t x=0;x<image->Width();++x)
-		{
-			num_t val = image->Value(x, y);
-			if(!maskA->Value(x, y) && !maskB->Value(x, y) && std::isfinite(val))
-			{
-				data[unflaggedCount] = val;
-				++unflaggedCount;
-			}
-		}
-	}
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	num_t *data = arena.Allocate<num_t>(image->Width() * image->Height());
+	size_t unflaggedCount = gatherUnflagged(image, data,
+		[maskA, maskB](size_t x, size_t y) { return maskA->Value(x, y) || maskB->Value(x, y); });
 	size_t highIndex = (size_t) floor(0.9 * unflaggedCount);
-	std::nth_element(data.get(), data.get() + highIndex, data.get() + unflaggedCount);
+	std::nth_element(data, data + highIndex, data + unflaggedCount);
 	num_t highValue = data[highIndex];
 	
 	num_t mode = 0.0;
@@ -600,12 +603,13 @@ num_t ThresholdTools::WinsorizedMode(const Image2D* image, const Mask2D* maskA,
 num_t ThresholdTools::WinsorizedMode(const Image2D* image)
 {
 	size_t size = image->Width() * image->Height();
-	num_t *data = new num_t[size];
+	ScratchArena& arena = ScratchArena::ForCurrentThread();
+	ScratchArena::Scope scope(arena);
+	num_t *data = arena.Allocate<num_t>(size);
 	image->CopyData(data);
-	std::sort(data, data + size, numLessThanOperator);
 	size_t highIndex = (size_t) ceil(0.9 * size)-1;
+	std::nth_element(data, data + highIndex, data + size, numLessThanOperator);
 	num_t highValue = data[highIndex];
-	delete[] data;
 
 	num_t mode = 0.0;
 	for(size_t y = 0;y<image->Height();++y) {
@@ -12,6 +12,8 @@
 
 #include "../../types.h"
 
+#include "../../util/scratcharena.h"
+
 #include "../algorithms/types.h"
 
 #include "../control/types.h"
@@ -74,6 +76,7 @@ namespace rfiStrategy {
 			TimeFrequencyData &ContaminatedData() { return _contaminatedData; }
 
 			void SetCanVisualize(bool canVisualize) { _canVisualize = canVisualize; }
+			bool CanVisualize() const { return _canVisualize; }
 			void AddVisualization(const std::string& label, const TimeFrequencyData& data, size_t sortingIndex)
 			{
 				if(_canVisualize)
@@ -137,6 +140,16 @@ namespace rfiStrategy {
 				return *_ioMutex;
 			}
 
+			/**
+			 * Memory for temporary buffers of the algorithms. Because actions might
+			 * run as sub-tasks on other threads, this is the arena of the calling
+			 * thread. The worker threads reset it after every baseline.
+			 */
+			ScratchArena& Scratch() const
+			{
+				return ScratchArena::ForCurrentThread();
+			}
+
 			bool HasAntennaFlagCountPlot() const { return _data->_antennaFlagCountPlot!=nullptr; }
 			class AntennaFlagCountPlot& AntennaFlagCountPlot()
 			{
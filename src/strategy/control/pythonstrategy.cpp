@@ -2,59 +2,80 @@
 
 #include "../../python/data.h"
 #include "../../python/functions.h"
+#include "../../python/gil.h"
 
 #include <boost/python.hpp>
 #include <boost/filesystem.hpp>
 
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
 
 using namespace boost::python;
 
-PythonStrategy::PythonStrategy() : _code(
-	"import aoflagger\n"
-	"\n"
-	"def flag(data):\n"
-	"  print(\'In flag() function\')\n"
-	"  processed_polarizations = data.polarizations()\n"
-	"  processed_representations = [ aoflagger.ComplexRepresentation.AmplitudePart ]\n"
-	"  \n"
-	"  for polarization in processed_polarizations:\n"
-	"    pol_data = data.convert_to_polarization(polarization)\n"
-	"    for representation in processed_representations:\n"
-	"      print(\'Flagging polarization \' + str(polarization) + \' (\' + str(representation) + \')\')\n"
-	"      repr_data = pol_data.convert_to_polarization(polarization)\n"
-	"      \n"
-	"      aoflagger.sumthreshold(repr_data, 1.0, 1.0, True, True)\n"
-	"\n"
-	"aoflagger.set_flag_function(flag)\n"
-	"\n"
-	"print(\'File parsed\')\n"
-	)
-{
-	std::ifstream file("strategy.py");
-	if(file.good())
-	{
-		file.seekg(0, std::ios::end);
-		size_t size = file.tellg();
-		std::vector<char> data(size+1, 0);
-		file.seekg(0, std::ios::beg);
-		file.read(data.data(), size);
-		_code = data.data();
-	}
+PythonStrategy::PythonStrategy() : PythonStrategy(readCode())
+{ }
 
+PythonStrategy::PythonStrategy(const std::string& code) : _code(code)
+{
 	Py_Initialize();
+#if PY_VERSION_HEX < 0x03070000
+	// Creates the interpreter lock, which Py_Initialize() does itself since
+	// Python 3.7
+	PyEval_InitThreads();
+#endif
 
 	// The following statement add the curr path to the Python search path
 	boost::filesystem::path workingDir = boost::filesystem::current_path().normalize();
 	PyObject* sysPath = PySys_GetObject(const_cast<char*>("path"));
 	PyList_Insert( sysPath, 0, PyUnicode_FromString(workingDir.string().c_str()));
+	
+	// Threads acquire the interpreter lock when they run Python code
+	_mainThreadState = PyEval_SaveThread();
 }
 
 PythonStrategy::~PythonStrategy()
 {
+	PyEval_RestoreThread(_mainThreadState);
+	_flagFunction.reset();
 	Py_Finalize();
 }
 
+std::string PythonStrategy::ReadFile(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if(!file.good())
+		throw std::runtime_error("Could not open Python strategy file '" + filename + "'");
+	std::ostringstream code;
+	code << file.rdbuf();
+	return code.str();
+}
+
+std::string PythonStrategy::readCode()
+{
+	if(boost::filesystem::exists("strategy.py"))
+		return ReadFile("strategy.py");
+	return
+		"import aoflagger\n"
+		"\n"
+		"def flag(data):\n"
+		"  print(\'In flag() function\')\n"
+		"  processed_polarizations = data.polarizations()\n"
+		"  processed_representations = [ aoflagger.ComplexRepresentation.AmplitudePart ]\n"
+		"  \n"
+		"  for polarization in processed_polarizations:\n"
+		"    pol_data = data.convert_to_polarization(polarization)\n"
+		"    for representation in processed_representations:\n"
+		"      print(\'Flagging polarization \' + str(polarization) + \' (\' + str(representation) + \')\')\n"
+		"      repr_data = pol_data.convert_to_polarization(polarization)\n"
+		"      \n"
+		"      aoflagger.sumthreshold(repr_data, 1.0, 1.0, True, True)\n"
+		"\n"
+		"aoflagger.set_flag_function(flag)\n"
+		"\n"
+		"print(\'File parsed\')\n";
+}
+
 std::string PythonStrategy::getPythonError()
 {
 	using namespace boost::python;
@@ -77,21 +98,43 @@ std::string PythonStrategy::getPythonError()
 	return extract<std::string>(formatted);
 }
 
-void PythonStrategy::Execute(TimeFrequencyData& tfData)
+object PythonStrategy::loadFlagFunction()
 {
-	try {
-		object main = import("__main__");
-		object global(main.attr("__dict__"));
-		object result = exec(_code.c_str(), global, global);
-		object flagFunction = aoflagger_python::get_flag_function();
+	object main = import("__main__");
+	object global(main.attr("__dict__"));
+	object result = exec(_code.c_str(), global, global);
+	object flagFunction = aoflagger_python::get_flag_function();
+	
+	if(flagFunction.is_none())
+		throw std::runtime_error("Incorrect Python strategy: strategy did not provide a flag method. Make sure your strategy uses aoflagger.set_flag_function() to provide the flag function to the caller");
+	return flagFunction;
+}
 
-		if(flagFunction.is_none())
-			throw std::runtime_error("Incorrect Python strategy: strategy did not provide a flag method. Make sure your strategy uses aoflagger.set_flag_function() to provide the flag function to the caller");
-		else {
-			aoflagger_python::Data data(tfData);
-			flagFunction(boost::ref(data));
-			tfData = data.TFData();
+object& PythonStrategy::flagFunction()
+{
+	// The mutex is taken before the interpreter lock, because running the
+	// script might release the interpreter lock to let other threads continue.
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	if(_flagFunction == nullptr)
+	{
+		aoflagger_python::AcquireGIL gil;
+		try {
+			_flagFunction.reset(new object(loadFlagFunction()));
+		} catch(const error_already_set&) {
+			throw std::runtime_error(getPythonError());
 		}
+	}
+	return *_flagFunction;
+}
+
+void PythonStrategy::Execute(TimeFrequencyData& tfData)
+{
+	object& function = flagFunction();
+	aoflagger_python::AcquireGIL gil;
+	try {
+		aoflagger_python::Data data(tfData);
+		function(boost::ref(data));
+		tfData = data.TFData();
 	} catch(const error_already_set&) {
 		throw std::runtime_error(getPythonError());
 	}
@@ -3,20 +3,53 @@
 
 #include "../../structures/timefrequencydata.h"
 
+#include <boost/python/object.hpp>
+
+#include <memory>
+#include <mutex>
 #include <string>
 
+/**
+ * Runs a strategy that is written in Python. The script should register
+ * its flag function with aoflagger.set_flag_function().
+ *
+ * The script is run once, when the first baseline is flagged, and its flag
+ * function is then called for every baseline. The global interpreter lock
+ * is only held while Python code runs. The aoflagger functions that the
+ * script calls release it while they compute, so Execute() can be called
+ * for different baselines from several threads at once, as the
+ * PythonAction in a ForEachBaselineAction does.
+ */
 class PythonStrategy
 {
 public:
+	/**
+	 * Runs the script in strategy.py in the current directory, or a default
+	 * script if there is no such file.
+	 */
 	PythonStrategy();
+	explicit PythonStrategy(const std::string& code);
 	~PythonStrategy();
 	
 	void Execute(TimeFrequencyData& tfData);
 	
+	/**
+	 * Returns the contents of a Python strategy file.
+	 */
+	static std::string ReadFile(const std::string& filename);
+	
 private:
+	static std::string readCode();
 	std::string getPythonError();
+	boost::python::object loadFlagFunction();
+	boost::python::object& flagFunction();
 	
 	std::string _code;
+	PyThreadState* _mainThreadState;
+	std::mutex _loadMutex;
+	// Python objects may only be copied and destructed while holding the
+	// interpreter lock, so the flag function is held by pointer.
+	std::unique_ptr<boost::python::object> _flagFunction;
 };
 
 #endif
@@ -576,6 +576,8 @@ std::unique_ptr<Action> StrategyReader::parseSVDAction(xmlNode* node)
 {
 	std::unique_ptr<SVDAction> newAction(new SVDAction());
 	newAction->SetSingularValueCount(getInt(node, "singular-value-count"));
+	newAction->SetRandomized(getBoolOr(node, "randomized", false));
+	newAction->SetTimeBlockSize(getIntOr(node, "time-block-size", 0));
 	return std::move(newAction);
 }
 
@@ -147,6 +147,7 @@ namespace rfiStrategy {
 				writeWriteFlagsAction(static_cast<const WriteFlagsAction&>(action));
 				break;
 			case ForEachSimulatedBaselineActionType:
+			case PythonActionType:
 			case ResamplingActionType:
 			case SaveHeatMapActionType:
 				throw std::runtime_error("Strategy contains an action for which saving is not supported");
@@ -396,6 +397,8 @@ namespace rfiStrategy {
 	{
 		Attribute("type", "SVDAction");
 		Write<int>("singular-value-count", action.SingularValueCount());
+		Write<bool>("randomized", action.Randomized());
+		Write<int>("time-block-size", action.TimeBlockSize());
 	}
 
 	void StrategyWriter::writeSumThresholdAction(const SumThresholdAction &action)
@@ -76,6 +76,10 @@ namespace rfiStrategy {
 		}
 		_reader->SetDataColumnName(_dataColumnName);
 		_reader->SetInterval(_intervalStart, _intervalEnd);
+		_reader->SetFlagWriteInterval(_flagWriteStart, _flagWriteEnd);
+		DirectBaselineReader* directReader = dynamic_cast<DirectBaselineReader*>(_reader.get());
+		if(directReader != nullptr && _readAheadSize)
+			directReader->SetReadAheadSize(_readAheadSize.get());
 		_reader->SetSubtractModel(_subtractModel);
 		_reader->SetReadFlags(_readFlags);
 		_reader->SetReadData(true);
@@ -53,6 +53,9 @@ public:
 		_dataColumnName("DATA"),
 		_intervalStart(),
 		_intervalEnd(),
+		_flagWriteStart(),
+		_flagWriteEnd(),
+		_readAheadSize(),
 		_subtractModel(false),
 		_readDipoleAutoPolarisations(true),
 		_readDipoleCrossPolarisations(true),
@@ -199,6 +202,25 @@ public:
 		if(end)
 			_metaData.SetIntervalEnd(end.get());
 	}
+	
+	/**
+	 * Only write flags for these timesteps; see
+	 * BaselineReader::SetFlagWriteInterval().
+	 */
+	void SetFlagWriteInterval(boost::optional<size_t> start, boost::optional<size_t> end)
+	{
+		_flagWriteStart = start;
+		_flagWriteEnd = end;
+	}
+	
+	/**
+	 * Memory for baselines that are read ahead in direct read mode; see
+	 * DirectBaselineReader::SetReadAheadSize().
+	 */
+	void SetReadAheadSize(boost::optional<size_t> readAheadSize)
+	{
+		_readAheadSize = readAheadSize;
+	}
 private:
 	friend class MSImageSetIndex;
 	MSImageSet(const std::string &location, BaselineReaderPtr reader) :
@@ -225,6 +247,8 @@ private:
 	BaselineReaderPtr _reader;
 	std::string _dataColumnName;
 	boost::optional<size_t> _intervalStart, _intervalEnd;
+	boost::optional<size_t> _flagWriteStart, _flagWriteEnd;
+	boost::optional<size_t> _readAheadSize;
 	bool _subtractModel;
 	bool _readDipoleAutoPolarisations, _readDipoleCrossPolarisations, _readStokesI;
 	std::vector<MSMetaData::Sequence> _sequences;
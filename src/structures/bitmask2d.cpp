@@ -0,0 +1,170 @@
+#include "bitmask2d.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	/**
+	 * Table that expands each possible byte to eight bools.
+	 */
+	struct ExpansionTable
+	{
+		ExpansionTable()
+		{
+			for(unsigned b=0; b!=256; ++b)
+			{
+				for(unsigned i=0; i!=8; ++i)
+					values[b][i] = ((b >> i) & 1) != 0;
+			}
+		}
+		bool values[256][8];
+	};
+
+	const ExpansionTable& expansionTable()
+	{
+		static const ExpansionTable table;
+		return table;
+	}
+
+	/**
+	 * Packs eight consecutive bools into the bits of a byte, where the first bool
+	 * goes to the least significant bit.
+	 */
+	inline unsigned char packEight(const bool* values)
+	{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		// Each byte is 0 or 1. The multiplication moves byte i to bit 56+i; none of
+		// the other partial products overlap, so no carries occur.
+		uint64_t eight;
+		memcpy(&eight, values, sizeof(eight));
+		return (eight * 0x0102040810204080ULL) >> 56;
+#else
+		unsigned char result = 0;
+		for(unsigned i=0; i!=8; ++i)
+			result |= (values[i] ? 1 : 0) << i;
+		return result;
+#endif
+	}
+
+	/**
+	 * row[i] |= row shifted by 'shift' bits towards higher x.
+	 */
+	void orShiftedUp(BitMask2D::Word* row, size_t wordCount, size_t shift)
+	{
+		const size_t wordShift = shift / BitMask2D::WordBits, bitShift = shift % BitMask2D::WordBits;
+		for(size_t i=wordCount; i>wordShift; --i)
+		{
+			const size_t dest = i - 1, src = dest - wordShift;
+			BitMask2D::Word value = row[src] << bitShift;
+			if(bitShift != 0 && src != 0)
+				value |= row[src - 1] >> (BitMask2D::WordBits - bitShift);
+			row[dest] |= value;
+		}
+	}
+
+	/**
+	 * row[i] |= row shifted by 'shift' bits towards lower x.
+	 */
+	void orShiftedDown(BitMask2D::Word* row, size_t wordCount, size_t shift)
+	{
+		const size_t wordShift = shift / BitMask2D::WordBits, bitShift = shift % BitMask2D::WordBits;
+		for(size_t dest=0; dest + wordShift < wordCount; ++dest)
+		{
+			const size_t src = dest + wordShift;
+			BitMask2D::Word value = row[src] >> bitShift;
+			if(bitShift != 0 && src + 1 < wordCount)
+				value |= row[src + 1] << (BitMask2D::WordBits - bitShift);
+			row[dest] |= value;
+		}
+	}
+}
+
+void BitMask2D::Pack(const bool* buffer, size_t stride)
+{
+	const size_t fullBytes = _width / 8;
+	for(size_t y=0; y!=_height; ++y)
+	{
+		const bool* values = &buffer[y * stride];
+		Word* row = Row(y);
+		std::fill(row, row + _wordsPerRow, Word(0));
+		for(size_t b=0; b!=fullBytes; ++b)
+			row[b / 8] |= Word(packEight(&values[b * 8])) << ((b % 8) * 8);
+		for(size_t x=fullBytes*8; x!=_width; ++x)
+		{
+			if(values[x])
+				row[x / WordBits] |= Word(1) << (x % WordBits);
+		}
+	}
+}
+
+void BitMask2D::Unpack(bool* buffer, size_t stride) const
+{
+	const ExpansionTable& table = expansionTable();
+	const size_t fullBytes = _width / 8;
+	for(size_t y=0; y!=_height; ++y)
+	{
+		bool* values = &buffer[y * stride];
+		const Word* row = Row(y);
+		for(size_t b=0; b!=fullBytes; ++b)
+		{
+			const unsigned char byte = row[b / 8] >> ((b % 8) * 8);
+			memcpy(&values[b * 8], table.values[byte], 8);
+		}
+		for(size_t x=fullBytes*8; x!=_width; ++x)
+			values[x] = (row[x / WordBits] >> (x % WordBits)) & 1;
+	}
+}
+
+void BitMask2D::Invert()
+{
+	if(_wordsPerRow == 0)
+		return;
+	const Word lastMask = lastWordMask();
+	for(size_t y=0; y!=_height; ++y)
+	{
+		Word* row = Row(y);
+		for(size_t i=0; i!=_wordsPerRow; ++i)
+			row[i] = ~row[i];
+		row[_wordsPerRow - 1] &= lastMask;
+	}
+}
+
+size_t BitMask2D::countTrue() const
+{
+	size_t count = 0;
+	for(Word word : _words)
+		count += __builtin_popcountll(word);
+	return count;
+}
+
+void BitMask2D::DilateHorizontally(size_t size)
+{
+	if(size == 0 || _wordsPerRow == 0)
+		return;
+	// A sample that is 'size' or more away can not reach the other side of the row
+	size = std::min(size, _width);
+	const Word lastMask = lastWordMask();
+	for(size_t y=0; y!=_height; ++y)
+	{
+		Word* row = Row(y);
+		// First spread all flags 'size' samples to the right: after each step,
+		// every flag has been spread over 'reach' samples, so the step size
+		// can be doubled.
+		size_t reach = 0;
+		while(reach < size)
+		{
+			const size_t step = std::min(reach + 1, size - reach);
+			orShiftedUp(row, _wordsPerRow, step);
+			reach += step;
+		}
+		row[_wordsPerRow - 1] &= lastMask;
+		// Then spread the result to the left.
+		reach = 0;
+		while(reach < size)
+		{
+			const size_t step = std::min(reach + 1, size - reach);
+			orShiftedDown(row, _wordsPerRow, step);
+			reach += step;
+		}
+	}
+}
@@ -0,0 +1,169 @@
+#ifndef BIT_MASK2D_H
+#define BIT_MASK2D_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mask2d.h"
+
+/**
+ * A two-dimensional flag mask that stores one bit per sample. Every row
+ * is stored as a whole number of 64-bit words, where bit (x % 64) of word
+ * (x / 64) holds the value of column x. Bits beyond the width of the mask are
+ * always zero.
+ *
+ * This class uses eight times less memory than a Mask2D, and performs
+ * logical operations, counting and horizontal dilation on 64 samples at a
+ * time. It is meant for flags that are kept around for a longer time, e.g.
+ * while they are waiting to be written, and for algorithms that benefit from
+ * word-parallel operations. Conversion from and to a Mask2D or a plain bool
+ * buffer is done eight samples at a time.
+ */
+class BitMask2D {
+	public:
+		typedef uint64_t Word;
+
+		enum { WordBits = 64 };
+
+		BitMask2D() : _width(0), _height(0), _wordsPerRow(0), _words()
+		{ }
+
+		/**
+		 * Construct a mask with all values set to false.
+		 */
+		BitMask2D(size_t width, size_t height) :
+			_width(width),
+			_height(height),
+			_wordsPerRow((width + WordBits - 1) / WordBits),
+			_words(_wordsPerRow * height, 0)
+		{ }
+
+		/**
+		 * Construct a packed copy of the given mask.
+		 */
+		explicit BitMask2D(const Mask2D& mask) : BitMask2D(mask.Width(), mask.Height())
+		{
+			Pack(mask.Data(), mask.Stride());
+		}
+
+		bool operator==(const BitMask2D& rhs) const
+		{
+			return _width == rhs._width && _height == rhs._height && _words == rhs._words;
+		}
+
+		bool operator!=(const BitMask2D& rhs) const { return !(*this == rhs); }
+
+		size_t Width() const { return _width; }
+
+		size_t Height() const { return _height; }
+
+		/**
+		 * Number of words that are used to store one row.
+		 */
+		size_t WordsPerRow() const { return _wordsPerRow; }
+
+		Word* Row(size_t y) { return &_words[y * _wordsPerRow]; }
+
+		const Word* Row(size_t y) const { return &_words[y * _wordsPerRow]; }
+
+		bool Value(size_t x, size_t y) const
+		{
+			return (Row(y)[x / WordBits] >> (x % WordBits)) & 1;
+		}
+
+		void SetValue(size_t x, size_t y, bool newValue)
+		{
+			const Word bit = Word(1) << (x % WordBits);
+			if(newValue)
+				Row(y)[x / WordBits] |= bit;
+			else
+				Row(y)[x / WordBits] &= ~bit;
+		}
+
+		/**
+		 * Sets the mask from a buffer of bools with Height() rows, of which
+		 * consecutive rows are stride elements apart. This can be used to
+		 * convert buffers such as the one of a Mask2D or a FlagMask.
+		 */
+		void Pack(const bool* buffer, size_t stride);
+
+		/**
+		 * Writes the mask into a buffer of bools. This is the inverse of Pack().
+		 * Only the first Width() values of each row are written.
+		 */
+		void Unpack(bool* buffer, size_t stride) const;
+
+		/**
+		 * Writes the values into the given mask, which should have the same
+		 * dimensions as this mask.
+		 */
+		void CopyTo(Mask2D& mask) const
+		{
+			Unpack(mask.Data(), mask.Stride());
+		}
+
+		Mask2D ToMask2D() const
+		{
+			Mask2D mask(Mask2D::MakeUnsetMask(_width, _height));
+			CopyTo(mask);
+			return mask;
+		}
+
+		void Join(const BitMask2D& other)
+		{
+			for(size_t i=0; i!=_words.size(); ++i)
+				_words[i] |= other._words[i];
+		}
+
+		void Intersect(const BitMask2D& other)
+		{
+			for(size_t i=0; i!=_words.size(); ++i)
+				_words[i] &= other._words[i];
+		}
+
+		void Invert();
+
+		template<bool BoolValue>
+		size_t GetCount() const
+		{
+			const size_t trueCount = countTrue();
+			return BoolValue ? trueCount : _width * _height - trueCount;
+		}
+
+		bool AllFalse() const
+		{
+			for(Word word : _words)
+			{
+				if(word != 0)
+					return false;
+			}
+			return true;
+		}
+
+		/**
+		 * Flags all samples that have a flagged sample within a horizontal
+		 * distance of 'size'. This has the same result as
+		 * MorphologicalFlagger::DilateFlagsHorizontally(), but is performed with
+		 * shifts of whole words, in log2(size) steps.
+		 */
+		void DilateHorizontally(size_t size);
+
+	private:
+		size_t countTrue() const;
+
+		/**
+		 * Mask with the bits of the last word of a row that are within the width.
+		 */
+		Word lastWordMask() const
+		{
+			const size_t rest = _width % WordBits;
+			return rest == 0 ? ~Word(0) : ((Word(1) << rest) - 1);
+		}
+
+		size_t _width, _height;
+		size_t _wordsPerRow;
+		std::vector<Word> _words;
+};
+
+#endif
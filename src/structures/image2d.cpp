@@ -2,6 +2,7 @@
 
 #include "../msio/fitsfile.h"
 
+#include "../util/memoryaccountant.h"
 #include "../util/uvector.h"
 
 #include <algorithm>
@@ -52,6 +53,7 @@ void Image2D::allocate()
 		if(posix_memalign((void **) &_dataConsecutive, 32, _stride * allocHeight * sizeof(num_t)) != 0)
 			throw std::bad_alloc();
 #endif
+	MemoryAccountant::Allocate(MemoryAccountant::ImageComponent, _stride * allocHeight * sizeof(num_t));
 	_dataPtr = new num_t*[allocHeight];
 	for(size_t y=0;y<_height;++y)
 	{
@@ -100,6 +102,17 @@ Image2D::Image2D(Image2D&& source) noexcept :
 
 Image2D::~Image2D() noexcept
 {
+	release();
+}
+
+void Image2D::release()
+{
+	if(_dataConsecutive != nullptr)
+	{
+		unsigned allocHeight = ((((_height-1)/4)+1)*4);
+		if(_height == 0) allocHeight = 0;
+		MemoryAccountant::Release(MemoryAccountant::ImageComponent, _stride * allocHeight * sizeof(num_t));
+	}
 	delete[] _dataPtr;
 	free(_dataConsecutive);
 }
@@ -110,8 +123,7 @@ Image2D& Image2D::operator=(const Image2D& rhs)
 		_height != rhs._height ||
 		_stride != rhs._stride)
 	{
-		delete[] _dataPtr;
-		free(_dataConsecutive);
+		release();
 		_width = rhs._width;
 		_height = rhs._height;
 		_stride = rhs._stride;
@@ -516,6 +516,7 @@ class Image2D : public boost::intrusive_ref_counter<Image2D> {
 		Image2D(size_t width, size_t height, size_t widthCapacity);
 		
 		void allocate();
+		void release();
 		
 		size_t _width, _height;
 		size_t _stride;
@@ -1,6 +1,9 @@
 #include "mask2d.h"
 #include "image2d.h"
 
+#include "../util/memoryaccountant.h"
+
+#include <cstdint>
 #include <iostream>
 
 Mask2D::Mask2D(const Mask2D& source) : Mask2D(source.Width(), source.Height())
@@ -36,6 +39,7 @@ void Mask2D::allocate()
 	unsigned allocHeight = ((((_height-1)/4)+1)*4);
 	if(_height == 0) allocHeight = 0;
 	_valuesConsecutive = new bool[_stride * allocHeight * sizeof(bool)];
+	MemoryAccountant::Allocate(MemoryAccountant::MaskComponent, _stride * allocHeight * sizeof(bool));
 	
 	_values = new bool*[allocHeight];
 	for(size_t y=0;y<_height;++y)
@@ -62,6 +66,17 @@ void Mask2D::allocate()
 
 Mask2D::~Mask2D() noexcept
 {
+	release();
+}
+
+void Mask2D::release()
+{
+	if(_valuesConsecutive != nullptr)
+	{
+		unsigned allocHeight = ((((_height-1)/4)+1)*4);
+		if(_height == 0) allocHeight = 0;
+		MemoryAccountant::Release(MemoryAccountant::MaskComponent, _stride * allocHeight * sizeof(bool));
+	}
 	delete[] _values;
 	delete[] _valuesConsecutive;
 }
@@ -72,8 +87,7 @@ Mask2D& Mask2D::operator=(const Mask2D& rhs)
 		_height != rhs._height ||
 		_stride != rhs._stride)
 	{
-		delete[] _values;
-		delete[] _valuesConsecutive;
+		release();
 		_width = rhs._width;
 		_height = rhs._height;
 		_stride = rhs._stride;
@@ -93,6 +107,99 @@ Mask2D& Mask2D::operator=(Mask2D&& rhs) noexcept
 	return *this;
 }
 
+namespace {
+	/**
+	 * The bools of a mask are either 0 or 1, so eight of them can be combined with
+	 * a single 64-bit integer operation.
+	 */
+	const uint64_t OnesPerByte = 0x0101010101010101ULL;
+
+	inline uint64_t loadEight(const bool* values)
+	{
+		uint64_t eight;
+		memcpy(&eight, values, sizeof(eight));
+		return eight;
+	}
+
+	inline void storeEight(bool* values, uint64_t eight)
+	{
+		memcpy(values, &eight, sizeof(eight));
+	}
+}
+
+void Mask2D::Join(const Mask2D& other)
+{
+	const size_t n = _stride * _height;
+	size_t i = 0;
+	for(; i+8 <= n; i+=8)
+		storeEight(&_valuesConsecutive[i], loadEight(&_valuesConsecutive[i]) | loadEight(&other._valuesConsecutive[i]));
+	for(; i!=n; ++i)
+		_valuesConsecutive[i] = _valuesConsecutive[i] || other._valuesConsecutive[i];
+}
+
+void Mask2D::Intersect(const Mask2D& other)
+{
+	const size_t n = _stride * _height;
+	size_t i = 0;
+	for(; i+8 <= n; i+=8)
+		storeEight(&_valuesConsecutive[i], loadEight(&_valuesConsecutive[i]) & loadEight(&other._valuesConsecutive[i]));
+	for(; i!=n; ++i)
+		_valuesConsecutive[i] = _valuesConsecutive[i] && other._valuesConsecutive[i];
+}
+
+void Mask2D::Invert()
+{
+	// Only the visible width is inverted: the padding after each row has to
+	// keep its value.
+	for(size_t y=0; y!=_height; ++y)
+	{
+		bool* row = _values[y];
+		size_t x = 0;
+		for(; x+8 <= _width; x+=8)
+			storeEight(&row[x], loadEight(&row[x]) ^ OnesPerByte);
+		for(; x!=_width; ++x)
+			row[x] = !row[x];
+	}
+}
+
+bool Mask2D::AllFalse() const
+{
+	for(size_t y=0; y!=_height; ++y)
+	{
+		const bool* row = _values[y];
+		size_t x = 0;
+		for(; x+8 <= _width; x+=8)
+		{
+			if(loadEight(&row[x]) != 0)
+				return false;
+		}
+		for(; x!=_width; ++x)
+		{
+			if(row[x])
+				return false;
+		}
+	}
+	return true;
+}
+
+size_t Mask2D::countTrue() const
+{
+	size_t count = 0;
+	for(size_t y=0; y!=_height; ++y)
+	{
+		const bool* row = _values[y];
+		size_t x = 0;
+		for(; x+8 <= _width; x+=8)
+			count += __builtin_popcountll(loadEight(&row[x]));
+		for(; x!=_width; ++x)
+		{
+			if(row[x])
+				++count;
+		}
+	}
+	return count;
+}
+
 Mask2D* Mask2D::CreateUnsetMask(const Image2D &templateImage)
 {
 	return new Mask2D(templateImage.Width(), templateImage.Height());
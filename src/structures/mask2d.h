@@ -128,18 +128,7 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 		
 		size_t Height() const { return _height; }
 
-		bool AllFalse() const
-		{
-			for(size_t y=0;y<_height;++y)
-			{
-				for(size_t x=0;x<_width;++x)
-				{
-					if(_values[y][x])
-						return false;
-				}
-			}
-			return true;
-		}
+		bool AllFalse() const;
 
 		/**
 		 * Returns a pointer to one row of data. This can be used to step
@@ -233,14 +222,11 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 			memset(_values[startY], BoolValue, _width * sizeof(bool) * (endY - startY));
 		}
 
-		void Invert()
-		{
-			for(size_t y=0;y<_height;++y)
-			{
-				for(size_t x=0;x<_width;++x)
-					_values[y][x] = !_values[y][x];
-			}
-		}
+		/**
+		 * Inverts all values. Like Join() and Intersect(), this processes eight
+		 * values at a time.
+		 */
+		void Invert();
 		
 		/**
 		 * Flips the image round the diagonal, i.e., x becomes y and y becomes x.
@@ -259,14 +245,8 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 		template<bool BoolValue>
 		size_t GetCount() const
 		{
-			size_t count = 0;
-			for(size_t y=0;y<_height;++y)
-			{
-				for(size_t x=0;x<_width;++x)
-					if(BoolValue == _values[y][x])
-						++count;
-			}
-			return count;
+			const size_t trueCount = countTrue();
+			return BoolValue ? trueCount : _width * _height - trueCount;
 		}
 		
 		Mask2D ShrinkHorizontally(int factor) const;
@@ -278,21 +258,16 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 		void EnlargeHorizontallyAndSet(const Mask2D& smallMask, int factor);
 		void EnlargeVerticallyAndSet(const Mask2D& smallMask, int factor);
 
-		void Join(const Mask2D& other)
-		{
-			for(size_t y=0;y<_height;++y) {
-				for(size_t x=0;x<_width;++x)
-					SetValue(x, y, other.Value(x, y) || Value(x, y));
-			}
-		}
+		/**
+		 * Sets all values that are set in the other mask, which should have the
+		 * same dimensions. This is a logical OR, and is performed on whole words.
+		 */
+		void Join(const Mask2D& other);
 		
-		void Intersect(const Mask2D& other)
-		{
-			for(size_t y=0;y<_height;++y) {
-				for(size_t x=0;x<_width;++x)
-					SetValue(x, y, other.Value(x, y) && Value(x, y));
-			}
-		}
+		/**
+		 * Logical AND with the other mask, which should have the same dimensions.
+		 */
+		void Intersect(const Mask2D& other);
 		
 		Mask2D Trim(size_t startX, size_t startY, size_t endX, size_t endY) const
 		{
@@ -342,6 +317,9 @@ class Mask2D : public boost::intrusive_ref_counter<Mask2D> {
 		Mask2D(size_t width, size_t height);
 		
 		void allocate();
+		void release();
+		
+		size_t countTrue() const;
 		
 		size_t _width, _height;
 		size_t _stride;
@@ -8,10 +8,26 @@
 #include "msmetadata.h"
 #include "date.h"
 
+#include "../msio/mappedfile.h"
+
 #include "../util/logger.h"
 
 #include "../strategy/control/strategywriter.h"
 
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 MSMetaData::~MSMetaData()
 { }
 
@@ -28,6 +44,7 @@ void MSMetaData::initializeOtherData()
 	initializeBands(ms);
 	initializeFields(ms);
 	initializeObservation(ms);
+	initializeDataDescriptions(ms);
 }
 
 void MSMetaData::initializeAntennas(casacore::MeasurementSet &ms)
@@ -130,72 +147,355 @@ void MSMetaData::initializeObservation(casacore::MeasurementSet& ms)
 	}
 }
 
-void MSMetaData::GetDataDescToBandVector(std::vector<size_t>& dataDescToBand)
+void MSMetaData::initializeDataDescriptions(casacore::MeasurementSet& ms)
 {
-	casacore::MeasurementSet ms(_path);
 	casacore::MSDataDescription dataDescTable = ms.dataDescription();
 	casacore::ScalarColumn<int>
 		spwIdCol(dataDescTable, dataDescTable.columnName(casacore::MSDataDescriptionEnums::SPECTRAL_WINDOW_ID));
-	dataDescToBand.resize(dataDescTable.nrow());
+	_dataDescToBand.resize(dataDescTable.nrow());
 	for(size_t dataDescId=0;dataDescId!=dataDescTable.nrow();++dataDescId)
 	{
-		dataDescToBand[dataDescId] = spwIdCol(dataDescId);
+		_dataDescToBand[dataDescId] = spwIdCol(dataDescId);
 	}
 }
 
-void MSMetaData::initializeMainTableData()
+/**
+ * Identifies the version of the main table from which a cache file was
+ * made. The table.dat file of a table is rewritten when rows are added or
+ * removed.
+ */
+struct MSMetaData::CacheKey
 {
-	if(!_isMainTableDataInitialized)
+	uint64_t modificationTime, modificationTimeNs, tableSize, rowCount;
+	
+	bool operator==(const CacheKey& rhs) const
 	{
-		Logger::Debug << "Initializing ms metadata cache data...\n"; 
+		return modificationTime == rhs.modificationTime &&
+			modificationTimeNs == rhs.modificationTimeNs &&
+			tableSize == rhs.tableSize &&
+			rowCount == rhs.rowCount;
+	}
+	bool operator!=(const CacheKey& rhs) const { return !(*this == rhs); }
+};
+
+namespace {
+	const char cacheMagic[8] = { 'A', 'O', 'F', 'M', 'E', 'T', 'A', '\0' };
+	const uint32_t cacheVersion = 1, cacheByteOrderMark = 0x01020304;
+	
+	/**
+	 * Sequential reader of the mapped cache file that checks the bounds, such
+	 * that a truncated file is detected.
+	 */
+	class CacheFileReader
+	{
+	public:
+		explicit CacheFileReader(const MappedFile& file) : _file(file), _position(0) { }
 		
-		casacore::MeasurementSet ms(_path);
-		casacore::ScalarColumn<int> antenna1Col(ms,
-			casacore::MeasurementSet::columnName(casacore::MeasurementSet::ANTENNA1));
-		casacore::ScalarColumn<int> antenna2Col(ms,
-			casacore::MeasurementSet::columnName(casacore::MeasurementSet::ANTENNA2));
-		casacore::ScalarColumn<int> fieldIdCol(ms,
-			casacore::MeasurementSet::columnName(casacore::MeasurementSet::FIELD_ID));
-		casacore::ScalarColumn<int> dataDescIdCol(ms,
-			casacore::MeasurementSet::columnName(casacore::MeasurementSet::DATA_DESC_ID));
-		casacore::ScalarColumn<double> timeCol(ms,
-			casacore::MeasurementSet::columnName(casacore::MeasurementSet::TIME));
+		template<typename T>
+		void ReadArray(T* values, size_t count)
+		{
+			if(count > (_file.Size() - _position) / sizeof(T))
+				throw std::runtime_error("Metadata cache file is truncated");
+			memcpy(values, _file.Data<char>(_position), count * sizeof(T));
+			_position += count * sizeof(T);
+		}
 		
-		double time = -1.0;
-		std::set<std::pair<size_t, size_t> > baselineSet;
-		std::set<Sequence> sequenceSet;
-		size_t
-			prevFieldId = size_t(-1),
-			sequenceId = size_t(-1);
-		for(size_t row=0; row!=ms.nrow(); ++row)
+		template<typename T>
+		T Read()
+		{
+			T value;
+			ReadArray(&value, 1);
+			return value;
+		}
+		
+		bool AtEnd() const { return _position == _file.Size(); }
+	private:
+		const MappedFile& _file;
+		size_t _position;
+	};
+	
+	template<typename T>
+	void writeValue(std::ostream& stream, T value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+}
+
+std::shared_ptr<const MSMetaData::MainTableData> MSMetaData::getMainTableData(const std::string& path)
+{
+	// Only the most recently used set is kept in memory. Other sets are read
+	// from the cache file in the set, if it is up to date.
+	static std::mutex cacheMutex;
+	static std::string cachedPath;
+	static CacheKey cachedKey;
+	static std::shared_ptr<const MainTableData> cachedData;
+	
+	casacore::MeasurementSet ms(path);
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	CacheKey key;
+	bool hasKey = getCacheKey(path, ms.nrow(), key);
+	if(cachedData != nullptr && cachedPath == path && hasKey && cachedKey == key)
+	{
+		Logger::Debug << "Using cached ms metadata.\n";
+		return cachedData;
+	}
+	
+	std::shared_ptr<const MainTableData> data;
+	const std::string cacheFilename = path + "/aoflagger-metadata.cache";
+	if(hasKey)
+		data = loadMainTableData(cacheFilename, key);
+	if(data == nullptr)
+	{
+		data = readMainTableData(ms);
+		if(hasKey)
+			saveMainTableData(cacheFilename, key, *data);
+	}
+	if(hasKey)
+	{
+		cachedData = data;
+		cachedPath = path;
+		cachedKey = key;
+	}
+	else {
+		cachedData.reset();
+	}
+	return data;
+}
+
+bool MSMetaData::getCacheKey(const std::string& path, size_t rowCount, CacheKey& key)
+{
+	struct stat tableStat;
+	if(stat((path + "/table.dat").c_str(), &tableStat) != 0)
+		return false;
+#ifdef __APPLE__
+	key.modificationTime = tableStat.st_mtimespec.tv_sec;
+	key.modificationTimeNs = tableStat.st_mtimespec.tv_nsec;
+#else
+	key.modificationTime = tableStat.st_mtim.tv_sec;
+	key.modificationTimeNs = tableStat.st_mtim.tv_nsec;
+#endif
+	key.tableSize = tableStat.st_size;
+	key.rowCount = rowCount;
+	return true;
+}
+
+std::shared_ptr<const MSMetaData::MainTableData> MSMetaData::loadMainTableData(const std::string& cacheFilename, const CacheKey& key)
+{
+	if(!boost::filesystem::exists(cacheFilename))
+		return nullptr;
+	try {
+		MappedFile file;
+		file.Open(cacheFilename);
+		CacheFileReader reader(file);
+		char magic[sizeof(cacheMagic)];
+		reader.ReadArray(magic, sizeof(magic));
+		if(memcmp(magic, cacheMagic, sizeof(magic)) != 0 ||
+			reader.Read<uint32_t>() != cacheVersion ||
+			reader.Read<uint32_t>() != cacheByteOrderMark)
 		{
-			size_t
-				a1 = antenna1Col(row),
-				a2 = antenna2Col(row),
-				fieldId = fieldIdCol(row),
-				spw = dataDescIdCol(row);
-			double cur_time = timeCol(row);
-			
-			bool isNewTime = cur_time != time;
-			if(fieldId != prevFieldId)
+			Logger::Debug << "Metadata cache file has a different format, ignoring it.\n";
+			return nullptr;
+		}
+		CacheKey fileKey;
+		reader.ReadArray(&fileKey, 1);
+		if(fileKey != key)
+		{
+			Logger::Debug << "Metadata cache file is out of date.\n";
+			return nullptr;
+		}
+		
+		std::shared_ptr<MainTableData> data = std::make_shared<MainTableData>();
+		data->rowCount = key.rowCount;
+		
+		data->baselines.resize(reader.Read<uint64_t>());
+		for(std::pair<size_t,size_t>& baseline : data->baselines)
+		{
+			baseline.first = reader.Read<uint64_t>();
+			baseline.second = reader.Read<uint64_t>();
+		}
+		
+		std::vector<double> times(reader.Read<uint64_t>());
+		reader.ReadArray(times.data(), times.size());
+		data->observationTimes.insert(times.begin(), times.end());
+		
+		size_t sequenceCount = reader.Read<uint64_t>();
+		data->observationTimesPerSequence.resize(sequenceCount);
+		data->timestepRowsPerSequence.resize(sequenceCount);
+		for(size_t s=0; s!=sequenceCount; ++s)
+		{
+			times.resize(reader.Read<uint64_t>());
+			reader.ReadArray(times.data(), times.size());
+			data->observationTimesPerSequence[s].insert(times.begin(), times.end());
+			std::vector<std::pair<size_t,size_t>>& rows = data->timestepRowsPerSequence[s];
+			rows.resize(times.size());
+			for(std::pair<size_t,size_t>& row : rows)
 			{
-				prevFieldId = fieldId;
-				sequenceId++;
-				_observationTimesPerSequence.emplace_back();
+				row.first = reader.Read<uint64_t>();
+				row.second = reader.Read<uint64_t>();
 			}
-			if(isNewTime)
+		}
+		
+		size_t sequenceListSize = reader.Read<uint64_t>();
+		data->sequences.reserve(sequenceListSize);
+		for(size_t i=0; i!=sequenceListSize; ++i)
+		{
+			uint32_t values[5];
+			reader.ReadArray(values, 5);
+			data->sequences.emplace_back(values[0], values[1], values[2], values[3], values[4]);
+		}
+		if(!reader.AtEnd())
+			throw std::runtime_error("Metadata cache file has trailing data");
+		Logger::Debug << "Read ms metadata from cache file.\n";
+		return data;
+	} catch(std::exception& e) {
+		Logger::Warn << "Could not read metadata cache file " << cacheFilename << ": " << e.what() << '\n';
+		return nullptr;
+	}
+}
+
+void MSMetaData::saveMainTableData(const std::string& cacheFilename, const CacheKey& key, const MainTableData& data)
+{
+	// The file is written under a temporary name and renamed afterwards, so
+	// that other processes never see a partly written cache file.
+	std::ostringstream tempFilename;
+	tempFilename << cacheFilename << ".tmp" << getpid();
+	{
+		std::ofstream stream(tempFilename.str(), std::ios::binary);
+		if(!stream)
+		{
+			Logger::Debug << "Metadata cache file can not be written (set is possibly read only).\n";
+			return;
+		}
+		stream.write(cacheMagic, sizeof(cacheMagic));
+		writeValue<uint32_t>(stream, cacheVersion);
+		writeValue<uint32_t>(stream, cacheByteOrderMark);
+		writeValue(stream, key);
+		
+		writeValue<uint64_t>(stream, data.baselines.size());
+		for(const std::pair<size_t,size_t>& baseline : data.baselines)
+		{
+			writeValue<uint64_t>(stream, baseline.first);
+			writeValue<uint64_t>(stream, baseline.second);
+		}
+		
+		writeValue<uint64_t>(stream, data.observationTimes.size());
+		for(double time : data.observationTimes)
+			writeValue(stream, time);
+		
+		writeValue<uint64_t>(stream, data.observationTimesPerSequence.size());
+		for(size_t s=0; s!=data.observationTimesPerSequence.size(); ++s)
+		{
+			writeValue<uint64_t>(stream, data.observationTimesPerSequence[s].size());
+			for(double time : data.observationTimesPerSequence[s])
+				writeValue(stream, time);
+			for(const std::pair<size_t,size_t>& rows : data.timestepRowsPerSequence[s])
 			{
-				time = cur_time;
-				_observationTimesPerSequence[sequenceId].insert(cur_time);
-				_observationTimes.emplace_hint(_observationTimes.end(), cur_time);
+				writeValue<uint64_t>(stream, rows.first);
+				writeValue<uint64_t>(stream, rows.second);
 			}
-			
-			baselineSet.insert(std::pair<size_t, size_t>(a1, a2));
-			sequenceSet.insert(Sequence(a1, a2, spw, sequenceId, fieldId));
 		}
 		
-		_baselines.assign(baselineSet.begin(), baselineSet.end());
-		_sequences.assign(sequenceSet.begin(), sequenceSet.end());
+		writeValue<uint64_t>(stream, data.sequences.size());
+		for(const Sequence& sequence : data.sequences)
+		{
+			const uint32_t values[5] = { sequence.antenna1, sequence.antenna2, sequence.spw, sequence.sequenceId, sequence.fieldId };
+			stream.write(reinterpret_cast<const char*>(values), sizeof(values));
+		}
+		if(!stream.good())
+		{
+			stream.close();
+			std::remove(tempFilename.str().c_str());
+			Logger::Warn << "Error while writing metadata cache file " << cacheFilename << ".\n";
+			return;
+		}
+	}
+	if(std::rename(tempFilename.str().c_str(), cacheFilename.c_str()) != 0)
+		std::remove(tempFilename.str().c_str());
+	else
+		Logger::Debug << "Wrote ms metadata to cache file.\n";
+}
+
+std::shared_ptr<const MSMetaData::MainTableData> MSMetaData::readMainTableData(casacore::MeasurementSet& ms)
+{
+	Logger::Debug << "Initializing ms metadata cache data...\n"; 
+	
+	casacore::ScalarColumn<int> antenna1Col(ms,
+		casacore::MeasurementSet::columnName(casacore::MeasurementSet::ANTENNA1));
+	casacore::ScalarColumn<int> antenna2Col(ms,
+		casacore::MeasurementSet::columnName(casacore::MeasurementSet::ANTENNA2));
+	casacore::ScalarColumn<int> fieldIdCol(ms,
+		casacore::MeasurementSet::columnName(casacore::MeasurementSet::FIELD_ID));
+	casacore::ScalarColumn<int> dataDescIdCol(ms,
+		casacore::MeasurementSet::columnName(casacore::MeasurementSet::DATA_DESC_ID));
+	casacore::ScalarColumn<double> timeCol(ms,
+		casacore::MeasurementSet::columnName(casacore::MeasurementSet::TIME));
+	
+	std::shared_ptr<MainTableData> data = std::make_shared<MainTableData>();
+	data->rowCount = ms.nrow();
+	
+	double time = -1.0;
+	std::set<std::pair<size_t, size_t> > baselineSet;
+	std::set<Sequence> sequenceSet;
+	std::vector<std::map<double, std::pair<size_t,size_t>>> timestepRows;
+	std::pair<size_t,size_t>* currentRows = nullptr;
+	size_t
+		prevFieldId = size_t(-1),
+		sequenceId = size_t(-1);
+	for(size_t row=0; row!=data->rowCount; ++row)
+	{
+		size_t
+			a1 = antenna1Col(row),
+			a2 = antenna2Col(row),
+			fieldId = fieldIdCol(row),
+			spw = dataDescIdCol(row);
+		double cur_time = timeCol(row);
+		
+		bool isNewTime = cur_time != time;
+		if(fieldId != prevFieldId)
+		{
+			prevFieldId = fieldId;
+			sequenceId++;
+			data->observationTimesPerSequence.emplace_back();
+			timestepRows.emplace_back();
+			// As in MSSelection, a new field always starts a new timestep, also when
+			// its first time equals the last time of the previous field. Otherwise,
+			// that time would be missing from the new sequence, and its rows at that
+			// time would be skipped by the readers.
+			isNewTime = true;
+		}
+		if(isNewTime)
+		{
+			time = cur_time;
+			data->observationTimesPerSequence[sequenceId].insert(cur_time);
+			data->observationTimes.emplace_hint(data->observationTimes.end(), cur_time);
+			currentRows = &timestepRows[sequenceId].emplace(cur_time, std::make_pair(row, row)).first->second;
+		}
+		currentRows->second = row;
+		
+		baselineSet.insert(std::pair<size_t, size_t>(a1, a2));
+		sequenceSet.insert(Sequence(a1, a2, spw, sequenceId, fieldId));
+	}
+	
+	data->baselines.assign(baselineSet.begin(), baselineSet.end());
+	data->sequences.assign(sequenceSet.begin(), sequenceSet.end());
+	data->timestepRowsPerSequence.resize(timestepRows.size());
+	for(size_t s=0; s!=timestepRows.size(); ++s)
+	{
+		for(const std::pair<const double, std::pair<size_t,size_t>>& rows : timestepRows[s])
+			data->timestepRowsPerSequence[s].push_back(rows.second);
+	}
+	return data;
+}
+
+void MSMetaData::initializeMainTableData()
+{
+	if(!_isMainTableDataInitialized)
+	{
+		_mainTableData = getMainTableData(_path);
+		_baselines = _mainTableData->baselines;
+		_sequences = _mainTableData->sequences;
+		_observationTimes = _mainTableData->observationTimes;
+		_observationTimesPerSequence = _mainTableData->observationTimesPerSequence;
 		
 		if(_intervalEnd)
 		{
@@ -221,6 +521,38 @@ void MSMetaData::initializeMainTableData()
 	}
 }
 
+MSMetaData::RowRange MSMetaData::GetIntervalRowRange()
+{
+	initializeMainTableData();
+	RowRange range;
+	range.startRow = _mainTableData->rowCount;
+	range.endRow = 0;
+	range.startSequenceId = 0;
+	const std::vector<std::vector<std::pair<size_t,size_t>>>& rowsPerSequence = _mainTableData->timestepRowsPerSequence;
+	for(size_t s=0; s!=rowsPerSequence.size(); ++s)
+	{
+		const size_t
+			start = _intervalStart ? std::min(_intervalStart.get(), rowsPerSequence[s].size()) : 0,
+			end = _intervalEnd ? std::min(_intervalEnd.get(), rowsPerSequence[s].size()) : rowsPerSequence[s].size();
+		for(size_t t=start; t<end; ++t)
+		{
+			const std::pair<size_t,size_t>& rows = rowsPerSequence[s][t];
+			if(rows.first < range.startRow)
+			{
+				range.startRow = rows.first;
+				range.startSequenceId = s;
+			}
+			range.endRow = std::max(range.endRow, rows.second + 1);
+		}
+	}
+	if(range.startRow >= range.endRow)
+	{
+		range.startRow = 0;
+		range.endRow = 0;
+	}
+	return range;
+}
+
 size_t MSMetaData::PolarizationCount(const std::string& filename)
 {
 	casacore::MeasurementSet ms(filename);
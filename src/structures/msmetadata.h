@@ -9,6 +9,7 @@
 
 #include <boost/optional/optional.hpp>
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
@@ -99,7 +100,10 @@ public:
 		return _fields[fieldIndex];
 	}
 	
-	void GetDataDescToBandVector(std::vector<size_t>& dataDescToBand);
+	void GetDataDescToBandVector(std::vector<size_t>& dataDescToBand) const
+	{
+		dataDescToBand = _dataDescToBand;
+	}
 	
 	std::string Path() const { return _path; }
 	
@@ -127,6 +131,18 @@ public:
 		return _observationTimesPerSequence[sequenceId];
 	}
 	
+	/**
+	 * Range of rows in the main table that contain the selected interval.
+	 * Readers only need to scan these rows. Because the sequence id is
+	 * counted while scanning, the sequence of the first row is also given.
+	 */
+	struct RowRange
+	{
+		size_t startRow, endRow, startSequenceId;
+	};
+	
+	RowRange GetIntervalRowRange();
+	
 	bool HasAOFlaggerHistory();
 	
 	void GetAOFlaggerHistory(std::ostream &stream);
@@ -179,6 +195,36 @@ public:
 	};
 
 private:
+	/**
+	 * Information from the main table, before selecting the interval. This
+	 * requires a scan over all rows, and is shared between the MSMetaData
+	 * instances of a set, e.g. when a set is processed in several intervals.
+	 */
+	struct MainTableData
+	{
+		size_t rowCount;
+		std::vector<std::pair<size_t,size_t> > baselines;
+		std::set<double> observationTimes;
+		std::vector<std::set<double> > observationTimesPerSequence;
+		std::vector<Sequence> sequences;
+		// For each sequence and timestep, the first and last row of that timestep
+		std::vector<std::vector<std::pair<size_t,size_t> > > timestepRowsPerSequence;
+	};
+	
+	struct CacheKey;
+	
+	/**
+	 * Returns the main table data of a set. It is taken from memory when the set
+	 * was used before in this process, otherwise from the cache file inside
+	 * the set, which is created when it does not exist. The cache file is
+	 * ignored when the main table has changed since it was written.
+	 */
+	static std::shared_ptr<const MainTableData> getMainTableData(const std::string& path);
+	static std::shared_ptr<const MainTableData> readMainTableData(casacore::MeasurementSet& ms);
+	static bool getCacheKey(const std::string& path, size_t rowCount, CacheKey& key);
+	static std::shared_ptr<const MainTableData> loadMainTableData(const std::string& cacheFilename, const CacheKey& key);
+	static void saveMainTableData(const std::string& cacheFilename, const CacheKey& key, const MainTableData& data);
+	
 	void initializeMainTableData();
 	
 	void initializeOtherData();
@@ -187,6 +233,7 @@ private:
 	void initializeBands(casacore::MeasurementSet& ms);
 	void initializeFields(casacore::MeasurementSet& ms);
 	void initializeObservation(casacore::MeasurementSet& ms);
+	void initializeDataDescriptions(casacore::MeasurementSet& ms);
 
 	const std::string _path;
 	
@@ -204,8 +251,12 @@ private:
 	
 	std::vector<FieldInfo> _fields;
 	
+	std::vector<size_t> _dataDescToBand;
+	
 	std::vector<Sequence> _sequences;
 	
+	std::shared_ptr<const MainTableData> _mainTableData;
+	
 	std::string _telescopeName;
 	
 	boost::optional<size_t> _intervalStart, _intervalEnd;
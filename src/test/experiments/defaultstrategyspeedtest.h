@@ -361,7 +361,7 @@ inline void DefaultStrategySpeedTest::TimeSumThresholdN::operator()()
 	//Logger::Info << "Mode: " << mode << '\n';
 	config.InitializeThresholdsFromFirstThreshold(6.0 * stddev, ThresholdConfig::Rayleigh);
 	const size_t N=100;
-	double hor=0.0, vert=0.0, sseHor=0.0, sseVert=0.0, avxVert=0.0;
+	double hor=0.0, vert=0.0, sseHor=0.0, sseVert=0.0, avxHor=0.0, avxVert=0.0, avx512Hor=0.0, avx512Vert=0.0;
 	for(unsigned i=0;i<9;++i)
 	{
 		const unsigned length = config.GetHorizontalLength(i);
@@ -389,16 +389,30 @@ inline void DefaultStrategySpeedTest::TimeSumThresholdN::operator()()
 		Logger::Info << "SSE Horizontal, length " << length << ": " << watchE.ToString() << '\n';
 #endif
 
-/*
-#ifdef __AVX2__
-		Mask2D maskC(*artifacts.OriginalData().GetSingleMask());
-		Stopwatch watchC(true);
-		for(size_t j=0; j!=N; ++j) {
-			maskInp = maskC;
-			CombinatorialThresholder::HorizontalSumThresholdLargeAVX(input.get(), maskInp, &scratch, length, threshold);
+#ifdef HAVE_AVX_KERNELS
+		if(SIMDSupport::Has(SIMDSupport::AVX2))
+		{
+			Mask2D maskC(*artifacts.OriginalData().GetSingleMask());
+			Stopwatch watchC(true);
+			for(size_t j=0; j!=N; ++j) {
+				maskInp = maskC;
+				SumThreshold::HorizontalLargeAVX(input.get(), &maskInp, &scratch, length, threshold);
+			}
+			avxHor += watchC.Seconds();
+			Logger::Info << "AVX Horizontal, length " << length << ": " << watchC.ToString() << '\n';
 		}
-		Logger::Info << "AVX Horizontal, length " << length << ": " << watchC.ToString() << '\n';
-#endif*/
+		if(SIMDSupport::Has(SIMDSupport::AVX512))
+		{
+			Mask2D maskG(*artifacts.OriginalData().GetSingleMask());
+			Stopwatch watchG(true);
+			for(size_t j=0; j!=N; ++j) {
+				maskInp = maskG;
+				SumThreshold::HorizontalLargeAVX512(input.get(), &maskInp, &scratch, length, threshold);
+			}
+			avx512Hor += watchG.Seconds();
+			Logger::Info << "AVX-512 Horizontal, length " << length << ": " << watchG.ToString() << '\n';
+		}
+#endif
 		
 		Mask2D maskB(*artifacts.OriginalData().GetSingleMask());
 		Stopwatch watchB(true);
@@ -420,22 +434,39 @@ inline void DefaultStrategySpeedTest::TimeSumThresholdN::operator()()
 		Logger::Info << "SSE Vertical, length " << length << ": " << watchD.ToString() << '\n';
 #endif
 
-#ifdef __AVX2__
-		Mask2D maskF(*artifacts.OriginalData().GetSingleMask());
-		Stopwatch watchF(true);
-		for(size_t j=0; j!=N; ++j) {
-			maskInp = maskF;
-			SumThreshold::VerticalLargeAVX(input.get(), &maskF, &scratch, length, threshold);
+#ifdef HAVE_AVX_KERNELS
+		if(SIMDSupport::Has(SIMDSupport::AVX2))
+		{
+			Mask2D maskF(*artifacts.OriginalData().GetSingleMask());
+			Stopwatch watchF(true);
+			for(size_t j=0; j!=N; ++j) {
+				maskInp = maskF;
+				SumThreshold::VerticalLargeAVX(input.get(), &maskInp, &scratch, length, threshold);
+			}
+			avxVert += watchF.Seconds();
+			Logger::Info << "AVX Vertical, length " << length << ": " << watchF.ToString() << '\n';
+		}
+		if(SIMDSupport::Has(SIMDSupport::AVX512))
+		{
+			Mask2D maskH(*artifacts.OriginalData().GetSingleMask());
+			Stopwatch watchH(true);
+			for(size_t j=0; j!=N; ++j) {
+				maskInp = maskH;
+				SumThreshold::VerticalLargeAVX512(input.get(), &maskInp, &scratch, length, threshold);
+			}
+			avx512Vert += watchH.Seconds();
+			Logger::Info << "AVX-512 Vertical, length " << length << ": " << watchH.ToString() << '\n';
 		}
-		avxVert += watchF.Seconds();
-		Logger::Info << "AVX Vertical, length " << length << ": " << watchF.ToString() << '\n';
 #endif
 		Logger::Info
 			<< "Horizontal ref: " << hor << "\n"
 			<< "  Vertical ref: " << vert << "\n"
 			<< "Horizontal SSE: " << sseHor << "\n"
 			<< "  Vertical SSE: " << sseVert << "\n"
-			<< "  Vertical AVX: " << avxVert << "\n";
+			<< "Horizontal AVX: " << avxHor << "\n"
+			<< "  Vertical AVX: " << avxVert << "\n"
+			<< "Horizontal AVX-512: " << avx512Hor << "\n"
+			<< "  Vertical AVX-512: " << avx512Vert << "\n";
 	}
 }
 
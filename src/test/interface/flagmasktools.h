@@ -0,0 +1,26 @@
+#ifndef AOFLAGGER_FLAGMASKTOOLS_H
+#define AOFLAGGER_FLAGMASKTOOLS_H
+
+#include "../../interface/aoflagger.h"
+
+#include <vector>
+
+class FlagMaskTools {
+	public:
+		/**
+		 * Returns the flags of the mask without its row padding, row by row, so
+		 * that masks with different strides can be compared.
+		 */
+		static std::vector<bool> ToVector(const aoflagger::FlagMask& mask)
+		{
+			std::vector<bool> flags(mask.Width() * mask.Height());
+			for(size_t y=0; y!=mask.Height(); ++y)
+			{
+				for(size_t x=0; x!=mask.Width(); ++x)
+					flags[y*mask.Width() + x] = mask.Buffer()[y*mask.HorizontalStride() + x];
+			}
+			return flags;
+		}
+};
+
+#endif
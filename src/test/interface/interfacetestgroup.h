@@ -0,0 +1,22 @@
+#ifndef AOFLAGGER_INTERFACETESTGROUP_H
+#define AOFLAGGER_INTERFACETESTGROUP_H
+
+#include "../testingtools/testgroup.h"
+
+#include "pythonstrategytest.h"
+#include "runbatchtest.h"
+#include "streamingflaggertest.h"
+
+class InterfaceTestGroup : public TestGroup {
+	public:
+		InterfaceTestGroup() : TestGroup("Library interface") { }
+		
+		virtual void Initialize() override
+		{
+			Add(new PythonStrategyTest());
+			Add(new RunBatchTest());
+			Add(new StreamingFlaggerTest());
+		}
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef AOFLAGGER_PYTHONSTRATEGYTEST_H
+#define AOFLAGGER_PYTHONSTRATEGYTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../python/gil.h"
+
+#include "../../strategy/actions/foreachbaselineaction.h"
+#include "../../strategy/actions/pythonaction.h"
+#include "../../strategy/actions/strategy.h"
+
+#include "../../strategy/control/artifactset.h"
+#include "../../strategy/control/defaultstrategy.h"
+
+#include "../../strategy/imagesets/imageset.h"
+
+#include "../../structures/image2d.h"
+#include "../../structures/mask2d.h"
+#include "../../structures/timefrequencydata.h"
+
+#include "../../util/progresslistener.h"
+
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+class PythonStrategyTest : public UnitTest {
+	public:
+		PythonStrategyTest() : UnitTest("Python strategy")
+		{
+			AddTest(TestParallelBaselines(), "Flagging baselines in parallel");
+		}
+
+	private:
+		struct TestParallelBaselines : public Asserter
+		{
+			void operator()();
+		};
+
+		/**
+		 * A set of baselines in memory, which stores the flags that are written
+		 * to it. Clones share the baselines and flags.
+		 */
+		class BaselineListSet : public rfiStrategy::ImageSet
+		{
+			public:
+				struct Baselines
+				{
+					std::vector<TimeFrequencyData> data;
+					std::vector<Mask2DCPtr> flags;
+				};
+
+				class Index : public rfiStrategy::ImageSetIndex
+				{
+					public:
+						Index(ImageSet& set, size_t value) : ImageSetIndex(set), _value(value) { }
+						void Previous() final override { --_value; }
+						void Next() final override { ++_value; }
+						std::string Description() const final override { return "Baseline " + std::to_string(_value); }
+						bool IsValid() const final override
+						{
+							return _value < static_cast<BaselineListSet&>(imageSet())._baselines->data.size();
+						}
+						std::unique_ptr<ImageSetIndex> Clone() const final override
+						{
+							return std::unique_ptr<ImageSetIndex>(new Index(*this));
+						}
+						size_t Value() const { return _value; }
+					private:
+						size_t _value;
+				};
+
+				explicit BaselineListSet(const std::shared_ptr<Baselines>& baselines) : _baselines(baselines)
+				{ }
+
+				std::unique_ptr<ImageSet> Clone() final override
+				{
+					return std::unique_ptr<ImageSet>(new BaselineListSet(_baselines));
+				}
+				std::unique_ptr<rfiStrategy::ImageSetIndex> StartIndex() final override
+				{
+					return std::unique_ptr<rfiStrategy::ImageSetIndex>(new Index(*this, 0));
+				}
+				void Initialize() final override { }
+				std::string Name() final override { return "Baseline list"; }
+				std::string File() final override { return std::string(); }
+				std::string TelescopeName() final override { return "Generic"; }
+				void AddReadRequest(const rfiStrategy::ImageSetIndex& index) final override
+				{
+					_requests.push_back(static_cast<const Index&>(index).Value());
+				}
+				void PerformReadRequests() final override
+				{
+					for(size_t request : _requests)
+						_read.emplace_back(new rfiStrategy::BaselineData(_baselines->data[request], TimeFrequencyMetaDataCPtr(), Index(*this, request)));
+					_requests.clear();
+				}
+				std::unique_ptr<rfiStrategy::BaselineData> GetNextRequested() final override
+				{
+					std::unique_ptr<rfiStrategy::BaselineData> baseline = std::move(_read.front());
+					_read.pop_front();
+					return baseline;
+				}
+				void AddWriteFlagsTask(const rfiStrategy::ImageSetIndex& index, std::vector<Mask2DCPtr>& flags) final override
+				{
+					_baselines->flags[static_cast<const Index&>(index).Value()] = flags.front();
+				}
+				void PerformWriteFlagsTask() final override
+				{ }
+
+			private:
+				std::shared_ptr<Baselines> _baselines;
+				std::vector<size_t> _requests;
+				std::deque<std::unique_ptr<rfiStrategy::BaselineData>> _read;
+		};
+
+		/**
+		 * Noise with RFI in one timestep and one channel that depend on the
+		 * baseline.
+		 */
+		static TimeFrequencyData makeBaseline(size_t index, size_t width, size_t height)
+		{
+			std::mt19937 rng(index);
+			std::normal_distribution<num_t> gaussian;
+			Image2DPtr image = Image2D::CreateUnsetImagePtr(width, height);
+			for(size_t y=0; y!=height; ++y)
+			{
+				for(size_t x=0; x!=width; ++x)
+				{
+					num_t value = std::fabs(gaussian(rng));
+					if(x == 10 + index*7 || y == (index*3) % height)
+						value += 100.0;
+					image->SetValue(x, y, value);
+				}
+			}
+			TimeFrequencyData data(TimeFrequencyData::AmplitudePart, Polarization::StokesI, image);
+			data.SetGlobalMask(Mask2D::CreateSetMaskPtr<false>(width, height));
+			return data;
+		}
+
+		/**
+		 * Flags all baselines in the way that the aoflagger program runs a .py
+		 * strategy, and returns the written flags.
+		 */
+		static std::vector<Mask2DCPtr> flagBaselines(rfiStrategy::Strategy& strategy, const std::shared_ptr<BaselineListSet::Baselines>& baselines, size_t threadCount)
+		{
+			baselines->flags.assign(baselines->data.size(), Mask2DCPtr());
+			rfiStrategy::Strategy::SetThreadCount(strategy, threadCount);
+			std::mutex ioMutex;
+			rfiStrategy::ArtifactSet artifacts(&ioMutex);
+			artifacts.SetImageSet(std::unique_ptr<rfiStrategy::ImageSet>(new BaselineListSet(baselines)));
+			DummyProgressListener progress;
+			strategy.InitializeAll();
+			strategy.Perform(artifacts, progress);
+			strategy.FinishAll();
+			return baselines->flags;
+		}
+
+		/**
+		 * The test needs the aoflagger Python module, which is not built in every
+		 * configuration.
+		 */
+		static bool hasPythonModule()
+		{
+			aoflagger_python::AcquireGIL gil;
+			PyObject* module = PyImport_ImportModule("aoflagger");
+			if(module == nullptr)
+			{
+				PyErr_Clear();
+				return false;
+			}
+			Py_DECREF(module);
+			return true;
+		}
+};
+
+inline void PythonStrategyTest::TestParallelBaselines::operator()()
+{
+	std::unique_ptr<rfiStrategy::Strategy> singleStrategy(new rfiStrategy::Strategy());
+	singleStrategy->Add(std::unique_ptr<rfiStrategy::PythonAction>(new rfiStrategy::PythonAction(
+		"import aoflagger\n"
+		"\n"
+		"def flag(data):\n"
+		"  aoflagger.sumthreshold(data, 1.0, 1.0, True, True)\n"
+		"\n"
+		"aoflagger.set_flag_function(flag)\n")));
+	if(!hasPythonModule())
+	{
+		std::cout << "(skipped: the aoflagger Python module was not found) ";
+		return;
+	}
+
+	rfiStrategy::DefaultStrategy::StrategySetup setup =
+		rfiStrategy::DefaultStrategy::DetermineSetup(rfiStrategy::DefaultStrategy::GENERIC_TELESCOPE, 0, 0.0, 0.0, 0.0);
+	setup.includeStatistics = false;
+	rfiStrategy::Strategy strategy;
+	rfiStrategy::DefaultStrategy::EncapsulateSingleStrategy(strategy, std::move(singleStrategy), setup);
+	// The baselines of the set have no antennas, so they are not cross-correlations
+	static_cast<rfiStrategy::ForEachBaselineAction&>(strategy.GetFirstChild()).SetSelection(rfiStrategy::All);
+
+	const size_t baselineCount = 8, width = 100, height = 40;
+	std::shared_ptr<BaselineListSet::Baselines> baselines(new BaselineListSet::Baselines());
+	for(size_t i=0; i!=baselineCount; ++i)
+		baselines->data.emplace_back(makeBaseline(i, width, height));
+
+	// The interpreter lock is released while sumthreshold computes, so the
+	// flag functions of the workers run interleaved.
+	const std::vector<Mask2DCPtr> expected = flagBaselines(strategy, baselines, 1);
+	const std::vector<Mask2DCPtr> results = flagBaselines(strategy, baselines, 3);
+	for(size_t i=0; i!=baselineCount; ++i)
+	{
+		AssertTrue(expected[i] != nullptr && results[i] != nullptr, "Flags were written");
+		AssertTrue(results[i]->Value(10 + i*7, 0), "RFI was flagged");
+		AssertTrue(*results[i] == *expected[i], "Flags equal those of a single thread");
+	}
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef AOFLAGGER_RUNBATCHTEST_H
+#define AOFLAGGER_RUNBATCHTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../interface/aoflagger.h"
+
+#include "flagmasktools.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+class RunBatchTest : public UnitTest {
+	public:
+		RunBatchTest() : UnitTest("Flagging a batch")
+		{
+			AddTest(TestEqualsSequential(), "Batch equals sequential flagging");
+		}
+		
+	private:
+		struct TestEqualsSequential : public Asserter
+		{
+			void operator()();
+		};
+};
+
+inline void RunBatchTest::TestEqualsSequential::operator()()
+{
+	const size_t count = 7, width = 100, height = 32;
+	aoflagger::AOFlagger flagger;
+	aoflagger::Strategy strategy = flagger.MakeStrategy();
+	std::vector<aoflagger::ImageSet> inputs;
+	std::mt19937 rng(1);
+	std::normal_distribution<float> gaussian;
+	for(size_t i=0; i!=count; ++i)
+	{
+		// Every baseline has different noise and RFI
+		inputs.emplace_back(flagger.MakeImageSet(width, height, 8));
+		for(size_t image=0; image!=8; ++image)
+		{
+			for(size_t y=0; y!=height; ++y)
+			{
+				float* row = inputs.back().ImageBuffer(image) + y*inputs.back().HorizontalStride();
+				for(size_t x=0; x!=width; ++x)
+				{
+					row[x] = gaussian(rng);
+					if(x == 10 + i*11 || y == (i*5) % height)
+						row[x] += 50.0;
+				}
+			}
+		}
+	}
+	
+	std::vector<std::vector<bool>> expected;
+	for(const aoflagger::ImageSet& input : inputs)
+		expected.emplace_back(FlagMaskTools::ToVector(flagger.Run(strategy, input)));
+	
+	for(size_t threadCount : {1, 4})
+	{
+		flagger.SetThreadCount(threadCount);
+		std::vector<aoflagger::FlagMask> results(count);
+		flagger.RunBatch(strategy, inputs.data(), results.data(), count);
+		for(size_t i=0; i!=count; ++i)
+		{
+			AssertEquals(results[i].Width(), width, "Width");
+			AssertTrue(FlagMaskTools::ToVector(results[i]) == expected[i], "Flags equal those of Run()");
+		}
+	}
+}
+
+#endif
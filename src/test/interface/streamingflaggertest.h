@@ -0,0 +1,156 @@
+#ifndef AOFLAGGER_STREAMINGFLAGGERTEST_H
+#define AOFLAGGER_STREAMINGFLAGGERTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../interface/aoflagger.h"
+
+#include "flagmasktools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+class StreamingFlaggerTest : public UnitTest {
+	public:
+		StreamingFlaggerTest() : UnitTest("Streaming flagger")
+		{
+			AddTest(TestSingleWindow(), "Single window equals whole image");
+			AddTest(TestUnevenChunks(), "Pushing uneven chunks");
+		}
+		
+	private:
+		struct TestSingleWindow : public Asserter
+		{
+			void operator()();
+		};
+		struct TestUnevenChunks : public Asserter
+		{
+			void operator()();
+		};
+		
+		/**
+		 * Noise with RFI at the first and last timesteps, in the middle and
+		 * in one channel.
+		 */
+		static aoflagger::ImageSet makeImage(aoflagger::AOFlagger& flagger, size_t width, size_t height)
+		{
+			aoflagger::ImageSet image = flagger.MakeImageSet(width, height, 1);
+			std::mt19937 rng(1);
+			std::normal_distribution<float> gaussian;
+			for(size_t y=0; y!=height; ++y)
+			{
+				float* row = image.ImageBuffer(0) + y*image.HorizontalStride();
+				for(size_t x=0; x!=width; ++x)
+				{
+					row[x] = std::fabs(gaussian(rng));
+					if(x == 1 || x == width/2 || x == width-2 || y == height/3)
+						row[x] += 100.0;
+				}
+			}
+			return image;
+		}
+		
+		static aoflagger::ImageSet slice(aoflagger::AOFlagger& flagger, const aoflagger::ImageSet& image, size_t start, size_t end)
+		{
+			aoflagger::ImageSet result = flagger.MakeImageSet(end - start, image.Height(), image.ImageCount());
+			for(size_t i=0; i!=image.ImageCount(); ++i)
+			{
+				for(size_t y=0; y!=image.Height(); ++y)
+					std::copy(image.ImageBuffer(i) + y*image.HorizontalStride() + start, image.ImageBuffer(i) + y*image.HorizontalStride() + end, result.ImageBuffer(i) + y*result.HorizontalStride());
+			}
+			return result;
+		}
+		
+		/**
+		 * Pushes the image in slices of the given sizes (repeating them), and
+		 * collects the flags in one mask with the width of the image.
+		 */
+		static std::vector<bool> stream(aoflagger::AOFlagger& flagger, aoflagger::Strategy& strategy, const aoflagger::ImageSet& image, size_t chunkSize, size_t guardSize, const std::vector<size_t>& sliceSizes)
+		{
+			const size_t width = image.Width(), height = image.Height();
+			aoflagger::StreamingFlagger streamer = flagger.MakeStreamingFlagger(strategy, height, image.ImageCount(), chunkSize, guardSize);
+			std::vector<bool> flags(width * height);
+			size_t x = 0, flaggedX = 0, pushCount = 0;
+			auto take = [&]()
+			{
+				while(streamer.ReadyCount() != 0)
+				{
+					aoflagger::FlagMask mask = streamer.TakeFlags();
+					for(size_t y=0; y!=height; ++y)
+					{
+						for(size_t i=0; i!=mask.Width(); ++i)
+							flags[y*width + flaggedX + i] = mask.Buffer()[y*mask.HorizontalStride() + i];
+					}
+					flaggedX += mask.Width();
+				}
+			};
+			while(x != width)
+			{
+				const size_t end = std::min(width, x + sliceSizes[pushCount % sliceSizes.size()]);
+				streamer.Push(slice(flagger, image, x, end));
+				x = end;
+				++pushCount;
+				take();
+			}
+			streamer.Finish();
+			take();
+			if(flaggedX != width || streamer.PendingCount() != 0)
+				flags.clear();
+			return flags;
+		}
+};
+
+inline void StreamingFlaggerTest::TestSingleWindow::operator()()
+{
+	// When the chunk and future guard hold all timesteps, the streamer flags
+	// the whole image at once in Finish(), and the flags should therefore
+	// be exactly those of flagging the image in one go.
+	aoflagger::AOFlagger flagger;
+	aoflagger::Strategy strategy = flagger.MakeStrategy();
+	const size_t width = 120, height = 24;
+	aoflagger::ImageSet image = makeImage(flagger, width, height);
+	const std::vector<bool> expected = FlagMaskTools::ToVector(flagger.Run(strategy, image));
+	const std::vector<bool> flags = stream(flagger, strategy, image, 100, 30, {1, 7, 3, 20, 13});
+	AssertEquals(flags.size(), expected.size(), "All timesteps flagged");
+	AssertTrue(flags == expected, "Flags equal those of the whole image");
+	AssertTrue(expected[1] && expected[width-2] && expected[width/2], "RFI was flagged");
+}
+
+inline void StreamingFlaggerTest::TestUnevenChunks::operator()()
+{
+	// The flags of each chunk are those of flagging the chunk with at most
+	// guardSize timesteps before and after it. The first chunk has no past
+	// guard and the last chunk has no future guard.
+	aoflagger::AOFlagger flagger;
+	aoflagger::Strategy strategy = flagger.MakeStrategy();
+	const size_t width = 230, height = 24, chunkSize = 50, guardSize = 20;
+	aoflagger::ImageSet image = makeImage(flagger, width, height);
+	std::vector<bool> expected(width * height);
+	for(size_t chunkStart=0; chunkStart<width; chunkStart+=chunkSize)
+	{
+		const size_t
+			windowStart = chunkStart > guardSize ? chunkStart - guardSize : 0,
+			windowEnd = std::min(width, chunkStart + chunkSize + guardSize),
+			chunkEnd = std::min(width, chunkStart + chunkSize);
+		const std::vector<bool> windowFlags = FlagMaskTools::ToVector(flagger.Run(strategy, slice(flagger, image, windowStart, windowEnd)));
+		const size_t windowWidth = windowEnd - windowStart;
+		for(size_t y=0; y!=height; ++y)
+		{
+			for(size_t x=chunkStart; x!=chunkEnd; ++x)
+				expected[y*width + x] = windowFlags[y*windowWidth + x - windowStart];
+		}
+	}
+	
+	for(const std::vector<size_t>& sliceSizes : std::vector<std::vector<size_t>>{ {1, 7, 3, 20}, {230}, {69, 71, 2} })
+	{
+		const std::vector<bool> flags = stream(flagger, strategy, image, chunkSize, guardSize, sliceSizes);
+		AssertEquals(flags.size(), expected.size(), "All timesteps flagged");
+		AssertTrue(flags == expected, "Flags equal those of flagging each window");
+	}
+	AssertTrue(expected[1] && expected[width-2] && expected[width/2], "RFI in the guard regions was flagged");
+}
+
+#endif
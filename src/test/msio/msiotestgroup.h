@@ -3,12 +3,15 @@
 
 #include "../testingtools/testgroup.h"
 
+#include "reorderedfilebuffertest.h"
+
 class MSIOTestGroup : public TestGroup {
 	public:
 		MSIOTestGroup() : TestGroup("Measurement set input/output") { }
 		
 		virtual void Initialize() override
 		{
+			Add(new ReorderedFileBufferTest());
 		}
 };
 
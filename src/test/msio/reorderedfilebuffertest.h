@@ -0,0 +1,80 @@
+#ifndef AOFLAGGER_REORDEREDFILEBUFFERTEST_H
+#define AOFLAGGER_REORDEREDFILEBUFFERTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../msio/reorderedfilebuffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+class ReorderedFileBufferTest : public UnitTest {
+	public:
+		ReorderedFileBufferTest() : UnitTest("Reordered file buffer")
+		{
+			AddTest(RandomWrites(), "Random writes");
+		}
+
+	private:
+		struct RandomWrites : public Asserter
+		{
+			void operator()();
+		};
+};
+
+inline void ReorderedFileBufferTest::RandomWrites::operator()()
+{
+	const char* filename = "aoflagger-reorderedfilebuffertest.tmp";
+	const size_t blockSize = 24, blockCount = 1000, largeSize = 8192;
+	const size_t fileSize = blockSize * blockCount + largeSize;
+	{
+		std::ofstream file(filename, std::ios::binary);
+		std::vector<char> zeros(fileSize, 0);
+		file.write(zeros.data(), zeros.size());
+	}
+
+	std::vector<char> expected(fileSize);
+	// Blocks are written in a shuffled order, and each block in parts, like
+	// the timesteps of a baseline. The small buffer size forces several flushes.
+	std::vector<size_t> order(blockCount);
+	for(size_t i=0; i!=blockCount; ++i)
+		order[i] = i;
+	std::mt19937 rng(42);
+	std::shuffle(order.begin(), order.end(), rng);
+	{
+		ReorderedFileBuffer buffer(filename, 4096);
+		for(size_t block : order)
+		{
+			buffer.seekp(block * blockSize);
+			for(size_t part=0; part!=3; ++part)
+			{
+				char data[blockSize/3];
+				for(size_t i=0; i!=blockSize/3; ++i)
+				{
+					data[i] = char(rng());
+					expected[block * blockSize + part * blockSize/3 + i] = data[i];
+				}
+				buffer.write(data, blockSize/3);
+			}
+		}
+		// A write that is larger than the buffer
+		std::vector<char> large(largeSize, 'x');
+		std::copy(large.begin(), large.end(), expected.begin() + blockSize * blockCount);
+		buffer.seekp(blockSize * blockCount);
+		buffer.write(large.data(), large.size());
+		buffer.flush();
+	}
+
+	std::ifstream file(filename, std::ios::binary);
+	std::vector<char> result((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::remove(filename);
+	AssertEquals(result.size(), expected.size(), "File size");
+	AssertTrue(result == expected, "File contents");
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef AOFLAGGER_HEATMAPRENDERERTEST_H
+#define AOFLAGGER_HEATMAPRENDERERTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../plot/heatmaprenderer.h"
+
+#include "../../structures/colormap.h"
+#include "../../structures/image2d.h"
+#include "../../structures/mask2d.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+class HeatMapRendererTest : public UnitTest {
+	public:
+		HeatMapRendererTest() : UnitTest("Heat map renderer")
+		{
+			AddTest(TestFullResolution(), "Colouring the full resolution image");
+			AddTest(TestLevels(), "Colouring block means with mask blending");
+		}
+		
+	private:
+		struct TestFullResolution : public Asserter
+		{
+			void operator()();
+		};
+		struct TestLevels : public Asserter
+		{
+			void operator()();
+		};
+		
+		typedef std::array<unsigned char, 4> Color;
+		
+		static const size_t Width = 203, Height = 77;
+		
+		/**
+		 * Positive values, except for a few that are zero or negative, which
+		 * a logarithmic scale shows with the first colour.
+		 */
+		static Image2DPtr makeImage()
+		{
+			std::mt19937 rng(1);
+			std::uniform_real_distribution<num_t> uniform(1.0, 100.0);
+			Image2DPtr image = Image2D::CreateUnsetImagePtr(Width, Height);
+			for(size_t y=0; y!=Height; ++y)
+			{
+				for(size_t x=0; x!=Width; ++x)
+					image->SetValue(x, y, (x*y) % 97 == 5 ? -num_t(x % 2) : uniform(rng) + x * 0.5);
+			}
+			return image;
+		}
+		
+		static Mask2DPtr makeMask(size_t period, size_t seed)
+		{
+			std::mt19937 rng(seed);
+			Mask2DPtr mask = Mask2D::CreateSetMaskPtr<false>(Width, Height);
+			for(size_t y=0; y!=Height; ++y)
+			{
+				for(size_t x=0; x!=Width; ++x)
+					mask->SetValue(x, y, rng() % period == 0);
+			}
+			return mask;
+		}
+		
+		/**
+		 * The colour of the entry of the colour table that the value maps to.
+		 */
+		static Color tableColor(const ColorMap& colorMap, num_t value, num_t min, num_t max, bool logarithmic)
+		{
+			const size_t tableSize = HeatMapRenderer::ColorTableSize;
+			double position;
+			if(logarithmic)
+				position = value > 0.0 ? (std::log10(value) - std::log10(min)) / (std::log10(max) - std::log10(min)) : 0.0;
+			else
+				position = (value - min) / (max - min);
+			position = std::max(0.0, std::min(1.0, position)) * (tableSize - 1);
+			const long double mapValue = (2.0L * size_t(position + 0.5)) / (tableSize - 1) - 1.0L;
+			return Color{{
+				colorMap.ValueToColorB(mapValue), colorMap.ValueToColorG(mapValue),
+				colorMap.ValueToColorR(mapValue), colorMap.ValueToColorA(mapValue) }};
+		}
+		
+		static int maxDifference(const Color& a, const Color& b)
+		{
+			int difference = 0;
+			for(size_t c=0; c!=4; ++c)
+				difference = std::max(difference, std::abs(int(a[c]) - int(b[c])));
+			return difference;
+		}
+		
+		static Color pixel(const std::vector<unsigned char>& data, const HeatMapRenderer::Region& region, size_t x, size_t y)
+		{
+			// The bottom row of the region is written first
+			const unsigned char* p = &data[((region.endY - y - 1) * region.Width() + x - region.startX) * 4];
+			return Color{{ p[0], p[1], p[2], p[3] }};
+		}
+};
+
+inline void HeatMapRendererTest::TestFullResolution::operator()()
+{
+	Image2DPtr image = makeImage();
+	Mask2DPtr original = makeMask(10, 2), alternative = makeMask(7, 3);
+	std::unique_ptr<ColorMap> colorMap = ColorMap::CreateColorMap(ColorMap::Viridis);
+	const Color originalColor{{255, 0, 255, 255}}, alternativeColor{{0, 255, 255, 255}};
+	for(bool logarithmic : {false, true})
+	{
+		HeatMapRenderer renderer;
+		renderer.SetImage(image, {{nullptr, original, alternative}});
+		renderer.SetColorMap(*colorMap, 1.0, 200.0, logarithmic);
+		renderer.SetMaskColor(HeatMapRenderer::OriginalMask, 255, 0, 255);
+		renderer.SetMaskColor(HeatMapRenderer::AlternativeMask, 255, 255, 0);
+		
+		const HeatMapRenderer::Region region = renderer.SelectRegion(0, Width, 0, Height, Width, Height);
+		AssertEquals(region.horizontalLevel + region.verticalLevel, 0u, "Full resolution");
+		std::vector<unsigned char> data(region.Width() * region.Height() * 4);
+		renderer.Render(region, data.data(), region.Width() * 4);
+		
+		int difference = 0;
+		for(size_t y=0; y!=Height; ++y)
+		{
+			for(size_t x=0; x!=Width; ++x)
+			{
+				Color expected;
+				if(original->Value(x, y))
+					expected = originalColor;
+				else if(alternative->Value(x, y))
+					expected = alternativeColor;
+				else
+					expected = tableColor(*colorMap, image->Value(x, y), 1.0, 200.0, logarithmic);
+				difference = std::max(difference, maxDifference(pixel(data, region, x, y), expected));
+			}
+		}
+		AssertLessThan(difference, 2, "Pixels have the colour of their sample");
+	}
+}
+
+inline void HeatMapRendererTest::TestLevels::operator()()
+{
+	Image2DPtr image = makeImage();
+	Mask2DPtr original = makeMask(10, 2), alternative = makeMask(7, 3);
+	std::unique_ptr<ColorMap> colorMap = ColorMap::CreateColorMap(ColorMap::Viridis);
+	const Color originalColor{{255, 0, 255, 255}}, alternativeColor{{0, 255, 255, 255}};
+	for(bool logarithmic : {false, true})
+	{
+		HeatMapRenderer renderer;
+		renderer.SetImage(image, {{nullptr, original, alternative}});
+		renderer.SetColorMap(*colorMap, 1.0, 200.0, logarithmic);
+		renderer.SetMaskColor(HeatMapRenderer::OriginalMask, 255, 0, 255);
+		renderer.SetMaskColor(HeatMapRenderer::AlternativeMask, 255, 255, 0);
+		
+		// The whole image, and a part that does not start at a block boundary
+		for(const std::array<size_t, 4>& area : { std::array<size_t, 4>{{0, Width, 0, Height}}, std::array<size_t, 4>{{37, 190, 11, 70}} })
+		{
+			const HeatMapRenderer::Region region = renderer.SelectRegion(area[0], area[1], area[2], area[3], (area[1] - area[0]) / 4, (area[3] - area[2]) / 3);
+			AssertTrue(region.horizontalLevel != 0 && region.verticalLevel != 0, "Both directions are averaged");
+			std::vector<unsigned char> data(region.Width() * region.Height() * 4);
+			renderer.Render(region, data.data(), region.Width() * 4);
+			
+			const size_t
+				blockWidth = size_t(1) << region.horizontalLevel,
+				blockHeight = size_t(1) << region.verticalLevel;
+			int difference = 0;
+			for(size_t levelY=region.startY; levelY!=region.endY; ++levelY)
+			{
+				for(size_t levelX=region.startX; levelX!=region.endX; ++levelX)
+				{
+					// The mean of the samples that are not flagged, mixed with the
+					// colours of the masks in proportion to their flags.
+					double sum = 0.0;
+					size_t count = 0, originalCount = 0, alternativeCount = 0, blockSize = 0;
+					for(size_t y=levelY*blockHeight; y!=std::min(Height, (levelY+1)*blockHeight); ++y)
+					{
+						for(size_t x=levelX*blockWidth; x!=std::min(Width, (levelX+1)*blockWidth); ++x)
+						{
+							++blockSize;
+							if(original->Value(x, y))
+								++originalCount;
+							else if(alternative->Value(x, y))
+								++alternativeCount;
+							else {
+								sum += image->Value(x, y);
+								++count;
+							}
+						}
+					}
+					const num_t mean = count == 0 ? 0.0 : sum / count;
+					const Color color = tableColor(*colorMap, mean, 1.0, 200.0, logarithmic);
+					const double
+						originalFraction = double(originalCount) / blockSize,
+						alternativeFraction = double(alternativeCount) / blockSize;
+					Color expected;
+					for(size_t c=0; c!=4; ++c)
+					{
+						const double mixed = (1.0 - originalFraction - alternativeFraction) * color[c] +
+							originalFraction * originalColor[c] + alternativeFraction * alternativeColor[c];
+						expected[c] = (unsigned char) std::min(mixed + 0.5, 255.0);
+					}
+					difference = std::max(difference, maxDifference(pixel(data, region, levelX, levelY), expected));
+				}
+			}
+			AssertLessThan(difference, 2, "Blocks have the colour of their mean and flags");
+		}
+	}
+}
+
+#endif
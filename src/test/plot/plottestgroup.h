@@ -0,0 +1,18 @@
+#ifndef AOFLAGGER_PLOTTESTGROUP_H
+#define AOFLAGGER_PLOTTESTGROUP_H
+
+#include "../testingtools/testgroup.h"
+
+#include "heatmaprenderertest.h"
+
+class PlotTestGroup : public TestGroup {
+	public:
+		PlotTestGroup() : TestGroup("Plotting") { }
+		
+		virtual void Initialize() override
+		{
+			Add(new HeatMapRendererTest());
+		}
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef AOFLAGGER_LOGHISTOGRAMTEST_H
+#define AOFLAGGER_LOGHISTOGRAMTEST_H
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../quality/loghistogram.h"
+
+class LogHistogramTest : public UnitTest {
+	public:
+		LogHistogramTest() : UnitTest("Log histogram")
+		{
+			AddTest(TestGetBins(), "Finding bins from float bits");
+			AddTest(TestAdd(), "Adding values and histograms");
+			AddTest(TestSerialization(), "Serialization");
+		}
+		
+	private:
+		struct TestGetBins : public Asserter
+		{
+			void operator()();
+		};
+		struct TestAdd : public Asserter
+		{
+			void operator()();
+		};
+		struct TestSerialization : public Asserter
+		{
+			void operator()();
+		};
+		
+		static size_t binCount(const LogHistogram &histogram)
+		{
+			size_t count = 0;
+			for(LogHistogram::const_iterator i=histogram.begin(); i!=histogram.end(); ++i)
+				++count;
+			return count;
+		}
+		
+		static int referenceBin(float amplitude)
+		{
+			return int(round(100.0*log10(amplitude)));
+		}
+};
+
+void LogHistogramTest::TestGetBins::operator()()
+{
+	std::vector<float> amplitudes;
+	// Values over the full range of normal floats, and the floats around the
+	// bin boundaries.
+	for(float a=std::numeric_limits<float>::min(); a<std::numeric_limits<float>::max()/1.0011f; a*=1.0011f)
+		amplitudes.push_back(a);
+	for(int bin=-3700; bin<3800; bin+=7)
+	{
+		const float boundary = exp10((bin - 0.5) / 100.0);
+		amplitudes.push_back(boundary);
+		amplitudes.push_back(std::nextafter(boundary, 0.0f));
+		amplitudes.push_back(std::nextafter(boundary, std::numeric_limits<float>::max()));
+	}
+	amplitudes.push_back(std::numeric_limits<float>::max());
+	amplitudes.push_back(std::numeric_limits<float>::denorm_min());
+	amplitudes.push_back(1e-40f);
+	amplitudes.push_back(1.0f);
+	std::vector<int> bins(amplitudes.size());
+	LogHistogram::GetBins(amplitudes.data(), bins.data(), amplitudes.size());
+	size_t errors = 0;
+	for(size_t i=0; i!=amplitudes.size(); ++i)
+	{
+		if(bins[i] != referenceBin(amplitudes[i]))
+			++errors;
+	}
+	AssertEquals(errors, size_t(0), "Bins that differ from round(100 log10(x))");
+	
+	const float specials[5] = { 0.0f, -0.0f, -1.0f,
+		std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN() };
+	int specialBins[5];
+	LogHistogram::GetBins(specials, specialBins, 5);
+	AssertEquals(specialBins[0], LogHistogram::ZeroBin, "Zero");
+	AssertEquals(specialBins[1], LogHistogram::ZeroBin, "Negative zero");
+	AssertEquals(specialBins[2], LogHistogram::InvalidBin, "Negative");
+	AssertEquals(specialBins[3], LogHistogram::InvalidBin, "Infinity");
+	AssertEquals(specialBins[4], LogHistogram::InvalidBin, "NaN");
+}
+
+void LogHistogramTest::TestAdd::operator()()
+{
+	LogHistogram histogramA, histogramB;
+	const float amplitudes[6] = { 0.0f, 1.0f, 1.0f, 10.0f, 1000.0f, std::numeric_limits<float>::quiet_NaN() };
+	const bool selection[6] = { false, true, false, true, false, true };
+	int bins[6];
+	LogHistogram::GetBins(amplitudes, bins, 6);
+	histogramA.AddBins(bins, 6);
+	histogramB.AddBins(bins, selection, 6);
+	
+	LogHistogram::const_iterator i = histogramA.begin();
+	AssertEquals(i.value(), 0.0, "Zero bin");
+	AssertEquals(i.unnormalizedCount(), 1ul, "Zero bin count");
+	++i;
+	AssertEquals(i.value(), 1.0, "First positive bin");
+	AssertEquals(i.unnormalizedCount(), 2ul, "First positive bin count");
+	++i;
+	AssertAlmostEqual(i.value(), 10.0, "Second positive bin");
+	++i;
+	AssertAlmostEqual(i.value(), 1000.0, "Third positive bin");
+	AssertEquals(binCount(histogramA), size_t(4), "Number of bins");
+	AssertAlmostEqual(histogramA.MaxAmplitude(), 1000.0, "MaxAmplitude()");
+	AssertEquals(histogramA.MinPositiveAmplitude(), 1.0, "MinPositiveAmplitude()");
+	
+	histogramB.Add(-10.0);
+	histogramB.Add(histogramA);
+	i = histogramB.begin();
+	AssertAlmostEqual(i.value(), -10.0, "Negative bin");
+	++i;
+	AssertEquals(i.value(), 0.0, "Zero bin after adding");
+	++i;
+	AssertEquals(i.unnormalizedCount(), 3ul, "Count after adding");
+	
+	histogramB -= histogramA;
+	AssertEquals(histogramB.NormalizedTotalCount(), 3.0, "Count after subtracting");
+	
+	histogramA.CreateMissingBins();
+	AssertEquals(binCount(histogramA), size_t(302), "Bins after CreateMissingBins()");
+}
+
+void LogHistogramTest::TestSerialization::operator()()
+{
+	LogHistogram histogram;
+	histogram.Add(-2.0);
+	histogram.Add(0.0);
+	histogram.Add(0.5);
+	histogram.Add(0.5);
+	histogram.Add(1e30);
+	
+	std::stringstream stream;
+	histogram.Serialize(stream);
+	
+	// The format is a bin count followed by (central amplitude, count) pairs
+	AssertEquals(Serializable::UnserializeUInt64(stream), uint64_t(4), "Bin count");
+	const double expectedValues[4] = { -exp10(30/100.0), 0.0, exp10(-30/100.0), exp10(30.0) };
+	const uint64_t expectedCounts[4] = { 1, 1, 2, 1 };
+	for(size_t i=0; i!=4; ++i)
+	{
+		AssertEquals(Serializable::UnserializeDouble(stream), expectedValues[i], "Central amplitude");
+		AssertEquals(Serializable::UnserializeUInt64(stream), expectedCounts[i], "Count");
+	}
+	
+	stream.seekg(0);
+	LogHistogram copy;
+	copy.Unserialize(stream);
+	std::stringstream copyStream;
+	copy.Serialize(copyStream);
+	AssertEquals(copyStream.str(), stream.str(), "Serialization after unserializing");
+}
+
+#endif
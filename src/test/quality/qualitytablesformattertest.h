@@ -22,6 +22,7 @@ class QualityTablesFormatterTest : public UnitTest {
 			AddTest(TestKindOperations(), "Statistic kind operations");
 			AddTest(TestKindNames(), "Statistic kind names");
 			AddTest(TestStoreStatistics(), "Storing statistics");
+			AddTest(TestBulkStoreStatistics(), "Storing statistics in bulk");
 		}
     virtual ~QualityTablesFormatterTest()
 		{
@@ -63,6 +64,10 @@ class QualityTablesFormatterTest : public UnitTest {
 		{
 			void operator()();
 		};
+		struct TestBulkStoreStatistics : public Asserter
+		{
+			void operator()();
+		};
 };
 
 void QualityTablesFormatterTest::TestConstructor::operator()()
@@ -188,6 +193,58 @@ void QualityTablesFormatterTest::TestStoreStatistics::operator()()
 	qd.RemoveTable(QualityTablesFormatter::TimeStatisticTable);
 }
 
+void QualityTablesFormatterTest::TestBulkStoreStatistics::operator()()
+{
+	QualityTablesFormatter qd("QualityTest.MS");
+	
+	qd.RemoveAllQualityTables();
+	qd.InitializeEmptyTable(QualityTablesFormatter::KindNameTable, 2);
+	qd.InitializeEmptyTable(QualityTablesFormatter::BaselineStatisticTable, 2);
+	unsigned meanStatIndex = qd.StoreKindName(QualityTablesFormatter::MeanStatistic);
+	unsigned countStatIndex = qd.StoreKindName(QualityTablesFormatter::CountStatistic);
+	
+	std::vector<std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> > stored;
+	for(unsigned i=0;i!=10;++i)
+	{
+		QualityTablesFormatter::BaselinePosition position;
+		position.antenna1 = i;
+		position.antenna2 = i + 1;
+		position.frequency = 107000000.0 + i;
+		StatisticalValue value(2);
+		value.SetKindIndex((i%2 == 0) ? meanStatIndex : countStatIndex);
+		value.SetValue(0, std::complex<float>(i, 1.0));
+		value.SetValue(1, std::complex<float>(-1.0, i));
+		stored.push_back(std::make_pair(position, value));
+	}
+	qd.StoreBaselineValues(stored);
+	qd.StoreBaselineValues(std::vector<std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> >());
+	AssertEquals(qd.QueryStatisticRowCount(QualityTablesFormatter::BaselineDimension), (size_t) 10, "QueryStatisticRowCount()");
+	AssertEquals(qd.QueryStatisticEntryCount(QualityTablesFormatter::BaselineDimension, meanStatIndex), 5u, "QueryStatisticEntryCount()");
+	
+	std::vector<std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> > entries;
+	qd.QueryBaselineStatisticRows(2, 6, entries);
+	AssertEquals(entries.size(), (size_t) 6, "entries.size() of row range");
+	for(unsigned i=0;i!=6;++i)
+	{
+		const std::pair<QualityTablesFormatter::BaselinePosition, StatisticalValue> &entry = entries[i];
+		AssertEquals(entry.first.antenna1, i + 2, "antenna1");
+		AssertEquals(entry.first.antenna2, i + 3, "antenna2");
+		AssertEquals(entry.first.frequency, 107000000.0 + i + 2, "frequency");
+		AssertEquals(entry.second.KindIndex(), stored[i+2].second.KindIndex(), "KindIndex()");
+		AssertEquals(entry.second.Value(0), stored[i+2].second.Value(0), "Value(0)");
+		AssertEquals(entry.second.Value(1), stored[i+2].second.Value(1), "Value(1)");
+	}
+	
+	entries.clear();
+	qd.QueryBaselineStatistic(countStatIndex, entries);
+	AssertEquals(entries.size(), (size_t) 5, "entries.size() of kind");
+	AssertEquals(entries[4].first.antenna1, 9u, "antenna1 of last entry");
+	AssertEquals(entries[4].second.Value(1), std::complex<float>(-1.0, 9.0), "Value(1) of last entry");
+	
+	qd.RemoveTable(QualityTablesFormatter::KindNameTable);
+	qd.RemoveTable(QualityTablesFormatter::BaselineStatisticTable);
+}
+
 void QualityTablesFormatterTest::TestKindNames::operator()()
 {
 	AssertEquals(QualityTablesFormatter::KindToName(QualityTablesFormatter::MeanStatistic), "Mean");
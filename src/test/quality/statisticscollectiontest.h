@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <iomanip>
+#include <limits>
 
 #include "../testingtools/asserter.h"
 #include "../testingtools/unittest.h"
@@ -18,6 +19,8 @@ class StatisticsCollectionTest : public UnitTest {
 			AddTest(TestStatisticsCollecting(), "Collecting statistics");
 			AddTest(TestImageCollecting(), "Collecting from image");
 			AddTest(TestComparison<false>(), "Add() and AddImage() do the same thing");
+			AddTest(TestNonFiniteSamples(), "Skipping non-finite samples");
+			AddTest(TestChangingMaps(), "Adding after changing the maps");
 			//AddTest(TestComparison<true>(), "Speed of collecting");
 		}
 	private:
@@ -69,6 +72,14 @@ class StatisticsCollectionTest : public UnitTest {
 		{
 			void operator()();
 		};
+		struct TestNonFiniteSamples : public Asserter
+		{
+			void operator()();
+		};
+		struct TestChangingMaps : public Asserter
+		{
+			void operator()();
+		};
 		template<bool SpeedTest>
 		struct TestComparison : public Asserter
 		{
@@ -224,6 +235,75 @@ void StatisticsCollectionTest::TestImageCollecting::operator()()
 	AssertEquals(statistics.sum->real(), 6.0, "real sum");
 }
 
+void StatisticsCollectionTest::TestNonFiniteSamples::operator()()
+{
+	// An odd number of samples, so that not all samples fit in whole lanes
+	const size_t nsamples = 11;
+	StatisticsCollection collection(1);
+	std::vector<double> frequencies(nsamples);
+	for(size_t i=0; i!=nsamples; ++i)
+		frequencies[i] = 100 + i;
+	collection.InitializeBand(0, frequencies.data(), nsamples);
+	float reals[nsamples], imags[nsamples];
+	bool isRFI[nsamples], isPreFlagged[nsamples];
+	for(size_t i=0; i!=nsamples; ++i)
+	{
+		reals[i] = i;
+		imags[i] = 2*i;
+		isRFI[i] = (i == 3);
+		isPreFlagged[i] = (i == 4);
+	}
+	reals[7] = std::numeric_limits<float>::quiet_NaN();
+	imags[9] = std::numeric_limits<float>::infinity();
+	collection.Add(0, 1, 0.0, 0, 0, reals, imags, isRFI, isPreFlagged, nsamples, 1, 1, 1);
+	
+	DefaultStatistics statistics(1);
+	collection.GetGlobalCrossBaselineStatistics(statistics);
+	// Samples 0, 1, 2, 5, 6, 8 and 10 are used
+	AssertEquals(statistics.count[0], 7ul, "count");
+	AssertEquals(statistics.rfiCount[0], 1ul, "rfi count");
+	AssertEquals(statistics.sum->real(), 32.0, "real sum");
+	AssertEquals(statistics.sum->imag(), 64.0, "imag sum");
+	AssertEquals(statistics.sumP2->real(), 230.0, "real sum^2");
+	AssertEquals(statistics.sumP2->imag(), 920.0, "imag sum^2");
+	// Differences 0-1, 1-2 and 5-6 are used
+	AssertEquals(statistics.dCount[0], 3ul, "dCount");
+	AssertAlmostEqual(statistics.dSum->real(), 3.0 * M_SQRT1_2, "real dSum");
+	
+	collection.GetGlobalTimeStatistics(statistics);
+	AssertEquals(statistics.count[0], 7ul, "time count");
+}
+
+void StatisticsCollectionTest::TestChangingMaps::operator()()
+{
+	StatisticsCollection collection(1);
+	double frequencies[3] = {100, 101, 102};
+	collection.InitializeBand(0, frequencies, 3);
+	float
+		reals[3] = { 1.0, 2.0, 3.0 },
+		imags[3] = { 4.0, 6.0, 8.0 };
+	bool isRFI[3] = { false, false, false };
+	for(size_t t=0; t!=4; ++t)
+		collection.Add(0, 1, t, 0, 0, reals, imags, isRFI, isRFI, 3, 1, 1, 1);
+	collection.LowerTimeResolution(1);
+	collection.Add(0, 1, 4.0, 0, 0, reals, imags, isRFI, isRFI, 3, 1, 1, 1);
+	AssertEquals(collection.TimeStatistics().size(), (size_t) 2, "Time steps after lowering resolution");
+	DefaultStatistics statistics(1);
+	collection.GetGlobalTimeStatistics(statistics);
+	AssertEquals(statistics.count[0], 15ul, "Count after lowering resolution");
+	
+	double frequencies2[3] = {200, 201, 202};
+	collection.InitializeBand(1, frequencies2, 3);
+	collection.Add(0, 1, 0.0, 1, 0, reals, imags, isRFI, isRFI, 3, 1, 1, 1);
+	collection.IntegrateBaselinesToOneChannel();
+	collection.IntegrateTimeToOneChannel();
+	collection.Add(0, 1, 0.0, 0, 0, reals, imags, isRFI, isRFI, 3, 1, 1, 1);
+	collection.GetGlobalTimeStatistics(statistics);
+	AssertEquals(statistics.count[0], 21ul, "Time count after integrating");
+	collection.GetGlobalCrossBaselineStatistics(statistics);
+	AssertEquals(statistics.count[0], 21ul, "Baseline count after integrating");
+}
+
 template<bool SpeedTest>
 void StatisticsCollectionTest::TestComparison<SpeedTest>::operator()()
 {
@@ -12,6 +12,7 @@
 #include "statisticalflaggertest.h"
 #include "sumthresholdtest.h"
 #include "sumthresholdmissingtest.h"
+#include "svdmitigatertest.h"
 #include "thresholdtoolstest.h"
 
 class AlgorithmsTestGroup : public TestGroup {
@@ -29,6 +30,7 @@ public:
 		Add(new StatisticalFlaggerTest());
 		Add(new SumThresholdTest());
 		Add(new SumThresholdMissingTest());
+		Add(new SVDMitigaterTest());
 		Add(new ThresholdToolsTest());
 	}
 };
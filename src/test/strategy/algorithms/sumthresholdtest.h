@@ -22,11 +22,22 @@ class SumThresholdTest : public UnitTest {
 			AddTest(HorizontalSumThresholdSSE(), "SumThreshold optimized SSE version (horizontal)");
 			AddTest(StabilitySSE(), "SumThreshold stability (SSE)");
 #endif
-#ifdef __AVX2__
-			AddTest(SimpleVerticalSumThresholdAVX(), "Simple SumThreshold AVX case (vertical)");
-			AddTest(VerticalSumThresholdAVX(), "SumThreshold optimized AVX version (vertical)");
-			AddTest(StabilityAVX(), "SumThreshold stability (AVX)");
+#ifdef HAVE_AVX_KERNELS
+			if(SIMDSupport::Has(SIMDSupport::AVX2))
+			{
+				AddTest(SimpleVerticalSumThresholdAVX(), "Simple SumThreshold AVX case (vertical)");
+				AddTest(VerticalSumThresholdAVX(), "SumThreshold optimized AVX version (vertical)");
+				AddTest(HorizontalSumThresholdAVX(), "SumThreshold optimized AVX version (horizontal)");
+				AddTest(StabilityAVX(), "SumThreshold stability (AVX)");
+			}
+			if(SIMDSupport::Has(SIMDSupport::AVX512))
+			{
+				AddTest(VerticalSumThresholdAVX512(), "SumThreshold optimized AVX-512 version (vertical)");
+				AddTest(HorizontalSumThresholdAVX512(), "SumThreshold optimized AVX-512 version (horizontal)");
+				AddTest(StabilityAVX512(), "SumThreshold stability (AVX-512)");
+			}
 #endif
+			AddTest(DispatchedKernels(), "SumThreshold kernel tables for all supported SIMD levels");
 		}
 		
 	private:
@@ -44,7 +55,7 @@ class SumThresholdTest : public UnitTest {
 			void operator()();
 		};
 #endif
-#ifdef __AVX2__
+#ifdef HAVE_AVX_KERNELS
 		struct SimpleVerticalSumThresholdAVX : public Asserter
 		{
 			void operator()();
@@ -53,11 +64,36 @@ class SumThresholdTest : public UnitTest {
 		{
 			void operator()();
 		};
+		struct HorizontalSumThresholdAVX : public Asserter
+		{
+			void operator()();
+		};
 		struct StabilityAVX : public Asserter
 		{
 			void operator()();
 		};
+		struct VerticalSumThresholdAVX512 : public Asserter
+		{
+			void operator()();
+		};
+		struct HorizontalSumThresholdAVX512 : public Asserter
+		{
+			void operator()();
+		};
+		struct StabilityAVX512 : public Asserter
+		{
+			void operator()();
+		};
 #endif
+		typedef void (*LengthKernel)(const Image2D* input, Mask2D* mask, Mask2D* scratch, size_t length, num_t threshold);
+		
+		static void compareWithReference(Asserter& asserter, LengthKernel kernel, LengthKernel reference, size_t width, size_t height, const std::string& name);
+		
+		static void testStability(LengthKernel horizontal, LengthKernel vertical);
+		struct DispatchedKernels : public Asserter
+		{
+			void operator()();
+		};
 };
 
 #ifdef __SSE__
@@ -173,7 +209,7 @@ void SumThresholdTest::StabilitySSE::operator()()
 }
 #endif // __SSE__
 
-#ifdef __AVX2__
+#ifdef HAVE_AVX_KERNELS
 void SumThresholdTest::VerticalSumThresholdAVX::operator()()
 {
 	const unsigned
@@ -275,16 +311,156 @@ void SumThresholdTest::StabilityAVX::operator()()
 	for(unsigned i=0;i<9;++i)
 	{
 		const unsigned length = config.GetHorizontalLength(i);
-		//SumThreshold::HorizontalLargeAVX(&realA, &maskA, &scratch, length, 1.0);
+		SumThreshold::HorizontalLargeAVX(&realA, &maskA, &scratch, length, 1.0);
 		SumThreshold::VerticalLargeAVX(&realA, &maskA, &scratch, length, 1.0);
-		//SumThreshold::HorizontalLargeAVX(&realA, &maskB, &scratch, length, 1.0);
+		SumThreshold::HorizontalLargeAVX(&realA, &maskB, &scratch, length, 1.0);
 		SumThreshold::VerticalLargeAVX(&realA, &maskB, &scratch, length, 1.0);
-		//SumThreshold::HorizontalLargeAVX(&realA, &maskC, &scratch, length, 1.0);
+		SumThreshold::HorizontalLargeAVX(&realA, &maskC, &scratch, length, 1.0);
 		SumThreshold::VerticalLargeAVX(&realA, &maskC, &scratch, length, 1.0);
-		//SumThreshold::HorizontalLargeAVX(&realA, &maskD, &scratch, length, 1.0);
+		SumThreshold::HorizontalLargeAVX(&realA, &maskD, &scratch, length, 1.0);
 		SumThreshold::VerticalLargeAVX(&realA, &maskD, &scratch, length, 1.0);
 	}
 }
-#endif // __AVX2__
+
+void SumThresholdTest::HorizontalSumThresholdAVX::operator()()
+{
+	// Sizes that are not a multiple of 8 test the remainders of the kernel
+	compareWithReference(*this, &SumThreshold::HorizontalLargeAVX, &SumThreshold::HorizontalLargeReference, 2048, 256, "AVX");
+	compareWithReference(*this, &SumThreshold::HorizontalLargeAVX, &SumThreshold::HorizontalLargeReference, 1001, 85, "AVX");
+}
+
+void SumThresholdTest::VerticalSumThresholdAVX512::operator()()
+{
+	compareWithReference(*this, &SumThreshold::VerticalLargeAVX512, &SumThreshold::VerticalLargeReference, 2048, 256, "AVX-512");
+	compareWithReference(*this, &SumThreshold::VerticalLargeAVX512, &SumThreshold::VerticalLargeReference, 1001, 85, "AVX-512");
+}
+
+void SumThresholdTest::HorizontalSumThresholdAVX512::operator()()
+{
+	compareWithReference(*this, &SumThreshold::HorizontalLargeAVX512, &SumThreshold::HorizontalLargeReference, 2048, 256, "AVX-512");
+	compareWithReference(*this, &SumThreshold::HorizontalLargeAVX512, &SumThreshold::HorizontalLargeReference, 1001, 85, "AVX-512");
+	compareWithReference(*this, &SumThreshold::HorizontalLargeAVX512, &SumThreshold::HorizontalLargeReference, 500, 30, "AVX-512");
+}
+
+void SumThresholdTest::StabilityAVX512::operator()()
+{
+	testStability(&SumThreshold::HorizontalLargeAVX512, &SumThreshold::VerticalLargeAVX512);
+}
+#endif // HAVE_AVX_KERNELS
+
+void SumThresholdTest::compareWithReference(Asserter& asserter, LengthKernel kernel, LengthKernel reference, size_t width, size_t height, const std::string& name)
+{
+	Mask2D
+		mask1 = Mask2D::MakeUnsetMask(width, height),
+		mask2 = Mask2D::MakeUnsetMask(width, height),
+		scratch = Mask2D::MakeUnsetMask(width, height);
+	Image2DPtr
+		real = Image2D::MakePtr(TestSetGenerator::MakeTestSet(26, mask1, width, height)),
+		imag = Image2D::MakePtr(TestSetGenerator::MakeTestSet(26, mask2, width, height));
+	TimeFrequencyData data(Polarization::XX, real, imag);
+	Image2DCPtr image = data.GetSingleImage();
+	
+	ThresholdConfig config;
+	config.InitializeLengthsDefault(9);
+	num_t mode = image->GetMode();
+	config.InitializeThresholdsFromFirstThreshold(6.0 * mode, ThresholdConfig::Rayleigh);
+	for(unsigned i=0;i<9;++i)
+	{
+		const unsigned length = config.GetHorizontalLength(i);
+		const double threshold = config.GetHorizontalThreshold(i);
+		
+		// Start from a partly flagged mask, so that flagged samples are also tested
+		mask1.SetAll<false>();
+		for(size_t y=0; y<height; y+=3)
+			mask1.SetHorizontalValues(y % width, y, true, std::min<size_t>(width - y % width, 5));
+		mask2 = mask1;
+		
+		reference(image.get(), &mask1, &scratch, length, threshold);
+		kernel(image.get(), &mask2, &scratch, length, threshold);
+		
+		std::stringstream s;
+		s << "Equal " << name << " and reference masks produced by SumThreshold length " << length << ", size " << width << " x " << height;
+		MaskAsserter::AssertEqualMasks(mask2, mask1, s.str());
+	}
+}
+
+void SumThresholdTest::testStability(LengthKernel horizontal, LengthKernel vertical)
+{
+	Mask2D
+		maskA = Mask2D::MakeSetMask<false>(1, 1),
+		maskB = Mask2D::MakeSetMask<false>(2, 2),
+		maskC = Mask2D::MakeSetMask<false>(3, 3),
+		maskD = Mask2D::MakeSetMask<false>(4, 4),
+		scratch = Mask2D::MakeUnsetMask(4, 4);
+	Image2D
+		realA = Image2D::MakeZeroImage(1, 1);
+		
+	ThresholdConfig config;
+	config.InitializeLengthsDefault(9);
+	config.InitializeThresholdsFromFirstThreshold(6.0, ThresholdConfig::Rayleigh);
+	for(unsigned i=0;i<9;++i)
+	{
+		const unsigned length = config.GetHorizontalLength(i);
+		horizontal(&realA, &maskA, &scratch, length, 1.0);
+		vertical(&realA, &maskA, &scratch, length, 1.0);
+		horizontal(&realA, &maskB, &scratch, length, 1.0);
+		vertical(&realA, &maskB, &scratch, length, 1.0);
+		horizontal(&realA, &maskC, &scratch, length, 1.0);
+		vertical(&realA, &maskC, &scratch, length, 1.0);
+		horizontal(&realA, &maskD, &scratch, length, 1.0);
+		vertical(&realA, &maskD, &scratch, length, 1.0);
+	}
+}
+
+void SumThresholdTest::DispatchedKernels::operator()()
+{
+	const unsigned
+		width = 2000,
+		height = 250;
+	Mask2D
+		mask1 = Mask2D::MakeUnsetMask(width, height),
+		mask2 = Mask2D::MakeUnsetMask(width, height),
+		scratch = Mask2D::MakeUnsetMask(width, height);
+	Image2DPtr
+		real = Image2D::MakePtr(TestSetGenerator::MakeTestSet(26, mask1, width, height)),
+		imag = Image2D::MakePtr(TestSetGenerator::MakeTestSet(26, mask2, width, height));
+	TimeFrequencyData data(Polarization::XX, real, imag);
+	Image2DCPtr image = data.GetSingleImage();
+	
+	ThresholdConfig config;
+	config.InitializeLengthsDefault(9);
+	num_t mode = image->GetMode();
+	config.InitializeThresholdsFromFirstThreshold(6.0 * mode, ThresholdConfig::Rayleigh);
+	for(int level=SIMDSupport::Reference; level<=SIMDSupport::Selected(); ++level)
+	{
+		const SumThreshold::KernelTable table =
+			SumThreshold::MakeKernelTable(SIMDSupport::Level(level));
+		for(unsigned i=0;i<9;++i)
+		{
+			const unsigned length = config.GetHorizontalLength(i);
+			const double threshold = config.GetHorizontalThreshold(i);
+			
+			mask1.SetAll<false>();
+			mask2.SetAll<false>();
+			SumThreshold::HorizontalLargeReference(image.get(), &mask1, &scratch, length, threshold);
+			table.horizontal[i](image.get(), &mask2, &scratch, threshold);
+			std::stringstream hStr;
+			hStr << "Equal " << SIMDSupport::Name(SIMDSupport::Level(level)) << " and reference masks produced by horizontal SumThreshold length " << length;
+			MaskAsserter::AssertEqualMasks(mask2, mask1, hStr.str());
+			
+			// See the SSE test: the vertical SIMD kernels round differently for length 32 on this set
+			if(length != 32)
+			{
+				mask1.SetAll<false>();
+				mask2.SetAll<false>();
+				SumThreshold::VerticalLargeReference(image.get(), &mask1, &scratch, length, threshold);
+				table.vertical[i](image.get(), &mask2, &scratch, threshold);
+				std::stringstream vStr;
+				vStr << "Equal " << SIMDSupport::Name(SIMDSupport::Level(level)) << " and reference masks produced by vertical SumThreshold length " << length;
+				MaskAsserter::AssertEqualMasks(mask2, mask1, vStr.str());
+			}
+		}
+	}
+}
 
 #endif
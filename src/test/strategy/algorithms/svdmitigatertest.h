@@ -0,0 +1,132 @@
+#ifndef AOFLAGGER_SVDMITIGATERTEST_H
+#define AOFLAGGER_SVDMITIGATERTEST_H
+
+#include "../../testingtools/asserter.h"
+#include "../../testingtools/unittest.h"
+
+#include "../../../structures/image2d.h"
+#include "../../../structures/timefrequencydata.h"
+
+#include "../../../strategy/algorithms/svdmitigater.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+class SVDMitigaterTest : public UnitTest {
+	public:
+		SVDMitigaterTest() : UnitTest("SVD mitigater")
+		{
+			AddTest(TestLowRank(), "Removing a low-rank signal");
+			AddTest(TestRandomizedEqualsFull(), "Randomized equals full decomposition");
+			AddTest(TestBlockSingularValues(), "Singular values of time blocks");
+		}
+		
+	private:
+		struct TestLowRank : public Asserter
+		{
+			void operator()();
+		};
+		struct TestRandomizedEqualsFull : public Asserter
+		{
+			void operator()();
+		};
+		struct TestBlockSingularValues : public Asserter
+		{
+			void operator()();
+		};
+		
+		/**
+		 * Strong signal of rank 3 plus weak noise.
+		 */
+		static TimeFrequencyData makeData(size_t width, size_t height, double noiseLevel)
+		{
+			std::mt19937 rng(1);
+			std::normal_distribution<num_t> gaussian;
+			Image2DPtr
+				real = Image2D::CreateUnsetImagePtr(width, height),
+				imaginary = Image2D::CreateUnsetImagePtr(width, height);
+			for(size_t y=0; y!=height; ++y)
+			{
+				for(size_t x=0; x!=width; ++x)
+				{
+					real->SetValue(x, y, 10.0 * std::sin(x * 0.05) * (y + 1) + 5.0 * std::cos(y * 0.3) + noiseLevel * gaussian(rng));
+					imaginary->SetValue(x, y, 3.0 * std::cos(x * 0.02) * (y % 7) + noiseLevel * gaussian(rng));
+				}
+			}
+			return TimeFrequencyData(Polarization::StokesI, real, imaginary);
+		}
+		
+		static double rms(const TimeFrequencyData& data)
+		{
+			Image2DCPtr real = data.GetRealPart(), imaginary = data.GetImaginaryPart();
+			double sum = 0.0;
+			for(size_t y=0; y!=real->Height(); ++y)
+			{
+				for(size_t x=0; x!=real->Width(); ++x)
+					sum += real->Value(x, y)*real->Value(x, y) + imaginary->Value(x, y)*imaginary->Value(x, y);
+			}
+			return std::sqrt(sum / (real->Width() * real->Height()));
+		}
+};
+
+inline void SVDMitigaterTest::TestLowRank::operator()()
+{
+	TimeFrequencyData data = makeData(200, 60, 0.0);
+	for(size_t mode=0; mode!=3; ++mode)
+	{
+		SVDMitigater mitigater;
+		mitigater.Initialize(data);
+		mitigater.SetRemoveCount(4);
+		mitigater.SetRandomized(mode != 0);
+		if(mode == 2)
+			mitigater.SetTimeBlockSize(64);
+		mitigater.PerformFit();
+		AssertLessThan(rms(mitigater.Background()), 1e-3, "Signal removed");
+		AssertEquals(mitigater.Background().ImageWidth(), size_t(200), "Width");
+	}
+}
+
+inline void SVDMitigaterTest::TestRandomizedEqualsFull::operator()()
+{
+	TimeFrequencyData data = makeData(300, 80, 0.1);
+	SVDMitigater full, randomized;
+	full.Initialize(data);
+	full.SetRemoveCount(3);
+	full.PerformFit();
+	randomized.Initialize(data);
+	randomized.SetRemoveCount(3);
+	randomized.SetRandomized(true);
+	randomized.PerformFit();
+	
+	AssertLessThan(std::fabs(full.SingularValue(0) - randomized.SingularValue(0)), 1e-6 * full.SingularValue(0), "First singular value");
+	TimeFrequencyData difference = TimeFrequencyData::MakeFromDiff(full.Background(), randomized.Background());
+	AssertLessThan(rms(difference), 0.01 * rms(full.Background()), "Background");
+}
+
+inline void SVDMitigaterTest::TestBlockSingularValues::operator()()
+{
+	TimeFrequencyData data = makeData(200, 60, 0.1);
+	SVDMitigater blocked;
+	blocked.Initialize(data);
+	blocked.SetRemoveCount(3);
+	blocked.SetTimeBlockSize(64);
+	blocked.PerformFit();
+	AssertEquals(blocked.BlockCount(), size_t(4), "Block count");
+	
+	// Every block has the singular values of decomposing that block by itself
+	for(size_t block=0; block!=4; ++block)
+	{
+		TimeFrequencyData blockData(data);
+		blockData.Trim(block * 64, 0, std::min<size_t>((block + 1) * 64, 200), 60);
+		SVDMitigater single;
+		single.Initialize(blockData);
+		single.SetRemoveCount(3);
+		single.PerformFit();
+		AssertEquals(single.BlockCount(), size_t(1), "Single block");
+		for(unsigned i=0; i!=3; ++i)
+			AssertLessThan(std::fabs(blocked.SingularValue(i, block) - single.SingularValue(i)), 1e-6 * single.SingularValue(0), "Singular value of block");
+	}
+}
+
+#endif
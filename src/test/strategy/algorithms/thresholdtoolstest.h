@@ -14,6 +14,7 @@ class ThresholdToolsTest : public UnitTest {
 		{
 			AddTest(WinsorizedMaskedMeanVar(), "Winsorized, masked mean and variance");
 			AddTest(WinsorizedMaskedMode(), "Winsorized, masked mode");
+			AddTest(WinsorizedQuantiles(), "Winsorized quantiles");
 		}
 		
 	private:
@@ -25,6 +26,10 @@ class ThresholdToolsTest : public UnitTest {
 		{
 			void operator()();
 		};
+		struct WinsorizedQuantiles : public Asserter
+		{
+			void operator()();
+		};
 };
 
 void ThresholdToolsTest::WinsorizedMaskedMeanVar::operator()()
@@ -117,4 +122,33 @@ void ThresholdToolsTest::WinsorizedMaskedMode::operator()()
 	// the Winsorized variance. Therefore, don't test it here. TODO
 }
 
+void ThresholdToolsTest::WinsorizedQuantiles::operator()()
+{
+	// Values 1 ... 100 in shuffled order. Winsorizing replaces 1-10 by 11 and
+	// 91-100 by 90, which keeps the mean at 50.5.
+	Image2DPtr image = Image2D::CreateZeroImagePtr(10, 10);
+	std::vector<num_t> values;
+	for(size_t i=0; i!=100; ++i)
+	{
+		const size_t v = (i * 37) % 100 + 1;
+		image->SetValue(i % 10, i / 10, v);
+		values.push_back(v);
+	}
+	Mask2DCPtr emptyMask = Mask2D::CreateSetMaskPtr<false>(10, 10);
+	
+	num_t mean, stddev, maskedMean, maskedStddev, vectorMean, vectorStddev;
+	ThresholdTools::WinsorizedMeanAndStdDev(image.get(), mean, stddev);
+	ThresholdTools::WinsorizedMeanAndStdDev(image.get(), emptyMask.get(), maskedMean, maskedStddev);
+	ThresholdTools::WinsorizedMeanAndStdDev(values, vectorMean, vectorStddev);
+	AssertAlmostEqual(mean, 50.5, "Mean of image");
+	AssertAlmostEqual(maskedMean, 50.5, "Mean of masked image");
+	AssertAlmostEqual(vectorMean, 50.5, "Mean of vector");
+	AssertAlmostEqual(maskedStddev, stddev, "Stddev of masked image");
+	AssertAlmostEqual(vectorStddev, stddev, "Stddev of vector");
+	
+	// Only the values above the 90% quantile (91-100) are replaced, by 90.
+	const num_t mode = ThresholdTools::WinsorizedMode(image.get());
+	AssertAlmostEqual(mode, sqrt((90.0*91.0*181.0/6.0 + 10.0*90.0*90.0) / 200.0) * 1.0541, "Mode of image");
+}
+
 #endif
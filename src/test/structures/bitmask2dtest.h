@@ -0,0 +1,154 @@
+#ifndef BITMASK2DTEST_H
+#define BITMASK2DTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../structures/bitmask2d.h"
+#include "../../structures/mask2d.h"
+
+#include "../../util/rng.h"
+
+class BitMask2DTest : public UnitTest {
+public:
+	BitMask2DTest() : UnitTest("Bit-packed mask")
+	{
+		AddTest(Conversion(), "Conversion");
+		AddTest(LogicalOperations(), "Logical operations");
+		AddTest(Dilation(), "Dilation");
+	}
+
+	struct Conversion : public Asserter
+	{
+		void operator()();
+	};
+
+	struct LogicalOperations : public Asserter
+	{
+		void operator()();
+	};
+
+	struct Dilation : public Asserter
+	{
+		void operator()();
+	};
+
+	static Mask2D makeRandomMask(size_t width, size_t height, double flagRatio)
+	{
+		Mask2D mask(Mask2D::MakeUnsetMask(width, height));
+		for(size_t y=0; y!=height; ++y)
+		{
+			for(size_t x=0; x!=width; ++x)
+				mask.SetValue(x, y, RNG::Uniform() < flagRatio);
+		}
+		return mask;
+	}
+};
+
+void BitMask2DTest::Conversion::operator()()
+{
+	const size_t sizes[] = { 1, 7, 8, 63, 64, 65, 130 };
+	for(size_t width : sizes)
+	{
+		Mask2D mask = makeRandomMask(width, 5, 0.5);
+		BitMask2D bitMask(mask);
+		bool equal = true;
+		for(size_t y=0; y!=mask.Height(); ++y)
+		{
+			for(size_t x=0; x!=mask.Width(); ++x)
+				equal = equal && (bitMask.Value(x, y) == mask.Value(x, y));
+		}
+		AssertTrue(equal, "Packed values");
+		AssertTrue(bitMask.ToMask2D() == mask, "Unpacked values");
+		AssertEquals(bitMask.GetCount<true>(), mask.GetCount<true>(), "Count");
+
+		Mask2D unpacked(Mask2D::MakeSetMask<true>(width, 5));
+		bitMask.CopyTo(unpacked);
+		AssertTrue(unpacked == mask, "CopyTo() overwrites all values");
+	}
+}
+
+void BitMask2DTest::LogicalOperations::operator()()
+{
+	Mask2D maskA = makeRandomMask(101, 9, 0.3), maskB = makeRandomMask(101, 9, 0.3);
+	BitMask2D bitA(maskA), bitB(maskB);
+
+	Mask2D joined(Mask2D::MakeUnsetMask(101, 9)), intersected(Mask2D::MakeUnsetMask(101, 9));
+	size_t trueCount = 0;
+	for(size_t y=0; y!=9; ++y)
+	{
+		for(size_t x=0; x!=101; ++x)
+		{
+			joined.SetValue(x, y, maskA.Value(x, y) || maskB.Value(x, y));
+			intersected.SetValue(x, y, maskA.Value(x, y) && maskB.Value(x, y));
+			if(maskA.Value(x, y))
+				++trueCount;
+		}
+	}
+	AssertEquals(maskA.GetCount<true>(), trueCount, "Mask2D::GetCount<true>()");
+	AssertEquals(maskA.GetCount<false>(), 101*9 - trueCount, "Mask2D::GetCount<false>()");
+	AssertEquals(bitA.GetCount<true>(), trueCount, "BitMask2D::GetCount<true>()");
+
+	Mask2D joinedMask(maskA);
+	joinedMask.Join(maskB);
+	AssertTrue(joinedMask == joined, "Mask2D::Join()");
+	BitMask2D joinedBits(bitA);
+	joinedBits.Join(bitB);
+	AssertTrue(joinedBits.ToMask2D() == joined, "BitMask2D::Join()");
+
+	Mask2D intersectedMask(maskA);
+	intersectedMask.Intersect(maskB);
+	AssertTrue(intersectedMask == intersected, "Mask2D::Intersect()");
+	BitMask2D intersectedBits(bitA);
+	intersectedBits.Intersect(bitB);
+	AssertTrue(intersectedBits.ToMask2D() == intersected, "BitMask2D::Intersect()");
+
+	Mask2D invertedMask(maskA);
+	invertedMask.Invert();
+	BitMask2D invertedBits(bitA);
+	invertedBits.Invert();
+	AssertEquals(invertedMask.GetCount<true>(), 101*9 - trueCount, "Mask2D::Invert()");
+	AssertEquals(invertedBits.GetCount<true>(), 101*9 - trueCount, "BitMask2D::Invert()");
+	AssertTrue(invertedBits.ToMask2D() == invertedMask, "Inverted masks are equal");
+	// Inverting must not touch the padding after the rows
+	Mask2D paddedMask = Mask2D::MakeSetMask<true>(101, 9);
+	paddedMask.Invert();
+	AssertTrue(paddedMask.AllFalse(), "Mask2D::Invert() of set mask");
+	bool paddingIsSet = true;
+	for(size_t y=0; y!=9; ++y)
+	{
+		for(size_t x=101; x!=paddedMask.Stride(); ++x)
+			paddingIsSet = paddingIsSet && paddedMask.ValuePtr(0, y)[x];
+	}
+	AssertTrue(paddingIsSet, "Mask2D::Invert() keeps padding");
+
+	AssertFalse(maskA.AllFalse(), "Mask2D::AllFalse() on flagged mask");
+	AssertFalse(bitA.AllFalse(), "BitMask2D::AllFalse() on flagged mask");
+	AssertTrue(Mask2D::MakeSetMask<false>(101, 9).AllFalse(), "Mask2D::AllFalse() on unflagged mask");
+	AssertTrue(BitMask2D(101, 9).AllFalse(), "BitMask2D::AllFalse() on unflagged mask");
+}
+
+void BitMask2DTest::Dilation::operator()()
+{
+	const size_t sizes[] = { 1, 2, 3, 5, 8, 31, 64, 65, 100, 500 };
+	for(size_t size : sizes)
+	{
+		Mask2D mask = makeRandomMask(200, 4, 0.01);
+		Mask2D expected(Mask2D::MakeUnsetMask(200, 4));
+		for(size_t y=0; y!=4; ++y)
+		{
+			for(size_t x=0; x!=200; ++x)
+			{
+				bool value = false;
+				for(size_t i=(x > size ? x - size : 0); i!=std::min<size_t>(x + size + 1, 200); ++i)
+					value = value || mask.Value(i, y);
+				expected.SetValue(x, y, value);
+			}
+		}
+		BitMask2D bitMask(mask);
+		bitMask.DilateHorizontally(size);
+		AssertTrue(bitMask.ToMask2D() == expected, "Dilation of size " + std::to_string(size));
+	}
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef AOFLAGGER_MSMETADATATEST_H
+#define AOFLAGGER_MSMETADATATEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../structures/msmetadata.h"
+
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+#include <casacore/tables/Tables/ScalarColumn.h>
+#include <casacore/tables/Tables/SetupNewTab.h>
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+class MSMetaDataTest : public UnitTest {
+	public:
+		MSMetaDataTest() : UnitTest("Measurement set metadata")
+		{
+			AddTest(TestFieldChange(), "Field change within a timestep");
+		}
+
+	private:
+		struct TestFieldChange : public Asserter
+		{
+			void operator()();
+		};
+
+		/**
+		 * Creates a set with baselines 0x1 and 0x2, in which each row gives the
+		 * field and time of a timestep.
+		 */
+		static void createSet(const std::string& path, const std::vector<std::pair<int, double>>& timesteps)
+		{
+			casacore::SetupNewTable setup(path, casacore::MeasurementSet::requiredTableDesc(), casacore::Table::New);
+			casacore::MeasurementSet ms(setup);
+			ms.createDefaultSubtables(casacore::Table::New);
+			casacore::ScalarColumn<int>
+				antenna1Col(ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::ANTENNA1)),
+				antenna2Col(ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::ANTENNA2)),
+				fieldIdCol(ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::FIELD_ID)),
+				dataDescIdCol(ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::DATA_DESC_ID));
+			casacore::ScalarColumn<double>
+				timeCol(ms, casacore::MeasurementSet::columnName(casacore::MeasurementSet::TIME));
+			ms.addRow(timesteps.size() * 2);
+			size_t row = 0;
+			for(const std::pair<int, double>& timestep : timesteps)
+			{
+				for(int antenna2=1; antenna2!=3; ++antenna2)
+				{
+					antenna1Col.put(row, 0);
+					antenna2Col.put(row, antenna2);
+					fieldIdCol.put(row, timestep.first);
+					dataDescIdCol.put(row, 0);
+					timeCol.put(row, timestep.second);
+					++row;
+				}
+			}
+		}
+};
+
+inline void MSMetaDataTest::TestFieldChange::operator()()
+{
+	const std::string path("MSMetaDataTest.ms");
+	// The second field starts at the time at which the first field ends. Like
+	// MSSelection, the metadata starts a new timestep when the field changes,
+	// so that the rows of both fields at that time are selected.
+	createSet(path, { {0, 1.0}, {0, 2.0}, {1, 2.0}, {1, 3.0} });
+	{
+		MSMetaData metaData(path);
+		AssertEquals(metaData.SequenceCount(), size_t(2), "Sequence count");
+		AssertTrue(metaData.GetObservationTimesSet(0) == std::set<double>{1.0, 2.0}, "Times of first field");
+		AssertTrue(metaData.GetObservationTimesSet(1) == std::set<double>{2.0, 3.0}, "Times of second field");
+		AssertEquals(metaData.TimestepCount(), size_t(3), "Timestep count");
+		AssertEquals(metaData.GetSequences().size(), size_t(4), "Sequences");
+	}
+	casacore::Table::deleteTable(path);
+}
+
+#endif
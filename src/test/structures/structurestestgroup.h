@@ -3,7 +3,9 @@
 
 #include "../testingtools/testgroup.h"
 
+#include "bitmask2dtest.h"
 #include "image2dtest.h"
+#include "msmetadatatest.h"
 #include "timefrequencydatatest.h"
 
 class StructuresTestGroup : public TestGroup {
@@ -12,7 +14,9 @@ class StructuresTestGroup : public TestGroup {
 		
 		virtual void Initialize() override
 		{
+			Add(new BitMask2DTest());
 			Add(new Image2DTest());
+			Add(new MSMetaDataTest());
 			Add(new TimeFrequencyDataTest());
 		}
 };
@@ -0,0 +1,69 @@
+#ifndef AOFLAGGER_MEMORYACCOUNTANTTEST_H
+#define AOFLAGGER_MEMORYACCOUNTANTTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../structures/image2d.h"
+#include "../../structures/mask2d.h"
+
+#include "../../util/memoryaccountant.h"
+
+class MemoryAccountantTest : public UnitTest {
+	public:
+		MemoryAccountantTest() : UnitTest("Memory accountant")
+		{
+			AddTest(ImagesAndMasks(), "Images and masks");
+			AddTest(ThreadPeak(), "Peak of thread");
+		}
+
+	private:
+		struct ImagesAndMasks : public Asserter
+		{
+			void operator()();
+		};
+		struct ThreadPeak : public Asserter
+		{
+			void operator()();
+		};
+};
+
+inline void MemoryAccountantTest::ImagesAndMasks::operator()()
+{
+	const size_t
+		imagesBefore = MemoryAccountant::Used(MemoryAccountant::ImageComponent),
+		masksBefore = MemoryAccountant::Used(MemoryAccountant::MaskComponent);
+	{
+		// Width is rounded up to 8 (images) or 4 (masks), height to 4
+		Image2D image = Image2D::MakeZeroImage(10, 10);
+		AssertEquals(MemoryAccountant::Used(MemoryAccountant::ImageComponent) - imagesBefore, 16*12*sizeof(num_t), "Image allocated");
+		Image2D copy(image);
+		Image2D moved(std::move(copy));
+		AssertEquals(MemoryAccountant::Used(MemoryAccountant::ImageComponent) - imagesBefore, 2*16*12*sizeof(num_t), "Image copied and moved");
+		
+		Mask2D mask = Mask2D::MakeSetMask<false>(10, 10);
+		AssertEquals(MemoryAccountant::Used(MemoryAccountant::MaskComponent) - masksBefore, 12*12*sizeof(bool), "Mask allocated");
+		mask = Mask2D::MakeSetMask<false>(20, 20);
+		AssertEquals(MemoryAccountant::Used(MemoryAccountant::MaskComponent) - masksBefore, 20*20*sizeof(bool), "Mask reassigned");
+		AssertTrue(MemoryAccountant::Peak(MemoryAccountant::MaskComponent) - masksBefore >= 20*20*sizeof(bool), "Peak");
+	}
+	AssertEquals(MemoryAccountant::Used(MemoryAccountant::ImageComponent), imagesBefore, "Images released");
+	AssertEquals(MemoryAccountant::Used(MemoryAccountant::MaskComponent), masksBefore, "Masks released");
+}
+
+inline void MemoryAccountantTest::ThreadPeak::operator()()
+{
+	Image2D input = Image2D::MakeZeroImage(16, 16);
+	MemoryAccountant::StartThreadMeasurement();
+	{
+		Image2D a = Image2D::MakeZeroImage(16, 16);
+		Image2D b = Image2D::MakeZeroImage(16, 16);
+	}
+	Image2D c = Image2D::MakeZeroImage(16, 16);
+	// The input was allocated before the measurement started, so releasing
+	// it lowers the usage of the thread below zero
+	input = Image2D();
+	AssertEquals(MemoryAccountant::ThreadPeak(), 2*16*16*sizeof(num_t), "Peak of two images");
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef AOFLAGGER_SCRATCHARENATEST_H
+#define AOFLAGGER_SCRATCHARENATEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../util/memoryaccountant.h"
+#include "../../util/scratcharena.h"
+
+#include <cstdint>
+
+class ScratchArenaTest : public UnitTest {
+	public:
+		ScratchArenaTest() : UnitTest("Scratch arena")
+		{
+			AddTest(Scopes(), "Scopes");
+			AddTest(Reuse(), "Reuse after reset");
+			AddTest(Accounting(), "Memory accounting");
+		}
+
+	private:
+		struct Scopes : public Asserter
+		{
+			void operator()();
+		};
+		struct Reuse : public Asserter
+		{
+			void operator()();
+		};
+		struct Accounting : public Asserter
+		{
+			void operator()();
+		};
+};
+
+inline void ScratchArenaTest::Scopes::operator()()
+{
+	ScratchArena arena;
+	char* first;
+	{
+		ScratchArena::Scope scope(arena);
+		first = arena.Allocate<char>(3);
+		int* second = arena.Allocate<int>(10);
+		AssertTrue(reinterpret_cast<char*>(second) >= first + 3, "No overlap");
+		AssertEquals<size_t>(reinterpret_cast<uintptr_t>(second) % ScratchArena::Alignment, size_t(0), "Alignment");
+	}
+	{
+		ScratchArena::Scope scope(arena);
+		AssertTrue(arena.Allocate<char>(3) == first, "Memory is released by scope");
+	}
+	AssertEquals(arena.AllocationCount(), size_t(3), "Allocation count");
+	AssertEquals(arena.HighWaterMark(), size_t(2 * ScratchArena::Alignment), "High-water mark");
+}
+
+inline void ScratchArenaTest::Reuse::operator()()
+{
+	ScratchArena arena;
+	// Allocations of several blocks are merged on reset
+	for(size_t i=0; i!=3; ++i)
+	{
+		for(size_t j=0; j!=10; ++j)
+		{
+			double* values = arena.Allocate<double>(100000);
+			values[0] = 1.0;
+			values[99999] = 2.0;
+		}
+		arena.Reset();
+	}
+	const size_t blockCount = arena.BlockAllocationCount();
+	for(size_t j=0; j!=10; ++j)
+		arena.Allocate<double>(100000);
+	arena.Reset();
+	AssertEquals(arena.BlockAllocationCount(), blockCount, "No new blocks after first baselines");
+}
+
+inline void ScratchArenaTest::Accounting::operator()()
+{
+	const size_t before = MemoryAccountant::Used(MemoryAccountant::ScratchComponent);
+	{
+		ScratchArena arena;
+		arena.Allocate<double>(100000);
+		AssertTrue(MemoryAccountant::Used(MemoryAccountant::ScratchComponent) >= before + 100000*sizeof(double), "Blocks are counted");
+		arena.Allocate<double>(100000);
+		arena.Reset();
+		AssertTrue(MemoryAccountant::Used(MemoryAccountant::ScratchComponent) >= before + 200000*sizeof(double), "Merged block is counted");
+	}
+	AssertEquals(MemoryAccountant::Used(MemoryAccountant::ScratchComponent), before, "Blocks are released");
+}
+
+#endif
@@ -3,7 +3,10 @@
 
 #include "../testingtools/testgroup.h"
 
+#include "memoryaccountanttest.h"
 #include "numberparsertest.h"
+#include "scratcharenatest.h"
+#include "workstealingpooltest.h"
 
 class UtilTestGroup : public TestGroup {
 	public:
@@ -11,7 +14,10 @@ class UtilTestGroup : public TestGroup {
 		
 		virtual void Initialize() override
 		{
+			Add(new MemoryAccountantTest());
 			Add(new NumberParserTest());
+			Add(new ScratchArenaTest());
+			Add(new WorkStealingPoolTest());
 		}
 };
 
@@ -0,0 +1,88 @@
+#ifndef AOFLAGGER_WORKSTEALINGPOOLTEST_H
+#define AOFLAGGER_WORKSTEALINGPOOLTEST_H
+
+#include "../testingtools/asserter.h"
+#include "../testingtools/unittest.h"
+
+#include "../../util/workstealingpool.h"
+
+#include <atomic>
+#include <stdexcept>
+
+class WorkStealingPoolTest : public UnitTest {
+	public:
+		WorkStealingPoolTest() : UnitTest("Work-stealing pool")
+		{
+			AddTest(SourceItems(), "Source items");
+			AddTest(SubTasks(), "Sub-tasks");
+			AddTest(TaskException(), "Exception in sub-task");
+		}
+
+	private:
+		struct SourceItems : public Asserter
+		{
+			void operator()();
+		};
+		struct SubTasks : public Asserter
+		{
+			void operator()();
+		};
+		struct TaskException : public Asserter
+		{
+			void operator()();
+		};
+};
+
+inline void WorkStealingPoolTest::SourceItems::operator()()
+{
+	WorkStealingPool pool(4);
+	std::atomic<size_t> next(0), sum(0);
+	pool.Run([&](size_t) {
+		size_t item = next++;
+		if(item >= 100)
+			return WorkStealingPool::SourceFinished;
+		sum += item;
+		return WorkStealingPool::WorkDone;
+	});
+	AssertEquals(size_t(sum), size_t(4950), "All items processed once");
+}
+
+inline void WorkStealingPoolTest::SubTasks::operator()()
+{
+	WorkStealingPool pool(3);
+	std::atomic<size_t> next(0), sum(0);
+	pool.Run([&](size_t) {
+		size_t item = next++;
+		if(item >= 10)
+			return WorkStealingPool::SourceFinished;
+		WorkStealingPool::TaskGroup group;
+		for(size_t i=0; i!=10; ++i)
+			WorkStealingPool::Current()->Submit(group, [&sum, item, i]() { sum += item * 10 + i; });
+		WorkStealingPool::Current()->Wait(group);
+		return WorkStealingPool::WorkDone;
+	});
+	AssertEquals(size_t(sum), size_t(4950), "All sub-tasks performed once");
+	AssertTrue(WorkStealingPool::Current() == nullptr, "Not a worker after run");
+}
+
+inline void WorkStealingPoolTest::TaskException::operator()()
+{
+	WorkStealingPool pool(2);
+	std::atomic<bool> done(false);
+	bool caught = false;
+	pool.Run([&](size_t) {
+		if(done.exchange(true))
+			return WorkStealingPool::SourceFinished;
+		WorkStealingPool::TaskGroup group;
+		WorkStealingPool::Current()->Submit(group, []() { throw std::runtime_error("test"); });
+		try {
+			WorkStealingPool::Current()->Wait(group);
+		} catch(std::exception&) {
+			caught = true;
+		}
+		return WorkStealingPool::WorkDone;
+	});
+	AssertTrue(caught, "Exception is passed to waiting worker");
+}
+
+#endif
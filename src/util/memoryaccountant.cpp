@@ -0,0 +1,97 @@
+#include "memoryaccountant.h"
+
+#include "logger.h"
+
+#include "../structures/system.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+std::atomic<size_t> MemoryAccountant::_used[ComponentCount];
+std::atomic<size_t> MemoryAccountant::_peak[ComponentCount];
+size_t MemoryAccountant::_explicitLimit = 0;
+thread_local int64_t MemoryAccountant::_threadUsed = 0;
+thread_local int64_t MemoryAccountant::_threadPeak = 0;
+
+namespace {
+	/**
+	 * Reads a limit from a cgroup file. Returns zero when the file does not
+	 * exist or has no limit ("max" in v2, a huge number in v1).
+	 */
+	size_t readLimitFile(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		std::string value;
+		if(!(file >> value) || value == "max")
+			return 0;
+		try {
+			const unsigned long long limit = std::stoull(value);
+			if(limit >= (1ull << 60))
+				return 0;
+			return limit;
+		} catch(std::exception&) {
+			return 0;
+		}
+	}
+
+	/**
+	 * Returns the smallest limit of the cgroup and its parents, since the
+	 * limits of all of them apply.
+	 */
+	size_t findHierarchyLimit(const std::string& root, std::string path, const std::string& limitFile)
+	{
+		size_t limit = 0;
+		while(true)
+		{
+			const size_t value = readLimitFile(root + path + "/" + limitFile);
+			if(value != 0 && (limit == 0 || value < limit))
+				limit = value;
+			if(path.empty() || path == "/")
+				break;
+			path = path.substr(0, path.find_last_of('/'));
+		}
+		return limit;
+	}
+}
+
+size_t MemoryAccountant::CGroupLimit()
+{
+	std::ifstream file("/proc/self/cgroup");
+	std::string line;
+	while(std::getline(file, line))
+	{
+		// Lines have the form "hierarchy-ID:controller-list:cgroup-path"
+		const size_t first = line.find(':'), second = line.find(':', first + 1);
+		if(first == std::string::npos || second == std::string::npos)
+			continue;
+		const std::string
+			controllers = line.substr(first + 1, second - first - 1),
+			path = line.substr(second + 1);
+		if(line.compare(0, first, "0") == 0 && controllers.empty())
+			return findHierarchyLimit("/sys/fs/cgroup", path, "memory.max");
+		else if(controllers.find("memory") != std::string::npos)
+			return findHierarchyLimit("/sys/fs/cgroup/memory", path, "memory.limit_in_bytes");
+	}
+	return 0;
+}
+
+size_t MemoryAccountant::Limit()
+{
+	if(_explicitLimit != 0)
+		return _explicitLimit;
+	const size_t
+		systemMemory = System::TotalMemory(),
+		cgroupLimit = CGroupLimit();
+	if(cgroupLimit != 0)
+		return std::min(systemMemory, cgroupLimit);
+	else
+		return systemMemory;
+}
+
+void MemoryAccountant::ReportPeaks()
+{
+	Logger::Debug << "Peak memory use: images " << (Peak(ImageComponent) + 1024*1024-1) / (1024*1024)
+		<< " MB, masks " << (Peak(MaskComponent) + 1024*1024-1) / (1024*1024)
+		<< " MB, scratch " << (Peak(ScratchComponent) + 1024*1024-1) / (1024*1024) << " MB.\n";
+}
@@ -0,0 +1,109 @@
+#ifndef MEMORY_ACCOUNTANT_H
+#define MEMORY_ACCOUNTANT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Keeps track of the memory that is used by the images, masks and scratch
+ * arenas, which make up most of the memory use of the flagger. The counters are global; in
+ * addition, the net number of bytes allocated by the calling thread is
+ * counted, so that the working memory of a single baseline can be measured
+ * while other threads are allocating as well.
+ *
+ * The memory limit is either set explicitly (with the -mem-limit option), or
+ * is the smaller of the system memory and the limit of the cgroup of the
+ * process, as set by e.g. Slurm or Kubernetes.
+ */
+class MemoryAccountant
+{
+public:
+	enum Component { ImageComponent, MaskComponent, ScratchComponent, ComponentCount };
+
+	static void Allocate(Component component, size_t bytes)
+	{
+		const size_t used = _used[component].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		updatePeak(_peak[component], used);
+		_threadUsed += int64_t(bytes);
+		if(_threadUsed > _threadPeak)
+			_threadPeak = _threadUsed;
+	}
+
+	static void Release(Component component, size_t bytes)
+	{
+		_used[component].fetch_sub(bytes, std::memory_order_relaxed);
+		_threadUsed -= int64_t(bytes);
+	}
+
+	/** Bytes that are currently allocated for the given component */
+	static size_t Used(Component component)
+	{
+		return _used[component].load(std::memory_order_relaxed);
+	}
+
+	/** Bytes that are currently allocated for all components together */
+	static size_t Used()
+	{
+		size_t used = 0;
+		for(size_t c=0; c!=ComponentCount; ++c)
+			used += Used(Component(c));
+		return used;
+	}
+
+	/** Largest number of bytes that were allocated at the same time for the component */
+	static size_t Peak(Component component)
+	{
+		return _peak[component].load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Starts measuring the memory that is allocated by the calling thread.
+	 */
+	static void StartThreadMeasurement()
+	{
+		_threadUsed = 0;
+		_threadPeak = 0;
+	}
+
+	/**
+	 * The largest number of bytes that was allocated by the calling thread since
+	 * the call to StartThreadMeasurement(), minus what it freed in between.
+	 */
+	static size_t ThreadPeak()
+	{
+		return size_t(_threadPeak);
+	}
+
+	/**
+	 * Overrides the detected memory limit. Zero restores the detected limit.
+	 */
+	static void SetLimit(size_t limit) { _explicitLimit = limit; }
+
+	/**
+	 * The number of bytes that the process should stay below.
+	 */
+	static size_t Limit();
+
+	/**
+	 * Returns the memory limit of the cgroup of this process, or zero if it has
+	 * none or it can not be determined.
+	 */
+	static size_t CGroupLimit();
+
+	static void ReportPeaks();
+
+private:
+	static void updatePeak(std::atomic<size_t>& peak, size_t value)
+	{
+		size_t current = peak.load(std::memory_order_relaxed);
+		while(value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{ }
+	}
+
+	static std::atomic<size_t> _used[ComponentCount], _peak[ComponentCount];
+	static size_t _explicitLimit;
+	static thread_local int64_t _threadUsed, _threadPeak;
+};
+
+#endif
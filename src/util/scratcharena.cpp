@@ -0,0 +1,97 @@
+#include "scratcharena.h"
+
+#include "logger.h"
+#include "memoryaccountant.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+	const size_t MinimumBlockSize = 64*1024;
+}
+
+ScratchArena::ScratchArena() :
+	_blockIndex(0),
+	_position(0),
+	_used(0),
+	_allocationCount(0),
+	_blockAllocationCount(0),
+	_highWaterMark(0)
+{ }
+
+ScratchArena::~ScratchArena()
+{
+	releaseBlocks();
+}
+
+void* ScratchArena::allocate(size_t size)
+{
+	size = (size + Alignment - 1) / Alignment * Alignment;
+	++_allocationCount;
+	if(_blocks.empty())
+		addBlock(size);
+	// Blocks that were added before and have been released by a Scope are
+	// reused when they are large enough.
+	while(_position + size > _blocks[_blockIndex].size)
+	{
+		++_blockIndex;
+		_position = 0;
+		if(_blockIndex == _blocks.size())
+			addBlock(size);
+	}
+	char* data = _blocks[_blockIndex].data + _position;
+	_position += size;
+	_used += size;
+	_highWaterMark = std::max(_highWaterMark, _used);
+	return data;
+}
+
+void ScratchArena::addBlock(size_t minimumSize)
+{
+	size_t size = std::max(minimumSize, MinimumBlockSize);
+	if(!_blocks.empty())
+		size = std::max(size, _blocks.back().size * 2);
+	Block block;
+	block.storage.reset(new char[size + Alignment]);
+	const uintptr_t address = reinterpret_cast<uintptr_t>(block.storage.get());
+	block.data = block.storage.get() + (Alignment - address % Alignment) % Alignment;
+	block.size = size;
+	MemoryAccountant::Allocate(MemoryAccountant::ScratchComponent, size + Alignment);
+	_blocks.emplace_back(std::move(block));
+	++_blockAllocationCount;
+}
+
+void ScratchArena::Reset()
+{
+	if(_blocks.size() > 1)
+	{
+		size_t totalSize = 0;
+		for(const Block& block : _blocks)
+			totalSize += block.size;
+		releaseBlocks();
+		addBlock(totalSize);
+	}
+	_blockIndex = 0;
+	_position = 0;
+	_used = 0;
+}
+
+void ScratchArena::releaseBlocks()
+{
+	for(const Block& block : _blocks)
+		MemoryAccountant::Release(MemoryAccountant::ScratchComponent, block.size + Alignment);
+	_blocks.clear();
+}
+
+void ScratchArena::ReportStatistics(const std::string& name) const
+{
+	Logger::Debug << name << ": " << _allocationCount << " scratch allocations, "
+		<< _blockAllocationCount << " heap allocations, high-water mark of "
+		<< (_highWaterMark + 1023) / 1024 << " KB.\n";
+}
+
+ScratchArena& ScratchArena::ForCurrentThread()
+{
+	static thread_local ScratchArena arena;
+	return arena;
+}
@@ -0,0 +1,111 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Memory for temporary buffers of the flagging algorithms, to avoid
+ * allocating and freeing them for every baseline.
+ *
+ * Allocations are taken sequentially from a list of blocks, and are freed in
+ * stack order with a Scope: when the Scope is destructed, everything that was
+ * allocated after its construction is released. Reset() releases everything
+ * and merges the blocks into one block, so after the first few baselines the
+ * arena no longer needs to allocate memory.
+ *
+ * An arena may only be used by a single thread. ForCurrentThread() returns
+ * the arena of the calling thread.
+ */
+class ScratchArena
+{
+public:
+	/**
+	 * All allocations are aligned on this number of bytes, which is sufficient
+	 * for aligned SSE/AVX loads.
+	 */
+	static const size_t Alignment = 64;
+
+	ScratchArena();
+
+	~ScratchArena();
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	/**
+	 * Returns uninitialized memory for @p count values of type T. The memory stays
+	 * valid until the enclosing Scope ends or until Reset() is called.
+	 */
+	template<typename T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T)));
+	}
+
+	/**
+	 * Releases all memory. May not be called while a Scope of this arena exists.
+	 */
+	void Reset();
+
+	/**
+	 * Releases the allocations made during its lifetime on destruction.
+	 */
+	class Scope
+	{
+	public:
+		explicit Scope(ScratchArena& arena) :
+			_arena(arena),
+			_blockIndex(arena._blockIndex),
+			_position(arena._position),
+			_used(arena._used)
+		{ }
+
+		~Scope()
+		{
+			_arena._blockIndex = _blockIndex;
+			_arena._position = _position;
+			_arena._used = _used;
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		ScratchArena& _arena;
+		size_t _blockIndex, _position, _used;
+	};
+
+	/** Number of calls to Allocate() */
+	size_t AllocationCount() const { return _allocationCount; }
+
+	/** Number of times that a block of memory was allocated from the heap */
+	size_t BlockAllocationCount() const { return _blockAllocationCount; }
+
+	/** Largest number of bytes that were in use at the same time */
+	size_t HighWaterMark() const { return _highWaterMark; }
+
+	/** Logs the above statistics */
+	void ReportStatistics(const std::string& name) const;
+
+	static ScratchArena& ForCurrentThread();
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]> storage;
+		char* data;
+		size_t size;
+	};
+
+	void* allocate(size_t size);
+	void addBlock(size_t minimumSize);
+	void releaseBlocks();
+
+	std::vector<Block> _blocks;
+	size_t _blockIndex, _position, _used;
+	size_t _allocationCount, _blockAllocationCount, _highWaterMark;
+};
+
+#endif
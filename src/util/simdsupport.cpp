@@ -0,0 +1,55 @@
+#include "simdsupport.h"
+
+#include "logger.h"
+
+#include <cstdlib>
+
+std::string SIMDSupport::Name(Level level)
+{
+	switch(level)
+	{
+		case Reference: return "reference";
+		case SSE: return "SSE";
+		case AVX2: return "AVX2";
+		case AVX512: return "AVX-512";
+	}
+	return "unknown";
+}
+
+SIMDSupport::Level SIMDSupport::detect()
+{
+	Level level = Reference;
+#ifdef __SSE__
+	level = SSE;
+#endif
+#ifdef HAVE_AVX_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+	{
+		level = AVX2;
+		if(__builtin_cpu_supports("avx512f"))
+			level = AVX512;
+	}
+#endif
+	
+	const char* limitStr = getenv("AOFLAGGER_SIMD");
+	if(limitStr != nullptr)
+	{
+		const std::string limit(limitStr);
+		Level maxLevel = level;
+		if(limit == "reference")
+			maxLevel = Reference;
+		else if(limit == "sse")
+			maxLevel = SSE;
+		else if(limit == "avx2")
+			maxLevel = AVX2;
+		else if(limit == "avx512")
+			maxLevel = AVX512;
+		else
+			Logger::Warn << "Unknown value '" << limit << "' for AOFLAGGER_SIMD ignored.\n";
+		if(maxLevel < level)
+			level = maxLevel;
+	}
+	Logger::Debug << "Using " << Name(level) << " kernels.\n";
+	return level;
+}
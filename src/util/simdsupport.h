@@ -0,0 +1,54 @@
+#ifndef SIMD_SUPPORT_H
+#define SIMD_SUPPORT_H
+
+#include <string>
+
+/*
+ * On x86 with gcc or clang, the AVX2 and AVX-512 kernels are compiled into
+ * every build by giving the functions a target attribute, independent of the
+ * -march flags that the rest of the code is compiled with. Which kernels are
+ * actually executed is decided at run time by SIMDSupport.
+ */
+#if defined(__SSE__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_AVX_KERNELS
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx2,avx512f")))
+#endif
+
+/**
+ * Run-time detection of the vector instruction sets that the processor
+ * supports. The level is determined once (at first use) from the CPUID
+ * information. It can be lowered by setting the environment variable
+ * AOFLAGGER_SIMD to "reference", "sse", "avx2" or "avx512", which is
+ * useful for testing and benchmarking the different kernels on a single
+ * machine.
+ */
+class SIMDSupport
+{
+public:
+	enum Level { Reference=0, SSE=1, AVX2=2, AVX512=3 };
+	
+	/**
+	 * The highest level that is supported by both the processor and the
+	 * build, and that is allowed by the AOFLAGGER_SIMD environment variable.
+	 */
+	static Level Selected()
+	{
+		static const Level level = detect();
+		return level;
+	}
+	
+	static bool Has(Level level)
+	{
+		return Selected() >= level;
+	}
+	
+	static std::string Name(Level level);
+	
+private:
+	SIMDSupport() = delete;
+	
+	static Level detect();
+};
+
+#endif
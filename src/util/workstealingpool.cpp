@@ -0,0 +1,219 @@
+#include "workstealingpool.h"
+
+#include "logger.h"
+
+#include <cmath>
+#include <thread>
+
+thread_local WorkStealingPool* WorkStealingPool::_currentPool = nullptr;
+thread_local size_t WorkStealingPool::_currentWorkerIndex = 0;
+
+WorkStealingPool::WorkStealingPool(size_t workerCount) :
+	_workers(),
+	_queuedTaskCount(0),
+	_busyWorkers(0),
+	_generation(0),
+	_sourceFinished(false),
+	_sourceException(),
+	_runTime()
+{
+	if(workerCount == 0)
+		workerCount = 1;
+	for(size_t i=0; i!=workerCount; ++i)
+		_workers.emplace_back(new Worker());
+}
+
+void WorkStealingPool::Run(const WorkSource& source)
+{
+	_busyWorkers = _workers.size();
+	_sourceFinished = false;
+	_sourceException = std::exception_ptr();
+	_runTime.Reset();
+	_runTime.Start();
+
+	std::vector<std::thread> threads;
+	for(size_t i=0; i!=_workers.size(); ++i)
+		threads.emplace_back([this, i, &source]() { workerLoop(i, source); });
+	for(std::thread& t : threads)
+		t.join();
+
+	_runTime.Pause();
+	if(_sourceException)
+		std::rethrow_exception(_sourceException);
+}
+
+void WorkStealingPool::Notify()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_generation;
+	_change.notify_all();
+}
+
+void WorkStealingPool::Submit(TaskGroup& group, Task task)
+{
+	++group._pending;
+	Worker& worker = *_workers[_currentWorkerIndex];
+
+	// The counter is changed while holding _mutex, so that a worker that is about
+	// to go idle either sees the new task or is woken up. It is increased before
+	// the task is queued: otherwise another worker could take the task and
+	// decrease the counter first, which would make it wrap around.
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_queuedTaskCount;
+	std::unique_lock<std::mutex> workerLock(worker.mutex);
+	worker.queue.emplace_back(std::move(task), &group);
+	workerLock.unlock();
+	_change.notify_one();
+}
+
+void WorkStealingPool::Wait(TaskGroup& group)
+{
+	Worker& worker = *_workers[_currentWorkerIndex];
+	while(group._pending != 0)
+	{
+		if(!performQueuedTask(_currentWorkerIndex))
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			worker.idleTime.Start();
+			while(group._pending != 0 && _queuedTaskCount == 0)
+				_change.wait(lock);
+			worker.idleTime.Pause();
+		}
+	}
+	if(group._exception)
+	{
+		std::exception_ptr exception = group._exception;
+		group._exception = std::exception_ptr();
+		std::rethrow_exception(exception);
+	}
+}
+
+void WorkStealingPool::workerLoop(size_t workerIndex, const WorkSource& source)
+{
+	_currentPool = this;
+	_currentWorkerIndex = workerIndex;
+	Worker& worker = *_workers[workerIndex];
+
+	while(true)
+	{
+		if(performQueuedTask(workerIndex))
+			continue;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		const size_t generation = _generation;
+		bool sourceFinished = _sourceFinished;
+		lock.unlock();
+
+		if(!sourceFinished)
+		{
+			SourceResult result;
+			try {
+				result = source(workerIndex);
+			} catch(...) {
+				lock.lock();
+				if(!_sourceException)
+					_sourceException = std::current_exception();
+				lock.unlock();
+				result = SourceFinished;
+			}
+			if(result == WorkDone)
+			{
+				++worker.sourceItems;
+				continue;
+			}
+			if(result == SourceFinished)
+			{
+				lock.lock();
+				_sourceFinished = true;
+				lock.unlock();
+			}
+		}
+
+		// Nothing to do: wait until tasks are submitted or new work becomes
+		// available, or stop when all other workers are idle too.
+		lock.lock();
+		--_busyWorkers;
+		if(_sourceFinished && _busyWorkers == 0)
+			_change.notify_all();
+		worker.idleTime.Start();
+		while(_queuedTaskCount == 0 && (_sourceFinished ? _busyWorkers != 0 : _generation == generation))
+			_change.wait(lock);
+		worker.idleTime.Pause();
+		if(_queuedTaskCount == 0 && _sourceFinished && _busyWorkers == 0)
+			break;
+		++_busyWorkers;
+	}
+	_currentPool = nullptr;
+}
+
+bool WorkStealingPool::performQueuedTask(size_t workerIndex)
+{
+	QueueItem item;
+	bool found = false, stolen = false;
+
+	Worker& worker = *_workers[workerIndex];
+	std::unique_lock<std::mutex> lock(worker.mutex);
+	if(!worker.queue.empty())
+	{
+		item = std::move(worker.queue.back());
+		worker.queue.pop_back();
+		found = true;
+	}
+	lock.unlock();
+
+	for(size_t i=1; i<_workers.size() && !found; ++i)
+	{
+		Worker& victim = *_workers[(workerIndex + i) % _workers.size()];
+		std::lock_guard<std::mutex> victimLock(victim.mutex);
+		if(!victim.queue.empty())
+		{
+			item = std::move(victim.queue.front());
+			victim.queue.pop_front();
+			found = true;
+			stolen = true;
+		}
+	}
+
+	if(!found)
+		return false;
+
+	--_queuedTaskCount;
+	++worker.tasksPerformed;
+	if(stolen)
+		++worker.tasksStolen;
+	performTask(item);
+	return true;
+}
+
+void WorkStealingPool::performTask(QueueItem& item)
+{
+	TaskGroup& group = *item.second;
+	try {
+		item.first();
+	} catch(...) {
+		std::lock_guard<std::mutex> lock(group._exceptionMutex);
+		if(!group._exception)
+			group._exception = std::current_exception();
+	}
+	// The submitting worker might be waiting for this group
+	std::lock_guard<std::mutex> lock(_mutex);
+	if(--group._pending == 0)
+		_change.notify_all();
+}
+
+void WorkStealingPool::ReportStatistics() const
+{
+	const double runTime = _runTime.Seconds();
+	double busyTotal = 0.0;
+	for(size_t i=0; i!=_workers.size(); ++i)
+	{
+		const Worker& worker = *_workers[i];
+		const double busy = runTime > 0.0 ? 1.0 - worker.idleTime.Seconds() / runTime : 1.0;
+		busyTotal += busy;
+		Logger::Debug << "Worker " << i << ": " << worker.sourceItems << " work items, "
+			<< worker.tasksPerformed << " sub-tasks (" << worker.tasksStolen << " stolen), "
+			<< round(busy * 1000.0) / 10.0 << "% busy.\n";
+	}
+	if(!_workers.empty())
+		Logger::Info << "Worker utilization: " << round(busyTotal * 1000.0 / _workers.size()) / 10.0 << "% over " << _workers.size() << " threads.\n";
+}
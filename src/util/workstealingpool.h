@@ -0,0 +1,143 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "stopwatch.h"
+
+/**
+ * A pool of worker threads that each have their own queue of tasks.
+ *
+ * A worker takes tasks from the back of its own queue. When that queue is
+ * empty, it steals from the front of the queue of another worker, and when
+ * no tasks are queued at all, it asks the work source for a new item of work
+ * (e.g. the next baseline). Work items can be split up into sub-tasks with
+ * Submit() and Wait(). Idle workers steal these sub-tasks, so a few large work
+ * items at the end of a run do not leave the other workers idle.
+ *
+ * Each worker keeps its own counters, which are reported by
+ * ReportStatistics() after the run.
+ */
+class WorkStealingPool
+{
+	public:
+		typedef std::function<void()> Task;
+
+		enum SourceResult {
+			/** An item of work was performed */
+			WorkDone,
+			/** No work is available at this moment; wait for Notify() */
+			NoWorkAvailable,
+			/** All work has been handed out */
+			SourceFinished
+		};
+
+		/**
+		 * Called by idle workers to perform the next item of work. It should
+		 * not block when no work is available, but return NoWorkAvailable.
+		 */
+		typedef std::function<SourceResult(size_t workerIndex)> WorkSource;
+
+		/**
+		 * A set of submitted tasks that can be waited for.
+		 */
+		class TaskGroup
+		{
+			public:
+				TaskGroup() : _pending(0), _exceptionMutex(), _exception() { }
+
+				bool IsFinished() const { return _pending == 0; }
+			private:
+				friend class WorkStealingPool;
+
+				std::atomic<size_t> _pending;
+				std::mutex _exceptionMutex;
+				std::exception_ptr _exception;
+		};
+
+		explicit WorkStealingPool(size_t workerCount);
+
+		size_t WorkerCount() const { return _workers.size(); }
+
+		/**
+		 * Starts the workers and returns once the source is finished and all
+		 * tasks have been performed. An exception that escapes the source
+		 * is rethrown.
+		 */
+		void Run(const WorkSource& source);
+
+		/**
+		 * Wakes up idle workers, so that they call the source again. Should be
+		 * called when new work has become available or when the source has
+		 * finished.
+		 */
+		void Notify();
+
+		/**
+		 * Adds a task to the queue of the calling worker. May only be called from
+		 * within a worker of this pool, i.e. when Current() == this.
+		 */
+		void Submit(TaskGroup& group, Task task);
+
+		/**
+		 * Waits until all tasks of the group have been performed. The calling
+		 * worker performs queued tasks while waiting. If one of the tasks threw
+		 * an exception, it is rethrown here.
+		 */
+		void Wait(TaskGroup& group);
+
+		/**
+		 * The pool of which the calling thread is a worker, or nullptr.
+		 */
+		static WorkStealingPool* Current() { return _currentPool; }
+
+		/**
+		 * Logs the number of work items and tasks per worker, and the fraction of
+		 * the run time that the workers were busy.
+		 */
+		void ReportStatistics() const;
+
+	private:
+		typedef std::pair<Task, TaskGroup*> QueueItem;
+
+		struct Worker
+		{
+			Worker() : sourceItems(0), tasksPerformed(0), tasksStolen(0) { }
+
+			std::mutex mutex;
+			std::deque<QueueItem> queue;
+
+			// These are only changed by the worker itself
+			size_t sourceItems, tasksPerformed, tasksStolen;
+			Stopwatch idleTime;
+		};
+
+		void workerLoop(size_t workerIndex, const WorkSource& source);
+		bool performQueuedTask(size_t workerIndex);
+		void performTask(QueueItem& item);
+
+		std::vector<std::unique_ptr<Worker>> _workers;
+
+		std::mutex _mutex;
+		std::condition_variable _change;
+		std::atomic<size_t> _queuedTaskCount;
+		size_t _busyWorkers;
+		size_t _generation;
+		bool _sourceFinished;
+		std::exception_ptr _sourceException;
+		Stopwatch _runTime;
+
+		static thread_local WorkStealingPool* _currentPool;
+		static thread_local size_t _currentWorkerIndex;
+};
+
+#endif